@@ -0,0 +1,209 @@
+// shares a capture memory budget between many scrolling buffers, most of them nearly idle
+// busy:    a few writers output as fast as the pacing allows and should be grown to keep deep history
+// idle:    the rest write a short line every second and stay at the minimum size
+// exited:  half of the idle writers close part way through and are shrunk by the manager
+// returns a non-zero exit code if the rings ever exceed the budget or resizing corrupted the recent output
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <fmt/core.h>
+
+#include "buffer_manager.h"
+#include "scrolling_buffer.h"
+
+// every byte is derived from its absolute offset so the recent output can be checked after resizes
+static inline char get_pattern_byte(const uint64_t offset) {
+    return char('a' + (offset % 26));
+}
+
+static void write_pattern(app::ScrollingBuffer &buffer, const size_t size) {
+    const size_t length = std::min(size, buffer.GetMaxSize());
+    const uint64_t offset = buffer.GetTotalWritten();
+    char *data = buffer.GetWriteBuffer(length);
+    for (size_t i = 0; i < length; i++) {
+        data[i] = get_pattern_byte(offset + i);
+    }
+    buffer.IncrementIndex(length);
+}
+
+static bool check_pattern(const app::ScrollingBuffer &buffer) {
+    auto lock = buffer.LockRead();
+    const uint64_t total_written = buffer.GetTotalWritten();
+    const size_t length = size_t(std::min(total_written, uint64_t(buffer.GetMaxSize())));
+    const uint64_t offset = total_written - length;
+    const char *data = buffer.GetBufferAtOffset(offset);
+    for (size_t i = 0; i < length; i++) {
+        if (data[i] != get_pattern_byte(offset + i)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void print_usage(const char *name) {
+    fprintf(stderr,
+        "Usage: %s [--buffers N] [--busy N] [--budget-mb N] [--rate-mb N] [--seconds N]\n"
+        "    --buffers    Total buffers (default: 1000)\n"
+        "    --busy       Buffers with a fast writer (default: 4)\n"
+        "    --budget-mb  Capture memory budget (default: 128)\n"
+        "    --rate-mb    Output rate of each busy writer in MiB/s (default: 50)\n"
+        "    --seconds    Duration of the run (default: 10)\n",
+        name);
+}
+
+int main(int argc, char **argv) {
+    long total_buffers = 1000;
+    long total_busy = 4;
+    long budget_mb = 128;
+    long rate_mb = 50;
+    long total_seconds = 10;
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        const bool has_value = (i+1) < argc;
+        if ((strcmp(arg, "--buffers") == 0) && has_value) {
+            total_buffers = strtol(argv[++i], NULL, 10);
+        } else if ((strcmp(arg, "--busy") == 0) && has_value) {
+            total_busy = strtol(argv[++i], NULL, 10);
+        } else if ((strcmp(arg, "--budget-mb") == 0) && has_value) {
+            budget_mb = strtol(argv[++i], NULL, 10);
+        } else if ((strcmp(arg, "--rate-mb") == 0) && has_value) {
+            rate_mb = strtol(argv[++i], NULL, 10);
+        } else if ((strcmp(arg, "--seconds") == 0) && has_value) {
+            total_seconds = strtol(argv[++i], NULL, 10);
+        } else {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+    if ((total_buffers <= 0) || (total_busy < 0) || (total_busy > total_buffers) || (budget_mb <= 0) || (total_seconds <= 0)) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    const size_t MiB = 1024*1024;
+    const size_t budget = size_t(budget_mb) * MiB;
+    auto &manager = app::BufferManager::Get();
+
+    std::vector<std::unique_ptr<app::ScrollingBuffer>> buffers;
+    try {
+        for (long i = 0; i < total_buffers; i++) {
+            buffers.push_back(std::make_unique<app::ScrollingBuffer>());
+            manager.Register(buffers.back().get());
+        }
+    } catch (std::exception &ex) {
+        fmt::print(stderr, "Benchmark failed: {}\n", ex.what());
+        return 1;
+    }
+    manager.SetBudget(budget);
+
+    std::atomic<bool> is_running = true;
+    const auto start = std::chrono::steady_clock::now();
+    const auto duration = std::chrono::seconds(total_seconds);
+
+    // paced in 1ms steps like a listener thread draining a pipe
+    std::vector<std::thread> busy_threads;
+    for (long i = 0; i < total_busy; i++) {
+        busy_threads.emplace_back([&is_running, &buffer = *buffers[size_t(i)], rate_mb]() {
+            const size_t bytes_per_step = size_t(rate_mb) * 1024 * 1024 / 1000;
+            auto next_step = std::chrono::steady_clock::now();
+            while (is_running) {
+                buffer.ApplyResize();
+                for (size_t written = 0; written < bytes_per_step;) {
+                    const size_t length = std::min(bytes_per_step - written, buffer.GetMaxSize());
+                    write_pattern(buffer, length);
+                    written += length;
+                }
+                next_step += std::chrono::milliseconds(1);
+                std::this_thread::sleep_until(next_step);
+            }
+            buffer.CloseWriter();
+        });
+    }
+
+    // one thread stands in for the listener threads of all the idle processes
+    std::thread idle_thread([&]() {
+        auto next_line = std::chrono::steady_clock::now();
+        bool is_half_closed = false;
+        while (is_running) {
+            const auto now = std::chrono::steady_clock::now();
+            const bool is_line = now >= next_line;
+            if (is_line) {
+                next_line = now + std::chrono::seconds(1);
+            }
+            const bool is_close = !is_half_closed && ((now - start) > (duration / 2));
+            for (size_t i = size_t(total_busy); i < buffers.size(); i++) {
+                auto &buffer = *buffers[i];
+                if (buffer.IsWriterClosed()) {
+                    continue;
+                }
+                if (is_close && ((i % 2) == 0)) {
+                    buffer.CloseWriter();
+                    continue;
+                }
+                buffer.ApplyResize();
+                if (is_line) {
+                    write_pattern(buffer, 64);
+                }
+            }
+            is_half_closed = is_half_closed || is_close;
+            std::this_thread::sleep_for(std::chrono::milliseconds(16));
+        }
+    });
+
+    size_t peak_size = 0;
+    size_t peak_largest = 0;
+    while ((std::chrono::steady_clock::now() - start) < duration) {
+        const auto stats = manager.GetStats();
+        peak_size = std::max(peak_size, stats.total_size);
+        peak_largest = std::max(peak_largest, stats.largest_size);
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+    const auto final_stats = manager.GetStats();
+    size_t busy_size = 0;
+    for (long i = 0; i < total_busy; i++) {
+        busy_size += buffers[size_t(i)]->GetMaxSize();
+    }
+
+    is_running = false;
+    for (auto &thread: busy_threads) {
+        thread.join();
+    }
+    idle_thread.join();
+    size_t total_corrupt = 0;
+    for (auto &buffer: buffers) {
+        total_corrupt += check_pattern(*buffer) ? 0 : 1;
+    }
+    for (auto &buffer: buffers) {
+        manager.Unregister(buffer.get());
+    }
+
+    fmt::print("{} buffers ({} busy at {} MiB/s), {} MiB budget, {} s\n", total_buffers, total_busy, rate_mb, budget_mb, total_seconds);
+    fmt::print("{:<28} {:>10.2f}\n", "peak total (MiB)", double(peak_size) / double(MiB));
+    fmt::print("{:<28} {:>10.2f}\n", "final total (MiB)", double(final_stats.total_size) / double(MiB));
+    fmt::print("{:<28} {:>10.2f}\n", "peak largest ring (MiB)", double(peak_largest) / double(MiB));
+    fmt::print("{:<28} {:>10.2f}\n", "busy ring average (MiB)", (total_busy > 0) ? (double(busy_size) / double(total_busy) / double(MiB)) : 0.0);
+    fmt::print("{:<28} {:>10}\n", "grown rings", final_stats.total_grown);
+    fmt::print("{:<28} {:>10}\n", "corrupt rings", total_corrupt);
+
+    bool is_passed = true;
+    // the budget can't go below the minimum ring size for every buffer
+    const size_t min_total = size_t(total_buffers) * app::ScrollingBuffer::MIN_SIZE;
+    if (peak_size > std::max(budget, min_total)) {
+        fmt::print(stderr, "Rings exceeded the budget by {} bytes\n", peak_size - std::max(budget, min_total));
+        is_passed = false;
+    }
+    if (total_corrupt > 0) {
+        fmt::print(stderr, "{} rings lost their recent output after a resize\n", total_corrupt);
+        is_passed = false;
+    }
+    return is_passed ? 0 : 1;
+}
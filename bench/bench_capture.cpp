@@ -0,0 +1,282 @@
+// output capture benchmark
+// runs capture_child in stream mode through AppProcess and ScrollingBuffer and measures
+// - sustained throughput of the capture path
+// - latency from the child writing a chunk to the chunk being visible to a consumer
+// - cpu time spent by the capture path per megabyte
+// - bytes dropped by the scrolling buffer and chunks never seen by the consumer
+// results are written as json so runs can be compared across changes
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <fstream>
+#include <algorithm>
+#include <filesystem>
+
+#include <fmt/core.h>
+#include <rapidjson/stringbuffer.h>
+#include <rapidjson/prettywriter.h>
+
+#include "app_process.h"
+#include "app_schema.h"
+#include "environ.h"
+#include "bench_utils.h"
+
+namespace fs = std::filesystem;
+using bench::get_timestamp_ns;
+
+struct BenchConfig {
+    long chunk_size = 4096;
+    long long rate = 0;
+    long duration_ms = 2000;
+    std::string stream = "stdout";
+    app::CaptureMode capture_mode = app::CaptureMode::LOSSY;
+    bool use_pty = false;
+    long poll_us = 1000;
+};
+
+struct BenchResults {
+    double elapsed_seconds = 0.0;
+    double cpu_seconds = 0.0;
+    app::ScrollingBufferStats stats;
+    std::vector<int64_t> latencies_ns;
+    long long chunks_expected = -1;
+    uint64_t consumer_skipped_bytes = 0;
+    uint64_t consumer_torn_reads = 0;
+};
+
+// consumer which follows the scrolling buffer by absolute offset
+class ChunkConsumer
+{
+private:
+    std::string m_line;
+    BenchResults &m_results;
+public:
+    ChunkConsumer(BenchResults &results): m_results(results) {}
+    void Consume(const char *data, const size_t length, const int64_t visible_ns) {
+        for (size_t i = 0; i < length; i++) {
+            const char c = data[i];
+            if (c != '\n') {
+                m_line.push_back(c);
+                continue;
+            }
+            ParseLine(visible_ns);
+            m_line.clear();
+        }
+    }
+    void Reset() { m_line.clear(); }
+private:
+    void ParseLine(const int64_t visible_ns) {
+        long long sequence = 0;
+        long long timestamp = 0;
+        long long total = 0;
+        // a pseudo terminal can prefix lines with escape sequences, so find our markers
+        const auto chunk_marker = m_line.find('@');
+        if ((chunk_marker != std::string::npos) &&
+            (sscanf(m_line.c_str() + chunk_marker, "@%lld:%lld:", &sequence, &timestamp) == 2))
+        {
+            m_results.latencies_ns.push_back(visible_ns - int64_t(timestamp));
+            return;
+        }
+        const auto total_marker = m_line.find("#total:");
+        if ((total_marker != std::string::npos) &&
+            (sscanf(m_line.c_str() + total_marker, "#total:%lld", &total) == 1))
+        {
+            m_results.chunks_expected = total;
+        }
+    }
+};
+
+static BenchResults run_bench(const BenchConfig &bench_cfg, app::AppConfig &cfg, app::environment_t &parent_env) {
+    BenchResults results;
+    ChunkConsumer consumer(results);
+
+    const double start_process_cpu = bench::get_process_cpu_seconds();
+    const double start_thread_cpu = bench::get_thread_cpu_seconds();
+    const auto start = std::chrono::steady_clock::now();
+
+    auto process = app::AppProcess(cfg, parent_env);
+    auto &buffer = process.GetBuffer();
+    uint64_t read_offset = 0;
+
+    while (true) {
+        // check state before reading so the final output is always consumed
+        const bool is_terminated = (process.GetState() == app::AppProcess::State::TERMINATED);
+        {
+            // the buffer manager can resize the ring between polls, so it is only read under the lock
+            auto lock = buffer.LockRead();
+            const uint64_t max_size = buffer.GetMaxSize();
+            const uint64_t total_written = buffer.GetTotalWritten();
+            const int64_t visible_ns = get_timestamp_ns();
+
+            if ((total_written - read_offset) > max_size) {
+                results.consumer_skipped_bytes += (total_written - max_size - read_offset);
+                read_offset = total_written - max_size;
+                consumer.Reset();
+            }
+
+            const uint64_t read_start = read_offset;
+            consumer.Consume(buffer.GetBufferAtOffset(read_offset), size_t(total_written - read_offset), visible_ns);
+            read_offset = total_written;
+            buffer.MarkConsumed(read_offset);
+
+            // the writer lapped us while we were parsing so some of the bytes might have been overwritten
+            if ((buffer.GetWriteEnd() - read_start) > max_size) {
+                results.consumer_torn_reads++;
+            }
+        }
+
+        if (is_terminated) {
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(bench_cfg.poll_us));
+    }
+
+    const auto end = std::chrono::steady_clock::now();
+    // exclude the consumer's parsing from the cpu time of the capture path
+    const double consumer_cpu = bench::get_thread_cpu_seconds() - start_thread_cpu;
+    results.cpu_seconds = (bench::get_process_cpu_seconds() - start_process_cpu) - consumer_cpu;
+    results.elapsed_seconds = std::chrono::duration<double>(end - start).count();
+    results.stats = buffer.GetStats();
+    return results;
+}
+
+static std::string create_results_json(const BenchConfig &bench_cfg, BenchResults &results) {
+    auto &x = results.latencies_ns;
+    std::sort(x.begin(), x.end());
+    auto percentile = [&x](double p) -> int64_t {
+        if (x.size() == 0) {
+            return 0;
+        }
+        const size_t i = std::min(size_t(p * double(x.size())), x.size()-1);
+        return x[i];
+    };
+
+    const double MB = 1e6;
+    const double total_mb = double(results.stats.total_captured) / MB;
+    const long long chunks_received = (long long)(x.size());
+
+    rapidjson::StringBuffer sb;
+    rapidjson::PrettyWriter<rapidjson::StringBuffer> writer(sb);
+    writer.SetIndent(' ', 1);
+
+    writer.StartObject();
+
+    writer.Key("config");
+    writer.StartObject();
+    writer.Key("chunk_size");       writer.Int64(bench_cfg.chunk_size);
+    writer.Key("rate");             writer.Int64(bench_cfg.rate);
+    writer.Key("duration_ms");      writer.Int64(bench_cfg.duration_ms);
+    writer.Key("stream");           writer.String(bench_cfg.stream.c_str());
+    writer.Key("capture_mode");     writer.String(app::capture_mode_to_string(bench_cfg.capture_mode));
+    writer.Key("use_pty");          writer.Bool(bench_cfg.use_pty);
+    writer.Key("poll_us");          writer.Int64(bench_cfg.poll_us);
+    writer.EndObject();
+
+    writer.Key("results");
+    writer.StartObject();
+    writer.Key("elapsed_seconds");      writer.Double(results.elapsed_seconds);
+    writer.Key("bytes_captured");       writer.Uint64(results.stats.total_captured);
+    writer.Key("throughput_mb_per_s");  writer.Double(total_mb / results.elapsed_seconds);
+    writer.Key("cpu_seconds");          writer.Double(results.cpu_seconds);
+    writer.Key("cpu_seconds_per_mb");   writer.Double((total_mb > 0.0) ? (results.cpu_seconds / total_mb) : 0.0);
+    writer.Key("latency_ns");
+    writer.StartObject();
+    writer.Key("count");    writer.Uint64(x.size());
+    writer.Key("p50");      writer.Int64(percentile(0.5));
+    writer.Key("p99");      writer.Int64(percentile(0.99));
+    writer.Key("p999");     writer.Int64(percentile(0.999));
+    writer.Key("max");      writer.Int64(percentile(1.0));
+    writer.EndObject();
+    writer.Key("dropped_bytes");            writer.Uint64(results.stats.total_dropped);
+    writer.Key("peak_pending_bytes");       writer.Uint64(results.stats.peak_pending_size);
+    writer.Key("chunks_expected");          writer.Int64(results.chunks_expected);
+    writer.Key("chunks_received");          writer.Int64(chunks_received);
+    writer.Key("chunks_missing");           writer.Int64(std::max(results.chunks_expected - chunks_received, 0LL));
+    writer.Key("consumer_skipped_bytes");   writer.Uint64(results.consumer_skipped_bytes);
+    writer.Key("consumer_torn_reads");      writer.Uint64(results.consumer_torn_reads);
+    writer.EndObject();
+
+    writer.EndObject();
+    return std::string(sb.GetString());
+}
+
+static void print_usage(const char *name) {
+    fprintf(stderr,
+        "Usage: %s [options]\n"
+        "    --chunk-size N     Size of each chunk written by the child (default: 4096)\n"
+        "    --rate N           Target bytes per second, 0 is unlimited (default: 0)\n"
+        "    --duration-ms N    How long the child writes for (default: 2000)\n"
+        "    --stream S         stdout, stderr or both (default: stdout)\n"
+        "    --capture-mode M   lossy or lossless (default: lossy)\n"
+        "    --pty              Launch the child with a pseudo terminal\n"
+        "    --poll-us N        Delay between consumer polls in microseconds (default: 1000)\n"
+        "    --output PATH      Also write the json results to a file\n"
+        "    --child PATH       Path to capture_child (default: next to this executable)\n",
+        name);
+}
+
+int main(int argc, char **argv) {
+    BenchConfig bench_cfg;
+    fs::path child_path = bench::get_default_child_path(argv[0]);
+    std::string output_path;
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        const bool has_value = (i+1) < argc;
+        if ((strcmp(arg, "--chunk-size") == 0) && has_value) {
+            bench_cfg.chunk_size = strtol(argv[++i], NULL, 10);
+        } else if ((strcmp(arg, "--rate") == 0) && has_value) {
+            bench_cfg.rate = strtoll(argv[++i], NULL, 10);
+        } else if ((strcmp(arg, "--duration-ms") == 0) && has_value) {
+            bench_cfg.duration_ms = strtol(argv[++i], NULL, 10);
+        } else if ((strcmp(arg, "--stream") == 0) && has_value) {
+            bench_cfg.stream = argv[++i];
+        } else if ((strcmp(arg, "--capture-mode") == 0) && has_value) {
+            bench_cfg.capture_mode = app::capture_mode_from_string(argv[++i]);
+        } else if (strcmp(arg, "--pty") == 0) {
+            bench_cfg.use_pty = true;
+        } else if ((strcmp(arg, "--poll-us") == 0) && has_value) {
+            bench_cfg.poll_us = strtol(argv[++i], NULL, 10);
+        } else if ((strcmp(arg, "--output") == 0) && has_value) {
+            output_path = argv[++i];
+        } else if ((strcmp(arg, "--child") == 0) && has_value) {
+            child_path = fs::absolute(fs::path(argv[++i]));
+        } else {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    try {
+        auto cfg = bench::create_bench_app_config(child_path,
+            fmt::format("--duration-ms {} --rate {} --chunk-size {} --stream {}",
+                bench_cfg.duration_ms, bench_cfg.rate, bench_cfg.chunk_size, bench_cfg.stream));
+        cfg.capture_mode = bench_cfg.capture_mode;
+        cfg.use_pty = bench_cfg.use_pty;
+        auto parent_env = app::get_env();
+
+        auto results = run_bench(bench_cfg, cfg, parent_env);
+        auto json = create_results_json(bench_cfg, results);
+        fmt::print("{}\n", json);
+
+        if (!output_path.empty()) {
+            std::ofstream file(output_path);
+            if (!file.is_open()) {
+                fmt::print(stderr, "Failed to open output file ({})\n", output_path);
+                return 1;
+            }
+            file << json << std::endl;
+        }
+    } catch (std::exception &ex) {
+        fmt::print(stderr, "Benchmark failed: {}\n", ex.what());
+        return 1;
+    }
+
+    return 0;
+}
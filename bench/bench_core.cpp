@@ -0,0 +1,487 @@
+// microbenchmarks of the core routines which don't need a gui or a child process
+// scrolling buffer:    writes into the ring and the gui's read path over the whole ring (buffer size)
+// environment:         reading, building and serialising environments (env size)
+// configs:             loading, validating, serialising and applying changes to app configs (config count)
+// triggers:            scanning log output for trigger patterns with the automaton (pattern count)
+// transcoding:         converting captured output to utf-8 (encoding, share of non-ascii text)
+// styles:              parsing colours out of a test runner log and looking up the runs of the visible lines (share of coloured lines)
+// layout:              wrapping the output pane's lines while tailing and after a resize (line count)
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <memory>
+#include <filesystem>
+
+#include <benchmark/benchmark.h>
+#include <fmt/core.h>
+
+#include "app_schema.h"
+#include "environ.h"
+#include "managed_config.h"
+#include "platform.h"
+#include "scrolling_buffer.h"
+#include "trigger_automaton.h"
+#include "output_transcoder.h"
+#include "output_styles.h"
+#include "output_layout.h"
+#include "bench_utils.h"
+
+namespace fs = std::filesystem;
+
+static constexpr size_t WRITE_CHUNK_SIZE = 4096;
+
+static std::vector<char> create_lines(const size_t size) {
+    std::vector<char> data(size);
+    for (size_t i = 0; i < size; i++) {
+        data[i] = ((i % 80) == 79) ? '\n' : char('a' + (i % 26));
+    }
+    return data;
+}
+
+static app::AppConfig create_app_config(const size_t index) {
+    app::AppConfig cfg;
+    cfg.name = fmt::format("app_{}", index);
+    cfg.username = "bench";
+    cfg.exec_path = fmt::format("C:/tools/app_{}/app.exe", index);
+    cfg.exec_cwd = fmt::format("C:/tools/app_{}", index);
+    cfg.args = "--verbose --port 8080";
+    cfg.env_name = "bench";
+    cfg.env_config_path = "res/default_env.json";
+    cfg.env_parent_dir = "envs";
+    if (index > 0) {
+        cfg.depends_on = { fmt::format("app_{}", index-1) };
+    }
+    cfg.ready_pattern = "listening";
+    return cfg;
+}
+
+static std::vector<app::AppConfig> create_app_configs(const size_t total_configs) {
+    std::vector<app::AppConfig> cfgs;
+    for (size_t i = 0; i < total_configs; i++) {
+        cfgs.push_back(create_app_config(i));
+    }
+    return cfgs;
+}
+
+static app::environment_t create_environment(const size_t total_variables) {
+    app::environment_t env;
+    for (size_t i = 0; i < total_variables; i++) {
+        env[fmt::format("BENCH_VARIABLE_{}", i)] = fmt::format("C:/some/fairly/long/path/number/{}", i);
+    }
+    return env;
+}
+
+// scrolling buffer
+static void BM_ScrollingBufferWrite(benchmark::State &state) {
+    app::ScrollingBuffer buffer(size_t(state.range(0)));
+    const auto data = create_lines(WRITE_CHUNK_SIZE);
+    for (auto _: state) {
+        memcpy(buffer.GetWriteBuffer(data.size()), data.data(), data.size());
+        buffer.IncrementIndex(data.size());
+    }
+    state.SetBytesProcessed(int64_t(state.iterations()) * int64_t(data.size()));
+}
+
+// lock the ring and find every line in it, which the output layout only does for new output
+static void BM_ScrollingBufferRead(benchmark::State &state) {
+    app::ScrollingBuffer buffer(size_t(state.range(0)));
+    const auto data = create_lines(WRITE_CHUNK_SIZE);
+    while (buffer.GetTotalWritten() < uint64_t(buffer.GetMaxSize())) {
+        memcpy(buffer.GetWriteBuffer(data.size()), data.data(), data.size());
+        buffer.IncrementIndex(data.size());
+    }
+
+    std::vector<size_t> line_offsets;
+    for (auto _: state) {
+        auto lock = buffer.LockRead();
+        const uint64_t total_written = buffer.GetTotalWritten();
+        const size_t length = size_t(std::min(total_written, uint64_t(buffer.GetMaxSize())));
+        const char *begin = buffer.GetBufferAtOffset(total_written - length);
+        const char *end = begin + length;
+        line_offsets.clear();
+        for (const char *line = begin; line < end;) {
+            line_offsets.push_back(size_t(line - begin));
+            const char *line_end = (const char *)(memchr(line, '\n', size_t(end - line)));
+            line = (line_end != nullptr) ? (line_end + 1) : end;
+        }
+        benchmark::DoNotOptimize(line_offsets.data());
+        buffer.MarkConsumed(total_written);
+    }
+    state.SetBytesProcessed(int64_t(state.iterations()) * int64_t(buffer.GetMaxSize()));
+}
+
+// environment
+static void BM_GetEnv(benchmark::State &state) {
+    // grow our own environment so get_env() has more to read
+    const auto extra_env = create_environment(size_t(state.range(0)));
+    for (auto &[key, value]: extra_env) {
+        app::platform::set_env_variable(key, value);
+    }
+    for (auto _: state) {
+        auto env = app::get_env();
+        benchmark::DoNotOptimize(env.size());
+    }
+    for (auto &[key, value]: extra_env) {
+        app::platform::unset_env_variable(key);
+    }
+}
+
+static void BM_CreateEnvString(benchmark::State &state) {
+    auto env = create_environment(size_t(state.range(0)));
+    for (auto _: state) {
+        auto env_str = app::create_env_string(env);
+        benchmark::DoNotOptimize(env_str.data());
+    }
+}
+
+// the directories already exist after the first iteration, the same as relaunching an app
+static void BM_CreateEnvFromCfg(benchmark::State &state) {
+    const size_t total_variables = size_t(state.range(0));
+    auto orig = create_environment(total_variables);
+    app::EnvConfig cfg;
+    cfg.env_directories = {
+        { "HOME",           "{root}/home/{username}" },
+        { "APPDATA",        "{root}/home/{username}/AppData/Roaming" },
+        { "LOCALAPPDATA",   "{root}/home/{username}/AppData/Local" },
+        { "TEMP",           "{root}/tmp" },
+    };
+    for (size_t i = 0; i < total_variables; i += 2) {
+        cfg.pass_through_variables.push_back(fmt::format("BENCH_VARIABLE_{}", i));
+    }
+    for (size_t i = 0; i < total_variables/8; i++) {
+        cfg.override_variables[fmt::format("BENCH_OVERRIDE_{}", i)] = "{root}/override/{username}";
+    }
+    app::EnvParams params;
+    params.root = (bench::get_bench_directory() / "envs" / "bench_core").string();
+    params.username = "bench";
+
+    for (auto _: state) {
+        auto env = app::create_env_from_cfg(orig, cfg, params);
+        benchmark::DoNotOptimize(env.size());
+    }
+}
+
+// configs
+static void BM_LoadAppConfigs(benchmark::State &state) {
+    auto cfgs = create_app_configs(size_t(state.range(0)));
+    auto doc = app::create_app_configs_doc(cfgs);
+    for (auto _: state) {
+        auto loaded_cfgs = app::load_app_configs(doc);
+        benchmark::DoNotOptimize(loaded_cfgs.data());
+    }
+}
+
+static void BM_ValidateDocument(benchmark::State &state) {
+    auto cfgs = create_app_configs(size_t(state.range(0)));
+    auto doc = app::create_app_configs_doc(cfgs);
+    for (auto _: state) {
+        const bool is_valid = app::validate_document(doc, app::APPS_SCHEMA);
+        if (!is_valid) {
+            state.SkipWithError("Generated configs failed validation");
+            break;
+        }
+    }
+}
+
+static void BM_CreateAppConfigsDoc(benchmark::State &state) {
+    auto cfgs = create_app_configs(size_t(state.range(0)));
+    for (auto _: state) {
+        auto doc = app::create_app_configs_doc(cfgs);
+        benchmark::DoNotOptimize(doc.MemberCount());
+    }
+}
+
+// an edit to every 8th config then applying all of them, like saving after a few edits in the gui
+static void BM_ManagedConfigListApplyChanges(benchmark::State &state) {
+    auto cfgs = create_app_configs(size_t(state.range(0)));
+    app::ManagedConfigList list;
+    for (auto &cfg: cfgs) {
+        list.Add(cfg);
+    }
+    list.ApplyChanges();
+
+    size_t total_edits = 0;
+    for (auto _: state) {
+        size_t index = 0;
+        for (auto &managed_cfg: list.GetConfigs()) {
+            if ((index++ % 8) == 0) {
+                managed_cfg->GetConfig().args = fmt::format("--edit {}", total_edits++);
+                managed_cfg->SetStatus(app::ManagedConfig::Status::CHANGED);
+            }
+        }
+        list.ApplyChanges();
+    }
+}
+
+// a clean list is the slow case since every config has to be checked
+static void BM_ManagedConfigListIsDirty(benchmark::State &state) {
+    auto cfgs = create_app_configs(size_t(state.range(0)));
+    app::ManagedConfigList list;
+    for (auto &cfg: cfgs) {
+        list.Add(cfg);
+    }
+    list.ApplyChanges();
+    for (auto _: state) {
+        benchmark::DoNotOptimize(list.IsDirty());
+    }
+}
+
+// triggers
+static std::vector<char> create_log_lines(const size_t size) {
+    static const char *LINES[] = {
+        "2024-05-01 12:00:00.000 INFO request handled in 12ms\n",
+        "2024-05-01 12:00:00.001 DEBUG cache hit for key user:1234\n",
+        "2024-05-01 12:00:00.002 INFO connection accepted from 10.0.0.1:51234\n",
+        "2024-05-01 12:00:00.003 WARN slow query took 250ms\n",
+    };
+    std::vector<char> data;
+    data.reserve(size);
+    for (size_t i = 0; data.size() < size; i++) {
+        const char *line = LINES[(i * 7) % 4];
+        data.insert(data.end(), line, line + strlen(line));
+    }
+    data.resize(size);
+    return data;
+}
+
+static std::vector<std::string> create_trigger_patterns(const size_t total_patterns) {
+    static const char *PATTERNS[] = {
+        "ERROR", "Segmentation fault", "Server started", "panic:", "Traceback", "FATAL", "assertion failed",
+        "out of memory", "deadlock", "timed out", "refused", "Exception", "core dumped", "disk full",
+    };
+    const size_t total_named = sizeof(PATTERNS) / sizeof(PATTERNS[0]);
+    std::vector<std::string> patterns;
+    for (size_t i = 0; i < total_patterns; i++) {
+        patterns.push_back((i < total_named) ? PATTERNS[i] : fmt::format("error code {}", i));
+    }
+    return patterns;
+}
+
+// all the triggers of a process over captured output in the chunks the listener reads
+static void BM_TriggerScan(benchmark::State &state) {
+    auto automaton = app::TriggerAutomaton(create_trigger_patterns(size_t(state.range(0))));
+    const auto data = create_log_lines(app::ScrollingBuffer::MIN_SIZE);
+    size_t total_matches = 0;
+    for (auto _: state) {
+        for (size_t offset = 0; offset < data.size(); offset += WRITE_CHUNK_SIZE) {
+            automaton.Scan(data.data() + offset, WRITE_CHUNK_SIZE, [&total_matches](const uint32_t, const size_t) {
+                total_matches++;
+            });
+        }
+    }
+    benchmark::DoNotOptimize(total_matches);
+    state.SetBytesProcessed(int64_t(state.iterations()) * int64_t(data.size()));
+}
+
+// transcoding
+// percent_non_ascii of the characters are cyrillic, which takes the slow path in every encoding
+static std::vector<char> create_encoded_lines(const app::OutputEncoding encoding, const size_t size, const int64_t percent_non_ascii) {
+    std::vector<char> data;
+    data.reserve(size);
+    for (size_t i = 0; data.size() < size; i++) {
+        const bool is_non_ascii = (int64_t(i % 100) < percent_non_ascii);
+        const uint16_t c = ((i % 80) == 79) ? uint16_t('\n') : is_non_ascii ? uint16_t(0x430 + (i % 32)) : uint16_t('a' + (i % 26));
+        if (encoding == app::OutputEncoding::UTF16LE) {
+            data.push_back(char(c & 0xFF));
+            data.push_back(char(c >> 8));
+        } else {
+            // any byte with the top bit set goes through the codepage table
+            data.push_back((c < 0x80) ? char(c) : char(0x80 | (c & 0x7F)));
+        }
+    }
+    data.resize(size);
+    return data;
+}
+
+static void BM_TranscodeOutput(benchmark::State &state) {
+    const auto encoding = app::OutputEncoding(state.range(0));
+    const auto data = create_encoded_lines(encoding, app::ScrollingBuffer::MIN_SIZE, state.range(1));
+    auto transcoder = app::OutputTranscoder(encoding);
+    auto output = std::vector<char>(app::OutputTranscoder::GetMaxOutputSize(WRITE_CHUNK_SIZE));
+    size_t total_written = 0;
+    for (auto _: state) {
+        for (size_t offset = 0; offset < data.size(); offset += WRITE_CHUNK_SIZE) {
+            total_written += transcoder.Convert(data.data() + offset, WRITE_CHUNK_SIZE, output.data());
+        }
+    }
+    benchmark::DoNotOptimize(total_written);
+    state.SetBytesProcessed(int64_t(state.iterations()) * int64_t(data.size()));
+}
+
+// styles
+// test runner output where percent_coloured of the lines have several coloured spans
+static std::vector<char> create_coloured_lines(const size_t size, const int64_t percent_coloured) {
+    std::vector<char> data;
+    data.reserve(size + 256);
+    for (size_t i = 0; data.size() < size; i++) {
+        std::string line;
+        if (int64_t(i % 100) < percent_coloured) {
+            line = fmt::format("\x1b[1m\x1b[32m[ OK ]\x1b[0m suite.test_case_{} (\x1b[38;5;208m{} ms\x1b[0m) \x1b[2mfrom worker {}\x1b[22m\n", i, i % 97, i % 8);
+        } else {
+            line = fmt::format("[ RUN ] suite.test_case_{} on worker {}\n", i, i % 8);
+        }
+        data.insert(data.end(), line.begin(), line.end());
+    }
+    data.resize(size);
+    return data;
+}
+
+static void BM_ParseStyles(benchmark::State &state) {
+    const auto data = create_coloured_lines(app::ScrollingBuffer::MIN_SIZE, state.range(0));
+    auto buffer = std::vector<char>(WRITE_CHUNK_SIZE);
+    auto styles = std::make_unique<app::OutputStyles>();
+    uint64_t offset = 0;
+    for (auto _: state) {
+        for (size_t i = 0; i < data.size(); i += WRITE_CHUNK_SIZE) {
+            memcpy(buffer.data(), data.data() + i, WRITE_CHUNK_SIZE);
+            const uint64_t begin_offset = offset - std::min(offset, uint64_t(app::ScrollingBuffer::MIN_SIZE));
+            offset += styles->Parse(buffer.data(), WRITE_CHUNK_SIZE, offset, begin_offset);
+        }
+    }
+    state.SetBytesProcessed(int64_t(state.iterations()) * int64_t(data.size()));
+}
+
+// the lookups the output pane does for a screen of lines, scrolling through the ring
+static void BM_GetVisibleStyleRuns(benchmark::State &state) {
+    constexpr size_t TOTAL_VISIBLE_LINES = 64;
+    auto data = create_coloured_lines(app::ScrollingBuffer::MIN_SIZE * 16, state.range(0));
+    auto styles = std::make_unique<app::OutputStyles>();
+    const size_t length = styles->Parse(data.data(), data.size(), 0, 0);
+    std::vector<size_t> line_offsets;
+    for (size_t i = 0; i < length; i++) {
+        if (data[i] == '\n') {
+            line_offsets.push_back(i + 1);
+        }
+    }
+    std::vector<app::StyleRun> runs;
+    size_t first_line = 0;
+    size_t total_spans = 0;
+    for (auto _: state) {
+        first_line = (first_line + TOTAL_VISIBLE_LINES) % (line_offsets.size() - TOTAL_VISIBLE_LINES - 1);
+        styles->GetRuns(line_offsets[first_line], line_offsets[first_line + TOTAL_VISIBLE_LINES], runs);
+        for (size_t i = first_line; i < (first_line + TOTAL_VISIBLE_LINES); i++) {
+            auto run = std::upper_bound(runs.begin(), runs.end(), line_offsets[i], [](const uint64_t offset, const app::StyleRun &other) {
+                return offset < other.offset;
+            });
+            for (; (run != runs.end()) && (run->offset < line_offsets[i+1]); ++run) {
+                total_spans++;
+            }
+        }
+    }
+    benchmark::DoNotOptimize(total_spans);
+    state.SetItemsProcessed(int64_t(state.iterations()) * int64_t(TOTAL_VISIBLE_LINES));
+}
+
+// layout
+// log lines from a few words to several rows long
+static std::vector<char> create_wrapped_lines(const size_t total_lines) {
+    std::vector<char> data;
+    for (size_t i = 0; i < total_lines; i++) {
+        const size_t length = 16 + (i*37) % 320;
+        for (size_t j = 0; j < length; j++) {
+            data.push_back(((j % 8) == 7) ? ' ' : char('a' + ((i + j) % 26)));
+        }
+        data.push_back('\n');
+    }
+    return data;
+}
+
+// stands in for imgui's word wrap with characters which are all the same width
+static uint32_t measure_fixed_width(const char *begin, const char *end, const size_t total_columns) {
+    return uint32_t((size_t(end - begin) + total_columns - 1) / total_columns);
+}
+
+// a frame of the output pane while the process keeps printing, scrolling through the ring
+static void BM_OutputLayoutFrame(benchmark::State &state) {
+    constexpr uint64_t TOTAL_VISIBLE_ROWS = 64;
+    constexpr size_t TOTAL_COLUMNS = 120;
+    const auto data = create_wrapped_lines(size_t(state.range(0)) * 2);
+    // the ring holds half of the output so lines are dropped as new ones are added
+    const uint64_t max_size = uint64_t(data.size() / 2);
+    const auto measure = [](const char *begin, const char *end) {
+        return measure_fixed_width(begin, end, TOTAL_COLUMNS);
+    };
+    app::OutputLayout layout;
+    layout.SetWrapWidth(float(TOTAL_COLUMNS), 1.0f);
+    layout.Update(data.data(), 0, max_size);
+    uint64_t end_offset = max_size;
+    uint64_t scroll_row = 0;
+    size_t total_rows_drawn = 0;
+    for (auto _: state) {
+        if ((end_offset + WRITE_CHUNK_SIZE) > uint64_t(data.size())) {
+            state.PauseTiming();
+            end_offset = max_size;
+            layout.Reset();
+            layout.Update(data.data(), 0, max_size);
+            state.ResumeTiming();
+        }
+        end_offset += WRITE_CHUNK_SIZE;
+        const uint64_t begin_offset = end_offset - max_size;
+        layout.Update(data.data() + begin_offset, begin_offset, end_offset);
+        scroll_row = (scroll_row + TOTAL_VISIBLE_ROWS*16) % layout.GetTotalRows();
+        uint32_t line_row = 0;
+        const size_t first_line = layout.FindRow(scroll_row, line_row);
+        layout.Measure(first_line, TOTAL_VISIBLE_ROWS, app::OutputLayout::MEASURE_BUDGET, measure);
+        // the clipper only needs the lines of the visible rows
+        const size_t last_line = layout.FindRow(scroll_row + TOTAL_VISIBLE_ROWS - 1, line_row);
+        for (size_t line = first_line; line <= last_line; line++) {
+            total_rows_drawn += layout.GetLineRows(line);
+        }
+    }
+    benchmark::DoNotOptimize(total_rows_drawn);
+    state.SetItemsProcessed(int64_t(state.iterations()));
+}
+
+// the frame after the pane is resized, every line is estimated again and the visible ones are measured
+static void BM_OutputLayoutResize(benchmark::State &state) {
+    constexpr uint64_t TOTAL_VISIBLE_ROWS = 64;
+    const auto data = create_wrapped_lines(size_t(state.range(0)));
+    size_t total_columns = 120;
+    const auto measure = [&total_columns](const char *begin, const char *end) {
+        return measure_fixed_width(begin, end, total_columns);
+    };
+    app::OutputLayout layout;
+    layout.SetWrapWidth(float(total_columns), 1.0f);
+    layout.Update(data.data(), 0, uint64_t(data.size()));
+    const size_t first_line = layout.GetTotalLines() / 2;
+    for (auto _: state) {
+        total_columns = (total_columns == 120) ? 100 : 120;
+        layout.SetWrapWidth(float(total_columns), 1.0f);
+        layout.Measure(first_line, TOTAL_VISIBLE_ROWS, app::OutputLayout::MEASURE_BUDGET, measure);
+    }
+    benchmark::DoNotOptimize(layout.GetTotalRows());
+    state.SetItemsProcessed(int64_t(state.iterations()) * int64_t(layout.GetTotalLines()));
+}
+
+// buffer size
+BENCHMARK(BM_ScrollingBufferWrite)->RangeMultiplier(16)->Range(int64_t(app::ScrollingBuffer::MIN_SIZE), int64_t(app::ScrollingBuffer::MAX_SIZE));
+BENCHMARK(BM_ScrollingBufferRead)->RangeMultiplier(16)->Range(int64_t(app::ScrollingBuffer::MIN_SIZE), int64_t(app::ScrollingBuffer::MAX_SIZE));
+// env size
+BENCHMARK(BM_GetEnv)->Arg(0)->Arg(64)->Arg(512);
+BENCHMARK(BM_CreateEnvString)->RangeMultiplier(8)->Range(8, 512);
+BENCHMARK(BM_CreateEnvFromCfg)->RangeMultiplier(8)->Range(8, 512);
+// config count
+BENCHMARK(BM_LoadAppConfigs)->RangeMultiplier(10)->Range(1, 1000);
+BENCHMARK(BM_ValidateDocument)->RangeMultiplier(10)->Range(1, 1000);
+BENCHMARK(BM_CreateAppConfigsDoc)->RangeMultiplier(10)->Range(1, 1000);
+BENCHMARK(BM_ManagedConfigListApplyChanges)->RangeMultiplier(10)->Range(1, 1000);
+BENCHMARK(BM_ManagedConfigListIsDirty)->RangeMultiplier(10)->Range(1, 1000);
+// pattern count
+BENCHMARK(BM_TriggerScan)->Arg(1)->Arg(3)->Arg(8)->Arg(64);
+// percent of coloured lines
+BENCHMARK(BM_ParseStyles)->Arg(0)->Arg(10)->Arg(100);
+BENCHMARK(BM_GetVisibleStyleRuns)->Arg(10)->Arg(100);
+// line count
+BENCHMARK(BM_OutputLayoutFrame)->Arg(100000)->Arg(500000);
+BENCHMARK(BM_OutputLayoutResize)->Arg(100000)->Arg(500000);
+// encoding, percent of non-ascii characters
+BENCHMARK(BM_TranscodeOutput)->ArgsProduct({
+    { int64_t(app::OutputEncoding::UTF16LE), int64_t(app::OutputEncoding::OEM) },
+    { 0, 10, 100 },
+});
+
+BENCHMARK_MAIN();
@@ -0,0 +1,233 @@
+// launch latency of the fork server compared with spawning directly from the app (linux only)
+// direct:      every launch reads and validates the environment config, builds the environment,
+//              creates the environment directories and spawns from this process
+// fork server: the environment is built and sent once, then each launch is a single request
+// --ballast-mb grows this process to something closer to the gui's footprint
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <filesystem>
+
+#include <fmt/core.h>
+
+#include "app_schema.h"
+#include "file_loading.h"
+#include "fork_server.h"
+#include "bench_utils.h"
+
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char **environ;
+
+namespace fs = std::filesystem;
+
+struct LaunchTimes {
+    std::vector<double> launch_us;
+};
+
+static std::vector<std::string> build_environment(const std::string &env_config_path, const fs::path &root) {
+    auto doc_res = app::load_document_from_filename(env_config_path.c_str());
+    if (!doc_res) {
+        throw std::runtime_error(fmt::format("Failed to read environment config ({})", env_config_path));
+    }
+    auto doc = std::move(doc_res.value());
+    if (!app::validate_document(doc, app::ENV_SCHEMA)) {
+        throw std::runtime_error("Failed to validate environment config");
+    }
+    auto cfg = app::load_env_config(doc);
+
+    std::vector<std::string> env;
+    for (auto &[key, value]: cfg.env_directories) {
+        auto dir = fmt::format(fmt::runtime(value), fmt::arg("root", root.string()), fmt::arg("username", "bench"));
+        fs::create_directories(dir);
+        env.push_back(fmt::format("{}={}", key, fs::absolute(dir).string()));
+    }
+    for (auto &key: cfg.pass_through_variables) {
+        const char *value = getenv(key.c_str());
+        if (value != nullptr) {
+            env.push_back(fmt::format("{}={}", key, value));
+        }
+    }
+    return env;
+}
+
+// a few directories so the direct path does the same directory setup as a real launch
+static std::string create_env_config(const fs::path &dir) {
+    app::EnvConfig env_cfg;
+    env_cfg.env_directories = {
+        { "HOME",               "{root}/home/{username}" },
+        { "XDG_CONFIG_HOME",    "{root}/home/{username}/.config" },
+        { "XDG_DATA_HOME",      "{root}/home/{username}/.local/share" },
+        { "XDG_CACHE_HOME",     "{root}/home/{username}/.cache" },
+        { "TMPDIR",             "{root}/tmp" },
+    };
+    env_cfg.pass_through_variables = { "PATH", "LANG", "TERM", "USER", "SHELL" };
+    auto doc = app::create_env_config_doc(env_cfg);
+    auto filepath = (dir / "bench_fork_server_env.json").string();
+    if (!app::write_document_to_file(filepath.c_str(), doc)) {
+        throw std::runtime_error(fmt::format("Failed to write benchmark environment config ({})", filepath));
+    }
+    return filepath;
+}
+
+static pid_t spawn_direct(const std::vector<std::string> &env, const std::string &exec_path, int &stdout_fd) {
+    int pipes[3][2];
+    for (auto &fds: pipes) {
+        if (pipe2(fds, O_CLOEXEC) != 0) {
+            throw std::runtime_error(fmt::format("Failed to create pipe: {}", strerror(errno)));
+        }
+    }
+    std::vector<char *> envp;
+    for (auto &entry: env) {
+        envp.push_back(const_cast<char *>(entry.c_str()));
+    }
+    envp.push_back(nullptr);
+    char *argv[] = { const_cast<char *>(exec_path.c_str()), nullptr };
+
+    posix_spawn_file_actions_t file_actions;
+    posix_spawn_file_actions_init(&file_actions);
+    posix_spawn_file_actions_adddup2(&file_actions, pipes[0][0], STDIN_FILENO);
+    posix_spawn_file_actions_adddup2(&file_actions, pipes[1][1], STDOUT_FILENO);
+    posix_spawn_file_actions_adddup2(&file_actions, pipes[2][1], STDERR_FILENO);
+    pid_t pid = -1;
+    const int error = posix_spawn(&pid, exec_path.c_str(), &file_actions, nullptr, argv, envp.data());
+    posix_spawn_file_actions_destroy(&file_actions);
+
+    close(pipes[0][0]);
+    close(pipes[0][1]);
+    close(pipes[1][1]);
+    close(pipes[2][0]);
+    close(pipes[2][1]);
+    stdout_fd = pipes[1][0];
+    if (error != 0) {
+        close(stdout_fd);
+        throw std::runtime_error(fmt::format("Failed to spawn ({}): {}", exec_path, strerror(error)));
+    }
+    return pid;
+}
+
+// reading until the child closes stdout keeps both modes waiting for the same thing
+static void drain_and_close(const int fd) {
+    char buffer[256];
+    while (read(fd, buffer, sizeof(buffer)) > 0) {}
+    close(fd);
+}
+
+static LaunchTimes run_direct(const std::string &env_config_path, const fs::path &root, const std::string &exec_path, const int total_launches) {
+    LaunchTimes times;
+    for (int i = 0; i < total_launches; i++) {
+        const int64_t start = bench::get_timestamp_ns();
+        const auto env = build_environment(env_config_path, root);
+        int stdout_fd = -1;
+        const pid_t pid = spawn_direct(env, exec_path, stdout_fd);
+        const int64_t end = bench::get_timestamp_ns();
+        times.launch_us.push_back(double(end - start) * 1e-3);
+        drain_and_close(stdout_fd);
+        waitpid(pid, nullptr, 0);
+    }
+    return times;
+}
+
+static LaunchTimes run_fork_server(
+    app::ForkServer &server, const std::string &env_config_path, const fs::path &root,
+    const std::string &exec_path, const int total_launches)
+{
+    LaunchTimes times;
+    const std::string env_key = fmt::format("{}:{}", env_config_path, root.string());
+    for (int i = 0; i < total_launches; i++) {
+        const int64_t start = bench::get_timestamp_ns();
+        uint64_t env_id = server.FindEnvironment(env_key);
+        if (env_id == 0) {
+            env_id = server.AddEnvironment(env_key, build_environment(env_config_path, root));
+        }
+        app::SpawnRequest request;
+        request.env_id = env_id;
+        request.exec_path = exec_path;
+        auto process = server.Spawn(request);
+        const int64_t end = bench::get_timestamp_ns();
+        times.launch_us.push_back(double(end - start) * 1e-3);
+        close(process.stdin_fd);
+        close(process.stderr_fd);
+        if (process.pidfd >= 0) {
+            close(process.pidfd);
+        }
+        drain_and_close(process.stdout_fd);
+        server.WaitExitStatus(process.pid);
+    }
+    return times;
+}
+
+static void print_times(const char *mode, LaunchTimes &times) {
+    auto &t = times.launch_us;
+    std::sort(t.begin(), t.end());
+    double total = 0.0;
+    for (double x: t) {
+        total += x;
+    }
+    auto percentile = [&t](double p) { return t[std::min(size_t(p * double(t.size())), t.size()-1)]; };
+    fmt::print("{:<12} {:>10.1f} {:>10.1f} {:>10.1f} {:>10.1f} {:>10.1f}\n",
+        mode, total / double(t.size()), t.front(), percentile(0.5), percentile(0.99), t.back());
+}
+
+static void print_usage(const char *name) {
+    fprintf(stderr,
+        "Usage: %s [--launches N] [--exec PATH] [--ballast-mb N]\n"
+        "    --launches    Launches per mode (default: 200)\n"
+        "    --exec        Program to launch (default: /bin/true)\n"
+        "    --ballast-mb  Memory touched by this process before launching (default: 0)\n",
+        name);
+}
+
+int main(int argc, char **argv) {
+    int total_launches = 200;
+    std::string exec_path = "/bin/true";
+    long ballast_mb = 0;
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        const bool has_value = (i+1) < argc;
+        if ((strcmp(arg, "--launches") == 0) && has_value) {
+            total_launches = int(strtol(argv[++i], NULL, 10));
+        } else if ((strcmp(arg, "--exec") == 0) && has_value) {
+            exec_path = argv[++i];
+        } else if ((strcmp(arg, "--ballast-mb") == 0) && has_value) {
+            ballast_mb = strtol(argv[++i], NULL, 10);
+        } else {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+    if (total_launches <= 0) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    // started before the ballast, the same as the app starting it before loading anything
+    app::ForkServer server;
+
+    std::vector<uint8_t> ballast(size_t(ballast_mb) * 1024 * 1024);
+    for (size_t i = 0; i < ballast.size(); i += 4096) {
+        ballast[i] = uint8_t(i);
+    }
+
+    const auto dir = bench::get_bench_directory();
+    const auto env_config_path = create_env_config(dir);
+    const auto root = dir / "envs" / "fork_server";
+
+    auto direct = run_direct(env_config_path, root, exec_path, total_launches);
+    auto forked = run_fork_server(server, env_config_path, root, exec_path, total_launches);
+
+    fmt::print("{} launches of {}, {} MiB ballast\n", total_launches, exec_path, ballast_mb);
+    fmt::print("{:<12} {:>10} {:>10} {:>10} {:>10} {:>10}\n", "mode", "mean us", "min us", "p50 us", "p99 us", "max us");
+    print_times("direct", direct);
+    print_times("fork_server", forked);
+    return 0;
+}
@@ -0,0 +1,134 @@
+// floods the scrolling buffer with a fast child process and checks the capture mode behaviour
+// lossy:    the reader keeps up with the child and overwritten output is counted as dropped
+// lossless: the child is throttled by the pipe and every byte is seen by the consumer
+// returns a non-zero exit code if the lossless run drops or misses any bytes, or if the lossy run drops nothing
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include <string>
+#include <chrono>
+#include <thread>
+#include <filesystem>
+
+#include <fmt/core.h>
+
+#include "app_process.h"
+#include "app_schema.h"
+#include "environ.h"
+#include "bench_utils.h"
+
+namespace fs = std::filesystem;
+
+struct FloodResults {
+    app::ScrollingBufferStats stats;
+    double elapsed_seconds;
+};
+
+static FloodResults run_mode(app::AppConfig &cfg, app::environment_t &parent_env, const long consumer_interval_us) {
+    const auto start = std::chrono::steady_clock::now();
+    auto process = app::AppProcess(cfg, parent_env);
+    auto &buffer = process.GetBuffer();
+
+    // consumer that periodically catches up, similar to the gui rendering a frame
+    while (process.GetState() != app::AppProcess::State::TERMINATED) {
+        std::this_thread::sleep_for(std::chrono::microseconds(consumer_interval_us));
+        buffer.MarkConsumed();
+    }
+    buffer.MarkConsumed();
+
+    const auto end = std::chrono::steady_clock::now();
+    FloodResults results;
+    results.stats = buffer.GetStats();
+    results.elapsed_seconds = std::chrono::duration<double>(end - start).count();
+    return results;
+}
+
+static void print_results(const char *mode, const FloodResults &results) {
+    const double MiB = 1024.0 * 1024.0;
+    const auto &stats = results.stats;
+    fmt::print("{:<10} {:>12.2f} {:>12.2f} {:>12.2f} {:>12.2f} {:>12}\n",
+        mode,
+        double(stats.total_captured) / MiB,
+        double(stats.total_dropped) / MiB,
+        double(stats.total_captured) / MiB / results.elapsed_seconds,
+        double(stats.peak_pending_size) / 1024.0,
+        stats.total_captured);
+}
+
+static void print_usage(const char *name) {
+    fprintf(stderr,
+        "Usage: %s [--flood-bytes N] [--chunk-size N] [--consumer-interval-us N] [--child PATH]\n"
+        "    --flood-bytes           Total bytes written by the child (default: 16777216)\n"
+        "    --chunk-size            Size of each write by the child (default: 4096)\n"
+        "    --consumer-interval-us  Delay between consumer catch ups (default: 16000)\n"
+        "    --child                 Path to capture_child (default: next to this executable)\n",
+        name);
+}
+
+int main(int argc, char **argv) {
+    long long flood_bytes = 16*1024*1024;
+    long chunk_size = 4096;
+    long consumer_interval_us = 16000;
+    fs::path child_path = bench::get_default_child_path(argv[0]);
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        const bool has_value = (i+1) < argc;
+        if ((strcmp(arg, "--flood-bytes") == 0) && has_value) {
+            flood_bytes = strtoll(argv[++i], NULL, 10);
+        } else if ((strcmp(arg, "--chunk-size") == 0) && has_value) {
+            chunk_size = strtol(argv[++i], NULL, 10);
+        } else if ((strcmp(arg, "--consumer-interval-us") == 0) && has_value) {
+            consumer_interval_us = strtol(argv[++i], NULL, 10);
+        } else if ((strcmp(arg, "--child") == 0) && has_value) {
+            child_path = fs::absolute(fs::path(argv[++i]));
+        } else {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    bool is_passed = true;
+
+    try {
+        auto cfg = bench::create_bench_app_config(child_path,
+            fmt::format("--flood-bytes {} --chunk-size {}", flood_bytes, chunk_size));
+        auto parent_env = app::get_env();
+
+        fmt::print("{:<10} {:>12} {:>12} {:>12} {:>12} {:>12}\n",
+            "mode", "total(MiB)", "dropped(MiB)", "rate(MiB/s)", "peak(KiB)", "total(B)");
+
+        cfg.capture_mode = app::CaptureMode::LOSSY;
+        auto lossy_results = run_mode(cfg, parent_env, consumer_interval_us);
+        print_results("lossy", lossy_results);
+
+        cfg.capture_mode = app::CaptureMode::LOSSLESS;
+        auto lossless_results = run_mode(cfg, parent_env, consumer_interval_us);
+        print_results("lossless", lossless_results);
+
+        if (lossy_results.stats.total_captured != uint64_t(flood_bytes)) {
+            fmt::print(stderr, "Lossy mode captured {}/{} bytes\n", lossy_results.stats.total_captured, flood_bytes);
+            is_passed = false;
+        }
+        if (lossless_results.stats.total_captured != uint64_t(flood_bytes)) {
+            fmt::print(stderr, "Lossless mode captured {}/{} bytes\n", lossless_results.stats.total_captured, flood_bytes);
+            is_passed = false;
+        }
+        // the child outruns the consumer, so a lossy run that drops nothing was throttled like a lossless one
+        if (lossy_results.stats.total_dropped == 0) {
+            fmt::print(stderr, "Lossy mode didn't drop any bytes\n");
+            is_passed = false;
+        }
+        if (lossless_results.stats.total_dropped != 0) {
+            fmt::print(stderr, "Lossless mode dropped {} bytes\n", lossless_results.stats.total_dropped);
+            is_passed = false;
+        }
+    } catch (std::exception &ex) {
+        fmt::print(stderr, "Benchmark failed: {}\n", ex.what());
+        return 1;
+    }
+
+    return is_passed ? 0 : 1;
+}
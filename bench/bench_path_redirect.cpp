@@ -0,0 +1,202 @@
+// per call cost of the path redirect table used by the preload shim
+// lookup:  time to rewrite or pass through a path with a table the size of a typical environment
+// shim:    (linux) time for stat() with and without the shim preloaded, the difference is the overhead
+//          of the hook on every filesystem call
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+#include <filesystem>
+
+#include <fmt/core.h>
+
+#include "path_redirect_table.h"
+#include "bench_utils.h"
+
+#ifdef __linux__
+#include <limits.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+static const char *REAL_HOME = "/home/bench";
+static const char *ENV_ROOT = "/home/bench/envs/Generic";
+
+static std::vector<app::PathRedirect> create_bench_redirects(const int total_extra_rules) {
+    std::vector<app::PathRedirect> redirects = {
+        { ENV_ROOT,                             ENV_ROOT },
+        { "/home/bench",                        "/home/bench/envs/Generic/home/bench" },
+        { "/home/bench/.config",                "/home/bench/envs/Generic/config" },
+        { "/home/bench/.local/share",           "/home/bench/envs/Generic/data" },
+        { "/home/bench/.local/state",           "/home/bench/envs/Generic/state" },
+        { "/home/bench/.cache",                 "/home/bench/envs/Generic/cache" },
+    };
+    // unrelated prefixes that make the trie wider and deeper
+    for (int i = 0; i < total_extra_rules; i++) {
+        redirects.push_back({ fmt::format("/mnt/data{}/games/saves", i), fmt::format("{}/mnt/{}", ENV_ROOT, i) });
+    }
+    return redirects;
+}
+
+struct LookupCase {
+    const char *name;
+    std::string path;
+};
+
+// written after each lookup so the compiler can't drop or hoist it
+static volatile char g_sink = 0;
+
+static double measure_lookup(const app::PathRedirectTable &table, const std::string &path, const long iterations) {
+    char buffer[4096];
+    size_t total_rewritten = 0;
+    const int64_t start = bench::get_timestamp_ns();
+    for (long i = 0; i < iterations; i++) {
+        buffer[0] = '\0';
+        total_rewritten += table.Rewrite(path.c_str(), buffer, sizeof(buffer)) ? 1 : 0;
+        g_sink = buffer[0];
+    }
+    const int64_t end = bench::get_timestamp_ns();
+    if ((total_rewritten != 0) && (total_rewritten != size_t(iterations))) {
+        fprintf(stderr, "Inconsistent rewrite results for %s\n", path.c_str());
+    }
+    return double(end - start) / double(iterations);
+}
+
+#ifdef __linux__
+static double measure_stat(const char *path, const long iterations) {
+    struct stat st;
+    const int64_t start = bench::get_timestamp_ns();
+    for (long i = 0; i < iterations; i++) {
+        stat(path, &st);
+    }
+    const int64_t end = bench::get_timestamp_ns();
+    return double(end - start) / double(iterations);
+}
+
+// rerun ourselves with the shim preloaded and read back the stat timings
+static bool measure_stat_with_shim(
+    const char *argv0, const fs::path &shim_path, const fs::path &table_path,
+    const long iterations, double &miss_ns, double &hit_ns)
+{
+    int fds[2];
+    if (pipe(fds) != 0) {
+        return false;
+    }
+    const pid_t pid = fork();
+    if (pid == 0) {
+        close(fds[0]);
+        dup2(fds[1], STDOUT_FILENO);
+        setenv("LD_PRELOAD", shim_path.c_str(), 1);
+        setenv(app::PATH_REDIRECT_TABLE_ENV, table_path.c_str(), 1);
+        const auto iterations_str = std::to_string(iterations);
+        execl(argv0, argv0, "--stat-only", "--iterations", iterations_str.c_str(), nullptr);
+        _exit(127);
+    }
+    close(fds[1]);
+    char output[256] = {0};
+    const ssize_t total_read = read(fds[0], output, sizeof(output)-1);
+    close(fds[0]);
+    int status = 0;
+    waitpid(pid, &status, 0);
+    return (total_read > 0) && (sscanf(output, "%lf %lf", &miss_ns, &hit_ns) == 2);
+}
+#endif
+
+static void print_usage(const char *name) {
+    fprintf(stderr,
+        "Usage: %s [--iterations N] [--extra-rules N] [--shim PATH]\n"
+        "    --iterations   Lookups per case (default: 2000000)\n"
+        "    --extra-rules  Unrelated prefixes added to the table (default: 0)\n"
+        "    --shim         Path to the preload shim, compares stat() with and without it (linux only)\n",
+        name);
+}
+
+int main(int argc, char **argv) {
+    long iterations = 2000000;
+    int total_extra_rules = 0;
+    fs::path shim_path;
+    bool is_stat_only = false;
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        const bool has_value = (i+1) < argc;
+        if ((strcmp(arg, "--iterations") == 0) && has_value) {
+            iterations = strtol(argv[++i], NULL, 10);
+        } else if ((strcmp(arg, "--extra-rules") == 0) && has_value) {
+            total_extra_rules = int(strtol(argv[++i], NULL, 10));
+        } else if ((strcmp(arg, "--shim") == 0) && has_value) {
+            shim_path = fs::absolute(argv[++i]);
+        } else if (strcmp(arg, "--stat-only") == 0) {
+            is_stat_only = true;
+        } else {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    // paths which exist on any linux machine so stat() does the same work with and without the shim
+    const char *stat_miss_path = "/usr/bin/env";
+    const std::string stat_hit_path = fmt::format("{}/.config", REAL_HOME);
+
+#ifdef __linux__
+    if (is_stat_only) {
+        const double miss_ns = measure_stat(stat_miss_path, iterations);
+        const double hit_ns = measure_stat(stat_hit_path.c_str(), iterations);
+        printf("%f %f\n", miss_ns, hit_ns);
+        return 0;
+    }
+#else
+    if (is_stat_only || !shim_path.empty()) {
+        fprintf(stderr, "The preload shim is only supported on linux\n");
+        return 1;
+    }
+#endif
+
+    const auto redirects = create_bench_redirects(total_extra_rules);
+    const auto table_data = app::compile_path_redirects(redirects);
+    app::PathRedirectTable table;
+    if (!table.Load(table_data.data(), table_data.size())) {
+        fprintf(stderr, "Failed to load the compiled table\n");
+        return 1;
+    }
+
+    const LookupCase cases[] = {
+        { "miss",           "/usr/lib/x86_64-linux-gnu/libc.so.6" },
+        { "miss_similar",   "/home/benchmark/file.txt" },
+        { "hit_home",       fmt::format("{}/Documents/notes.txt", REAL_HOME) },
+        { "hit_config",     fmt::format("{}/.config/app/settings.ini", REAL_HOME) },
+        { "pass_through",   fmt::format("{}/home/bench/.config/app/settings.ini", ENV_ROOT) },
+    };
+
+    fmt::print("{} rules, {} byte table\n", redirects.size(), table_data.size());
+    fmt::print("{:<16} {:>12}\n", "case", "ns/lookup");
+    for (auto &c: cases) {
+        fmt::print("{:<16} {:>12.2f}\n", c.name, measure_lookup(table, c.path, iterations));
+    }
+
+#ifdef __linux__
+    if (!shim_path.empty()) {
+        const auto table_path = bench::get_bench_directory() / "path_redirect_table.bin";
+        app::write_path_redirect_table(table_path.string(), table_data);
+        const double direct_miss_ns = measure_stat(stat_miss_path, iterations);
+        const double direct_hit_ns = measure_stat(stat_hit_path.c_str(), iterations);
+        double shim_miss_ns = 0.0;
+        double shim_hit_ns = 0.0;
+        if (!measure_stat_with_shim(argv[0], shim_path, table_path, iterations, shim_miss_ns, shim_hit_ns)) {
+            fprintf(stderr, "Failed to run with the shim preloaded\n");
+            return 1;
+        }
+        // a hit stats a different (usually missing) path so only the miss overhead is like for like
+        fmt::print("\n{:<16} {:>12} {:>12} {:>12}\n", "stat()", "direct ns", "shim ns", "overhead ns");
+        fmt::print("{:<16} {:>12.2f} {:>12.2f} {:>12.2f}\n", "miss", direct_miss_ns, shim_miss_ns, shim_miss_ns - direct_miss_ns);
+        fmt::print("{:<16} {:>12.2f} {:>12.2f} {:>12.2f}\n", "hit", direct_hit_ns, shim_hit_ns, shim_hit_ns - direct_hit_ns);
+    }
+#endif
+    return 0;
+}
@@ -0,0 +1,155 @@
+// measures the time from a child's printf to the byte being visible in the scrolling buffer
+// runs the synthetic capture_child once with plain pipes and once with a pseudo terminal
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#include <filesystem>
+
+#include <fmt/core.h>
+
+#include "app_process.h"
+#include "app_schema.h"
+#include "environ.h"
+#include "bench_utils.h"
+
+namespace fs = std::filesystem;
+using bench::get_timestamp_ns;
+
+struct LatencyResults {
+    std::vector<int64_t> latencies_ns;
+    size_t total_expected = 0;
+};
+
+static LatencyResults run_mode(app::AppConfig &cfg, app::environment_t &parent_env, const size_t total_lines) {
+    LatencyResults results;
+    results.total_expected = total_lines;
+
+    auto process = app::AppProcess(cfg, parent_env);
+    auto &buffer = process.GetBuffer();
+
+    // lines are small and polled often enough that the output is never overwritten before it is parsed
+    uint64_t read_offset = 0;
+    std::string line;
+    const auto timeout = std::chrono::seconds(30);
+    const auto start = std::chrono::steady_clock::now();
+
+    while (true) {
+        const bool is_terminated = (process.GetState() == app::AppProcess::State::TERMINATED);
+        {
+            // the buffer manager can resize the ring between polls, so it is only read under the lock
+            auto lock = buffer.LockRead();
+            const uint64_t total_written = buffer.GetTotalWritten();
+            const char *data = buffer.GetBufferAtOffset(read_offset);
+            const size_t length = size_t(total_written - read_offset);
+            const int64_t visible_ns = get_timestamp_ns();
+
+            for (size_t i = 0; i < length; i++) {
+                const char c = data[i];
+                if (c != '\n') {
+                    line.push_back(c);
+                    continue;
+                }
+                // a pseudo terminal can prefix lines with escape sequences, so find our marker
+                auto marker = line.find('@');
+                long sequence = 0;
+                long long timestamp = 0;
+                if ((marker != std::string::npos) &&
+                    (sscanf(line.c_str() + marker, "@%ld:%lld", &sequence, &timestamp) == 2))
+                {
+                    results.latencies_ns.push_back(visible_ns - int64_t(timestamp));
+                }
+                line.clear();
+            }
+            read_offset = total_written;
+            buffer.MarkConsumed(read_offset);
+        }
+
+        if (is_terminated || (results.latencies_ns.size() >= total_lines)) {
+            break;
+        }
+        if ((std::chrono::steady_clock::now() - start) > timeout) {
+            process.Terminate();
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+
+    return results;
+}
+
+static void print_results(const char *mode, LatencyResults &results) {
+    auto &x = results.latencies_ns;
+    if (x.size() == 0) {
+        fmt::print("{:<8} received 0/{} lines\n", mode, results.total_expected);
+        return;
+    }
+
+    std::sort(x.begin(), x.end());
+    auto percentile = [&x](double p) {
+        const size_t i = std::min(size_t(p * double(x.size())), x.size()-1);
+        return double(x[i]) * 1e-6;
+    };
+
+    fmt::print("{:<8} {:>6}/{:<6} {:>10.3f} {:>10.3f} {:>10.3f} {:>10.3f}\n",
+        mode, x.size(), results.total_expected,
+        percentile(0.0), percentile(0.5), percentile(0.99), percentile(1.0));
+}
+
+static void print_usage(const char *name) {
+    fprintf(stderr,
+        "Usage: %s [--lines N] [--interval-us N] [--child PATH]\n"
+        "    --lines        Total number of lines printed by the child (default: 200)\n"
+        "    --interval-us  Delay between lines in microseconds (default: 5000)\n"
+        "    --child        Path to capture_child (default: next to this executable)\n",
+        name);
+}
+
+int main(int argc, char **argv) {
+    size_t total_lines = 200;
+    long interval_us = 5000;
+    fs::path child_path = bench::get_default_child_path(argv[0]);
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        const bool has_value = (i+1) < argc;
+        if ((strcmp(arg, "--lines") == 0) && has_value) {
+            total_lines = size_t(strtoul(argv[++i], NULL, 10));
+        } else if ((strcmp(arg, "--interval-us") == 0) && has_value) {
+            interval_us = strtol(argv[++i], NULL, 10);
+        } else if ((strcmp(arg, "--child") == 0) && has_value) {
+            child_path = fs::absolute(fs::path(argv[++i]));
+        } else {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    try {
+        auto cfg = bench::create_bench_app_config(child_path,
+            fmt::format("--lines {} --interval-us {}", total_lines, interval_us));
+
+        auto parent_env = app::get_env();
+
+        fmt::print("{:<8} {:>13} {:>10} {:>10} {:>10} {:>10}\n", "mode", "lines", "min(ms)", "p50(ms)", "p99(ms)", "max(ms)");
+
+        cfg.use_pty = false;
+        auto pipe_results = run_mode(cfg, parent_env, total_lines);
+        print_results("pipe", pipe_results);
+
+        cfg.use_pty = true;
+        auto pty_results = run_mode(cfg, parent_env, total_lines);
+        print_results("pty", pty_results);
+    } catch (std::exception &ex) {
+        fmt::print(stderr, "Benchmark failed: {}\n", ex.what());
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,225 @@
+// tails an exported scrolling buffer through shared memory while a writer outputs as fast as it can
+// baseline: the writer on its own
+// readers:  the same writer with readers copying out of the shared ring, plus one which maps it and never reads
+// the writer resizes the ring every so often so readers also have to follow it across generations
+// returns a non-zero exit code if a reader ever accepted bytes that don't match what was written
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <fmt/core.h>
+
+#include "platform.h"
+#include "scrolling_buffer.h"
+#include "shared_ring.h"
+
+// every byte is derived from its absolute offset so readers can check what they copied
+static inline char get_pattern_byte(const uint64_t offset) {
+    return char('a' + (offset % 26));
+}
+
+static void write_pattern(app::ScrollingBuffer &buffer, const size_t size) {
+    const size_t length = std::min(size, buffer.GetMaxSize());
+    const uint64_t offset = buffer.GetTotalWritten();
+    char *data = buffer.GetWriteBuffer(length);
+    for (size_t i = 0; i < length; i++) {
+        data[i] = get_pattern_byte(offset + i);
+    }
+    buffer.IncrementIndex(length);
+}
+
+struct ReaderResult {
+    uint64_t total_read = 0;
+    uint64_t total_skipped = 0;
+    uint64_t total_retries = 0;
+    uint64_t total_corrupt = 0;
+};
+
+struct RunResult {
+    double seconds = 0.0;
+    uint64_t total_written = 0;
+    uint64_t total_resizes = 0;
+    std::vector<ReaderResult> readers;
+};
+
+// same loop as ring_tail but checks the bytes instead of printing them
+static ReaderResult run_reader(const std::string &name, const size_t chunk_size) {
+    ReaderResult result;
+    auto reader = app::SharedRingReader(name);
+    std::vector<char> chunk(chunk_size);
+    uint64_t offset = 0;
+    while (true) {
+        const bool is_closed = reader.IsWriterClosed();
+        if (!reader.Update()) {
+            break;
+        }
+        const uint64_t end_offset = reader.GetTotalWritten();
+        const uint64_t oldest_offset = reader.GetOldestOffset();
+        if (offset < oldest_offset) {
+            result.total_skipped += oldest_offset - offset;
+            offset = oldest_offset;
+        }
+        if (offset < end_offset) {
+            const size_t length = size_t(std::min(end_offset - offset, uint64_t(chunk.size())));
+            memcpy(chunk.data(), reader.GetBufferAtOffset(offset), length);
+            if (!reader.IsValid(offset)) {
+                result.total_retries++;
+                continue;
+            }
+            for (size_t i = 0; i < length; i++) {
+                if (chunk[i] != get_pattern_byte(offset + i)) {
+                    result.total_corrupt++;
+                }
+            }
+            result.total_read += uint64_t(length);
+            offset += uint64_t(length);
+            continue;
+        }
+        if (is_closed) {
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return result;
+}
+
+static RunResult run(const long total_mb, const long total_readers, const long resize_mb, const size_t chunk_size) {
+    const size_t MiB = 1024*1024;
+    const auto name = fmt::format("appvirtualenv_bench.{}", app::platform::get_current_process_id());
+    auto buffer = std::make_unique<app::ScrollingBuffer>(MiB);
+    if (!buffer->Export(name)) {
+        throw std::runtime_error(fmt::format("Failed to export ring as ({})", name));
+    }
+
+    RunResult result;
+    result.readers.resize(size_t(total_readers));
+    std::vector<std::thread> reader_threads;
+    for (long i = 0; i < total_readers; i++) {
+        reader_threads.emplace_back([&name, &result = result.readers[size_t(i)], chunk_size]() {
+            result = run_reader(name, chunk_size);
+        });
+    }
+    // maps the ring and then never reads from it, the writer shouldn't notice
+    std::unique_ptr<app::SharedRingReader> idle_reader;
+    if (total_readers > 0) {
+        idle_reader = std::make_unique<app::SharedRingReader>(name);
+    }
+
+    const uint64_t total_bytes = uint64_t(total_mb) * MiB;
+    const uint64_t resize_bytes = uint64_t(resize_mb) * MiB;
+    const auto start = std::chrono::steady_clock::now();
+    uint64_t next_resize = resize_bytes;
+    bool is_large = false;
+    while (buffer->GetTotalWritten() < total_bytes) {
+        if ((resize_bytes > 0) && (buffer->GetTotalWritten() >= next_resize)) {
+            is_large = !is_large;
+            buffer->RequestResize(is_large ? 4*MiB : MiB);
+            result.total_resizes += buffer->ApplyResize() ? 1 : 0;
+            next_resize += resize_bytes;
+        }
+        write_pattern(*buffer, chunk_size);
+    }
+    buffer->CloseWriter();
+    const auto end = std::chrono::steady_clock::now();
+
+    for (auto &thread: reader_threads) {
+        thread.join();
+    }
+    result.seconds = std::chrono::duration<double>(end - start).count();
+    result.total_written = buffer->GetTotalWritten();
+    return result;
+}
+
+static void print_usage(const char *name) {
+    fprintf(stderr,
+        "Usage: %s [--readers N] [--total-mb N] [--resize-mb N] [--chunk-kb N]\n"
+        "    --readers    Reader threads tailing the shared ring (default: 4)\n"
+        "    --total-mb   Output written in each run (default: 2048)\n"
+        "    --resize-mb  Resize the ring after this much output, 0 to disable (default: 64)\n"
+        "    --chunk-kb   Size of each write and read (default: 4)\n",
+        name);
+}
+
+int main(int argc, char **argv) {
+    long total_readers = 4;
+    long total_mb = 2048;
+    long resize_mb = 64;
+    long chunk_kb = 4;
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        const bool has_value = (i+1) < argc;
+        if ((strcmp(arg, "--readers") == 0) && has_value) {
+            total_readers = strtol(argv[++i], NULL, 10);
+        } else if ((strcmp(arg, "--total-mb") == 0) && has_value) {
+            total_mb = strtol(argv[++i], NULL, 10);
+        } else if ((strcmp(arg, "--resize-mb") == 0) && has_value) {
+            resize_mb = strtol(argv[++i], NULL, 10);
+        } else if ((strcmp(arg, "--chunk-kb") == 0) && has_value) {
+            chunk_kb = strtol(argv[++i], NULL, 10);
+        } else {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+    // chunks have to fit in the smallest ring the writer resizes to
+    if ((total_readers < 0) || (total_mb <= 0) || (resize_mb < 0) || (chunk_kb <= 0) || (chunk_kb > 1024)) {
+        print_usage(argv[0]);
+        return 1;
+    }
+    const size_t chunk_size = size_t(chunk_kb) * 1024;
+
+    RunResult baseline;
+    RunResult shared;
+    try {
+        baseline = run(total_mb, 0, resize_mb, chunk_size);
+        shared = run(total_mb, total_readers, resize_mb, chunk_size);
+    } catch (std::exception &ex) {
+        fmt::print(stderr, "Benchmark failed: {}\n", ex.what());
+        return 1;
+    }
+
+    const double MiB = 1024.0*1024.0;
+    const double baseline_rate = double(baseline.total_written) / MiB / baseline.seconds;
+    const double shared_rate = double(shared.total_written) / MiB / shared.seconds;
+    ReaderResult total;
+    for (auto &reader: shared.readers) {
+        total.total_read += reader.total_read;
+        total.total_skipped += reader.total_skipped;
+        total.total_retries += reader.total_retries;
+        total.total_corrupt += reader.total_corrupt;
+    }
+
+    fmt::print("{} MiB written in {} KiB chunks, {} readers, {} resizes\n", total_mb, chunk_kb, total_readers, shared.total_resizes);
+    fmt::print("{:<28} {:>10.2f}\n", "writer alone (MiB/s)", baseline_rate);
+    fmt::print("{:<28} {:>10.2f}\n", "writer with readers (MiB/s)", shared_rate);
+    fmt::print("{:<28} {:>10.2f}\n", "writer slowdown (%)", 100.0 * (1.0 - shared_rate / baseline_rate));
+    fmt::print("{:<28} {:>10.2f}\n", "read per reader (MiB)", (total_readers > 0) ? (double(total.total_read) / double(total_readers) / MiB) : 0.0);
+    fmt::print("{:<28} {:>10.2f}\n", "skipped per reader (MiB)", (total_readers > 0) ? (double(total.total_skipped) / double(total_readers) / MiB) : 0.0);
+    fmt::print("{:<28} {:>10}\n", "torn reads retried", total.total_retries);
+    fmt::print("{:<28} {:>10}\n", "corrupt bytes", total.total_corrupt);
+
+    bool is_passed = true;
+    if (total.total_corrupt > 0) {
+        fmt::print(stderr, "Readers accepted {} bytes which didn't match the output\n", total.total_corrupt);
+        is_passed = false;
+    }
+    // every byte is either read or reported as skipped
+    for (auto &reader: shared.readers) {
+        if ((reader.total_read + reader.total_skipped) != shared.total_written) {
+            fmt::print(stderr, "A reader lost track of the output, {} read and {} skipped out of {}\n",
+                reader.total_read, reader.total_skipped, shared.total_written);
+            is_passed = false;
+            break;
+        }
+    }
+    return is_passed ? 0 : 1;
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <string>
+#include <chrono>
+#include <stdexcept>
+#include <filesystem>
+
+#include <fmt/core.h>
+
+#include "app_schema.h"
+#include "file_loading.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+namespace bench {
+
+namespace fs = std::filesystem;
+
+inline int64_t get_timestamp_ns() {
+    auto now = std::chrono::steady_clock::now().time_since_epoch();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(now).count();
+}
+
+#ifdef _WIN32
+inline double filetime_to_seconds(const FILETIME &ft) {
+    ULARGE_INTEGER x;
+    x.LowPart = ft.dwLowDateTime;
+    x.HighPart = ft.dwHighDateTime;
+    return double(x.QuadPart) * 100e-9;
+}
+#endif
+
+// user and kernel time consumed by this process
+inline double get_process_cpu_seconds() {
+#ifdef _WIN32
+    FILETIME creation_time, exit_time, kernel_time, user_time;
+    GetProcessTimes(GetCurrentProcess(), &creation_time, &exit_time, &kernel_time, &user_time);
+    return filetime_to_seconds(kernel_time) + filetime_to_seconds(user_time);
+#else
+    timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return double(ts.tv_sec) + double(ts.tv_nsec)*1e-9;
+#endif
+}
+
+// user and kernel time consumed by the calling thread
+inline double get_thread_cpu_seconds() {
+#ifdef _WIN32
+    FILETIME creation_time, exit_time, kernel_time, user_time;
+    GetThreadTimes(GetCurrentThread(), &creation_time, &exit_time, &kernel_time, &user_time);
+    return filetime_to_seconds(kernel_time) + filetime_to_seconds(user_time);
+#else
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return double(ts.tv_sec) + double(ts.tv_nsec)*1e-9;
+#endif
+}
+
+// capture_child is built next to the benchmark executables
+inline fs::path get_default_child_path(const char *argv0) {
+    auto path = fs::absolute(fs::path(argv0)).replace_filename("capture_child");
+    path.replace_extension(fs::path(argv0).extension());
+    return path;
+}
+
+// scratch directory for environment configs and environment roots
+inline fs::path get_bench_directory() {
+    const auto dir = fs::temp_directory_path() / "appvirtualenv_bench";
+    fs::create_directories(dir);
+    return dir;
+}
+
+// create a minimal environment config so the child can start
+inline std::string create_bench_env_config(const fs::path &dir) {
+    app::EnvConfig env_cfg;
+    env_cfg.pass_through_variables = { "PATH", "SYSTEMROOT", "WINDIR", "TEMP", "TMP", "HOME" };
+    auto doc = app::create_env_config_doc(env_cfg);
+    auto filepath = (dir / "bench_env.json").string();
+    if (!app::write_document_to_file(filepath.c_str(), doc)) {
+        throw std::runtime_error(fmt::format("Failed to write benchmark environment config ({})", filepath));
+    }
+    return filepath;
+}
+
+inline app::AppConfig create_bench_app_config(const fs::path &child_path, const std::string &args) {
+    const auto dir = get_bench_directory();
+    app::AppConfig cfg;
+    cfg.name = "capture_child";
+    cfg.username = "bench";
+    cfg.exec_path = child_path.string();
+    cfg.exec_cwd = dir.string();
+    cfg.args = args;
+    cfg.env_name = "bench";
+    cfg.env_parent_dir = (dir / "envs").string();
+    cfg.env_config_path = create_bench_env_config(dir);
+    return cfg;
+}
+
+}
@@ -0,0 +1,146 @@
+// synthetic child process used by the capture benchmarks
+// the timestamps are read from the steady clock which is shared across processes
+// (QueryPerformanceCounter on windows, CLOCK_MONOTONIC on linux)
+//
+// line mode:   prints lines of the form "@<sequence>:<timestamp_ns>" using the c runtime's stdio
+//              stdout is intentionally not flushed so the runtime's buffering policy is part of what gets measured
+// flood mode:  writes a fixed number of bytes to stdout as fast as possible
+// stream mode: writes fixed size chunks at a target rate for a duration, each chunk is flushed and
+//              starts with "@<sequence>:<timestamp_ns>:" and is padded out to the chunk size ending in a newline
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include <chrono>
+#include <thread>
+#include <vector>
+
+static int64_t get_timestamp_ns() {
+    auto now = std::chrono::steady_clock::now().time_since_epoch();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(now).count();
+}
+
+static void print_usage(const char *name) {
+    fprintf(stderr,
+        "Usage: %s [--lines N] [--interval-us N] [--flood-bytes N] [--chunk-size N]\n"
+        "          [--duration-ms N] [--rate N] [--stream stdout|stderr|both]\n"
+        "    --lines        Total number of lines to print (default: 200)\n"
+        "    --interval-us  Delay between lines in microseconds (default: 5000)\n"
+        "    --flood-bytes  Write this many bytes as fast as possible instead of lines\n"
+        "    --chunk-size   Size of each write in flood and stream mode (default: 4096)\n"
+        "    --duration-ms  Write timestamped chunks for this long instead of lines\n"
+        "    --rate         Target bytes per second in stream mode, 0 is unlimited (default: 0)\n"
+        "    --stream       Output stream used in stream mode (default: stdout)\n",
+        name);
+}
+
+static int run_stream_mode(long duration_ms, long long rate, long chunk_size, const char *stream) {
+    const bool use_stdout = (strcmp(stream, "stderr") != 0);
+    const bool use_stderr = (strcmp(stream, "stdout") != 0);
+
+    auto chunk = std::vector<char>(size_t(chunk_size > 32 ? chunk_size : 32));
+    for (size_t i = 0; i < chunk.size(); i++) {
+        chunk[i] = ((i % 64) == 63) ? '\n' : char('a' + (i % 26));
+    }
+    chunk.back() = '\n';
+
+    using clock = std::chrono::steady_clock;
+    const auto start = clock::now();
+    const auto end = start + std::chrono::milliseconds(duration_ms);
+    const auto chunk_period = (rate > 0) ?
+        std::chrono::nanoseconds(int64_t(double(chunk.size()) * 1e9 / double(rate))) :
+        std::chrono::nanoseconds(0);
+    auto next_write = start;
+
+    long long sequence = 0;
+    while (clock::now() < end) {
+        if (rate > 0) {
+            std::this_thread::sleep_until(next_write);
+            next_write += chunk_period;
+        }
+
+        // header overwrites the start of the padding, the padding always ends in a newline
+        char header[64];
+        const int header_length = snprintf(header, sizeof(header), "@%lld:%lld:", sequence, (long long)get_timestamp_ns());
+        memcpy(chunk.data(), header, size_t(header_length));
+
+        FILE *fp = (use_stdout && use_stderr) ? ((sequence % 2) ? stderr : stdout) : (use_stdout ? stdout : stderr);
+        if (fwrite(chunk.data(), 1, chunk.size(), fp) != chunk.size()) {
+            return 1;
+        }
+        fflush(fp);
+        sequence++;
+    }
+
+    // report the total so the benchmark knows how many chunks to expect
+    printf("#total:%lld\n", sequence);
+    fflush(stdout);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    long total_lines = 200;
+    long interval_us = 5000;
+    long long flood_bytes = 0;
+    long chunk_size = 4096;
+    long duration_ms = 0;
+    long long rate = 0;
+    const char *stream = "stdout";
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        const bool has_value = (i+1) < argc;
+        if ((strcmp(arg, "--lines") == 0) && has_value) {
+            total_lines = strtol(argv[++i], NULL, 10);
+        } else if ((strcmp(arg, "--interval-us") == 0) && has_value) {
+            interval_us = strtol(argv[++i], NULL, 10);
+        } else if ((strcmp(arg, "--flood-bytes") == 0) && has_value) {
+            flood_bytes = strtoll(argv[++i], NULL, 10);
+        } else if ((strcmp(arg, "--chunk-size") == 0) && has_value) {
+            chunk_size = strtol(argv[++i], NULL, 10);
+        } else if ((strcmp(arg, "--duration-ms") == 0) && has_value) {
+            duration_ms = strtol(argv[++i], NULL, 10);
+        } else if ((strcmp(arg, "--rate") == 0) && has_value) {
+            rate = strtoll(argv[++i], NULL, 10);
+        } else if ((strcmp(arg, "--stream") == 0) && has_value) {
+            stream = argv[++i];
+        } else {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (duration_ms > 0) {
+        return run_stream_mode(duration_ms, rate, chunk_size, stream);
+    }
+
+    if (flood_bytes > 0) {
+        // printable repeating pattern broken into lines
+        auto chunk = std::vector<char>(size_t(chunk_size > 0 ? chunk_size : 1));
+        for (size_t i = 0; i < chunk.size(); i++) {
+            chunk[i] = ((i % 64) == 63) ? '\n' : char('a' + (i % 26));
+        }
+        long long total_written = 0;
+        while (total_written < flood_bytes) {
+            const long long remain = flood_bytes - total_written;
+            const size_t length = size_t((remain < (long long)chunk.size()) ? remain : (long long)chunk.size());
+            const size_t rv = fwrite(chunk.data(), 1, length, stdout);
+            if (rv == 0) {
+                return 1;
+            }
+            total_written += (long long)rv;
+        }
+        fflush(stdout);
+        return 0;
+    }
+
+    for (long i = 0; i < total_lines; i++) {
+        printf("@%ld:%lld\n", i, (long long)get_timestamp_ns());
+        if (interval_us > 0) {
+            std::this_thread::sleep_for(std::chrono::microseconds(interval_us));
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,117 @@
+// launches a program which writes to a hard coded path in the real ~/.config with each sandbox mode (linux only)
+// the write has to land in the home directory of the environment under env_parent_dir/env_name
+// and the real ~/.config has to be left untouched
+// returns 77 if this kernel doesn't allow unprivileged user namespaces, otherwise non-zero if any mode fails
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+#include <chrono>
+#include <thread>
+#include <filesystem>
+
+#include <fmt/core.h>
+
+#include "app_process.h"
+#include "app_schema.h"
+#include "environ.h"
+#include "file_loading.h"
+#include "bench_utils.h"
+
+#include <sched.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+constexpr int EXIT_SKIPPED = 77;
+
+static bool is_sandbox_supported() {
+    const pid_t pid = fork();
+    if (pid == 0) {
+        _exit((unshare(CLONE_NEWUSER | CLONE_NEWNS) == 0) ? 0 : 1);
+    }
+    int status = 0;
+    return (pid > 0) && (waitpid(pid, &status, 0) == pid) && WIFEXITED(status) && (WEXITSTATUS(status) == 0);
+}
+
+// the home and config directories of the environment are mounted over the real ones
+static std::string create_sandbox_env_config(const fs::path &dir) {
+    app::EnvConfig env_cfg;
+    env_cfg.env_directories = {
+        { "HOME", "{root}/home" },
+        { "XDG_CONFIG_HOME", "{root}/home/.config" },
+    };
+    env_cfg.pass_through_variables = { "PATH" };
+    auto doc = app::create_env_config_doc(env_cfg);
+    auto filepath = (dir / "sandbox_env.json").string();
+    if (!app::write_document_to_file(filepath.c_str(), doc)) {
+        throw std::runtime_error(fmt::format("Failed to write sandbox environment config ({})", filepath));
+    }
+    return filepath;
+}
+
+static bool check_mode(const app::SandboxMode mode, const fs::path &real_home, app::environment_t &parent_env) {
+    const char *mode_name = app::sandbox_mode_to_string(mode);
+    const auto dir = bench::get_bench_directory();
+    const auto filename = fmt::format("appvirtualenv_check_sandbox_{}_{}.txt", mode_name, getpid());
+    const auto real_path = real_home / ".config" / filename;
+
+    app::AppConfig cfg;
+    cfg.name = fmt::format("check_sandbox_{}", mode_name);
+    cfg.username = "check";
+    cfg.exec_path = "/bin/sh";
+    cfg.exec_cwd = dir.string();
+    cfg.args = fmt::format("-c \"mkdir -p '{0}' && echo sandboxed > '{1}'\"", real_path.parent_path().string(), real_path.string());
+    cfg.env_name = cfg.name;
+    cfg.env_parent_dir = (dir / "envs").string();
+    cfg.env_config_path = create_sandbox_env_config(dir);
+    cfg.sandbox = mode;
+    const auto env_path = fs::absolute(fs::path(cfg.env_parent_dir) / cfg.env_name / "home" / ".config" / filename);
+    fs::remove(env_path);
+
+    int64_t exit_code = -1;
+    try {
+        auto process = app::AppProcess(cfg, parent_env);
+        while (process.GetState() != app::AppProcess::State::TERMINATED) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        exit_code = process.GetExitCode();
+    } catch (std::exception &ex) {
+        fmt::print("{:<8} failed to launch: {}\n", mode_name, ex.what());
+        return false;
+    }
+
+    const bool is_leaked = fs::exists(real_path);
+    const bool is_redirected = fs::exists(env_path);
+    if (is_leaked) {
+        fs::remove(real_path);
+    }
+    const bool is_passed = (exit_code == 0) && is_redirected && !is_leaked;
+    fmt::print("{:<8} {} exit code {}, written to {}\n",
+        mode_name, is_passed ? "passed" : "FAILED", exit_code,
+        is_redirected ? env_path.string() : (is_leaked ? real_path.string() : "nowhere"));
+    return is_passed;
+}
+
+int main() {
+    if (!is_sandbox_supported()) {
+        fprintf(stderr, "Skipped, unprivileged user namespaces aren't allowed on this system\n");
+        return EXIT_SKIPPED;
+    }
+
+    auto parent_env = app::get_env();
+    const char *home = getenv("HOME");
+    if ((home == nullptr) || (home[0] != '/')) {
+        fprintf(stderr, "HOME has to be an absolute path\n");
+        return 1;
+    }
+    const auto real_home = fs::path(home);
+
+    bool is_passed = true;
+    for (auto mode: { app::SandboxMode::BIND, app::SandboxMode::OVERLAY }) {
+        is_passed = check_mode(mode, real_home, parent_env) && is_passed;
+    }
+    return is_passed ? 0 : 1;
+}
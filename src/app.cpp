@@ -1,16 +1,19 @@
 #include "app.h"
 
 #include <string>
+#include <algorithm>
 #include <filesystem>
 #include <ranges>
+#include <unordered_map>
 
 #include <fmt/core.h>
 #include <spdlog/spdlog.h>
 
 #include "app_schema.h"
+#include "buffer_manager.h"
 #include "environ.h"
 #include "file_loading.h"
-#include "utils.h"
+#include "tracing.h"
 
 namespace app {
 
@@ -21,8 +24,17 @@ extern const char *DEFAULT_APP_FILEPATH = "./res/default_app.json";
 extern const char *DEFAULT_APPS_FILEPATH = "./res/apps.json";
 
 // application
-App::App() {
-    m_parent_env = get_env();
+App::App()
+: m_supervisor([this](const AppConfig &cfg) {
+    // restarts which fail to launch go through the same backoff as a failed exit
+    auto on_failure = [this, cfg](const std::string &error) {
+        m_supervisor.OnLaunchFailure(cfg, error);
+    };
+    m_launch_scheduler.Enqueue({ cfg }, m_parent_env, m_terminal_size.load(), m_on_process_update, get_process_exit_callback(), on_failure);
+  }),
+  m_parent_env(get_env())
+{
+    BufferManager::Get().SetBudget(BufferManager::DEFAULT_BUDGET);
 
     // load default app config
     auto app_doc_res = load_document_from_filename(DEFAULT_APP_FILEPATH);
@@ -47,16 +59,26 @@ App::App(const std::string &app_filepath)
     open_app_config(app_filepath);
 }
 
+App::~App() {
+    // restarts and launch workers run on their own threads and use our members
+    // so they are stopped before any member is destroyed
+    m_supervisor.Shutdown();
+    m_launch_scheduler.Shutdown();
+    // launches which finished in the meantime are destroyed with the rest of the processes
+    std::vector<std::string> errors;
+    m_launch_scheduler.TakeResults(m_processes, errors);
+}
+
 bool App::open_app_config(const std::string &app_filepath) {
     auto apps_doc_res = load_document_from_filename(app_filepath.c_str());
     if (!apps_doc_res) {
-        m_runtime_warnings.push_back(fmt::format("Failed to read apps file ({})", app_filepath));
+        add_runtime_warning(fmt::format("Failed to read apps file ({})", app_filepath));
         return false;
     }
 
     auto apps_doc = std::move(apps_doc_res.value());
     if (!validate_document(apps_doc, APPS_SCHEMA)) {
-        m_runtime_warnings.push_back(std::string("Failed to validate apps schema"));
+        add_runtime_warning(std::string("Failed to validate apps schema"));
         return false;
     }
 
@@ -89,11 +111,97 @@ bool App::open_app_config(const std::string &app_filepath) {
 }
 
 void App::launch_app(AppConfig &app) {
-    try {
-        auto process_ptr = std::make_unique<AppProcess>(app, m_parent_env);
-        m_processes.push_back(std::move(process_ptr));
-    } catch (std::exception &ex) {
-        m_runtime_warnings.push_back(ex.what());
+    launch_apps({ app });
+}
+
+void App::launch_apps(const std::vector<AppConfig> &apps) {
+    TRACE_SCOPE("enqueue_launch");
+    // a manual launch takes over from any pending restart
+    for (auto &app: apps) {
+        m_supervisor.OnUserLaunch(app.name);
+    }
+    m_launch_scheduler.Enqueue(apps, m_parent_env, m_terminal_size.load(), m_on_process_update, get_process_exit_callback());
+}
+
+process_exit_callback_t App::get_process_exit_callback() {
+    return [this](AppProcess &process) {
+        m_supervisor.OnProcessExit(process);
+    };
+}
+
+void App::poll_launches() {
+    std::vector<std::string> errors;
+    // launches requested by output triggers, by app name
+    for (auto &process: m_processes) {
+        for (auto &name: process->GetTriggers().TakeLaunches()) {
+            auto &configs = m_managed_configs.GetConfigs();
+            auto it = std::find_if(configs.begin(), configs.end(), [&name](auto &cfg) {
+                return cfg->GetConfig().name == name;
+            });
+            if (it == configs.end()) {
+                errors.push_back(fmt::format("Trigger of ({}) can't launch unknown app ({})", process->GetName(), name));
+                continue;
+            }
+            spdlog::info(fmt::format("Launching ({}) on a trigger of ({})", name, process->GetName()));
+            launch_app((*it)->GetConfig());
+        }
+    }
+    m_launch_scheduler.TakeResults(m_processes, errors);
+    retire_processes();
+    m_supervisor.TakeWarnings(errors);
+    for (auto &error: errors) {
+        add_runtime_warning(std::move(error));
+    }
+}
+
+void App::retire_processes() {
+    // newest first so the most recent instances of each app are the ones kept
+    std::unordered_map<std::string, size_t> total_terminated;
+    std::vector<AppProcess *> retired;
+    for (auto it = m_processes.rbegin(); it != m_processes.rend(); it++) {
+        auto &process = *it;
+        if (process->GetState() != AppProcess::State::TERMINATED) {
+            continue;
+        }
+        if (++total_terminated[process->GetName()] > MAX_TERMINATED_PER_APP) {
+            retired.push_back(process.get());
+        }
+    }
+    if (retired.empty()) {
+        return;
+    }
+
+    // the timeline points at the process, the buffer manager is left by the destructor
+    // launch requests keep their own copy of what dependents need, and the daemon looks processes up by id
+    // the destructor joins the listener so an exit callback still running finishes first
+    for (auto *process: retired) {
+        m_timeline.RemoveSource(process);
+    }
+    auto it = std::remove_if(m_processes.begin(), m_processes.end(), [&retired](auto &process) {
+        return std::find(retired.begin(), retired.end(), process.get()) != retired.end();
+    });
+    m_processes.erase(it, m_processes.end());
+}
+
+void App::consume_output() {
+    // the output pane consumes what it draws itself, this covers the readers which aren't on screen
+    for (auto &process: m_processes) {
+        auto &buffer = process->GetBuffer();
+        // the archive sees every byte as it is captured
+        if (process->GetArchive() != nullptr) {
+            buffer.MarkConsumed(process->GetArchive()->GetStats().total_archived);
+        }
+    }
+    for (auto &source: m_timeline.GetSources()) {
+        source.process->GetBuffer().MarkConsumed(source.next_offset);
+    }
+}
+
+void App::add_runtime_warning(std::string warning) {
+    spdlog::warn(warning);
+    m_runtime_warnings.push_back(std::move(warning));
+    while (m_runtime_warnings.size() > MAX_RUNTIME_WARNINGS) {
+        m_runtime_warnings.pop_front();
     }
 }
 
@@ -113,7 +221,7 @@ void App::save_configs() {
 
     auto doc = create_app_configs_doc(cfgs);
     if (!write_document_to_file(m_app_filepath.c_str(), doc)) {
-        m_runtime_warnings.push_back(fmt::format("Failed to save configs to {}", m_app_filepath));
+        add_runtime_warning(fmt::format("Failed to save configs to {}", m_app_filepath));
     } else {
         m_managed_configs.CommitSave();
     }
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <atomic>
 #include <string>
 #include <vector>
 #include <list>
@@ -9,6 +10,10 @@
 #include "app_process.h"
 #include "managed_config.h"
 #include "environ.h"
+#include "log_ring_sink.h"
+#include "process_timeline.h"
+#include "launch_scheduler.h"
+#include "supervisor.h"
 
 namespace app {
 
@@ -19,22 +24,53 @@ extern const char *DEFAULT_APPS_FILEPATH;
 class App 
 {
 public:
+    // oldest warnings are dropped once the history is full
+    static constexpr size_t MAX_RUNTIME_WARNINGS = 100;
+    // terminated processes kept per app so their output can still be read
+    // older ones are destroyed as restarts and relaunches add new ones
+    static constexpr size_t MAX_TERMINATED_PER_APP = 4;
     std::string m_app_filepath;
     std::list<std::string> m_runtime_errors;
     std::list<std::string> m_runtime_warnings;
+    // declared before the processes so it is destroyed after them
+    LaunchScheduler m_launch_scheduler;
+    // restarts exited processes, launches through the scheduler
+    Supervisor m_supervisor;
     std::vector<std::unique_ptr<AppProcess>> m_processes;
     ManagedConfigList m_managed_configs;
+    // size of the output pane, used for processes launched with a pseudo terminal
+    // written by the gui every frame and read by restarts on the supervisor's thread
+    std::atomic<TerminalSize> m_terminal_size;
+    // passed to launched processes so the gui can wake up on new output, set before anything is launched
+    process_update_callback_t m_on_process_update;
+    // recent log messages shown in the gui, can be null if logging wasn't setup with one
+    std::shared_ptr<LogRingSink> m_log_sink;
+    // output of the selected processes merged in arrival order
+    ProcessTimeline m_timeline;
 private:
-    environment_t m_parent_env;
+    // never changes after construction so restarts can read it from any thread
+    const environment_t m_parent_env;
     // single instance that we preload with default for our app factory
     ManagedConfig m_default_app_config;
 public:
     App();
     App(const std::string &app_filepath);
+    ~App();
     inline auto &GetCreatorConfig() { return m_default_app_config; }
     bool open_app_config(const std::string &app_filepath);
+    // launches are queued and run on the scheduler's worker threads
     void launch_app(AppConfig &app);
+    void launch_apps(const std::vector<AppConfig> &apps);
+    // take finished launches from the scheduler, called from the gui thread
+    void poll_launches();
+    // lets lossless processes capture more once their archive or the timeline has read their output
+    // without either they wait until the output pane has drawn it
+    void consume_output();
+    void add_runtime_warning(std::string warning);
     void save_configs();
+private:
+    process_exit_callback_t get_process_exit_callback();
+    void retire_processes();
 };
 
 }
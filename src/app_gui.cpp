@@ -1,18 +1,30 @@
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
 #include <string>
 #include <array>
 #include <filesystem>
 #include <optional>
 #include <functional>
+#include <algorithm>
+#include <vector>
+#include <chrono>
 
 #include <imgui.h>
 #include <imgui_stdlib.h>
 
 #include <fmt/format.h>
+#include <fmt/ranges.h>
 #include <spdlog/spdlog.h>
 
 #include "app.h"
+#include "buffer_manager.h"
+#include "daemon_client.h"
 #include "font_awesome_definitions.h"
-#include "utils.h"
+#include "frame_profiler.h"
+#include "output_layout.h"
+#include "platform.h"
+#include "tracing.h"
 
 #define WIN32_LEAN_AND_MEAN
 #include <windows.h>
@@ -28,6 +40,9 @@ namespace app::gui {
 
 namespace fs = std::filesystem;
 
+// chrome trace event json which can be opened in chrome://tracing or perfetto
+static const char *TRACE_EXPORT_FILEPATH = "trace.json";
+
 // helper object for creating windows file dialogs
 class CoFileDialog 
 {
@@ -57,7 +72,7 @@ public:
         if (!SUCCEEDED(hr)) return {};
 
         std::wstring ws(pFilepath);
-        return utility::wide_string_to_string(ws);
+        return platform::wide_string_to_string(ws);
     }   
     inline IFileOpenDialog* operator->() const { return m_dialog; }
 private:
@@ -66,6 +81,10 @@ private:
 
 static void RenderAppsTab(App &main_app);
 static void RenderProcessesTab(App &main_app);
+static void RenderTimelineTab(App &main_app);
+static void RenderLaunchQueue(App &main_app);
+static void RenderCaptureMemory();
+static void RenderLogsTab(App &main_app);
 
 static void RenderManagedConfigList(App &main_app);
 static void RenderManagedConfig(App &main_app, ManagedConfig &managed_cfg);
@@ -74,8 +93,13 @@ static void RenderManagedConfigPopup(App &main_app, ManagedConfig &managed_cfg);
 static void RenderAppConfigEditForm(ManagedConfig &managed_cfg);
 static void RenderWarnings(App &main_app);
 static void RenderCriticalErrors(App &main_app);
+static void RenderFrameProfiler(FrameProfiler &profiler);
+static void RenderRemoteProcessState(const uint8_t state);
 
 void RenderApp(App &main_app, const char *label) {
+    PROFILE_SCOPE("RenderApp");
+    main_app.poll_launches();
+
     ImGuiViewport* viewport = ImGui::GetMainViewport();
     ImGui::SetNextWindowPos(viewport->Pos);
     ImGui::SetNextWindowSize(viewport->Size);
@@ -131,6 +155,29 @@ void RenderApp(App &main_app, const char *label) {
         if (ImGui::MenuItem("Add app")) {
             app_creator_opened = true;
         }
+
+        if (ImGui::BeginMenu("View")) {
+            auto &profiler = FrameProfiler::Get();
+            bool is_profiler_enabled = profiler.IsEnabled();
+            if (ImGui::MenuItem("Frame profiler", NULL, &is_profiler_enabled)) {
+                profiler.SetIsEnabled(is_profiler_enabled);
+            }
+
+            ImGui::Separator();
+            auto &tracer = Tracer::Get();
+            bool is_tracing_enabled = tracer.IsEnabled();
+            if (ImGui::MenuItem("Launch tracing", NULL, &is_tracing_enabled)) {
+                tracer.SetIsEnabled(is_tracing_enabled);
+            }
+            if (ImGui::MenuItem("Export trace")) {
+                if (tracer.ExportChromeTrace(TRACE_EXPORT_FILEPATH)) {
+                    spdlog::info(fmt::format("Exported trace to {}", TRACE_EXPORT_FILEPATH));
+                } else {
+                    main_app.add_runtime_warning(fmt::format("Failed to export trace to {}", TRACE_EXPORT_FILEPATH));
+                }
+            }
+            ImGui::EndMenu();
+        }
         ImGui::EndMenuBar();
     }
 
@@ -149,6 +196,16 @@ void RenderApp(App &main_app, const char *label) {
             ImGui::EndTabItem();
         }
 
+        if (ImGui::BeginTabItem("Timeline###timeline_tab")) {
+            RenderTimelineTab(main_app);
+            ImGui::EndTabItem();
+        }
+
+        if (ImGui::BeginTabItem("Logs###logs_tab")) {
+            RenderLogsTab(main_app);
+            ImGui::EndTabItem();
+        }
+
         ImGui::EndTabBar();
     }
     ImGui::End();
@@ -159,11 +216,18 @@ void RenderApp(App &main_app, const char *label) {
 
     RenderCriticalErrors(main_app);
     RenderAppConfigCreatorPopup(main_app, app_create_cfg_label);
+    main_app.consume_output();
+
+    auto &profiler = FrameProfiler::Get();
+    if (profiler.IsEnabled()) {
+        RenderFrameProfiler(profiler);
+    }
 
     ImGui::PopID();
 }
 
 void RenderAppsTab(App &main_app) {
+    PROFILE_SCOPE("RenderAppsTab");
     // configs list 
     float alpha = 0.7f;
     auto left_panel_size = ImVec2(ImGui::GetContentRegionAvail().x*alpha, 0);
@@ -181,7 +245,217 @@ void RenderAppsTab(App &main_app) {
     ImGui::EndChild();
 }
 
+static ImVec4 GetTextStyleColour(const uint32_t colour) {
+    return ImColor(int((colour >> 16) & 0xFF), int((colour >> 8) & 0xFF), int(colour & 0xFF)).Value;
+}
+
+static void RenderStyledSpan(const char *begin, const char *end, const TextStyle &style, const ImVec4 &default_colour) {
+    ImVec4 foreground = (style.foreground != TextStyle::DEFAULT_COLOUR) ? GetTextStyleColour(style.foreground) : default_colour;
+    ImVec4 background = (style.background != TextStyle::DEFAULT_COLOUR) ? GetTextStyleColour(style.background) : ImGui::GetStyleColorVec4(ImGuiCol_WindowBg);
+    bool is_background = (style.background != TextStyle::DEFAULT_COLOUR);
+    if (style.attributes & TextStyle::INVERSE) {
+        std::swap(foreground, background);
+        is_background = true;
+    }
+    if (style.attributes & TextStyle::DIM) {
+        foreground.w *= 0.6f;
+    }
+
+    auto *draw_list = ImGui::GetWindowDrawList();
+    const ImVec2 pos = ImGui::GetCursorScreenPos();
+    const ImVec2 size = ImVec2(ImGui::CalcTextSize(begin, end).x, ImGui::GetTextLineHeight());
+    if (is_background) {
+        draw_list->AddRectFilled(pos, ImVec2(pos.x + size.x, pos.y + size.y), ImGui::GetColorU32(background));
+    }
+    ImGui::PushStyleColor(ImGuiCol_Text, foreground);
+    ImGui::TextUnformatted(begin, end);
+    ImGui::PopStyleColor();
+    const ImU32 colour = ImGui::GetColorU32(foreground);
+    // there is only the one font so bold text is drawn again a pixel across
+    if (style.attributes & TextStyle::BOLD) {
+        draw_list->AddText(ImVec2(pos.x + 1.0f, pos.y), colour, begin, end);
+    }
+    if (style.attributes & TextStyle::UNDERLINE) {
+        draw_list->AddLine(ImVec2(pos.x, pos.y + size.y - 1.0f), ImVec2(pos.x + size.x, pos.y + size.y - 1.0f), colour);
+    }
+    if (style.attributes & TextStyle::STRIKETHROUGH) {
+        draw_list->AddLine(ImVec2(pos.x, pos.y + size.y*0.5f), ImVec2(pos.x + size.x, pos.y + size.y*0.5f), colour);
+    }
+}
+
+// draws a line of output at an absolute offset as a span for each style run over it
+// runs are from OutputStyles::GetRuns() for a range which includes the line
+static void RenderStyledLine(const char *begin, const char *end, const uint64_t offset, const std::vector<StyleRun> &runs, const ImVec4 &default_colour) {
+    auto run = std::upper_bound(runs.begin(), runs.end(), offset, [](const uint64_t value, const StyleRun &other) {
+        return value < other.offset;
+    });
+    TextStyle style = (run != runs.begin()) ? std::prev(run)->style : TextStyle{};
+    const uint64_t end_offset = offset + uint64_t(end - begin);
+    // most lines don't have any colour
+    if (style.IsDefault() && ((run == runs.end()) || (run->offset >= end_offset))) {
+        ImGui::PushStyleColor(ImGuiCol_Text, default_colour);
+        ImGui::TextUnformatted(begin, end);
+        ImGui::PopStyleColor();
+        return;
+    }
+
+    const char *span_begin = begin;
+    bool is_first_span = true;
+    while (true) {
+        const uint64_t span_end_offset = ((run != runs.end()) && (run->offset < end_offset)) ? run->offset : end_offset;
+        const char *span_end = begin + (span_end_offset - offset);
+        if (span_end > span_begin) {
+            if (!is_first_span) {
+                ImGui::SameLine(0.0f, 0.0f);
+            }
+            RenderStyledSpan(span_begin, span_end, style, default_colour);
+            is_first_span = false;
+        }
+        if (span_end_offset >= end_offset) {
+            break;
+        }
+        style = run->style;
+        ++run;
+        span_begin = span_end;
+    }
+    if (is_first_span) {
+        ImGui::TextUnformatted("");
+    }
+}
+
+// splits a line into the rows it wraps to at a width, rows gets the start of each one
+// stops once there are max_rows since the rest aren't drawn
+static void GetWrappedRows(const char *begin, const char *end, const float wrap_width, const size_t max_rows, std::vector<const char *> &rows) {
+    rows.clear();
+    rows.push_back(begin);
+    if (wrap_width <= 0.0f) {
+        return;
+    }
+    ImFont *font = ImGui::GetFont();
+    const float scale = ImGui::GetFontSize() / font->FontSize;
+    const char *row = begin;
+    while (rows.size() < max_rows) {
+        const char *row_end = font->CalcWordWrapPositionA(scale, row, end, wrap_width);
+        // a character wider than the pane still has to take up a row
+        if (row_end == row) {
+            row_end++;
+            while ((row_end < end) && ((uint8_t(*row_end) & 0xC0) == 0x80)) {
+                row_end++;
+            }
+        }
+        // blanks at a wrap are dropped instead of starting the next row
+        while ((row_end < end) && ((*row_end == ' ') || (*row_end == '\t'))) {
+            row_end++;
+        }
+        if (row_end >= end) {
+            break;
+        }
+        rows.push_back(row_end);
+        row = row_end;
+    }
+}
+
+// draws the output still in a ring with a row for each row its lines wrap to, only the visible rows are drawn
+// the layout is kept between frames by the caller so only new output is indexed, and reset when the ring changes
+// the ring has to be locked for reading, timestamps are drawn by the callback in a column of their own
+static void RenderOutputLines(
+    ScrollingBuffer &scroll_buffer, const uint64_t total_written, OutputLayout &layout, OutputStyles &styles,
+    const std::vector<uint64_t> &highlights, const bool is_wrap_lines,
+    const float timestamp_width, const std::function<void(const uint64_t)> &render_timestamp)
+{
+    const size_t buffer_length = size_t(std::min(total_written, uint64_t(scroll_buffer.GetMaxSize())));
+    const uint64_t buffer_offset = total_written - uint64_t(buffer_length);
+    const char *buffer_begin = scroll_buffer.GetBufferAtOffset(buffer_offset);
+    const bool is_show_timestamps = (timestamp_width > 0.0f);
+
+    ImGui::PushStyleVar(ImGuiStyleVar_ItemSpacing, ImVec2(ImGui::GetStyle().ItemSpacing.x, 0.0f));
+    const float line_height = ImGui::GetTextLineHeight();
+    // wrapped rows line up under the text instead of under the timestamps
+    const float text_x = is_show_timestamps ? (timestamp_width + ImGui::GetStyle().ItemSpacing.x) : 0.0f;
+    const float char_width = ImGui::CalcTextSize("abcdefghijklmnopqrstuvwxyz").x / 26.0f;
+    const float wrap_width = is_wrap_lines ? std::max(floorf(ImGui::GetContentRegionAvail().x - text_x), char_width*8.0f) : 0.0f;
+    static std::vector<const char *> wrap_rows;
+    const auto measure_rows = [&](const char *begin, const char *end) {
+        GetWrappedRows(begin, end, wrap_width, SIZE_MAX, wrap_rows);
+        return uint32_t(wrap_rows.size());
+    };
+
+    // the line at the top of the pane stays there when the width changes
+    const uint64_t scroll_row = uint64_t(std::max(ImGui::GetScrollY(), 0.0f) / line_height);
+    const uint64_t total_visible_rows = uint64_t(ImGui::GetWindowHeight() / line_height) + 2;
+    uint64_t anchor_offset = buffer_offset;
+    uint32_t anchor_line_row = 0;
+    if (layout.GetTotalLines() > 0) {
+        const size_t anchor_line = layout.FindRow(scroll_row, anchor_line_row);
+        anchor_offset = layout.GetLineOffset(anchor_line);
+    }
+    layout.Update(buffer_begin, buffer_offset, total_written);
+    const bool is_relayout = layout.SetWrapWidth(wrap_width, char_width);
+    if (layout.GetTotalLines() > 0) {
+        uint32_t line_row = 0;
+        const size_t first_line = is_relayout ? layout.FindOffset(anchor_offset) : layout.FindRow(scroll_row, line_row);
+        layout.Measure(first_line, total_visible_rows, OutputLayout::MEASURE_BUDGET, measure_rows);
+        if (is_relayout) {
+            const uint32_t row = std::min(anchor_line_row, layout.GetLineRows(first_line) - 1);
+            ImGui::SetScrollY(float(layout.GetLineRow(first_line) + row) * line_height);
+        }
+    }
+
+    // colours of the visible lines, fetched once for each range the clipper gives us
+    static std::vector<StyleRun> style_runs;
+    const ImVec4 text_colour = ImGui::GetStyleColorVec4(ImGuiCol_Text);
+    const ImVec4 highlight_colour = ImColor(255,215,0).Value;
+
+    const uint64_t total_rows = std::min(layout.GetTotalRows(), uint64_t(INT32_MAX));
+    ImGuiListClipper clipper;
+    clipper.Begin(int(total_rows), line_height);
+    while (clipper.Step()) {
+        if (clipper.DisplayStart >= clipper.DisplayEnd) {
+            continue;
+        }
+        uint32_t line_row = 0;
+        uint32_t last_line_row = 0;
+        size_t line = layout.FindRow(uint64_t(clipper.DisplayStart), line_row);
+        const size_t last_line = layout.FindRow(uint64_t(clipper.DisplayEnd - 1), last_line_row);
+        styles.GetRuns(layout.GetLineOffset(line), layout.GetLineEnd(last_line), style_runs);
+        for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; line++, line_row = 0) {
+            const uint64_t line_offset = layout.GetLineOffset(line);
+            const uint64_t line_end = layout.GetLineEnd(line);
+            const uint64_t next_line_offset = ((line+1) < layout.GetTotalLines()) ? layout.GetLineOffset(line+1) : total_written;
+            const char *text_begin = buffer_begin + (line_offset - buffer_offset);
+            const char *text_end = buffer_begin + (line_end - buffer_offset);
+            auto highlight = std::lower_bound(highlights.begin(), highlights.end(), line_offset);
+            const bool is_highlight = (highlight != highlights.end()) && (*highlight < next_line_offset);
+            // lines which haven't been measured yet may wrap to a different number of rows than were laid out
+            const uint32_t total_line_rows = layout.GetLineRows(line);
+            // one more row than is drawn so the last one knows where it ends
+            const size_t max_rows = size_t(line_row) + size_t(clipper.DisplayEnd - row) + 1;
+            GetWrappedRows(text_begin, text_end, wrap_width, std::min(max_rows, size_t(total_line_rows)), wrap_rows);
+            for (; (line_row < total_line_rows) && (row < clipper.DisplayEnd); line_row++, row++) {
+                if ((line_row == 0) && is_show_timestamps) {
+                    render_timestamp(line_offset);
+                    ImGui::SameLine(text_x);
+                } else if (is_show_timestamps) {
+                    ImGui::SetCursorPosX(text_x);
+                }
+                if (line_row >= wrap_rows.size()) {
+                    ImGui::TextUnformatted("");
+                    continue;
+                }
+                const char *row_begin = wrap_rows[line_row];
+                const bool is_last_row = ((line_row + 1) >= wrap_rows.size()) || ((line_row + 1) >= total_line_rows);
+                const char *row_end = is_last_row ? text_end : wrap_rows[line_row+1];
+                RenderStyledLine(
+                    row_begin, row_end, line_offset + uint64_t(row_begin - text_begin),
+                    style_runs, is_highlight ? highlight_colour : text_colour);
+            }
+        }
+    }
+    ImGui::PopStyleVar();
+}
+
 void RenderProcessesTab(App &main_app) {
+    PROFILE_SCOPE("RenderProcessesTab");
     // configs list 
     float alpha = 0.3f;
     auto left_panel_size = ImVec2(ImGui::GetContentRegionAvail().x*alpha, 0);
@@ -191,16 +465,25 @@ void RenderProcessesTab(App &main_app) {
     ImGuiWindowFlags flags = 0;
     ImGui::BeginChild("##process_list_panel", left_panel_size, true, flags);
 
-    static size_t selected_pid = 0;
+    RenderLaunchQueue(main_app);
+    RenderCaptureMemory();
+
+    // selected by id since older processes are removed from the list as their apps restart
+    static uint64_t selected_id = 0;
     
     if (ImGui::BeginListBox("##process_list", ImVec2(-1, -1))) {
         size_t pid = 0;
         for (auto &proc: processes) {
-            bool is_selected = (pid == selected_pid);
+            bool is_selected = (proc->GetId() == selected_id);
             ImGui::PushID(pid);
             ImGui::PushItemWidth(-1.0f);
 
             const auto proc_state = proc->GetState();
+            // restart status is tracked per app name so it is shared by every process of the app
+            std::optional<SupervisedStatus> restart_status;
+            if (proc->GetConfig().restart_policy != RestartPolicy::NEVER) {
+                restart_status = main_app.m_supervisor.GetStatus(proc->GetName());
+            }
 
             switch (proc_state) {
                 case AppProcess::State::RUNNING:
@@ -222,7 +505,64 @@ void RenderProcessesTab(App &main_app) {
             ImGui::SameLine();
 
             if (ImGui::Selectable(proc->GetName().c_str(), is_selected, ImGuiSelectableFlags_SpanAllColumns)) {
-                selected_pid = pid;
+                selected_id = proc->GetId();
+            }
+
+            // capture statistics
+            if (ImGui::IsItemHovered()) {
+                const auto stats = proc->GetBuffer().GetStats();
+                const double KiB = 1024.0;
+                ImGui::BeginTooltip();
+                ImGui::Text("Capture mode: %s%s", 
+                    capture_mode_to_string(proc->GetCaptureMode()),
+                    proc->IsCaptureStalled() ? " (waiting for consumer)" : "");
+                const auto encoding = proc->GetOutputEncoding();
+                const bool is_detected = (proc->GetConfig().output_encoding == OutputEncoding::AUTO) && (encoding != OutputEncoding::AUTO);
+                ImGui::Text("Encoding: %s%s", output_encoding_to_string(encoding), is_detected ? " (detected)" : "");
+                ImGui::Text("Captured: %.1f KiB", double(stats.total_captured) / KiB);
+                ImGui::Text("Dropped: %.1f KiB", double(stats.total_dropped) / KiB);
+                ImGui::Text("Peak fill: %.1f/%.1f KiB", 
+                    double(stats.peak_pending_size) / KiB, 
+                    double(proc->GetBuffer().GetMaxSize()) / KiB);
+                if (proc->GetArchive() != nullptr) {
+                    const auto archive_stats = proc->GetArchive()->GetStats();
+                    const double MiB = 1024.0*1024.0;
+                    const uint64_t total_compressed_input = archive_stats.total_archived - archive_stats.total_pending - archive_stats.total_dropped;
+                    ImGui::Separator();
+                    ImGui::Text("Archived: %.2f MiB", double(archive_stats.total_archived) / MiB);
+                    ImGui::Text("Compressed: %.2f MiB (%.1fx)", 
+                        double(archive_stats.total_compressed) / MiB,
+                        (archive_stats.total_compressed > 0) ? (double(total_compressed_input) / double(archive_stats.total_compressed)) : 0.0);
+                    ImGui::Text("Compression speed: %.0f MiB/s", 
+                        (archive_stats.compress_seconds > 0.0) ? (double(total_compressed_input) / MiB / archive_stats.compress_seconds) : 0.0);
+                    if (archive_stats.total_dropped > 0) {
+                        ImGui::Text("Dropped: %.2f MiB", double(archive_stats.total_dropped) / MiB);
+                    }
+                }
+                auto &triggers = proc->GetTriggers();
+                if (!triggers.GetRules().empty()) {
+                    ImGui::Separator();
+                    auto &rules = triggers.GetRules();
+                    for (size_t i = 0; i < rules.size(); i++) {
+                        ImGui::Text("%s (%s): %llu",
+                            rules[i].pattern.c_str(), trigger_action_to_string(rules[i].action),
+                            (unsigned long long)(triggers.GetCount(i)));
+                    }
+                }
+                if (restart_status) {
+                    ImGui::Separator();
+                    ImGui::Text("Restart policy: %s", restart_policy_to_string(proc->GetConfig().restart_policy));
+                    ImGui::Text("Restarts: %u", restart_status->total_restarts);
+                    if (!restart_status->last_exit_reason.empty()) {
+                        ImGui::Text("Last exit: %s", restart_status->last_exit_reason.c_str());
+                    }
+                    if (restart_status->state == SupervisedStatus::State::BACKOFF) {
+                        ImGui::Text("Restarting in %.1fs", restart_status->backoff_seconds);
+                    } else {
+                        ImGui::Text("Supervisor: %s", supervised_state_to_string(restart_status->state));
+                    }
+                }
+                ImGui::EndTooltip();
             }
 
             // options while process is running
@@ -233,6 +573,13 @@ void RenderProcessesTab(App &main_app) {
                     }
                     ImGui::EndPopup();
                 }
+            } else if (restart_status && (restart_status->state == SupervisedStatus::State::BACKOFF)) {
+                if (ImGui::BeginPopupContextItem()) {
+                    if (ImGui::MenuItem("Cancel restart")) {
+                        main_app.m_supervisor.Stop(proc->GetName());
+                    }
+                    ImGui::EndPopup();
+                }
             }
 
             ImGui::PopItemWidth();
@@ -247,35 +594,467 @@ void RenderProcessesTab(App &main_app) {
     ImGui::SameLine();
 
     // errors list
-    flags = ImGuiWindowFlags_AlwaysHorizontalScrollbar;
+    flags = 0;
     ImGui::BeginChild("##process_buffer_panel", ImVec2(0,0), true, flags);
-    bool pid_outside_range = (selected_pid < 0) || (selected_pid >= processes.size());
-    if (pid_outside_range) {
+    auto selected_it = std::find_if(processes.begin(), processes.end(), [](auto &proc) {
+        return proc->GetId() == selected_id;
+    });
+    if (selected_it == processes.end()) {
         ImGui::Text("Select a process to view buffer");
     } else {
-        auto &proc = processes[selected_pid];
+        auto &proc = *selected_it;
+
+        // timestamps are shown in seconds since the process was started
+        static bool is_show_timestamps = false;
+        // long lines are soft wrapped to the pane instead of scrolling sideways
+        static bool is_wrap_lines = true;
+        static float jump_time = 0.0f;
+        bool is_jump = false;
+        ImGui::Checkbox("Timestamps", &is_show_timestamps);
+        ImGui::SameLine();
+        ImGui::Checkbox("Wrap lines", &is_wrap_lines);
+        ImGui::SameLine();
+        ImGui::PushItemWidth(ImGui::GetFontSize() * 8.0f);
+        if (ImGui::InputFloat("##jump_time", &jump_time, 0.0f, 0.0f, "%.3f s", ImGuiInputTextFlags_EnterReturnsTrue)) {
+            is_jump = true;
+        }
+        ImGui::PopItemWidth();
+        ImGui::SameLine();
+        if (ImGui::Button("Jump to time")) {
+            is_jump = true;
+        }
+
+        // search the full output history, which is read back from the compressed archive
+        auto &archive = proc->GetArchive();
+        if (archive != nullptr) {
+            static uint64_t search_id = 0;
+            static std::string search_pattern;
+            static std::vector<std::pair<uint64_t, std::string>> search_results;
+            const size_t MAX_SEARCH_RESULTS = 256;
+            const size_t MAX_RESULT_LENGTH = 256;
+
+            if (search_id != proc->GetId()) {
+                search_id = proc->GetId();
+                search_results.clear();
+            }
+
+            ImGui::SameLine();
+            ImGui::PushItemWidth(ImGui::GetFontSize() * 12.0f);
+            bool is_search = ImGui::InputTextWithHint("##search_history", "Search history", &search_pattern, ImGuiInputTextFlags_EnterReturnsTrue);
+            ImGui::PopItemWidth();
+            ImGui::SameLine();
+            is_search = ImGui::Button("Search") || is_search;
+
+            if (is_search) {
+                search_results.clear();
+                uint64_t start_offset = 0;
+                uint64_t match_offset = 0;
+                std::string line;
+                while ((search_results.size() < MAX_SEARCH_RESULTS) && archive->Find(search_pattern, start_offset, match_offset)) {
+                    // show the line around the match
+                    // the read starts later if the line runs into a gap from dropped segments
+                    uint64_t line_offset = match_offset - std::min(match_offset, uint64_t(MAX_RESULT_LENGTH/2));
+                    archive->Read(line_offset, MAX_RESULT_LENGTH, line, line_offset);
+                    const size_t match_index = size_t(match_offset - line_offset);
+                    size_t line_begin = line.rfind('\n', match_index);
+                    line_begin = (line_begin == std::string::npos) ? 0 : (line_begin+1);
+                    size_t line_end = line.find('\n', match_index);
+                    line_end = (line_end == std::string::npos) ? line.size() : line_end;
+                    line = line.substr(line_begin, line_end - line_begin);
+                    search_results.push_back({ match_offset, std::move(line) });
+                    start_offset = match_offset + 1;
+                }
+            }
+
+            if (!search_results.empty()) {
+                ImGui::BeginChild("##search_results", ImVec2(0, ImGui::GetTextLineHeightWithSpacing() * 8.0f), true);
+                ImGuiListClipper clipper;
+                clipper.Begin(int(search_results.size()));
+                while (clipper.Step()) {
+                    for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; row++) {
+                        auto &[offset, text] = search_results[size_t(row)];
+                        ImGui::TextDisabled("%10llu", (unsigned long long)(offset));
+                        ImGui::SameLine();
+                        ImGui::TextUnformatted(text.c_str(), text.c_str() + text.size());
+                    }
+                }
+                ImGui::EndChild();
+            }
+        }
+
+        // the rest of the tab is the output pane
+        PROFILE_SCOPE("RenderProcessOutput");
+        flags = is_wrap_lines ? 0 : ImGuiWindowFlags_AlwaysHorizontalScrollbar;
+        ImGui::BeginChild("##process_output", ImVec2(0,0), false, flags);
+
+        // pseudo terminals are sized to fit the output pane
+        {
+            const auto char_size = ImGui::CalcTextSize("M");
+            const auto pane_size = ImGui::GetContentRegionAvail();
+            TerminalSize terminal_size;
+            terminal_size.columns = int16_t(std::max(pane_size.x / char_size.x, 1.0f));
+            terminal_size.rows = int16_t(std::max(pane_size.y / char_size.y, 1.0f));
+            main_app.m_terminal_size.store(terminal_size);
+            proc->SetTerminalSize(terminal_size);
+        }
+
+        // absolute range of the bytes still in the buffer
         auto &scroll_buffer = proc->GetBuffer();
-        char *buffer_begin = scroll_buffer.GetReadBuffer();
-        size_t buffer_length = scroll_buffer.GetReadSize();
-        char *buffer_end = buffer_begin + buffer_length;
-        ImGui::TextUnformatted(buffer_begin, buffer_end);
+        // keeps the ring mapped while we render straight out of it
+        auto buffer_lock = scroll_buffer.LockRead();
+        const uint64_t total_written = scroll_buffer.GetTotalWritten();
+        const size_t buffer_length = size_t(std::min(total_written, uint64_t(scroll_buffer.GetMaxSize())));
+        const uint64_t buffer_offset = total_written - uint64_t(buffer_length);
+        const char *buffer_begin = scroll_buffer.GetBufferAtOffset(buffer_offset);
+
+        // rows of each line at the width of the pane, kept between frames so only new output is indexed
+        static OutputLayout layout;
+        static uint64_t layout_process_id = 0;
+        if (layout_process_id != proc->GetId()) {
+            layout_process_id = proc->GetId();
+            layout.Reset();
+        }
+
+        // lines with a highlight trigger match in them
+        static std::vector<uint64_t> highlights;
+        proc->GetTriggers().GetHighlights(buffer_offset, total_written, highlights);
+        const int64_t start_timestamp = proc->GetStartTimestamp();
+        const float timestamp_width = is_show_timestamps ? ImGui::CalcTextSize("0000000.000").x : 0.0f;
+        RenderOutputLines(
+            scroll_buffer, total_written, layout, proc->GetStyles(), highlights, is_wrap_lines,
+            timestamp_width, [&](const uint64_t line_offset) {
+                int64_t timestamp_ns;
+                if (scroll_buffer.GetTimestampAtOffset(line_offset, timestamp_ns)) {
+                    ImGui::TextDisabled("%10.3f", double(timestamp_ns - start_timestamp) * 1e-9);
+                } else {
+                    ImGui::TextDisabled("%10s", "?");
+                }
+            });
+        // everything up to here is in the pane, so a lossless process can overwrite it
+        scroll_buffer.MarkConsumed(total_written);
+
+        // find the line containing the first output at or after the requested time
+        if (is_jump) {
+            const float line_height = ImGui::GetTextLineHeight();
+            const int64_t timestamp_ns = start_timestamp + int64_t(double(jump_time) * 1e9);
+            uint64_t offset;
+            if (scroll_buffer.GetOffsetAtTime(timestamp_ns, offset) && (layout.GetTotalLines() > 0)) {
+                const size_t line_index = layout.FindOffset(offset);
+                ImGui::SetScrollY(float(layout.GetLineRow(line_index)) * line_height);
+            }
+        }
+
         // copy process text to clipboard
-        if (ImGui::BeginPopupContextItem("##buffer_text_context_menu")) {
+        if (ImGui::BeginPopupContextWindow("##buffer_text_context_menu")) {
             if (ImGui::MenuItem("Copy")) {
-                utility::CopyToClipboard(buffer_begin, buffer_length);
+                platform::copy_to_clipboard(buffer_begin, buffer_length);
             }
             ImGui::EndPopup();
         }
+        ImGui::EndChild();
+    }
+    ImGui::EndChild();
+}
+
+void RenderLaunchQueue(App &main_app) {
+    PROFILE_SCOPE("RenderLaunchQueue");
+    auto &scheduler = main_app.m_launch_scheduler;
+    const auto requests = scheduler.GetRequests();
+
+    size_t total_pending = 0;
+    for (auto &request: requests) {
+        if ((request.state == LaunchRequest::State::QUEUED) || (request.state == LaunchRequest::State::LAUNCHING)) {
+            total_pending++;
+        }
+    }
 
+    auto header_label = fmt::format("Launch queue ({})###launch_queue", total_pending);
+    if (!ImGui::CollapsingHeader(header_label.c_str())) {
+        return;
+    }
+
+    ImGui::PushItemWidth(ImGui::GetFontSize() * 6.0f);
+    int max_concurrent = int(scheduler.GetMaxConcurrent());
+    if (ImGui::InputInt("Max concurrent", &max_concurrent)) {
+        scheduler.SetMaxConcurrent(size_t(std::max(max_concurrent, 1)));
+    }
+    int stagger_ms = int(scheduler.GetStaggerDelay().count());
+    if (ImGui::InputInt("Stagger (ms)", &stagger_ms, 100, 1000)) {
+        scheduler.SetStaggerDelay(std::chrono::milliseconds(std::max(stagger_ms, 0)));
+    }
+    ImGui::PopItemWidth();
+
+    ImGuiTableFlags table_flags = ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingStretchProp;
+    if (ImGui::BeginTable("##launch_queue_table", 3, table_flags)) {
+        ImGui::TableSetupColumn("Name");
+        ImGui::TableSetupColumn("State");
+        ImGui::TableSetupColumn("", ImGuiTableColumnFlags_WidthFixed);
+        ImGui::TableHeadersRow();
+
+        // newest first
+        for (auto it = requests.rbegin(); it != requests.rend(); it++) {
+            auto &request = *it;
+            ImGui::PushID(int(request.id));
+            ImGui::TableNextRow();
+            ImGui::TableSetColumnIndex(0);
+            ImGui::TextUnformatted(request.config.name.c_str());
+            ImGui::TableSetColumnIndex(1);
+            const bool is_waiting = (request.state == LaunchRequest::State::QUEUED) && !request.dependencies.empty();
+            ImGui::Text("%s", is_waiting ? "waiting" : launch_state_to_string(request.state));
+            if (!request.error.empty() && ImGui::IsItemHovered()) {
+                ImGui::SetTooltip("%s", request.error.c_str());
+            } else if (is_waiting && ImGui::IsItemHovered()) {
+                ImGui::SetTooltip("Waiting on: %s", fmt::format("{}", fmt::join(request.config.depends_on, ", ")).c_str());
+            }
+            ImGui::TableSetColumnIndex(2);
+            if (request.state == LaunchRequest::State::QUEUED) {
+                if (ImGui::SmallButton("Cancel")) {
+                    scheduler.Cancel(request.id);
+                }
+            }
+            ImGui::PopID();
+        }
+        ImGui::EndTable();
+    }
+    ImGui::Separator();
+}
+
+void RenderCaptureMemory() {
+    PROFILE_SCOPE("RenderCaptureMemory");
+    auto &manager = BufferManager::Get();
+    const auto stats = manager.GetStats();
+    const double MiB = 1024.0*1024.0;
+
+    auto header_label = fmt::format("Capture memory ({:.0f}/{:.0f} MiB)###capture_memory", 
+        double(stats.total_size) / MiB, double(stats.budget) / MiB);
+    if (!ImGui::CollapsingHeader(header_label.c_str())) {
+        return;
+    }
+
+    ImGui::PushItemWidth(ImGui::GetFontSize() * 6.0f);
+    int budget_mib = int(stats.budget / size_t(MiB));
+    if (ImGui::InputInt("Budget (MiB)", &budget_mib, 16, 128)) {
+        manager.SetBudget(size_t(std::max(budget_mib, 16)) * size_t(MiB));
+    }
+    ImGui::PopItemWidth();
+    ImGui::Text("Buffers: %zu (%zu grown)", stats.total_buffers, stats.total_grown);
+    ImGui::Text("Largest: %.1f MiB", double(stats.largest_size) / MiB);
+    // every ring keeps at least the minimum size
+    if ((stats.total_buffers * ScrollingBuffer::MIN_SIZE) > stats.budget) {
+        ImGui::TextColored(ImColor(255,200,0).Value, "Budget is below the minimum for %zu buffers", stats.total_buffers);
+    }
+    ImGui::Separator();
+}
+
+// distinct colour for each merged process
+static ImVec4 GetTimelineColour(const size_t index) {
+    const float golden_ratio = 0.618034f;
+    float hue = float(index) * golden_ratio;
+    hue = hue - float(int(hue));
+    return ImColor::HSV(hue, 0.6f, 0.9f).Value;
+}
+
+void RenderTimelineTab(App &main_app) {
+    PROFILE_SCOPE("RenderTimelineTab");
+    auto &timeline = main_app.m_timeline;
+    timeline.Update(Tracer::GetTimestamp());
+
+    // processes to merge
+    float alpha = 0.3f;
+    auto left_panel_size = ImVec2(ImGui::GetContentRegionAvail().x*alpha, 0);
+    ImGui::BeginChild("##timeline_process_list", left_panel_size, true);
+    size_t pid = 0;
+    for (auto &proc: main_app.m_processes) {
+        ImGui::PushID(int(pid));
+        bool is_merged = timeline.HasSource(proc.get());
+        if (ImGui::Checkbox(proc->GetName().c_str(), &is_merged)) {
+            if (is_merged) {
+                timeline.AddSource(proc.get());
+            } else {
+                timeline.RemoveSource(proc.get());
+            }
+        }
+        ImGui::PopID();
+        pid++;
+    }
+    ImGui::EndChild();
+
+    ImGui::SameLine();
+
+    ImGui::BeginChild("##timeline_panel", ImVec2(0,0), true);
+    const auto &sources = timeline.GetSources();
+    if (sources.empty()) {
+        ImGui::Text("Select processes to merge their output");
+        ImGui::EndChild();
+        return;
+    }
+
+    static bool is_show_timestamps = true;
+    static bool is_autoscroll = true;
+    ImGui::Checkbox("Timestamps", &is_show_timestamps);
+    ImGui::SameLine();
+    ImGui::Checkbox("Autoscroll", &is_autoscroll);
+    for (size_t i = 0; i < sources.size(); i++) {
+        ImGui::SameLine();
+        ImGui::TextColored(GetTimelineColour(i), "%s", sources[i].process->GetName().c_str());
+        if ((sources[i].total_dropped > 0) && ImGui::IsItemHovered()) {
+            ImGui::SetTooltip("%llu bytes were overwritten before they were merged", 
+                (unsigned long long)(sources[i].total_dropped));
+        }
+    }
+
+    ImGui::BeginChild("##timeline_lines", ImVec2(0,0), false, ImGuiWindowFlags_AlwaysHorizontalScrollbar);
+    ImGui::PushStyleVar(ImGuiStyleVar_ItemSpacing, ImVec2(ImGui::GetStyle().ItemSpacing.x, 0.0f));
+    const auto &lines = timeline.GetLines();
+    const int64_t start_timestamp = timeline.GetStartTimestamp();
+    ImGuiListClipper clipper;
+    clipper.Begin(int(lines.size()), ImGui::GetTextLineHeight());
+    while (clipper.Step()) {
+        for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; row++) {
+            const auto &line = lines[size_t(row)];
+            if (is_show_timestamps) {
+                ImGui::TextDisabled("%10.3f", double(line.timestamp_ns - start_timestamp) * 1e-9);
+                ImGui::SameLine();
+            }
+            ImGui::TextColored(GetTimelineColour(line.source_index), "[%s]", 
+                sources[line.source_index].process->GetName().c_str());
+            ImGui::SameLine();
+            ImGui::TextUnformatted(line.text.c_str(), line.text.c_str() + line.text.size());
+        }
+    }
+    ImGui::PopStyleVar();
+
+    if (is_autoscroll && (ImGui::GetScrollY() >= ImGui::GetScrollMaxY())) {
+        ImGui::SetScrollHereY(1.0f);
+    }
+    ImGui::EndChild();
+    ImGui::EndChild();
+}
+
+void RenderLogsTab(App &main_app) {
+    PROFILE_SCOPE("RenderLogsTab");
+
+    auto &log_sink = main_app.m_log_sink;
+    if (log_sink == nullptr) {
+        ImGui::Text("Logging to the gui is not enabled");
+        return;
+    }
+
+    static ImGuiTextFilter filter;
+    static int show_level = spdlog::level::info;
+    static bool is_autoscroll = true;
+
+    // level of messages which get logged at all
+    ImGui::PushItemWidth(ImGui::GetFontSize() * 8.0f);
+    int log_level = int(spdlog::get_level());
+    auto log_level_name = spdlog::level::to_string_view(spdlog::level::level_enum(log_level));
+    if (ImGui::BeginCombo("Log level", log_level_name.data())) {
+        for (int i = spdlog::level::trace; i < spdlog::level::off; i++) {
+            auto name = spdlog::level::to_string_view(spdlog::level::level_enum(i));
+            if (ImGui::Selectable(name.data(), i == log_level)) {
+                spdlog::set_level(spdlog::level::level_enum(i));
+            }
+        }
+        ImGui::EndCombo();
+    }
+
+    // level of messages which are shown here
+    ImGui::SameLine();
+    auto show_level_name = spdlog::level::to_string_view(spdlog::level::level_enum(show_level));
+    if (ImGui::BeginCombo("Show", show_level_name.data())) {
+        for (int i = spdlog::level::trace; i < spdlog::level::off; i++) {
+            auto name = spdlog::level::to_string_view(spdlog::level::level_enum(i));
+            if (ImGui::Selectable(name.data(), i == show_level)) {
+                show_level = i;
+            }
+        }
+        ImGui::EndCombo();
+    }
+    ImGui::PopItemWidth();
+
+    ImGui::SameLine();
+    ImGui::Checkbox("Autoscroll", &is_autoscroll);
+    ImGui::SameLine();
+    filter.Draw("Filter", -1.0f);
+    ImGui::Separator();
+
+    ImGui::BeginChild("##log_entries", ImVec2(0,0), true, ImGuiWindowFlags_HorizontalScrollbar);
+
+    // find the entries which pass the filters, only the visible ones are copied out again for rendering
+    static std::vector<uint64_t> indices;
+    indices.clear();
+    LogEntry entry;
+    const uint64_t index_begin = log_sink->GetOldestIndex();
+    const uint64_t index_end = log_sink->GetTotalWritten();
+    for (uint64_t i = index_begin; i < index_end; i++) {
+        if (filter.IsActive()) {
+            if (!log_sink->ReadEntry(i, entry)) continue;
+            if (int(entry.level) < show_level) continue;
+            if (!filter.PassFilter(entry.text.data(), entry.text.data() + entry.length)) continue;
+        } else {
+            spdlog::level::level_enum level;
+            if (!log_sink->ReadLevel(i, level)) continue;
+            if (int(level) < show_level) continue;
+        }
+        indices.push_back(i);
+    }
+
+    ImGuiListClipper clipper;
+    clipper.Begin(int(indices.size()));
+    while (clipper.Step()) {
+        for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; row++) {
+            if (!log_sink->ReadEntry(indices[row], entry)) {
+                ImGui::TextUnformatted("...");
+                continue;
+            }
+            ImVec4 color = ImGui::GetStyleColorVec4(ImGuiCol_Text);
+            switch (entry.level) {
+            case spdlog::level::trace:
+            case spdlog::level::debug:
+                color = ImColor(128,128,128).Value;
+                break;
+            case spdlog::level::warn:
+                color = ImColor(200,140,0).Value;
+                break;
+            case spdlog::level::err:
+            case spdlog::level::critical:
+                color = ImColor(220,0,0).Value;
+                break;
+            default:
+                break;
+            }
+            ImGui::PushStyleColor(ImGuiCol_Text, color);
+            ImGui::TextUnformatted(entry.text.data(), entry.text.data() + entry.length);
+            ImGui::PopStyleColor();
+        }
+    }
+
+    if (is_autoscroll && (ImGui::GetScrollY() >= ImGui::GetScrollMaxY())) {
+        ImGui::SetScrollHereY(1.0f);
     }
     ImGui::EndChild();
 }
 
 void RenderManagedConfigList(App &main_app) {
+    PROFILE_SCOPE("RenderManagedConfigList");
     // filtered table
     static ImGuiTextFilter filter;
     filter.Draw();
 
+    // launch everything that is shown, the scheduler orders them by their dependencies
+    ImGui::SameLine();
+    if (ImGui::Button("Launch all")) {
+        std::vector<AppConfig> cfgs;
+        for (auto &managed_cfg: main_app.m_managed_configs.GetConfigs()) {
+            auto &cfg = managed_cfg->GetConfig();
+            if (managed_cfg->IsPendingDelete() || !filter.PassFilter(cfg.name.c_str())) {
+                continue;
+            }
+            cfgs.push_back(cfg);
+        }
+        main_app.launch_apps(cfgs);
+    }
+
     ImGui::Separator();
 
     ImGuiTableFlags table_flags = 
@@ -318,6 +1097,7 @@ void RenderManagedConfigList(App &main_app) {
 }
 
 void RenderManagedConfig(App &main_app, ManagedConfig &managed_cfg) {
+    PROFILE_SCOPE("RenderManagedConfig");
     auto &cfg = managed_cfg.GetConfig();
 
     ImGui::TableNextRow();
@@ -391,6 +1171,7 @@ struct PathEditCallbacks {
 };
 
 void RenderPathEdit(std::string &s_in, const char *id, PathEditCallbacks &&cbs, const bool expand_flag=true) {
+    PROFILE_SCOPE("RenderPathEdit");
     ImGui::PushID(id);
     ImGui::BeginGroup(); 
     ImGui::PushStyleVar(ImGuiStyleVar_ItemSpacing, ImVec2(0,0));
@@ -449,6 +1230,7 @@ std::optional<std::string> GetAbsolutePath(const std::string &f_in) {
 };
 
 void RenderAppConfigEditForm(ManagedConfig &managed_cfg) {
+    PROFILE_SCOPE("RenderAppConfigEditForm");
     auto &cfg = managed_cfg.GetConfig();
 
     ImGuiTableFlags flags = 
@@ -613,6 +1395,304 @@ void RenderAppConfigEditForm(ManagedConfig &managed_cfg) {
         ImGui::PopStyleVar();
         ImGui::PopItemWidth();
 
+        // pseudo terminal
+        ImGui::TableNextRow();
+        ImGui::TableSetColumnIndex(0);
+        ImGui::Text("Pseudo terminal");
+        if (ImGui::IsItemHovered()) {
+            ImGui::BeginTooltip();
+            ImGui::Text("Launch with a terminal so output is line buffered instead of arriving in bursts");
+            ImGui::EndTooltip();
+        }
+        ImGui::TableSetColumnIndex(1);
+        if (ImGui::Checkbox("##edit_use_pty", &cfg.use_pty)) {
+            managed_cfg.SetStatus(ManagedConfig::Status::CHANGED);
+        }
+
+        // capture mode
+        ImGui::TableNextRow();
+        ImGui::TableSetColumnIndex(0);
+        ImGui::Text("Capture mode");
+        if (ImGui::IsItemHovered()) {
+            ImGui::BeginTooltip();
+            ImGui::Text("Lossy overwrites old output when the process writes faster than it is viewed");
+            ImGui::Text("Lossless pauses the process until its output has been viewed, merged into the timeline or archived");
+            ImGui::EndTooltip();
+        }
+        ImGui::TableSetColumnIndex(1);
+        ImGui::PushItemWidth(-1.0f);
+        if (ImGui::BeginCombo("##edit_capture_mode", capture_mode_to_string(cfg.capture_mode))) {
+            for (auto mode: { CaptureMode::LOSSY, CaptureMode::LOSSLESS }) {
+                const bool is_selected = (mode == cfg.capture_mode);
+                if (ImGui::Selectable(capture_mode_to_string(mode), is_selected)) {
+                    cfg.capture_mode = mode;
+                    managed_cfg.SetStatus(ManagedConfig::Status::CHANGED);
+                }
+            }
+            ImGui::EndCombo();
+        }
+        ImGui::PopItemWidth();
+
+        // output encoding
+        ImGui::TableNextRow();
+        ImGui::TableSetColumnIndex(0);
+        ImGui::Text("Output encoding");
+        if (ImGui::IsItemHovered()) {
+            ImGui::BeginTooltip();
+            ImGui::Text("What the process writes, it is converted to utf-8 as it is captured");
+            ImGui::Text("Auto decides from the first output which isn't plain ascii");
+            ImGui::Text("Oem and ansi are the legacy console and windows codepages of the system");
+            ImGui::EndTooltip();
+        }
+        ImGui::TableSetColumnIndex(1);
+        ImGui::PushItemWidth(-1.0f);
+        if (ImGui::BeginCombo("##edit_output_encoding", output_encoding_to_string(cfg.output_encoding))) {
+            for (auto encoding: { OutputEncoding::AUTO, OutputEncoding::UTF8, OutputEncoding::UTF16LE, OutputEncoding::OEM, OutputEncoding::ANSI }) {
+                const bool is_selected = (encoding == cfg.output_encoding);
+                if (ImGui::Selectable(output_encoding_to_string(encoding), is_selected)) {
+                    cfg.output_encoding = encoding;
+                    managed_cfg.SetStatus(ManagedConfig::Status::CHANGED);
+                }
+            }
+            ImGui::EndCombo();
+        }
+        ImGui::PopItemWidth();
+
+        // output archive
+        ImGui::TableNextRow();
+        ImGui::TableSetColumnIndex(0);
+        ImGui::Text("Archive output");
+        if (ImGui::IsItemHovered()) {
+            ImGui::BeginTooltip();
+            ImGui::Text("Keep the full output history compressed in the logs folder of the environment");
+            ImGui::EndTooltip();
+        }
+        ImGui::TableSetColumnIndex(1);
+        if (ImGui::Checkbox("##edit_archive_output", &cfg.archive_output)) {
+            managed_cfg.SetStatus(ManagedConfig::Status::CHANGED);
+        }
+
+        // output shared memory
+        ImGui::TableNextRow();
+        ImGui::TableSetColumnIndex(0);
+        ImGui::Text("Share output");
+        if (ImGui::IsItemHovered()) {
+            ImGui::BeginTooltip();
+            ImGui::Text("Export the output buffer as read only shared memory which ring_tail can follow");
+            ImGui::EndTooltip();
+        }
+        ImGui::TableSetColumnIndex(1);
+        if (ImGui::Checkbox("##edit_share_output", &cfg.share_output)) {
+            managed_cfg.SetStatus(ManagedConfig::Status::CHANGED);
+        }
+
+        // colours
+        ImGui::TableNextRow();
+        ImGui::TableSetColumnIndex(0);
+        ImGui::Text("Strip escapes");
+        if (ImGui::IsItemHovered()) {
+            ImGui::BeginTooltip();
+            ImGui::Text("Parse colours out of the output and strip the escape sequences as it is captured");
+            ImGui::Text("Subscribers, shared rings and archives then only get the plain text");
+            ImGui::EndTooltip();
+        }
+        ImGui::TableSetColumnIndex(1);
+        if (ImGui::Checkbox("##edit_strip_escapes", &cfg.strip_escapes)) {
+            managed_cfg.SetStatus(ManagedConfig::Status::CHANGED);
+        }
+
+        // sandbox
+        ImGui::TableNextRow();
+        ImGui::TableSetColumnIndex(0);
+        ImGui::Text("Sandbox");
+        if (ImGui::IsItemHovered()) {
+            ImGui::BeginTooltip();
+            ImGui::Text("Mount the home and xdg directories of the environment over the real ones, linux only");
+            ImGui::Text("Bind hides the real directories, overlay shows them but writes land in the environment");
+            ImGui::EndTooltip();
+        }
+        ImGui::TableSetColumnIndex(1);
+        ImGui::PushItemWidth(-1.0f);
+        if (ImGui::BeginCombo("##edit_sandbox", sandbox_mode_to_string(cfg.sandbox))) {
+            for (auto mode: { SandboxMode::OFF, SandboxMode::BIND, SandboxMode::OVERLAY }) {
+                const bool is_selected = (mode == cfg.sandbox);
+                if (ImGui::Selectable(sandbox_mode_to_string(mode), is_selected)) {
+                    cfg.sandbox = mode;
+                    managed_cfg.SetStatus(ManagedConfig::Status::CHANGED);
+                }
+            }
+            ImGui::EndCombo();
+        }
+        ImGui::PopItemWidth();
+
+        // path redirection
+        ImGui::TableNextRow();
+        ImGui::TableSetColumnIndex(0);
+        ImGui::Text("Redirect paths");
+        if (ImGui::IsItemHovered()) {
+            ImGui::BeginTooltip();
+            ImGui::Text("Preload a library which rewrites hard coded paths in the real home into the environment, linux only");
+            ImGui::EndTooltip();
+        }
+        ImGui::TableSetColumnIndex(1);
+        if (ImGui::Checkbox("##edit_redirect_paths", &cfg.redirect_paths)) {
+            managed_cfg.SetStatus(ManagedConfig::Status::CHANGED);
+        }
+
+        // dependencies as a comma separated list of app names
+        ImGui::TableNextRow();
+        ImGui::TableSetColumnIndex(0);
+        ImGui::Text("Depends on");
+        if (ImGui::IsItemHovered()) {
+            ImGui::BeginTooltip();
+            ImGui::Text("Comma separated names of apps which have to exit successfully or print their ready pattern first");
+            ImGui::EndTooltip();
+        }
+        ImGui::TableSetColumnIndex(1);
+        ImGui::PushItemWidth(-1.0f);
+        auto depends_on = fmt::format("{}", fmt::join(cfg.depends_on, ", "));
+        if (ImGui::InputText("##edit_depends_on", &depends_on)) {
+            cfg.depends_on.clear();
+            size_t start = 0;
+            while (start <= depends_on.size()) {
+                size_t end = depends_on.find(',', start);
+                end = (end == std::string::npos) ? depends_on.size() : end;
+                auto name = depends_on.substr(start, end-start);
+                const size_t name_begin = name.find_first_not_of(' ');
+                const size_t name_end = name.find_last_not_of(' ');
+                if (name_begin != std::string::npos) {
+                    cfg.depends_on.push_back(name.substr(name_begin, name_end-name_begin+1));
+                }
+                start = end+1;
+            }
+            managed_cfg.SetStatus(ManagedConfig::Status::CHANGED);
+        }
+        ImGui::PopItemWidth();
+
+        // ready pattern
+        ImGui::TableNextRow();
+        ImGui::TableSetColumnIndex(0);
+        ImGui::Text("Ready pattern");
+        if (ImGui::IsItemHovered()) {
+            ImGui::BeginTooltip();
+            ImGui::Text("Apps depending on this one are launched once it prints this text");
+            ImGui::EndTooltip();
+        }
+        ImGui::TableSetColumnIndex(1);
+        ImGui::PushItemWidth(-1.0f);
+        if (ImGui::InputText("##edit_ready_pattern", &cfg.ready_pattern)) {
+            managed_cfg.SetStatus(ManagedConfig::Status::CHANGED);
+        }
+        ImGui::PopItemWidth();
+
+        // restart policy
+        ImGui::TableNextRow();
+        ImGui::TableSetColumnIndex(0);
+        ImGui::Text("Restart policy");
+        if (ImGui::IsItemHovered()) {
+            ImGui::BeginTooltip();
+            ImGui::Text("Restart the app with an increasing delay when it exits");
+            ImGui::Text("Restarting stops if it restarts too many times within the window");
+            ImGui::EndTooltip();
+        }
+        ImGui::TableSetColumnIndex(1);
+        ImGui::PushItemWidth(-1.0f);
+        if (ImGui::BeginCombo("##edit_restart_policy", restart_policy_to_string(cfg.restart_policy))) {
+            for (auto policy: { RestartPolicy::NEVER, RestartPolicy::ON_FAILURE, RestartPolicy::ALWAYS }) {
+                const bool is_selected = (policy == cfg.restart_policy);
+                if (ImGui::Selectable(restart_policy_to_string(policy), is_selected)) {
+                    cfg.restart_policy = policy;
+                    managed_cfg.SetStatus(ManagedConfig::Status::CHANGED);
+                }
+            }
+            ImGui::EndCombo();
+        }
+        ImGui::PopItemWidth();
+
+        if (cfg.restart_policy != RestartPolicy::NEVER) {
+            ImGui::TableNextRow();
+            ImGui::TableSetColumnIndex(0);
+            ImGui::Text("Max restarts");
+            ImGui::TableSetColumnIndex(1);
+            ImGui::PushItemWidth(-1.0f);
+            if (ImGui::InputInt("##edit_max_restarts", &cfg.max_restarts)) {
+                cfg.max_restarts = std::max(cfg.max_restarts, 0);
+                managed_cfg.SetStatus(ManagedConfig::Status::CHANGED);
+            }
+            ImGui::PopItemWidth();
+
+            ImGui::TableNextRow();
+            ImGui::TableSetColumnIndex(0);
+            ImGui::Text("Restart window (s)");
+            ImGui::TableSetColumnIndex(1);
+            ImGui::PushItemWidth(-1.0f);
+            if (ImGui::InputInt("##edit_restart_window_seconds", &cfg.restart_window_seconds)) {
+                cfg.restart_window_seconds = std::max(cfg.restart_window_seconds, 1);
+                managed_cfg.SetStatus(ManagedConfig::Status::CHANGED);
+            }
+            ImGui::PopItemWidth();
+        }
+
+        // output triggers
+        int remove_trigger = -1;
+        for (size_t i = 0; i < cfg.triggers.size(); i++) {
+            auto &trigger = cfg.triggers[i];
+            ImGui::PushID(int(i));
+            ImGui::TableNextRow();
+            ImGui::TableSetColumnIndex(0);
+            ImGui::Text("Trigger %zu", i+1);
+            if (ImGui::IsItemHovered()) {
+                ImGui::BeginTooltip();
+                ImGui::Text("Runs an action whenever the output contains the pattern");
+                ImGui::EndTooltip();
+            }
+            ImGui::TableSetColumnIndex(1);
+            const float button_width = ImGui::GetFrameHeight();
+            const float spacing = ImGui::GetStyle().ItemSpacing.x;
+            const float field_width = (ImGui::GetContentRegionAvail().x - button_width - spacing*3.0f) / 3.0f;
+            ImGui::PushItemWidth(field_width);
+            if (ImGui::InputTextWithHint("##edit_trigger_pattern", "Pattern", &trigger.pattern)) {
+                managed_cfg.SetStatus(ManagedConfig::Status::CHANGED);
+            }
+            ImGui::SameLine();
+            if (ImGui::BeginCombo("##edit_trigger_action", trigger_action_to_string(trigger.action))) {
+                for (auto action: { TriggerAction::HIGHLIGHT, TriggerAction::NOTIFY, TriggerAction::COUNT, TriggerAction::TERMINATE, TriggerAction::LAUNCH }) {
+                    const bool is_selected = (action == trigger.action);
+                    if (ImGui::Selectable(trigger_action_to_string(action), is_selected)) {
+                        trigger.action = action;
+                        managed_cfg.SetStatus(ManagedConfig::Status::CHANGED);
+                    }
+                }
+                ImGui::EndCombo();
+            }
+            ImGui::SameLine();
+            if (trigger.action == TriggerAction::LAUNCH) {
+                if (ImGui::InputTextWithHint("##edit_trigger_launch_app", "App to launch", &trigger.launch_app)) {
+                    managed_cfg.SetStatus(ManagedConfig::Status::CHANGED);
+                }
+            } else {
+                ImGui::Dummy(ImVec2(field_width, 0.0f));
+            }
+            ImGui::PopItemWidth();
+            ImGui::SameLine();
+            if (ImGui::Button(ICON_FA_TRASH "##remove_trigger", ImVec2(button_width, 0))) {
+                remove_trigger = int(i);
+            }
+            ImGui::PopID();
+        }
+        if (remove_trigger >= 0) {
+            cfg.triggers.erase(cfg.triggers.begin() + remove_trigger);
+            managed_cfg.SetStatus(ManagedConfig::Status::CHANGED);
+        }
+        ImGui::TableNextRow();
+        ImGui::TableSetColumnIndex(0);
+        ImGui::Text("Triggers");
+        ImGui::TableSetColumnIndex(1);
+        if (ImGui::Button(ICON_FA_PLUS " Add trigger##add_trigger")) {
+            cfg.triggers.push_back(TriggerRule{});
+            managed_cfg.SetStatus(ManagedConfig::Status::CHANGED);
+        }
+
         // configuration file
         ImGui::TableNextRow();
         ImGui::TableSetColumnIndex(0);
@@ -655,6 +1735,7 @@ void RenderAppConfigEditForm(ManagedConfig &managed_cfg) {
 }
 
 void RenderManagedConfigPopup(App &main_app, ManagedConfig &managed_cfg) {
+    PROFILE_SCOPE("RenderManagedConfigPopup");
     RenderAppConfigEditForm(managed_cfg);
 
     auto status = managed_cfg.GetStatus();
@@ -673,6 +1754,7 @@ void RenderManagedConfigPopup(App &main_app, ManagedConfig &managed_cfg) {
 }
 
 void RenderAppConfigCreatorPopup(App &main_app, const char *label) {
+    PROFILE_SCOPE("RenderAppConfigCreatorPopup");
     auto &creator_cfg = main_app.GetCreatorConfig();
 
     bool is_open = true;
@@ -688,6 +1770,7 @@ void RenderAppConfigCreatorPopup(App &main_app, const char *label) {
 }
 
 void RenderWarnings(App &main_app) {
+    PROFILE_SCOPE("RenderWarnings");
     auto &errors = main_app.m_runtime_warnings;
 
     ImGui::Text("Error List");
@@ -720,6 +1803,7 @@ void RenderWarnings(App &main_app) {
 }
 
 void RenderCriticalErrors(App &main_app) {
+    PROFILE_SCOPE("RenderCriticalErrors");
     static const char *modal_title = "Application error###app error modal";
 
     auto &errors = main_app.m_runtime_errors;
@@ -748,4 +1832,249 @@ void RenderCriticalErrors(App &main_app) {
     }
 }
 
+void RenderFrameProfiler(FrameProfiler &profiler) {
+    PROFILE_SCOPE("RenderFrameProfiler");
+
+    ImGui::SetNextWindowSize(ImVec2(480, 520), ImGuiCond_FirstUseEver);
+    bool is_open = true;
+    if (!ImGui::Begin("Frame profiler", &is_open)) {
+        ImGui::End();
+        if (!is_open) {
+            profiler.SetIsEnabled(false);
+        }
+        return;
+    }
+
+    const size_t total_frames = profiler.GetTotalFrames();
+    const size_t total_sections = profiler.GetTotalSections();
+
+    // histogram of the total frame time
+    struct PlotContext {
+        FrameProfiler *profiler;
+        int section;    // negative for the frame total
+    };
+    auto get_plot_value = [](void *data, int index) -> float {
+        auto *ctx = reinterpret_cast<PlotContext*>(data);
+        auto &frame = ctx->profiler->GetFrame(size_t(index));
+        return (ctx->section < 0) ? frame.total_ms : frame.section_ms[ctx->section];
+    };
+
+    {
+        PlotContext ctx { &profiler, -1 };
+        auto label = fmt::format("Frame ({} frames)", total_frames);
+        ImGui::PlotHistogram("##frame_total", get_plot_value, &ctx, int(total_frames), 0, label.c_str(), 0.0f, FLT_MAX, ImVec2(-1, 60));
+    }
+
+    ImGuiTableFlags table_flags = 
+        ImGuiTableFlags_Borders | ImGuiTableFlags_Resizable |
+        ImGuiTableFlags_RowBg;
+
+    // per section statistics over the ring of recent frames
+    if (ImGui::BeginTable("##profiler_sections", 5, table_flags)) {
+        ImGui::TableSetupColumn("Section", ImGuiTableColumnFlags_WidthStretch);
+        ImGui::TableSetupColumn("Last (ms)", ImGuiTableColumnFlags_WidthFixed);
+        ImGui::TableSetupColumn("Avg (ms)", ImGuiTableColumnFlags_WidthFixed);
+        ImGui::TableSetupColumn("Max (ms)", ImGuiTableColumnFlags_WidthFixed);
+        ImGui::TableSetupColumn("History", ImGuiTableColumnFlags_WidthStretch);
+        ImGui::TableHeadersRow();
+
+        for (size_t i = 0; i < total_sections; i++) {
+            float last = 0.0f;
+            float sum = 0.0f;
+            float max_ms = 0.0f;
+            for (size_t j = 0; j < total_frames; j++) {
+                const float v = profiler.GetFrame(j).section_ms[i];
+                sum += v;
+                max_ms = std::max(max_ms, v);
+                last = v;
+            }
+            const float avg = (total_frames > 0) ? (sum / float(total_frames)) : 0.0f;
+
+            ImGui::PushID(int(i));
+            ImGui::TableNextRow();
+            ImGui::TableSetColumnIndex(0);
+            ImGui::TextUnformatted(profiler.GetSectionName(i));
+            ImGui::TableSetColumnIndex(1);
+            ImGui::Text("%.3f", last);
+            ImGui::TableSetColumnIndex(2);
+            ImGui::Text("%.3f", avg);
+            ImGui::TableSetColumnIndex(3);
+            ImGui::Text("%.3f", max_ms);
+            ImGui::TableSetColumnIndex(4);
+            PlotContext ctx { &profiler, int(i) };
+            ImGui::PlotHistogram("##section_history", get_plot_value, &ctx, int(total_frames), 0, NULL, 0.0f, FLT_MAX, ImVec2(-1, 20));
+            ImGui::PopID();
+        }
+        ImGui::EndTable();
+    }
+
+    // breakdown of the slowest frames
+    ImGui::Separator();
+    if (ImGui::Button("Reset")) {
+        profiler.Reset();
+    }
+    ImGui::SameLine();
+    ImGui::Text("Worst frames");
+    for (size_t i = 0; i < profiler.GetTotalWorstFrames(); i++) {
+        auto &frame = profiler.GetWorstFrame(i);
+        auto label = fmt::format("#{} {:.3f} ms###worst_frame_{}", frame.frame_number, frame.total_ms, i);
+        if (ImGui::TreeNode(label.c_str())) {
+            for (size_t j = 0; j < total_sections; j++) {
+                if (frame.section_ms[j] > 0.0f) {
+                    ImGui::Text("%s: %.3f ms", profiler.GetSectionName(j), frame.section_ms[j]);
+                }
+            }
+            ImGui::TreePop();
+        }
+    }
+
+    ImGui::End();
+    if (!is_open) {
+        profiler.SetIsEnabled(false);
+    }
+}
+
+void RenderRemoteProcessState(const uint8_t state) {
+    switch (state) {
+        case AppProcess::State::RUNNING:
+            ImGui::PushStyleColor(ImGuiCol_Text, ImColor(0,255,0).Value);
+            break;
+        case AppProcess::State::TERMINATING:
+            ImGui::PushStyleColor(ImGuiCol_Text, ImColor(255,215,0).Value);
+            break;
+        case AppProcess::State::TERMINATED:
+            ImGui::PushStyleColor(ImGuiCol_Text, ImColor(255,0,0).Value);
+            break;
+        default:
+            ImGui::PushStyleColor(ImGuiCol_Text, ImColor(60,60,255).Value);
+            break;
+    }
+    ImGui::Text(ICON_FA_CIRCLE);
+    ImGui::PopStyleColor();
+}
+
+void RenderDaemonClient(DaemonClient &client, const char *label) {
+    PROFILE_SCOPE("RenderDaemonClient");
+
+    ImGuiViewport* viewport = ImGui::GetMainViewport();
+    ImGui::SetNextWindowPos(viewport->Pos);
+    ImGui::SetNextWindowSize(viewport->Size);
+    ImGui::SetNextWindowViewport(viewport->ID);
+
+    ImGui::PushID(label);
+    ImGuiWindowFlags win_flags = 
+        ImGuiWindowFlags_NoTitleBar | ImGuiWindowFlags_NoResize | 
+        ImGuiWindowFlags_NoMove | ImGuiWindowFlags_NoCollapse;
+    ImGui::Begin("##Daemon", NULL, win_flags);
+
+    // failed requests are only logged, the daemon keeps its own warnings
+    for (auto &error: client.TakeErrors()) {
+        spdlog::warn(fmt::format("Daemon request failed: {}", error));
+    }
+    if (!client.IsConnected()) {
+        ImGui::PushStyleColor(ImGuiCol_Text, ImColor(255,0,0).Value);
+        ImGui::Text("Disconnected from the daemon");
+        ImGui::PopStyleColor();
+    }
+
+    const auto app_names = client.GetAppNames();
+    const auto processes = client.GetProcesses();
+    static uint64_t selected_id = 0;
+
+    float alpha = 0.3f;
+    auto left_panel_size = ImVec2(ImGui::GetContentRegionAvail().x*alpha, 0);
+    ImGui::BeginChild("##daemon_list_panel", left_panel_size, true);
+
+    ImGui::Text("Applications");
+    for (auto &name: app_names) {
+        ImGui::PushID(name.c_str());
+        if (ImGui::Button(ICON_FA_PLAY)) {
+            client.Launch(name);
+        }
+        ImGui::SameLine();
+        ImGui::TextUnformatted(name.c_str());
+        ImGui::PopID();
+    }
+
+    ImGui::Separator();
+    ImGui::Text("Processes (%d)", int(processes.size()));
+    if (ImGui::BeginListBox("##daemon_process_list", ImVec2(-1, -1))) {
+        for (auto &proc: processes) {
+            ImGui::PushID(int(proc.id));
+            RenderRemoteProcessState(proc.state);
+            ImGui::SameLine();
+            if (ImGui::Selectable(proc.name.c_str(), proc.id == selected_id, ImGuiSelectableFlags_SpanAllColumns)) {
+                // only the selected process is streamed to us
+                if (selected_id != proc.id) {
+                    client.Unsubscribe(selected_id);
+                    client.Subscribe(proc.id);
+                    selected_id = proc.id;
+                }
+            }
+            if (proc.state == AppProcess::State::RUNNING) {
+                if (ImGui::BeginPopupContextItem()) {
+                    if (ImGui::MenuItem("Terminate")) {
+                        client.Terminate(proc.id);
+                    }
+                    ImGui::EndPopup();
+                }
+            } else if (ImGui::IsItemHovered()) {
+                ImGui::SetTooltip("Exit code: %lld", (long long)(proc.exit_code));
+            }
+            ImGui::PopID();
+        }
+        ImGui::EndListBox();
+    }
+    ImGui::EndChild();
+
+    ImGui::SameLine();
+
+    ImGui::BeginChild("##daemon_output_panel", ImVec2(0,0), true);
+    auto it = std::find_if(processes.begin(), processes.end(), [](const RemoteProcess &proc) { return proc.id == selected_id; });
+    if ((it == processes.end()) || (it->buffer == nullptr)) {
+        ImGui::Text("Select a process to view buffer");
+    } else {
+        if (it->total_skipped > 0) {
+            ImGui::TextDisabled("%.1f KiB of output was overwritten before it reached us", double(it->total_skipped) / 1024.0);
+        }
+        // long lines are soft wrapped to the pane instead of scrolling sideways
+        static bool is_wrap_lines = true;
+        ImGui::Checkbox("Wrap lines", &is_wrap_lines);
+        ImGui::BeginChild("##daemon_process_output", ImVec2(0,0), false, is_wrap_lines ? 0 : ImGuiWindowFlags_AlwaysHorizontalScrollbar);
+        auto &scroll_buffer = *it->buffer;
+        auto buffer_lock = scroll_buffer.LockRead();
+        const uint64_t total_written = scroll_buffer.GetTotalWritten();
+        const size_t buffer_length = size_t(std::min(total_written, uint64_t(scroll_buffer.GetMaxSize())));
+        const char *buffer_begin = scroll_buffer.GetBufferAtOffset(total_written - uint64_t(buffer_length));
+
+        // the local copy is laid out the same way as the output of our own processes
+        static OutputLayout layout;
+        static uint64_t layout_process_id = 0;
+        if (layout_process_id != selected_id) {
+            layout_process_id = selected_id;
+            layout.Reset();
+        }
+        // triggers and timestamps stay with the daemon
+        static const std::vector<uint64_t> highlights;
+        RenderOutputLines(scroll_buffer, total_written, layout, *it->styles, highlights, is_wrap_lines, 0.0f, nullptr);
+
+        if (ImGui::BeginPopupContextWindow("##daemon_text_context_menu")) {
+            if (ImGui::MenuItem("Copy")) {
+                platform::copy_to_clipboard(buffer_begin, buffer_length);
+            }
+            ImGui::EndPopup();
+        }
+        ImGui::EndChild();
+    }
+    ImGui::EndChild();
+
+    ImGui::End();
+
+    auto &profiler = FrameProfiler::Get();
+    if (profiler.IsEnabled()) {
+        RenderFrameProfiler(profiler);
+    }
+    ImGui::PopID();
+}
+
 }
@@ -2,8 +2,14 @@
 
 #include "app.h"
 
+namespace app {
+class DaemonClient;
+}
+
 namespace app::gui {
 
 void RenderApp(App &main_app, const char *label);
+// thin client mode, the processes are owned by a daemon
+void RenderDaemonClient(DaemonClient &client, const char *label);
 
 }
\ No newline at end of file
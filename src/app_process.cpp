@@ -1,88 +1,158 @@
+#include <string.h>
+#include <time.h>
 #include <string>
+#include <vector>
+#include <mutex>
+#include <chrono>
+#include <thread>
 #include <filesystem>
+#include <unordered_map>
 
 #include <spdlog/spdlog.h>
 #include <fmt/core.h>
+#include <fmt/chrono.h>
 
 #include "app_process.h"
+#include "buffer_manager.h"
 #include "environ.h"
 #include "file_loading.h"
-#include "utils.h"
-
-#define WIN32_LEAN_AND_MEAN
-#include <windows.h>
-#include <processenv.h>
-
-#pragma comment(lib, "user32.lib")
+#include "tracing.h"
+#ifdef __linux__
+#include "mount_sandbox.h"
+#endif
 
 namespace app {
 
 namespace fs = std::filesystem;
 
-template <typename T>
-void warn_and_throw(T x) {
-    spdlog::warn(x);
-    throw std::runtime_error(x);
+// replace characters which aren't allowed in windows filenames
+static std::string sanitise_filename(const std::string &name) {
+    std::string filename = name;
+    for (auto &c: filename) {
+        if ((static_cast<unsigned char>(c) < 32) || (strchr("<>:\"/\\|?*", c) != nullptr)) {
+            c = '_';
+        }
+    }
+    return filename.empty() ? "process" : filename;
 }
 
+static std::string get_timestamp_string() {
+    return fmt::format("{:%Y%m%d_%H%M%S}", fmt::localtime(std::time(nullptr)));
+}
 
-// helper function for initialising an environment for a process
-// inherits from parent environment with changes determined by
-// 1. EnvConfig: environment configuration file (reuseable - i.e. default_env.json)
-// 2. EnvParams: determinied by app config      (specialized - apps.json)
-struct EnvParams {
-    std::string root;
-    std::string username;
-};
-
-environment_t create_env_from_cfg(environment_t &orig, EnvConfig &cfg, EnvParams &params) {
-    environment_t env;
-
-    auto fill_params = [&params](const std::string &v) {
-        return fmt::format(fmt::runtime(v), 
-            fmt::arg("root", params.root),
-            fmt::arg("username", params.username));
+// most apps share a few environment configs, so they are only read and validated again once the file changes
+static EnvConfig load_env_config_cached(const std::string &env_filepath) {
+    struct CachedEnvConfig {
+        fs::file_time_type modified_time;
+        EnvConfig config;
     };
-
-    auto create_directory = [](const std::string &s_in) {
-        try {
-            fs::create_directories(fs::path(s_in));
-        } catch (std::exception &ex) {
-            spdlog::warn(fmt::format("Failed to create directory ({}): ({})", s_in, ex.what()));
+    static std::mutex cache_mutex;
+    static std::unordered_map<std::string, CachedEnvConfig> cache;
+
+    std::error_code ec;
+    const auto modified_time = fs::last_write_time(env_filepath, ec);
+    if (!ec) {
+        auto lock = std::scoped_lock(cache_mutex);
+        auto it = cache.find(env_filepath);
+        if ((it != cache.end()) && (it->second.modified_time == modified_time)) {
+            return it->second.config;
         }
-    };
+    }
 
-    // directories
-    for (auto &[k,v]: cfg.env_directories) {
-        auto dir = fill_params(v);
-        // pass absolute directory to environment
-        env.insert({k, fs::absolute(dir).string() });
-        create_directory(dir);
+    auto read_env_span = TraceSpan("read_env_config");
+    auto env_doc_res = load_document_from_filename(env_filepath.c_str());
+    read_env_span.End();
+    if (!env_doc_res) {
+        throw std::runtime_error(fmt::format("Failed to retrieve default environment file ({})", env_filepath));
     }
 
-    for (auto &v: cfg.seed_directories) {
-        auto dir = fill_params(v);
-        create_directory(dir);
+    auto env_doc = std::move(env_doc_res.value());
+    auto validate_env_span = TraceSpan("validate_env_schema");
+    if (!validate_document(env_doc, ENV_SCHEMA)) {
+        throw std::runtime_error(std::string("Failed to validate default environment schema"));
+    }
+    validate_env_span.End();
+
+    auto env_cfg = load_env_config(env_doc);
+    if (!ec) {
+        auto lock = std::scoped_lock(cache_mutex);
+        cache[env_filepath] = { modified_time, env_cfg };
     }
+    return env_cfg;
+}
+
+// building an environment creates its directories and rewrites its path redirect table
+// it only changes with the environment config, the app's parameters or our own environment, so launches reuse it
+// the directories and the redirect table it created are checked for since they could have been deleted in the meantime
+struct BuiltEnv {
+    environment_t env;
+    tstring env_str;
+    std::vector<std::string> created_paths;
+};
 
-    // variables
-    for (auto &[k,v]: cfg.override_variables) {
-        env.insert({k, fill_params(v)});
+static bool is_built_env_intact(const BuiltEnv &built) {
+    std::error_code ec;
+    for (auto &path: built.created_paths) {
+        if (!fs::exists(path, ec)) {
+            return false;
+        }
     }
+    return true;
+}
 
-    for (auto &k: cfg.pass_through_variables) {
-        if (!orig.contains(k)) {
-            continue;
+static std::shared_ptr<const BuiltEnv> build_env_cached(const std::string &env_filepath, environment_t &orig, EnvParams &params) {
+    struct CachedEnv {
+        fs::file_time_type modified_time;
+        environment_t orig;
+        std::shared_ptr<const BuiltEnv> built;
+    };
+    static std::mutex cache_mutex;
+    static std::unordered_map<std::string, CachedEnv> cache;
+
+    const auto key = fmt::format("{}\n{}\n{}\n{}", env_filepath, params.root, params.username, params.redirect_paths);
+    std::error_code ec;
+    const auto modified_time = fs::last_write_time(env_filepath, ec);
+    if (!ec) {
+        std::shared_ptr<const BuiltEnv> cached;
+        {
+            auto lock = std::scoped_lock(cache_mutex);
+            auto it = cache.find(key);
+            if ((it != cache.end()) && (it->second.modified_time == modified_time) && (it->second.orig == orig)) {
+                cached = it->second.built;
+            }
+        }
+        // checked without the lock so other launches don't wait on the filesystem
+        if ((cached != nullptr) && is_built_env_intact(*cached)) {
+            return cached;
         }
-        auto &v = orig.at(k);
-        env.insert({k, fill_params(v)});
     }
 
-    return env;
+    auto env_cfg = load_env_config_cached(env_filepath);
+    auto built = std::make_shared<BuiltEnv>();
+    built->env = create_env_from_cfg(orig, env_cfg, params, &built->created_paths);
+    auto create_env_string_span = TraceSpan("create_env_string");
+    built->env_str = create_env_string(built->env);
+    create_env_string_span.End();
+    if (!ec) {
+        auto lock = std::scoped_lock(cache_mutex);
+        cache[key] = { modified_time, orig, built };
+    }
+    return built;
 }
 
-AppProcess::AppProcess(AppConfig &app_cfg, environment_t &orig) {
+AppProcess::AppProcess(
+    AppConfig &app_cfg, environment_t &orig, 
+    const TerminalSize terminal_size, process_update_callback_t on_update,
+    process_exit_callback_t on_exit) 
+{
+    static std::atomic<uint64_t> total_processes = 0;
+    m_id = ++total_processes;
     m_state = State::TERMINATED;
+    m_is_terminated_by_user = false;
+    m_is_closing = false;
+    m_launch_id = TraceLaunchScope::GetCurrentLaunchId();
+    m_is_ready = false;
+    m_exit_code = -1;
 
     // create params to generate our environment data structure
     EnvParams params;
@@ -91,86 +161,82 @@ AppProcess::AppProcess(AppConfig &app_cfg, environment_t &orig) {
         fs::path root = fs::path(app_cfg.env_parent_dir) / app_cfg.env_name;
         params.root = root.string();
         params.username = app_cfg.username;
+        params.redirect_paths = app_cfg.redirect_paths;
     }
 
-    // load the environment config
-    const auto env_filepath = app_cfg.env_config_path;
-    auto env_doc_res = load_document_from_filename(env_filepath.c_str());
-    if (!env_doc_res) {
-        throw std::runtime_error(fmt::format("Failed to retrieve default environment file ({})", env_filepath));
-    }
-
-    auto env_doc = std::move(env_doc_res.value());
-    if (!validate_document(env_doc, ENV_SCHEMA)) {
-        throw std::runtime_error(std::string("Failed to validate default environment schema"));
-    }
-
-    auto env_cfg = load_env_config(env_doc);
-    environment_t env = create_env_from_cfg(orig, env_cfg, params);
-    auto env_str = create_env_string(env);
+    auto built_env = build_env_cached(app_cfg.env_config_path, orig, params);
 
     // initialise descriptors for process
     m_label = app_cfg.name;
-
-    // Set the bInheritHandle flag so pipe handles are inherited. 
-    SECURITY_ATTRIBUTES security_attr = {sizeof(security_attr)};
-    security_attr.bInheritHandle = TRUE; 
-
-    // setup win32 process parameters
-    PROCESS_INFORMATION process_info = {0};
-
-    STARTUPINFOA startup_info = {sizeof(STARTUPINFOA)};
-    startup_info.dwFlags = STARTF_USESTDHANDLES;
-
-    // TODO: free pipes if we fail somewhere along this?
-    if (!CreatePipe(&startup_info.hStdInput, &m_handle_write_std_in, &security_attr, 0)) {
-        warn_and_throw("Failed to create child pipe on stdin");
-    }
-        
-    if (!CreatePipe(&m_handle_read_std_out, &startup_info.hStdOutput, &security_attr, 0)) {
-        warn_and_throw("Failed to create child pipe on stdout");
-    }
-
-    if (!CreatePipe(&m_handle_read_std_err, &startup_info.hStdError, &security_attr, 0)) {
-        warn_and_throw("Failed to create child pipe on stderr");
+    m_config = app_cfg;
+    m_terminal_size = terminal_size;
+    m_capture_mode = app_cfg.capture_mode;
+    m_buffer.SetIsLossless(m_capture_mode == CaptureMode::LOSSLESS);
+    m_transcoder = std::make_unique<OutputTranscoder>(app_cfg.output_encoding);
+    m_on_update = std::move(on_update);
+    m_on_exit = std::move(on_exit);
+    m_triggers = std::make_unique<OutputTriggers>(m_label, app_cfg.triggers, app_cfg.ready_pattern);
+
+    // archives go in the logs folder of the environment root
+    // capture still works without one so a failure here doesn't stop the launch
+    if (app_cfg.archive_output) {
+        try {
+            auto logs_dir = fs::path(params.root) / "logs";
+            fs::create_directories(logs_dir);
+            auto filename = fmt::format("{}_{}.log.lz4", sanitise_filename(m_label), get_timestamp_string());
+            m_archive = std::make_shared<OutputArchive>((logs_dir / filename).string());
+        } catch (std::exception &ex) {
+            spdlog::warn(fmt::format("Failed to create output archive for ({}): {}", m_label, ex.what()));
+        }
     }
 
-    if (!SetHandleInformation(m_handle_read_std_err, HANDLE_FLAG_INHERIT, 0)) {
-        warn_and_throw("Failed to set handle information on std_err_rd");
+    // other processes can tail the ring without going through us, the name has our pid so instances don't collide
+    if (app_cfg.share_output) {
+        const auto export_name = fmt::format("appvirtualenv.{}.{}", platform::get_current_process_id(), m_id);
+        if (m_buffer.Export(export_name)) {
+            spdlog::info(fmt::format("Sharing output of ({}) as ({})", m_label, export_name));
+        } else {
+            spdlog::warn(fmt::format("Failed to share output of ({}) as ({})", m_label, export_name));
+        }
     }
 
-    if (!SetHandleInformation(m_handle_read_std_out, HANDLE_FLAG_INHERIT, 0)) {
-        warn_and_throw("Failed to set handle information on std_out_rd");
+    platform::SpawnParams spawn_params;
+    spawn_params.exec_path = app_cfg.exec_path;
+    spawn_params.args = app_cfg.args;
+    spawn_params.cwd = app_cfg.exec_cwd;
+    spawn_params.env_block = built_env->env_str;
+    spawn_params.use_pty = app_cfg.use_pty;
+    spawn_params.terminal_size = m_terminal_size;
+
+    // the child enters the sandbox before it starts so hard coded paths like ~/.config also end up in the environment
+    if (app_cfg.sandbox != SandboxMode::OFF) {
+#ifdef __linux__
+        auto sandbox = std::make_shared<MountSandbox>(
+            get_sandbox_mounts(built_env->env, orig), app_cfg.sandbox,
+            (fs::absolute(params.root) / ".sandbox_work").string());
+        spawn_params.pre_exec = [sandbox](const char *&failed_step) {
+            const int error = sandbox->Enter();
+            if (error != 0) {
+                failed_step = sandbox->GetFailedStep();
+            }
+            return error;
+        };
+#else
+        spdlog::warn(fmt::format("Sandbox isn't supported on this platform, launching ({}) without it", app_cfg.name));
+#endif
     }
 
-
-    BOOL is_inherit_handles = TRUE;
-    DWORD dw_flags = CREATE_SUSPENDED | CREATE_NO_WINDOW;
-
-    auto args_str = fmt::format("\"{}\" {}", app_cfg.exec_path, app_cfg.args);
-
     // create the process
-    bool rv = CreateProcessA(
-        app_cfg.exec_path.c_str(),
-        args_str.data(),
-        NULL, NULL,
-        is_inherit_handles, dw_flags,
-        env_str.data(),
-        app_cfg.exec_cwd.c_str(),
-        &startup_info, &process_info);
-    
-    if (!rv) {
-        throw std::runtime_error(fmt::format("Failed to start application ({})", app_cfg.exec_path));
-    }
-    
+    auto create_process_span = TraceSpan("create_process");
+    m_child = std::make_unique<platform::ChildProcess>(spawn_params);
+    create_process_span.End();
+
     m_state = State::RUNNING;
-    m_handle_process = process_info.hProcess;
+    m_is_pseudo_terminal = m_child->IsPseudoTerminal();
+    m_start_timestamp = Tracer::GetTimestamp();
 
-    ResumeThread(process_info.hThread);
-    CloseHandle(process_info.hThread);
-    CloseHandle(startup_info.hStdInput);
-    CloseHandle(startup_info.hStdOutput);
-    CloseHandle(startup_info.hStdError);
+    // the ring is grown or shrunk to fit our output rate from here on
+    BufferManager::Get().Register(&m_buffer);
 
     // startup the listener thread    
     m_thread = std::make_unique<std::thread>([this]() {
@@ -178,53 +244,176 @@ AppProcess::AppProcess(AppConfig &app_cfg, environment_t &orig) {
     });
 }
 
+// how long to wait for the exit code once the pipes have closed
+static constexpr uint32_t EXIT_CODE_TIMEOUT_MS = 1000;
+
 // separate thread which loops every N milliseconds and reads from the handle into the scrolling buffer
 void AppProcess::ListenerThread() {
-    BOOL bSuccess = FALSE;
-
-    auto get_pipe_count = [](HANDLE pipe) -> DWORD {
-        DWORD result;
-        PeekNamedPipe(pipe, 0, 0, 0, &result, 0);
-        return result;
-    };
+    auto &tracer = Tracer::Get();
+    tracer.SetThreadName(fmt::format("listener ({})", m_label));
+    auto trace_launch_scope = TraceLaunchScope(m_launch_id);
+    bool is_first_output = true;
+    using Stream = platform::ChildProcess::Stream;
+    auto &child = *m_child;
 
     // return true if the pipe is broken
-    auto read_from_pipe = [this](HANDLE pipe) -> bool {
-        DWORD dwRead = 0;
-        const BOOL is_success = ReadFile(
-            pipe, 
-            LPVOID(m_buffer.GetWriteBuffer()), 
-            DWORD(m_buffer.GetMaxSize()), 
-            &dwRead, 
-            nullptr
-        );
-
-        if((!is_success) || (dwRead == 0)) {
-            return true;
+    auto read_from_pipe = [this, &child, &tracer, &is_first_output](const Stream pipe, const size_t read_size) -> bool {
+        TRACE_SCOPE("read_pipe");
+        size_t total_read = 0;
+        size_t total_written = 0;
+        const uint64_t write_offset = m_buffer.GetTotalWritten();
+        char *write_buffer = nullptr;
+        if (m_transcoder->IsPassthrough()) {
+            // leaves room for the start of a sequence from the last read and for replacing invalid sequences
+            write_buffer = m_buffer.GetWriteBuffer(OutputTranscoder::GetMaxOutputSize(read_size));
+            const size_t total_carry = m_transcoder->WriteCarry(write_buffer);
+            if (!child.Read(pipe, write_buffer + total_carry, read_size, total_read)) {
+                return true;
+            }
+            TRACE_SCOPE("validate_utf8");
+            total_written = m_transcoder->RepairUtf8(write_buffer, total_carry + total_read);
+        } else {
+            if (m_transcode_buffer.size() < read_size) {
+                m_transcode_buffer.resize(read_size);
+            }
+            if (!child.Read(pipe, m_transcode_buffer.data(), read_size, total_read)) {
+                return true;
+            }
+            TRACE_SCOPE("transcode");
+            write_buffer = m_buffer.GetWriteBuffer(OutputTranscoder::GetMaxOutputSize(total_read));
+            total_written = m_transcoder->Convert(m_transcode_buffer.data(), total_read, write_buffer);
+        }
+        // apps which strip escapes have the sequences parsed out so everything after this only sees the text
+        // otherwise the output is kept as the bytes the app wrote, without any colours
+        if (m_config.strip_escapes) {
+            const uint64_t begin_offset = write_offset - std::min(write_offset, uint64_t(m_buffer.GetMaxSize()));
+            total_written = m_styles.Parse(write_buffer, total_written, write_offset, begin_offset);
         }
 
         // update the circular buffer to point in the right location
-        m_buffer.IncrementIndex(size_t(dwRead));
+        m_buffer.IncrementIndex(total_written);
+        // the mirrored pages keep the read contiguous even if it wrapped around
+        if (m_archive != nullptr) {
+            m_archive->Append(write_buffer, total_written);
+        }
+        // the automaton carries partial matches over to the next read
+        const auto events = m_triggers->Scan(write_buffer, total_written, write_offset);
+        if (events.is_ready) {
+            m_is_ready = true;
+        }
+        // unlike a terminate from the user this still goes through the restart policy
+        if (events.is_terminate && (m_state == State::RUNNING)) {
+            spdlog::info(fmt::format("Terminating ({}) on a trigger", m_label));
+            m_state = State::TERMINATING;
+            if (child.Terminate()) {
+                m_state = State::TERMINATED;
+            }
+        }
+
+        if (is_first_output) {
+            tracer.AddEvent("wait_first_output", m_start_timestamp, Tracer::GetTimestamp());
+            is_first_output = false;
+        }
+        return false;
+    };
+
+    // return true if the pipe is broken
+    auto drain_pipe = [this, &child, &read_from_pipe](const Stream pipe) -> bool {
+        size_t total_pending = 0;
+        while (!m_is_closing) {
+            // we are the only writer so resizes requested by the buffer manager are applied here
+            m_buffer.ApplyResize();
+            if (!child.GetPendingSize(pipe, total_pending)) {
+                return true;
+            }
+            if (total_pending == 0) {
+                return false;
+            }
+
+            size_t read_size = m_buffer.GetMaxSize();
+            // leave the data in the pipe until consumers catch up, which blocks the child once the pipe is full
+            if (m_capture_mode == CaptureMode::LOSSLESS) {
+                read_size = m_buffer.GetFreeSize();
+                if (read_size == 0) {
+                    return false;
+                }
+            }
+            // converted output can be longer than what was read, so only read as much as is sure to fit
+            // utf-8 too, since invalid sequences are replaced
+            read_size = OutputTranscoder::GetMaxInputSize(read_size);
+            if (read_size == 0) {
+                return false;
+            }
+            // readers of a shared ring treat everything we might overwrite as invalid, so only claim what is there
+            read_size = std::min(read_size, total_pending);
+
+            if (read_from_pipe(pipe, read_size)) {
+                return true;
+            }
+        }
         return false;
     };
 
     bool is_pipe_broken = false;
-    DWORD total_pending;
 
-    while (m_state == State::RUNNING) 
-    { 
-        while ((total_pending = get_pipe_count(m_handle_read_std_out)) && !is_pipe_broken) {
-            is_pipe_broken = is_pipe_broken || read_from_pipe(m_handle_read_std_out); 
+    auto notify_update = [this]() {
+        if (m_on_update) {
+            m_on_update();
         }
-        while ((total_pending = get_pipe_count(m_handle_read_std_err)) && !is_pipe_broken) {
-            is_pipe_broken = is_pipe_broken || read_from_pipe(m_handle_read_std_err); 
+    };
+
+    while ((m_state == State::RUNNING) && !m_is_closing) 
+    { 
+        const uint64_t prev_total_written = m_buffer.GetTotalWritten();
+        is_pipe_broken = is_pipe_broken || drain_pipe(Stream::STDOUT);
+        is_pipe_broken = is_pipe_broken || drain_pipe(Stream::STDERR);
+        if (m_buffer.GetTotalWritten() != prev_total_written) {
+            notify_update();
         }
-        Sleep(16);
         if (is_pipe_broken) {
             break;
         }
+        // the pseudo console keeps its end of the pipe open after the child exits
+        // so we detect the exit ourselves and drain what is left before closing it
+        if (m_is_pseudo_terminal && child.HasExited()) {
+            drain_pipe(Stream::STDOUT);
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(16));
     } 
+
+    if (m_archive != nullptr) {
+        m_archive->Flush();
+    }
+    // whoever owns us is going away so don't wait on the child or call back into them
+    if (m_is_closing) {
+        m_buffer.CloseWriter();
+        return;
+    }
+    child.ClosePseudoTerminal();
+
+    // the pipes can close slightly before the process has fully exited
+    int64_t exit_code = 0;
+    if (child.WaitForExit(EXIT_CODE_TIMEOUT_MS, exit_code)) {
+        m_exit_code = exit_code;
+    }
+    // the buffer manager shrinks the ring from now on
+    m_buffer.CloseWriter();
     m_state = State::TERMINATED;
+    notify_update();
+    if (m_on_exit) {
+        m_on_exit(*this);
+    }
+}
+
+void AppProcess::SetTerminalSize(const TerminalSize size) {
+    if ((size.columns == m_terminal_size.columns) && (size.rows == m_terminal_size.rows)) {
+        return;
+    }
+
+    if (m_child->Resize(size)) {
+        m_terminal_size = size;
+    }
 }
 
 size_t AppProcess::Write(const char* data, const size_t length) {
@@ -232,20 +421,23 @@ size_t AppProcess::Write(const char* data, const size_t length) {
         return 0;
     }
 
-    DWORD total_written = 0;
-    WriteFile(m_handle_write_std_in, LPCVOID(data), DWORD(length), &total_written, nullptr);
-    return size_t(total_written);
+    return m_child->Write(data, length);
 }
 
 AppProcess::~AppProcess() {
-    m_state = State::TERMINATED;
-    // TODO: cleanup the thread somehow
-    m_thread->detach();
+    // the listener uses our buffers and callbacks so it has to stop before they are destroyed
+    // the child is left running the same as if we had exited
+    m_is_closing = true;
+    if (m_thread->joinable()) {
+        m_thread->join();
+    }
+    BufferManager::Get().Unregister(&m_buffer);
 }
 
 void AppProcess::Terminate() {
+    m_is_terminated_by_user = true;
     m_state = State::TERMINATING;
-    if (TerminateProcess(m_handle_process, 0)) {
+    if (m_child->Terminate()) {
         m_state = State::TERMINATED;
     }
 }
@@ -3,17 +3,29 @@
 #include <atomic>
 #include <thread>
 #include <memory>
+#include <mutex>
+#include <functional>
 
 #include "environ.h"
 #include "app_schema.h"
+#include "platform.h"
 #include "scrolling_buffer.h"
-
-#define WIN32_LEAN_AND_MEAN
-#include <windows.h>
-#include <processenv.h>
+#include "output_archive.h"
+#include "output_triggers.h"
+#include "output_transcoder.h"
+#include "output_styles.h"
 
 namespace app {
 
+using TerminalSize = platform::TerminalSize;
+
+// called from the listener thread when a process has new output or changes state
+typedef std::function<void (void)> process_update_callback_t;
+
+class AppProcess;
+// called from the listener thread once the process has exited and its exit code is known
+typedef std::function<void (AppProcess &)> process_exit_callback_t;
+
 // creates a process with the specified environment and app configuration
 // attaches a thread with a scrolling buffer to read from it
 class AppProcess 
@@ -21,21 +33,70 @@ class AppProcess
 public:
     enum State { RUNNING, TERMINATING, TERMINATED };
 private:
+    // unique while we are running, clients of the daemon refer to processes by it
+    uint64_t m_id;
     std::atomic<State> m_state;
     std::unique_ptr<std::thread> m_thread;
-    HANDLE m_handle_write_std_in = NULL;
-    HANDLE m_handle_read_std_out = NULL;
-    HANDLE m_handle_read_std_err = NULL;
-    HANDLE m_handle_process = NULL;
+    std::unique_ptr<platform::ChildProcess> m_child;
+    bool m_is_pseudo_terminal = false;
+    TerminalSize m_terminal_size;
+    CaptureMode m_capture_mode;
     std::string m_label;
+    AppConfig m_config;
     ScrollingBuffer m_buffer;
+    // output which isn't utf-8 is read into the staging buffer and converted into the ring
+    std::unique_ptr<OutputTranscoder> m_transcoder;
+    std::vector<char> m_transcode_buffer;
+    // colours from the escape sequences which are stripped out of the output, empty unless the app strips escapes
+    OutputStyles m_styles;
+    // full output history on disk, null if archiving is disabled
+    std::shared_ptr<OutputArchive> m_archive;
+    process_update_callback_t m_on_update;
+    process_exit_callback_t m_on_exit;
+    // tracing for the launch this process was created in
+    uint64_t m_launch_id;
+    int64_t m_start_timestamp;
+    // trigger rules and the ready pattern, matched as the output is captured
+    std::unique_ptr<OutputTriggers> m_triggers;
+    // readiness is signalled by the process printing a pattern
+    std::atomic<bool> m_is_ready;
+    std::atomic<int64_t> m_exit_code;
+    std::atomic<bool> m_is_terminated_by_user;
+    // the listener stops without running the exit callbacks once we are being destroyed
+    std::atomic<bool> m_is_closing;
 public:
-    AppProcess(AppConfig &app_cfg, environment_t &orig);
+    AppProcess(
+        AppConfig &app_cfg, environment_t &orig, 
+        const TerminalSize terminal_size={}, process_update_callback_t on_update={},
+        process_exit_callback_t on_exit={});
     ~AppProcess();
+    inline uint64_t GetId() const { return m_id; }
     inline const std::string &GetName() const { return m_label; }
+    inline const AppConfig &GetConfig() const { return m_config; }
     inline State GetState() const { return m_state; }
+    inline bool IsPseudoTerminal() const { return m_is_pseudo_terminal; }
+    inline CaptureMode GetCaptureMode() const { return m_capture_mode; }
+    // auto until the encoding has been detected from the output
+    inline OutputEncoding GetOutputEncoding() const { return m_transcoder->GetEncoding(); }
+    inline uint64_t GetLaunchId() const { return m_launch_id; }
+    // true once the process has printed its ready pattern
+    inline bool IsReady() const { return m_is_ready; }
+    // -1 while running or if the exit code couldn't be read
+    inline int64_t GetExitCode() const { return m_exit_code; }
+    inline bool IsTerminatedByUser() const { return m_is_terminated_by_user; }
+    // steady clock time the process was started, same clock as the buffer chunk timestamps
+    inline int64_t GetStartTimestamp() const { return m_start_timestamp; }
+    // lossless capture has stopped reading from the child until the buffer is consumed
+    inline bool IsCaptureStalled() const { 
+        return (m_capture_mode == CaptureMode::LOSSLESS) && (m_buffer.GetFreeSize() == 0); 
+    }
+    // resize the pseudo terminal, ignored if the process was launched with plain pipes
+    void SetTerminalSize(const TerminalSize size);
     void ListenForChanges(); // listen for changes to the process's status
     ScrollingBuffer& GetBuffer() { return m_buffer; }
+    inline const std::shared_ptr<OutputArchive> &GetArchive() const { return m_archive; }
+    inline OutputTriggers &GetTriggers() { return *m_triggers; }
+    inline OutputStyles &GetStyles() { return m_styles; }
     size_t Write(const char* data, const size_t length);
     void Terminate();
 private:
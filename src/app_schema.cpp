@@ -1,3 +1,5 @@
+#include <string.h>
+
 #include <rapidjson/document.h>
 #include <rapidjson/schema.h>
 #include <rapidjson/stringbuffer.h>
@@ -75,7 +77,33 @@ R"({
                     "args": { "type": "string" },
                     "env_name": { "type": "string" },
                     "env_config_path": { "type": "string" },
-                    "env_parent_dir": { "type": "string" }
+                    "env_parent_dir": { "type": "string" },
+                    "use_pty": { "type": "boolean" },
+                    "capture_mode": { "enum": ["lossy", "lossless"] },
+                    "output_encoding": { "enum": ["auto", "utf-8", "utf-16le", "oem", "ansi"] },
+                    "archive_output": { "type": "boolean" },
+                    "share_output": { "type": "boolean" },
+        "strip_escapes": { "type": "boolean" },
+                    "strip_escapes": { "type": "boolean" },
+                    "sandbox": { "enum": ["off", "bind", "overlay"] },
+                    "redirect_paths": { "type": "boolean" },
+                    "depends_on": { "type": "array", "items": { "type": "string" } },
+                    "ready_pattern": { "type": "string" },
+                    "restart_policy": { "enum": ["never", "on-failure", "always"] },
+                    "max_restarts": { "type": "integer", "minimum": 0 },
+                    "restart_window_seconds": { "type": "integer", "minimum": 1 },
+                    "triggers": {
+                        "type": "array",
+                        "items": {
+                            "type": "object",
+                            "properties": {
+                                "pattern": { "type": "string" },
+                                "action": { "enum": ["highlight", "notify", "count", "terminate", "launch"] },
+                                "launch_app": { "type": "string" }
+                            },
+                            "required": ["pattern", "action"]
+                        }
+                    }
                 },
                 "required": [
                     "name", "username", "exec_path", "args", 
@@ -104,12 +132,156 @@ R"({
         "args": { "type": "string" },
         "env_name": { "type": "string" },
         "env_config_path": { "type": "string" },
-        "env_parent_dir": { "type": "string" }
+        "env_parent_dir": { "type": "string" },
+        "use_pty": { "type": "boolean" },
+        "capture_mode": { "enum": ["lossy", "lossless"] },
+        "output_encoding": { "enum": ["auto", "utf-8", "utf-16le", "oem", "ansi"] },
+        "archive_output": { "type": "boolean" },
+        "share_output": { "type": "boolean" },
+        "strip_escapes": { "type": "boolean" },
+        "sandbox": { "enum": ["off", "bind", "overlay"] },
+        "redirect_paths": { "type": "boolean" },
+        "depends_on": { "type": "array", "items": { "type": "string" } },
+        "ready_pattern": { "type": "string" },
+        "restart_policy": { "enum": ["never", "on-failure", "always"] },
+        "max_restarts": { "type": "integer", "minimum": 0 },
+        "restart_window_seconds": { "type": "integer", "minimum": 1 },
+        "triggers": {
+            "type": "array",
+            "items": {
+                "type": "object",
+                "properties": {
+                    "pattern": { "type": "string" },
+                    "action": { "enum": ["highlight", "notify", "count", "terminate", "launch"] },
+                    "launch_app": { "type": "string" }
+                },
+                "required": ["pattern", "action"]
+            }
+        }
     }
 })";
 
 extern rapidjson::SchemaDocument DEFAULT_APP_SCHEMA = load_schema_from_cstr(DEFAULT_APP_SCHEMA_STR);
 
+const char *capture_mode_to_string(const CaptureMode mode) {
+    switch (mode) {
+    case CaptureMode::LOSSLESS: return "lossless";
+    case CaptureMode::LOSSY:
+    default:                    return "lossy";
+    }
+}
+
+CaptureMode capture_mode_from_string(const char *str) {
+    if (strcmp(str, "lossless") == 0) {
+        return CaptureMode::LOSSLESS;
+    }
+    return CaptureMode::LOSSY;
+}
+
+const char *output_encoding_to_string(const OutputEncoding encoding) {
+    switch (encoding) {
+    case OutputEncoding::AUTO:      return "auto";
+    case OutputEncoding::UTF16LE:   return "utf-16le";
+    case OutputEncoding::OEM:       return "oem";
+    case OutputEncoding::ANSI:      return "ansi";
+    case OutputEncoding::UTF8:
+    default:                        return "utf-8";
+    }
+}
+
+OutputEncoding output_encoding_from_string(const char *str) {
+    if (strcmp(str, "auto") == 0) {
+        return OutputEncoding::AUTO;
+    }
+    if (strcmp(str, "utf-16le") == 0) {
+        return OutputEncoding::UTF16LE;
+    }
+    if (strcmp(str, "oem") == 0) {
+        return OutputEncoding::OEM;
+    }
+    if (strcmp(str, "ansi") == 0) {
+        return OutputEncoding::ANSI;
+    }
+    return OutputEncoding::UTF8;
+}
+
+const char *sandbox_mode_to_string(const SandboxMode mode) {
+    switch (mode) {
+    case SandboxMode::BIND:     return "bind";
+    case SandboxMode::OVERLAY:  return "overlay";
+    case SandboxMode::OFF:
+    default:                    return "off";
+    }
+}
+
+SandboxMode sandbox_mode_from_string(const char *str) {
+    if (strcmp(str, "bind") == 0) {
+        return SandboxMode::BIND;
+    }
+    if (strcmp(str, "overlay") == 0) {
+        return SandboxMode::OVERLAY;
+    }
+    return SandboxMode::OFF;
+}
+
+const char *restart_policy_to_string(const RestartPolicy policy) {
+    switch (policy) {
+    case RestartPolicy::ON_FAILURE: return "on-failure";
+    case RestartPolicy::ALWAYS:     return "always";
+    case RestartPolicy::NEVER:
+    default:                        return "never";
+    }
+}
+
+RestartPolicy restart_policy_from_string(const char *str) {
+    if (strcmp(str, "on-failure") == 0) {
+        return RestartPolicy::ON_FAILURE;
+    }
+    if (strcmp(str, "always") == 0) {
+        return RestartPolicy::ALWAYS;
+    }
+    return RestartPolicy::NEVER;
+}
+
+const char *trigger_action_to_string(const TriggerAction action) {
+    switch (action) {
+    case TriggerAction::NOTIFY:     return "notify";
+    case TriggerAction::COUNT:      return "count";
+    case TriggerAction::TERMINATE:  return "terminate";
+    case TriggerAction::LAUNCH:     return "launch";
+    case TriggerAction::HIGHLIGHT:
+    default:                        return "highlight";
+    }
+}
+
+TriggerAction trigger_action_from_string(const char *str) {
+    if (strcmp(str, "notify") == 0) {
+        return TriggerAction::NOTIFY;
+    }
+    if (strcmp(str, "count") == 0) {
+        return TriggerAction::COUNT;
+    }
+    if (strcmp(str, "terminate") == 0) {
+        return TriggerAction::TERMINATE;
+    }
+    if (strcmp(str, "launch") == 0) {
+        return TriggerAction::LAUNCH;
+    }
+    return TriggerAction::HIGHLIGHT;
+}
+
+static std::vector<TriggerRule> load_triggers(rapidjson::Value &triggers) {
+    std::vector<TriggerRule> rules;
+    for (auto &v: triggers.GetArray()) {
+        TriggerRule rule;
+        rule.pattern = v["pattern"].GetString();
+        rule.action = trigger_action_from_string(v["action"].GetString());
+        rule.launch_app = v.HasMember("launch_app") ? v["launch_app"].GetString() : "";
+        rules.push_back(std::move(rule));
+    }
+    return rules;
+}
+
 EnvConfig load_env_config(rapidjson::Document &doc) {
     EnvConfig cfg;
 
@@ -157,6 +329,30 @@ AppConfig load_app_config(rapidjson::Document &doc) {
     cfg.env_name        = load_default("env_name");
     cfg.env_config_path = load_default("env_config_path");
     cfg.env_parent_dir  = load_default("env_parent_dir");
+    cfg.use_pty         = doc.HasMember("use_pty") ? doc["use_pty"].GetBool() : false;
+    cfg.capture_mode    = capture_mode_from_string(load_default("capture_mode"));
+    cfg.output_encoding = output_encoding_from_string(load_default("output_encoding"));
+    cfg.archive_output  = doc.HasMember("archive_output") ? doc["archive_output"].GetBool() : false;
+    cfg.share_output    = doc.HasMember("share_output") ? doc["share_output"].GetBool() : false;
+    cfg.strip_escapes   = doc.HasMember("strip_escapes") ? doc["strip_escapes"].GetBool() : false;
+    cfg.sandbox         = sandbox_mode_from_string(load_default("sandbox"));
+    cfg.redirect_paths  = doc.HasMember("redirect_paths") ? doc["redirect_paths"].GetBool() : false;
+    cfg.ready_pattern   = load_default("ready_pattern");
+    cfg.restart_policy  = restart_policy_from_string(load_default("restart_policy"));
+    if (doc.HasMember("max_restarts")) {
+        cfg.max_restarts = doc["max_restarts"].GetInt();
+    }
+    if (doc.HasMember("restart_window_seconds")) {
+        cfg.restart_window_seconds = doc["restart_window_seconds"].GetInt();
+    }
+    if (doc.HasMember("depends_on")) {
+        for (auto &v: doc["depends_on"].GetArray()) {
+            cfg.depends_on.push_back(v.GetString());
+        }
+    }
+    if (doc.HasMember("triggers")) {
+        cfg.triggers = load_triggers(doc["triggers"]);
+    }
     return cfg;
 }
 
@@ -166,6 +362,12 @@ std::vector<AppConfig> load_app_configs(rapidjson::Document &doc) {
     auto load_default = [](rapidjson::Value &app, const char *key) {
         return app.HasMember(key) ? app[key].GetString() : "";
     };
+    auto load_default_bool = [](rapidjson::Value &app, const char *key) {
+        return app.HasMember(key) ? app[key].GetBool() : false;
+    };
+    auto load_default_int = [](rapidjson::Value &app, const char *key, int value) {
+        return app.HasMember(key) ? app[key].GetInt() : value;
+    };
 
     for (auto &app: apps) {
         AppConfig cfg;
@@ -177,6 +379,26 @@ std::vector<AppConfig> load_app_configs(rapidjson::Document &doc) {
         cfg.env_name        = app["env_name"].GetString();
         cfg.env_config_path = app["env_config_path"].GetString();
         cfg.env_parent_dir  = app["env_parent_dir"].GetString();
+        cfg.use_pty         = load_default_bool(app, "use_pty");
+        cfg.capture_mode    = capture_mode_from_string(load_default(app, "capture_mode"));
+        cfg.output_encoding = output_encoding_from_string(load_default(app, "output_encoding"));
+        cfg.archive_output  = load_default_bool(app, "archive_output");
+        cfg.share_output    = load_default_bool(app, "share_output");
+        cfg.strip_escapes   = load_default_bool(app, "strip_escapes");
+        cfg.sandbox         = sandbox_mode_from_string(load_default(app, "sandbox"));
+        cfg.redirect_paths  = load_default_bool(app, "redirect_paths");
+        cfg.ready_pattern   = load_default(app, "ready_pattern");
+        cfg.restart_policy  = restart_policy_from_string(load_default(app, "restart_policy"));
+        cfg.max_restarts    = load_default_int(app, "max_restarts", cfg.max_restarts);
+        cfg.restart_window_seconds = load_default_int(app, "restart_window_seconds", cfg.restart_window_seconds);
+        if (app.HasMember("depends_on")) {
+            for (auto &v: app["depends_on"].GetArray()) {
+                cfg.depends_on.push_back(v.GetString());
+            }
+        }
+        if (app.HasMember("triggers")) {
+            cfg.triggers = load_triggers(app["triggers"]);
+        }
 
         cfgs.push_back(std::move(cfg));
     }
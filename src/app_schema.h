@@ -22,6 +22,67 @@ struct EnvConfig {
     std::vector<std::string>                     pass_through_variables;
 };
 
+// how process output is captured when the child writes faster than it is consumed
+enum class CaptureMode {
+    LOSSY,      // overwrite the oldest output
+    LOSSLESS,   // stop reading from the child until the output is consumed
+};
+
+const char *capture_mode_to_string(const CaptureMode mode);
+CaptureMode capture_mode_from_string(const char *str);
+
+// what the child writes, converted to utf-8 as it is captured
+enum class OutputEncoding {
+    AUTO,       // decided from the first output which isn't plain ascii
+    UTF8,       // stored as is
+    UTF16LE,
+    OEM,        // legacy console codepage
+    ANSI,       // legacy windows codepage
+};
+
+const char *output_encoding_to_string(const OutputEncoding encoding);
+OutputEncoding output_encoding_from_string(const char *str);
+
+// how the environment directories replace the real ones for programs which ignore the environment variables
+// only supported on linux, where it uses an unprivileged user and mount namespace
+enum class SandboxMode {
+    OFF,        // only the environment variables point into the environment
+    BIND,       // only the environment directory is visible
+    OVERLAY,    // the real directory is visible but all writes land in the environment directory
+};
+
+const char *sandbox_mode_to_string(const SandboxMode mode);
+SandboxMode sandbox_mode_from_string(const char *str);
+
+// when an exited process is launched again
+enum class RestartPolicy {
+    NEVER,
+    ON_FAILURE, // only if it exited with a non-zero exit code
+    ALWAYS,     // unless it was terminated by the user
+};
+
+const char *restart_policy_to_string(const RestartPolicy policy);
+RestartPolicy restart_policy_from_string(const char *str);
+
+// what happens when a process prints the pattern of a trigger
+enum class TriggerAction {
+    HIGHLIGHT,  // colour the line in the output pane
+    NOTIFY,     // log a warning, at most once a second per trigger
+    COUNT,      // only count the matches
+    TERMINATE,  // terminate the process, it can still be restarted by its restart policy
+    LAUNCH,     // launch another app, at most once a second per trigger
+};
+
+const char *trigger_action_to_string(const TriggerAction action);
+TriggerAction trigger_action_from_string(const char *str);
+
+struct TriggerRule {
+    std::string pattern;
+    TriggerAction action = TriggerAction::HIGHLIGHT;
+    // name of the app to launch
+    std::string launch_app;
+};
+
 struct AppConfig {
     std::string name;
     std::string username;
@@ -31,6 +92,26 @@ struct AppConfig {
     std::string env_name;
     std::string env_config_path;
     std::string env_parent_dir;
+    bool use_pty = false;
+    CaptureMode capture_mode = CaptureMode::LOSSY;
+    OutputEncoding output_encoding = OutputEncoding::UTF8;
+    bool archive_output = false;
+    // export the output ring as shared memory so other processes can tail it
+    bool share_output = false;
+    // parse colours out of the output, which strips the escape sequences from what subscribers and shared rings see
+    bool strip_escapes = false;
+    SandboxMode sandbox = SandboxMode::OFF;
+    // preload a shim which rewrites hard coded paths in the real home into the environment, linux only
+    bool redirect_paths = false;
+    // launch only after these apps have exited successfully or printed their ready pattern
+    std::vector<std::string> depends_on;
+    std::string ready_pattern;
+    RestartPolicy restart_policy = RestartPolicy::NEVER;
+    // give up restarting after this many restarts within the window
+    int max_restarts = 5;
+    int restart_window_seconds = 60;
+    // matched against the output as it is captured, all of them at once
+    std::vector<TriggerRule> triggers;
 };
 
 EnvConfig load_env_config(rapidjson::Document &doc);
@@ -76,6 +157,63 @@ rapidjson::Document create_app_configs_doc(T &configs) {
         writer.Key("env_parent_dir"); 
         writer.String(cfg.env_parent_dir.c_str());
 
+        writer.Key("use_pty"); 
+        writer.Bool(cfg.use_pty);
+
+        writer.Key("capture_mode"); 
+        writer.String(capture_mode_to_string(cfg.capture_mode));
+
+        writer.Key("output_encoding"); 
+        writer.String(output_encoding_to_string(cfg.output_encoding));
+
+        writer.Key("archive_output"); 
+        writer.Bool(cfg.archive_output);
+
+        writer.Key("share_output"); 
+        writer.Bool(cfg.share_output);
+
+        writer.Key("strip_escapes"); 
+        writer.Bool(cfg.strip_escapes);
+
+        writer.Key("sandbox"); 
+        writer.String(sandbox_mode_to_string(cfg.sandbox));
+
+        writer.Key("redirect_paths"); 
+        writer.Bool(cfg.redirect_paths);
+
+        writer.Key("depends_on"); 
+        writer.StartArray();
+        for (auto &name: cfg.depends_on) {
+            writer.String(name.c_str());
+        }
+        writer.EndArray();
+
+        writer.Key("ready_pattern"); 
+        writer.String(cfg.ready_pattern.c_str());
+
+        writer.Key("restart_policy"); 
+        writer.String(restart_policy_to_string(cfg.restart_policy));
+
+        writer.Key("max_restarts"); 
+        writer.Int(cfg.max_restarts);
+
+        writer.Key("restart_window_seconds"); 
+        writer.Int(cfg.restart_window_seconds);
+
+        writer.Key("triggers"); 
+        writer.StartArray();
+        for (auto &trigger: cfg.triggers) {
+            writer.StartObject();
+            writer.Key("pattern");
+            writer.String(trigger.pattern.c_str());
+            writer.Key("action");
+            writer.String(trigger_action_to_string(trigger.action));
+            writer.Key("launch_app");
+            writer.String(trigger.launch_app.c_str());
+            writer.EndObject();
+        }
+        writer.EndArray();
+
         writer.EndObject();
     }
     writer.EndArray();
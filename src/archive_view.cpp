@@ -0,0 +1,104 @@
+// prints or searches the output archive of a process, including archives from earlier runs
+// the archive is read through its index so gaps from dropped segments are reported on stderr and skipped
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <algorithm>
+#include <string>
+#include <string_view>
+
+#include <fmt/core.h>
+
+#include "output_archive.h"
+
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#endif
+
+static constexpr size_t CHUNK_SIZE = 0x10000;
+static constexpr size_t MAX_LINE_LENGTH = 256;
+
+static void print_usage(const char *name) {
+    fprintf(stderr,
+        "Usage: %s FILE [--find PATTERN]\n"
+        "    FILE            Archive in the logs folder of the environment, ending with .log.lz4\n"
+        "    --find PATTERN  Print the offset and line of every match instead of the whole output\n",
+        name);
+}
+
+static void print_matches(app::OutputArchive &archive, const std::string &pattern) {
+    uint64_t start_offset = 0;
+    uint64_t match_offset = 0;
+    std::string line;
+    while (archive.Find(pattern, start_offset, match_offset)) {
+        uint64_t line_offset = match_offset - std::min(match_offset, uint64_t(MAX_LINE_LENGTH/2));
+        archive.Read(line_offset, MAX_LINE_LENGTH, line, line_offset);
+        const size_t match_index = size_t(match_offset - line_offset);
+        size_t line_begin = line.rfind('\n', match_index);
+        line_begin = (line_begin == std::string::npos) ? 0 : (line_begin+1);
+        size_t line_end = line.find('\n', match_index);
+        line_end = (line_end == std::string::npos) ? line.size() : line_end;
+        fmt::print("{}: {}\n", match_offset, std::string_view(line).substr(line_begin, line_end - line_begin));
+        start_offset = match_offset + 1;
+    }
+}
+
+static void print_all(app::OutputArchive &archive) {
+    std::string chunk;
+    uint64_t offset = archive.GetReadableBegin();
+    const uint64_t end_offset = archive.GetReadableEnd();
+    while (offset < end_offset) {
+        uint64_t read_offset = 0;
+        if (archive.Read(offset, CHUNK_SIZE, chunk, read_offset) == 0) {
+            break;
+        }
+        if (read_offset > offset) {
+            fmt::print(stderr, "Skipped {} bytes which were dropped\n", read_offset - offset);
+        }
+        fwrite(chunk.data(), 1, chunk.size(), stdout);
+        offset = read_offset + uint64_t(chunk.size());
+    }
+    fflush(stdout);
+}
+
+int main(int argc, char **argv) {
+    const char *filepath = nullptr;
+    const char *pattern = nullptr;
+    for (int i = 1; i < argc; i++) {
+        const bool has_value = (i+1) < argc;
+        if ((strcmp(argv[i], "--find") == 0) && has_value) {
+            pattern = argv[++i];
+        } else if ((strcmp(argv[i], "--help") == 0) || (strcmp(argv[i], "-h") == 0)) {
+            print_usage(argv[0]);
+            return 0;
+        } else if (filepath == nullptr) {
+            filepath = argv[i];
+        } else {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+    if (filepath == nullptr) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    #ifdef _WIN32
+    _setmode(_fileno(stdout), _O_BINARY);
+    #endif
+
+    try {
+        auto archive = app::OutputArchive::Open(filepath);
+        if (pattern != nullptr) {
+            print_matches(*archive, pattern);
+        } else {
+            print_all(*archive);
+        }
+    } catch (std::exception &ex) {
+        fmt::print(stderr, "{}\n", ex.what());
+        return 1;
+    }
+    return 0;
+}
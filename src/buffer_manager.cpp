@@ -0,0 +1,199 @@
+#include "buffer_manager.h"
+
+#include <algorithm>
+#include <queue>
+
+#include "tracing.h"
+
+namespace app {
+
+BufferManager::BufferManager()
+: m_budget(0), m_prev_rebalance(clock::now()), m_is_running(true)
+{
+    m_thread = std::thread([this]() { ManagerThread(); });
+}
+
+BufferManager::~BufferManager() {
+    {
+        auto lock = std::scoped_lock(m_mutex);
+        m_is_running = false;
+    }
+    m_cv.notify_all();
+    m_thread.join();
+}
+
+BufferManager &BufferManager::Get() {
+    static BufferManager manager;
+    return manager;
+}
+
+void BufferManager::Register(ScrollingBuffer *buffer) {
+    auto lock = std::scoped_lock(m_mutex);
+    m_entries.push_back({ buffer, buffer->GetTotalWritten(), 0.0, buffer->GetMaxSize() });
+}
+
+void BufferManager::Unregister(ScrollingBuffer *buffer) {
+    auto lock = std::scoped_lock(m_mutex);
+    m_entries.erase(
+        std::remove_if(m_entries.begin(), m_entries.end(), [buffer](const Entry &entry) { return entry.buffer == buffer; }),
+        m_entries.end());
+}
+
+void BufferManager::SetBudget(const size_t budget) {
+    {
+        auto lock = std::scoped_lock(m_mutex);
+        m_budget = budget;
+    }
+    m_cv.notify_all();
+}
+
+size_t BufferManager::GetBudget() {
+    auto lock = std::scoped_lock(m_mutex);
+    return m_budget;
+}
+
+BufferManagerStats BufferManager::GetStats() {
+    auto lock = std::scoped_lock(m_mutex);
+    BufferManagerStats stats;
+    stats.budget = m_budget;
+    stats.total_size = 0;
+    stats.total_buffers = m_entries.size();
+    stats.total_grown = 0;
+    stats.largest_size = 0;
+    for (auto &entry: m_entries) {
+        const size_t size = entry.buffer->GetMaxSize();
+        stats.total_size += entry.buffer->GetMappedSize();
+        stats.total_grown += (size > ScrollingBuffer::MIN_SIZE) ? 1 : 0;
+        stats.largest_size = std::max(stats.largest_size, size);
+    }
+    return stats;
+}
+
+void BufferManager::Rebalance() {
+    TRACE_SCOPE("rebalance_buffers");
+    auto lock = std::scoped_lock(m_mutex);
+    const auto now = clock::now();
+    const double elapsed_seconds = std::chrono::duration<double>(now - m_prev_rebalance).count();
+    m_prev_rebalance = now;
+    if (elapsed_seconds <= 0.0) {
+        return;
+    }
+
+    for (auto &entry: m_entries) {
+        const uint64_t total_written = entry.buffer->GetTotalWritten();
+        const double rate = double(total_written - entry.prev_total_written) / elapsed_seconds;
+        entry.prev_total_written = total_written;
+        entry.rate = (rate >= entry.rate) ? rate : (entry.rate*RATE_DECAY + rate*(1.0-RATE_DECAY));
+        // nothing more will be written so give everything back
+        if (entry.buffer->IsWriterClosed()) {
+            entry.rate = 0.0;
+        }
+    }
+    if (m_budget == 0) {
+        return;
+    }
+
+    size_t total_target = 0;
+    for (auto &entry: m_entries) {
+        entry.target_size = ScrollingBuffer::GetRingSize(size_t(entry.rate * HISTORY_SECONDS));
+        total_target += entry.target_size;
+    }
+
+    // halve the largest rings until everything fits, the slower one gives way on a tie
+    // if every ring is at the minimum size this is as low as we can go
+    if (total_target > m_budget) {
+        auto is_smaller = [](const Entry *a, const Entry *b) {
+            if (a->target_size != b->target_size) {
+                return a->target_size < b->target_size;
+            }
+            return a->rate > b->rate;
+        };
+        std::priority_queue<Entry *, std::vector<Entry *>, decltype(is_smaller)> largest(is_smaller);
+        for (auto &entry: m_entries) {
+            if (entry.target_size > ScrollingBuffer::MIN_SIZE) {
+                largest.push(&entry);
+            }
+        }
+        while ((total_target > m_budget) && !largest.empty()) {
+            auto *entry = largest.top();
+            largest.pop();
+            entry->target_size /= 2;
+            total_target -= entry->target_size;
+            if (entry->target_size > ScrollingBuffer::MIN_SIZE) {
+                largest.push(entry);
+            }
+        }
+    }
+
+    // a resize maps the new ring before the old one is released, so every resize needs room for its new ring
+    // pending requests are left alone since the writer may already be applying them
+    // this keeps the rings under the budget even while they are being copied
+    size_t total_size = 0;
+    std::vector<Entry *> shrinks;
+    std::vector<Entry *> grows;
+    for (auto &entry: m_entries) {
+        auto &buffer = *entry.buffer;
+        // there is no writer left to apply it
+        if (buffer.IsWriterClosed()) {
+            buffer.ApplyResize();
+        }
+        // checked before the mapped size, so a resize that finishes in between is still counted
+        const bool is_resize_pending = buffer.IsResizePending();
+        total_size += buffer.GetMappedSize();
+        if (is_resize_pending) {
+            total_size += buffer.GetRequestedSize();
+            continue;
+        }
+        const size_t size = buffer.GetMaxSize();
+        if (entry.target_size < size) {
+            shrinks.push_back(&entry);
+        } else if (entry.target_size > size) {
+            grows.push_back(&entry);
+        }
+    }
+
+    // idle rings first since they give back the most for the least history
+    // once we are over the budget, e.g. after new buffers were registered, shrinking is the only way back under
+    std::sort(shrinks.begin(), shrinks.end(), [](const Entry *a, const Entry *b) { return a->rate < b->rate; });
+    const bool is_over_budget = total_size > m_budget;
+    for (auto *entry: shrinks) {
+        if (!is_over_budget && ((total_size + entry->target_size) > m_budget)) {
+            continue;
+        }
+        auto &buffer = *entry->buffer;
+        buffer.RequestResize(entry->target_size);
+        total_size += entry->target_size;
+        if (buffer.IsWriterClosed()) {
+            buffer.ApplyResize();
+        }
+    }
+
+    // busiest first so they get the free memory, a grow that doesn't fit waits for the shrinks to be applied
+    std::sort(grows.begin(), grows.end(), [](const Entry *a, const Entry *b) { return a->rate > b->rate; });
+    for (auto *entry: grows) {
+        if ((total_size + entry->target_size) > m_budget) {
+            continue;
+        }
+        entry->buffer->RequestResize(entry->target_size);
+        total_size += entry->target_size;
+    }
+}
+
+void BufferManager::ManagerThread() {
+    Tracer::Get().SetThreadName("buffer manager");
+    auto lock = std::unique_lock(m_mutex);
+    while (m_is_running) {
+        m_cv.wait_for(lock, REBALANCE_INTERVAL);
+        if (!m_is_running) {
+            break;
+        }
+        if ((clock::now() - m_prev_rebalance) < REBALANCE_INTERVAL) {
+            continue;
+        }
+        lock.unlock();
+        Rebalance();
+        lock.lock();
+    }
+}
+
+}
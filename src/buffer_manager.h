@@ -0,0 +1,68 @@
+#pragma once
+
+#include <stdint.h>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "scrolling_buffer.h"
+
+namespace app {
+
+struct BufferManagerStats {
+    size_t budget;
+    size_t total_size;          // bytes held by the rings, the mirrors don't use any extra memory
+    size_t total_buffers;
+    size_t total_grown;         // buffers above the minimum size
+    size_t largest_size;
+};
+
+// shares a global memory budget between the scrolling buffers of every process
+// rings of processes with a high output rate are grown so they keep more history
+// idle rings and the rings of exited processes are shrunk back to the minimum size
+// resizes are only requested here and applied by each buffer's writer, so capture never waits on us
+class BufferManager
+{
+public:
+    using clock = std::chrono::steady_clock;
+    static constexpr size_t DEFAULT_BUDGET = 256*1024*1024;
+    static constexpr auto REBALANCE_INTERVAL = std::chrono::milliseconds(500);
+    // a ring is sized to hold this much of its output at the recent rate
+    static constexpr double HISTORY_SECONDS = 10.0;
+    // the rate follows increases straight away but decays slowly
+    // so a busy process that pauses for a moment doesn't lose its history
+    static constexpr double RATE_DECAY = 0.9;
+private:
+    struct Entry {
+        ScrollingBuffer *buffer;
+        uint64_t prev_total_written;
+        double rate;            // bytes per second
+        size_t target_size;
+    };
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::vector<Entry> m_entries;
+    // zero leaves every buffer at the size it was created with
+    size_t m_budget;
+    clock::time_point m_prev_rebalance;
+    bool m_is_running;
+    std::thread m_thread;
+public:
+    static BufferManager &Get();
+    ~BufferManager();
+    void Register(ScrollingBuffer *buffer);
+    // blocks until a rebalance using the buffer has finished
+    void Unregister(ScrollingBuffer *buffer);
+    void SetBudget(const size_t budget);
+    size_t GetBudget();
+    BufferManagerStats GetStats();
+    // normally run periodically by the manager's thread
+    void Rebalance();
+private:
+    BufferManager();
+    void ManagerThread();
+};
+
+}
@@ -0,0 +1,304 @@
+#include "daemon_client.h"
+
+#include <string.h>
+#include <algorithm>
+#include <stdexcept>
+
+#include <fmt/core.h>
+#include <spdlog/spdlog.h>
+
+#include "tracing.h"
+
+namespace app {
+
+static constexpr size_t RECV_SIZE = 0x10000;
+
+DaemonClient::DaemonClient(const std::string &socket_path, std::function<void()> on_update)
+: m_on_update(on_update)
+{
+    m_socket = platform::connect_local_socket(socket_path);
+    // a daemon run by someone else would see everything we launch
+    if (!platform::is_local_socket_peer_trusted(m_socket)) {
+        platform::close_socket(m_socket);
+        throw std::runtime_error(fmt::format("Daemon socket is owned by another user ({})", socket_path));
+    }
+    m_reader_thread = std::thread([this]() { ReaderThread(); });
+}
+
+DaemonClient::~DaemonClient() {
+    platform::shutdown_socket(m_socket);
+    m_reader_thread.join();
+    platform::close_socket(m_socket);
+}
+
+bool DaemonClient::IsConnected() {
+    auto lock = std::scoped_lock(m_mutex);
+    return m_is_connected;
+}
+
+std::vector<std::string> DaemonClient::GetAppNames() {
+    auto lock = std::scoped_lock(m_mutex);
+    return m_app_names;
+}
+
+std::vector<RemoteProcess> DaemonClient::GetProcesses() {
+    auto lock = std::scoped_lock(m_mutex);
+    std::vector<RemoteProcess> processes;
+    processes.reserve(m_processes.size());
+    for (auto &info: m_processes) {
+        RemoteProcess process;
+        process.id = info.id;
+        process.name = info.name;
+        process.state = info.state;
+        process.is_ready = info.is_ready;
+        process.exit_code = info.exit_code;
+        process.buffer = nullptr;
+        process.styles = nullptr;
+        process.total_skipped = 0;
+        auto it = m_subscriptions.find(info.id);
+        if (it != m_subscriptions.end()) {
+            process.buffer = it->second.buffer;
+            process.styles = it->second.styles;
+            process.total_skipped = it->second.total_skipped;
+        }
+        processes.push_back(std::move(process));
+    }
+    return processes;
+}
+
+void DaemonClient::Launch(const std::string &app_name) {
+    std::string message;
+    auto writer = DaemonMessageWriter(message, DaemonMessageType::LAUNCH, m_next_request_id++);
+    writer.PutString(app_name);
+    writer.End();
+    Send(message);
+}
+
+void DaemonClient::Terminate(const uint64_t process_id) {
+    std::string message;
+    auto writer = DaemonMessageWriter(message, DaemonMessageType::TERMINATE, m_next_request_id++);
+    writer.PutU64(process_id);
+    writer.End();
+    Send(message);
+}
+
+void DaemonClient::Subscribe(const uint64_t process_id, const uint64_t offset) {
+    {
+        auto lock = std::scoped_lock(m_mutex);
+        if (m_subscriptions.find(process_id) != m_subscriptions.end()) {
+            return;
+        }
+        auto &sub = m_subscriptions[process_id];
+        sub.buffer = std::make_shared<ScrollingBuffer>(LOCAL_BUFFER_SIZE);
+        sub.styles = std::make_shared<OutputStyles>();
+        sub.next_offset = offset;
+    }
+    std::string message;
+    auto writer = DaemonMessageWriter(message, DaemonMessageType::SUBSCRIBE, m_next_request_id++);
+    writer.PutU64(process_id);
+    writer.PutU64(offset);
+    writer.PutU32(SUBSCRIPTION_WINDOW);
+    writer.End();
+    Send(message);
+}
+
+void DaemonClient::Unsubscribe(const uint64_t process_id) {
+    {
+        auto lock = std::scoped_lock(m_mutex);
+        if (m_subscriptions.erase(process_id) == 0) {
+            return;
+        }
+    }
+    std::string message;
+    auto writer = DaemonMessageWriter(message, DaemonMessageType::UNSUBSCRIBE, m_next_request_id++);
+    writer.PutU64(process_id);
+    writer.End();
+    Send(message);
+}
+
+std::vector<std::string> DaemonClient::TakeErrors() {
+    auto lock = std::scoped_lock(m_mutex);
+    return std::move(m_errors);
+}
+
+// the socket is blocking, requests are small so this only waits if the daemon stopped reading
+void DaemonClient::Send(const std::string &message) {
+    auto lock = std::scoped_lock(m_send_mutex);
+    size_t total_sent = 0;
+    while (total_sent < message.size()) {
+        const int64_t rv = platform::send_socket(m_socket, message.data() + total_sent, message.size() - total_sent);
+        if (rv < 0) {
+            spdlog::warn("Failed to send request to the daemon");
+            return;
+        }
+        total_sent += size_t(rv);
+    }
+}
+
+void DaemonClient::ReaderThread() {
+    Tracer::Get().SetThreadName("daemon_client");
+    std::string recv_buffer;
+    std::vector<char> data(RECV_SIZE);
+    try {
+        while (true) {
+            const int64_t rv = platform::recv_socket(m_socket, data.data(), data.size());
+            if (rv <= 0) {
+                break;
+            }
+            recv_buffer.append(data.data(), size_t(rv));
+
+            size_t offset = 0;
+            DaemonMessageHeader header;
+            while (read_daemon_message_header(recv_buffer.data() + offset, recv_buffer.size() - offset, header)) {
+                const size_t message_size = DAEMON_HEADER_SIZE + size_t(header.size);
+                if ((recv_buffer.size() - offset) < message_size) {
+                    break;
+                }
+                auto reader = DaemonMessageReader(recv_buffer.data() + offset + DAEMON_HEADER_SIZE, header.size);
+                HandleMessage(header, reader);
+                offset += message_size;
+            }
+            recv_buffer.erase(0, offset);
+            if ((offset > 0) && m_on_update) {
+                m_on_update();
+            }
+        }
+    } catch (std::exception &ex) {
+        spdlog::error(fmt::format("Invalid message from the daemon: {}", ex.what()));
+    }
+
+    spdlog::info("Disconnected from the daemon");
+    {
+        auto lock = std::scoped_lock(m_mutex);
+        m_is_connected = false;
+    }
+    if (m_on_update) {
+        m_on_update();
+    }
+}
+
+void DaemonClient::HandleMessage(const DaemonMessageHeader &header, DaemonMessageReader &reader) {
+    switch (header.type) {
+    case DaemonMessageType::RESULT:
+        {
+            const bool is_success = reader.GetU8() != 0;
+            auto error = reader.GetString();
+            if (!is_success) {
+                auto lock = std::scoped_lock(m_mutex);
+                m_errors.push_back(std::move(error));
+            }
+        }
+        break;
+    case DaemonMessageType::PROCESS_LIST:
+        {
+            std::vector<std::string> app_names;
+            const uint32_t total_apps = reader.GetU32();
+            for (uint32_t i = 0; i < total_apps; i++) {
+                app_names.push_back(reader.GetString());
+            }
+            std::vector<DaemonProcessInfo> processes;
+            const uint32_t total_processes = reader.GetU32();
+            for (uint32_t i = 0; i < total_processes; i++) {
+                processes.push_back(read_daemon_process_info(reader));
+            }
+            auto lock = std::scoped_lock(m_mutex);
+            m_app_names = std::move(app_names);
+            m_processes = std::move(processes);
+        }
+        break;
+    case DaemonMessageType::OUTPUT:
+        {
+            TRACE_SCOPE("daemon_client_output");
+            const uint64_t process_id = reader.GetU64();
+            const uint64_t offset = reader.GetU64();
+            const auto output = reader.GetRemaining();
+            uint32_t credit = 0;
+            {
+                auto lock = std::scoped_lock(m_mutex);
+                auto it = m_subscriptions.find(process_id);
+                // output which was already queued when we unsubscribed
+                if (it == m_subscriptions.end()) {
+                    break;
+                }
+                auto &sub = it->second;
+                if (offset > sub.next_offset) {
+                    sub.total_skipped += offset - sub.next_offset;
+                }
+                sub.next_offset = offset + output.size();
+                // chunks are never larger than the local ring, and the mirror lets them run off the end of it
+                auto &buffer = *sub.buffer;
+                const size_t length = std::min(output.size(), buffer.GetMaxSize());
+                // runs are moved onto our offsets, those before what we keep of the chunk start at its beginning
+                const uint64_t local_offset = buffer.GetTotalWritten();
+                const uint64_t kept_offset = offset + uint64_t(output.size() - length);
+                for (auto &run: sub.pending_runs) {
+                    run.offset = local_offset + (std::max(run.offset, kept_offset) - kept_offset);
+                }
+                memcpy(buffer.GetWriteBuffer(length), output.data() + (output.size() - length), length);
+                buffer.IncrementIndex(length);
+                const uint64_t total_written = buffer.GetTotalWritten();
+                sub.styles->AddRuns(sub.pending_runs, total_written - std::min(total_written, uint64_t(buffer.GetMaxSize())));
+                sub.pending_runs.clear();
+                // the output is copied out as soon as it arrives, so credit is only held back to batch it
+                sub.total_unacknowledged += uint32_t(output.size());
+                if (sub.total_unacknowledged >= (SUBSCRIPTION_WINDOW/2)) {
+                    credit = sub.total_unacknowledged;
+                    sub.total_unacknowledged = 0;
+                }
+            }
+            if (credit > 0) {
+                std::string message;
+                auto writer = DaemonMessageWriter(message, DaemonMessageType::CREDIT);
+                writer.PutU64(process_id);
+                writer.PutU32(credit);
+                writer.End();
+                Send(message);
+            }
+        }
+        break;
+    case DaemonMessageType::GAP:
+        {
+            const uint64_t process_id = reader.GetU64();
+            const uint64_t offset = reader.GetU64();
+            const uint64_t length = reader.GetU64();
+            auto lock = std::scoped_lock(m_mutex);
+            auto it = m_subscriptions.find(process_id);
+            if (it == m_subscriptions.end()) {
+                break;
+            }
+            // a gap over output we already have means it was overwritten while it was sent to us,
+            // it is already in the local buffer so we can only count it
+            auto &sub = it->second;
+            sub.total_skipped += length;
+            sub.pending_runs.clear();
+            sub.next_offset = std::max(sub.next_offset, offset + length);
+        }
+        break;
+    case DaemonMessageType::STYLES:
+        {
+            const uint64_t process_id = reader.GetU64();
+            const uint32_t total_runs = reader.GetU32();
+            std::vector<StyleRun> runs;
+            for (uint32_t i = 0; i < total_runs; i++) {
+                StyleRun run;
+                run.offset = reader.GetU64();
+                run.style.foreground = reader.GetU32();
+                run.style.background = reader.GetU32();
+                run.style.attributes = reader.GetU8();
+                runs.push_back(run);
+            }
+            auto lock = std::scoped_lock(m_mutex);
+            auto it = m_subscriptions.find(process_id);
+            if (it == m_subscriptions.end()) {
+                break;
+            }
+            it->second.pending_runs = std::move(runs);
+        }
+        break;
+    default:
+        spdlog::debug("Ignoring unknown message from the daemon ({})", uint16_t(header.type));
+        break;
+    }
+}
+
+}
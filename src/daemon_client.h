@@ -0,0 +1,90 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "daemon_protocol.h"
+#include "output_styles.h"
+#include "platform.h"
+#include "scrolling_buffer.h"
+
+namespace app {
+
+// process owned by the daemon as seen by a client
+struct RemoteProcess {
+    uint64_t id;
+    std::string name;
+    uint8_t state;          // AppProcess::State
+    bool is_ready;
+    int64_t exit_code;
+    // local copy of the output, null unless we are subscribed to the process
+    std::shared_ptr<ScrollingBuffer> buffer;
+    // style runs of the local copy, at its offsets
+    std::shared_ptr<OutputStyles> styles;
+    // output the daemon skipped because it was overwritten before it reached us
+    uint64_t total_skipped;
+};
+
+// thin client of a DaemonServer, used by the gui to attach to a daemon instead of owning the processes
+// a reader thread decodes what the daemon sends, the getters return snapshots so the gui never waits on the socket
+// disconnecting only detaches us, the daemon keeps the processes running
+class DaemonClient
+{
+public:
+    // size of the local copy of each subscribed process's output
+    static constexpr size_t LOCAL_BUFFER_SIZE = 0x100000;
+    // output the daemon may send us ahead of what we have copied, credit is returned in halves of it
+    static constexpr uint32_t SUBSCRIPTION_WINDOW = 0x40000;
+private:
+    struct Subscription {
+        std::shared_ptr<ScrollingBuffer> buffer;
+        std::shared_ptr<OutputStyles> styles;
+        // from the STYLES sent ahead of the next OUTPUT, at the daemon's offsets
+        std::vector<StyleRun> pending_runs;
+        uint64_t next_offset = 0;
+        uint64_t total_skipped = 0;
+        uint32_t total_unacknowledged = 0;
+    };
+    platform::socket_t m_socket;
+    std::mutex m_send_mutex;
+    std::atomic<uint32_t> m_next_request_id = 1;
+    std::mutex m_mutex;
+    std::vector<std::string> m_app_names;
+    std::vector<DaemonProcessInfo> m_processes;
+    std::unordered_map<uint64_t, Subscription> m_subscriptions;
+    std::vector<std::string> m_errors;
+    bool m_is_connected = true;
+    // called from the reader thread whenever something new arrived
+    std::function<void()> m_on_update;
+    std::thread m_reader_thread;
+public:
+    // throws if the daemon couldn't be connected to
+    DaemonClient(const std::string &socket_path, std::function<void()> on_update=nullptr);
+    ~DaemonClient();
+    bool IsConnected();
+    std::vector<std::string> GetAppNames();
+    std::vector<RemoteProcess> GetProcesses();
+    // requests are sent without waiting for their result, failures show up in TakeErrors()
+    void Launch(const std::string &app_name);
+    void Terminate(const uint64_t process_id);
+    // output from the offset onwards is copied into the process's local buffer
+    // anything before the oldest byte the daemon still has is counted as skipped
+    void Subscribe(const uint64_t process_id, const uint64_t offset=0);
+    void Unsubscribe(const uint64_t process_id);
+    std::vector<std::string> TakeErrors();
+    DaemonClient(const DaemonClient &) = delete;
+    DaemonClient &operator=(const DaemonClient &) = delete;
+private:
+    void Send(const std::string &message);
+    void ReaderThread();
+    void HandleMessage(const DaemonMessageHeader &header, DaemonMessageReader &reader);
+};
+
+}
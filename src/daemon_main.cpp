@@ -0,0 +1,93 @@
+// headless supervisor which owns the processes, the gui attaches to it with --connect
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <memory>
+#include <string>
+
+#include <fmt/core.h>
+#include <spdlog/spdlog.h>
+
+#include "app.h"
+#include "daemon_protocol.h"
+#include "daemon_server.h"
+#include "tracing.h"
+#ifdef __linux__
+#include "fork_server.h"
+#include "platform.h"
+#endif
+
+static app::DaemonServer *g_server = nullptr;
+
+static void on_stop_signal(int) {
+    if (g_server != nullptr) {
+        g_server->Stop();
+    }
+}
+
+static void print_usage(const char *name) {
+    fprintf(stderr, "Usage: %s [apps.json] [--socket PATH] [--no-fork-server]\n", name);
+}
+
+int main(int argc, char **argv) {
+    const char *apps_filepath = app::DEFAULT_APPS_FILEPATH;
+    std::string socket_path = app::get_default_daemon_socket_path();
+    [[maybe_unused]] bool is_fork_server = true;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--socket") == 0) {
+            if ((i+1) >= argc) {
+                print_usage(argv[0]);
+                return 1;
+            }
+            socket_path = argv[++i];
+        } else if (strcmp(argv[i], "--no-fork-server") == 0) {
+            is_fork_server = false;
+        } else if ((strcmp(argv[i], "--help") == 0) || (strcmp(argv[i], "-h") == 0)) {
+            print_usage(argv[0]);
+            return 0;
+        } else {
+            apps_filepath = argv[i];
+        }
+    }
+
+    #if NDEBUG
+    spdlog::set_level(spdlog::level::info);
+    #else
+    spdlog::set_level(spdlog::level::debug);
+    #endif
+
+#ifdef __linux__
+    // forked before any other thread is started, launches are spawned directly without it
+    std::unique_ptr<app::ForkServer> fork_server;
+    if (is_fork_server) {
+        try {
+            fork_server = std::make_unique<app::ForkServer>();
+            app::platform::set_fork_server(fork_server.get());
+        } catch (std::exception &ex) {
+            spdlog::warn(fmt::format("Launching without the fork server: {}", ex.what()));
+        }
+    }
+#endif
+
+    int rv = 0;
+    try {
+        app::Tracer::Get().SetThreadName("daemon");
+        auto main_app = app::App(apps_filepath);
+        auto server = app::DaemonServer(main_app, socket_path);
+        g_server = &server;
+        signal(SIGINT, on_stop_signal);
+        signal(SIGTERM, on_stop_signal);
+        spdlog::info(fmt::format("Listening on {}", socket_path));
+        server.Run();
+        g_server = nullptr;
+        spdlog::info("Stopping daemon");
+    } catch (std::exception &ex) {
+        spdlog::critical(fmt::format("Exception in daemon: {}", ex.what()));
+        rv = 1;
+    }
+    g_server = nullptr;
+#ifdef __linux__
+    app::platform::set_fork_server(nullptr);
+#endif
+    return rv;
+}
@@ -0,0 +1,153 @@
+#include "daemon_protocol.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include <filesystem>
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+#include <fmt/core.h>
+
+namespace app {
+
+std::string get_default_daemon_socket_path() {
+    namespace fs = std::filesystem;
+#ifndef _WIN32
+    const char *runtime_dir = getenv("XDG_RUNTIME_DIR");
+    if ((runtime_dir != nullptr) && (runtime_dir[0] != '\0')) {
+        return (fs::path(runtime_dir) / DAEMON_SOCKET_FILENAME).string();
+    }
+    // the temp directory is shared, so the socket goes in a directory of our own which the daemon creates
+    const auto private_dir = fmt::format("appvirtualenv-{}", getuid());
+    return (fs::temp_directory_path() / private_dir / DAEMON_SOCKET_FILENAME).string();
+#else
+    return (fs::temp_directory_path() / DAEMON_SOCKET_FILENAME).string();
+#endif
+    return (fs::temp_directory_path() / DAEMON_SOCKET_FILENAME).string();
+}
+
+static void put_le(std::string &buffer, const uint64_t x, const size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        buffer.push_back(char((x >> (i*8)) & 0xFF));
+    }
+}
+
+static uint64_t get_le(const char *data, const size_t length) {
+    uint64_t x = 0;
+    for (size_t i = 0; i < length; i++) {
+        x |= uint64_t(uint8_t(data[i])) << (i*8);
+    }
+    return x;
+}
+
+DaemonMessageWriter::DaemonMessageWriter(std::string &buffer, const DaemonMessageType type, const uint32_t request_id)
+: m_buffer(buffer), m_start(buffer.size())
+{
+    put_le(m_buffer, 0, 4);
+    put_le(m_buffer, uint64_t(type), 2);
+    put_le(m_buffer, 0, 2);
+    put_le(m_buffer, request_id, 4);
+}
+
+void DaemonMessageWriter::PutU8(const uint8_t x) {
+    m_buffer.push_back(char(x));
+}
+
+void DaemonMessageWriter::PutU32(const uint32_t x) {
+    put_le(m_buffer, x, 4);
+}
+
+void DaemonMessageWriter::PutU64(const uint64_t x) {
+    put_le(m_buffer, x, 8);
+}
+
+void DaemonMessageWriter::PutString(const std::string_view str) {
+    PutU32(uint32_t(str.size()));
+    m_buffer.append(str);
+}
+
+void DaemonMessageWriter::PutBytes(const char *data, const size_t length) {
+    m_buffer.append(data, length);
+}
+
+void DaemonMessageWriter::End(const size_t trailing_size) {
+    const size_t size = m_buffer.size() - m_start - DAEMON_HEADER_SIZE + trailing_size;
+    if (size > MAX_DAEMON_MESSAGE_SIZE) {
+        m_buffer.resize(m_start);
+        throw std::runtime_error(fmt::format("Daemon message is too large ({} bytes)", size));
+    }
+    for (size_t i = 0; i < 4; i++) {
+        m_buffer[m_start+i] = char((size >> (i*8)) & 0xFF);
+    }
+}
+
+DaemonMessageReader::DaemonMessageReader(const char *data, const size_t size)
+: m_data(data), m_size(size), m_offset(0) {}
+
+const char *DaemonMessageReader::Take(const size_t length) {
+    if (length > (m_size - m_offset)) {
+        throw std::runtime_error("Daemon message is truncated");
+    }
+    const char *data = m_data + m_offset;
+    m_offset += length;
+    return data;
+}
+
+uint8_t DaemonMessageReader::GetU8() {
+    return uint8_t(*Take(1));
+}
+
+uint32_t DaemonMessageReader::GetU32() {
+    return uint32_t(get_le(Take(4), 4));
+}
+
+uint64_t DaemonMessageReader::GetU64() {
+    return get_le(Take(8), 8);
+}
+
+std::string DaemonMessageReader::GetString() {
+    const uint32_t length = GetU32();
+    const char *data = Take(length);
+    return std::string(data, length);
+}
+
+std::string_view DaemonMessageReader::GetRemaining() {
+    const size_t length = m_size - m_offset;
+    return std::string_view(Take(length), length);
+}
+
+bool read_daemon_message_header(const char *data, const size_t size, DaemonMessageHeader &header) {
+    if (size < DAEMON_HEADER_SIZE) {
+        return false;
+    }
+    header.size = uint32_t(get_le(data, 4));
+    header.type = DaemonMessageType(get_le(data+4, 2));
+    header.request_id = uint32_t(get_le(data+8, 4));
+    if (header.size > MAX_DAEMON_MESSAGE_SIZE) {
+        throw std::runtime_error(fmt::format("Daemon message is too large ({} bytes)", header.size));
+    }
+    return true;
+}
+
+void write_daemon_process_info(DaemonMessageWriter &writer, const DaemonProcessInfo &info) {
+    writer.PutU64(info.id);
+    writer.PutString(info.name);
+    writer.PutU8(info.state);
+    writer.PutU8(info.is_ready ? 1 : 0);
+    writer.PutI64(info.exit_code);
+}
+
+DaemonProcessInfo read_daemon_process_info(DaemonMessageReader &reader) {
+    DaemonProcessInfo info;
+    info.id = reader.GetU64();
+    info.name = reader.GetString();
+    info.state = reader.GetU8();
+    info.is_ready = reader.GetU8() != 0;
+    info.exit_code = reader.GetI64();
+    return info;
+}
+
+}
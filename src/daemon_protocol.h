@@ -0,0 +1,110 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <string_view>
+
+namespace app {
+
+// binary rpc between the daemon and its clients over a local socket
+// every message is a fixed size header followed by its payload
+// integers are little endian, strings are a u32 length followed by the bytes
+static constexpr size_t DAEMON_HEADER_SIZE = 12;
+static constexpr size_t MAX_DAEMON_MESSAGE_SIZE = 0x100000;
+static constexpr const char *DAEMON_SOCKET_FILENAME = "appvirtualenv.sock";
+
+enum class DaemonMessageType: uint16_t {
+    // client to daemon, each one is answered with a RESULT carrying the same request id
+    LAUNCH = 1,             // string app name
+    TERMINATE = 2,          // u64 process id
+    SUBSCRIBE = 3,          // u64 process id, u64 offset, u32 window
+    UNSUBSCRIBE = 4,        // u64 process id
+    CREDIT = 5,             // u64 process id, u32 bytes added to the window, not answered
+    // daemon to client, with a request id of zero unless it is a reply
+    RESULT = 0x100,         // u8 is_success, string error
+    PROCESS_LIST = 0x101,   // u32 total apps, app names, u32 total processes, processes
+    OUTPUT = 0x102,         // u64 process id, u64 offset, the rest of the payload is output
+    GAP = 0x103,            // u64 process id, u64 offset, u64 length
+    STYLES = 0x104,         // u64 process id, u32 total runs, runs of u64 offset, u32 foreground, u32 background, u8 attributes
+};
+
+// output subscriptions
+// a subscription streams a process's output from an absolute byte offset, so a consumer which reconnects
+// can resume from the end of what it has, or ask for 0 to get everything the daemon still has
+// output which was overwritten in the ring before it could be sent is reported as a GAP instead
+// if a GAP overlaps output which was already received, that output was overwritten while it was being sent
+// and should be discarded
+// the window is how many output bytes the daemon may send before the client grants more with CREDIT,
+// a SUBSCRIBE with a zero window is refused since it could never be sent anything
+// for a lossy app a consumer which stops granting credit only falls behind and gets a GAP, it never holds up capture
+// a lossless app only captures as far as its slowest subscriber has returned credit for
+// for apps with strip_escapes set the escape sequences are stripped from the output before it reaches the ring, so the style runs covering
+// an OUTPUT are sent in a STYLES just before it, starting with the run in effect at its offset
+
+struct DaemonMessageHeader {
+    uint32_t size;          // payload only
+    DaemonMessageType type;
+    uint32_t request_id;
+};
+
+// entry of a PROCESS_LIST
+// u64 id, string name, u8 state, u8 is_ready, i64 exit_code
+struct DaemonProcessInfo {
+    uint64_t id;
+    std::string name;
+    uint8_t state;          // AppProcess::State
+    bool is_ready;
+    int64_t exit_code;
+};
+
+// the temp directory is per user on windows, on linux we prefer the per user runtime directory
+// and fall back to a directory of our own in the temp directory
+std::string get_default_daemon_socket_path();
+
+// appends a message to the buffer, the size in the header is filled in by End()
+class DaemonMessageWriter
+{
+private:
+    std::string &m_buffer;
+    size_t m_start;
+public:
+    DaemonMessageWriter(std::string &buffer, const DaemonMessageType type, const uint32_t request_id=0);
+    void PutU8(const uint8_t x);
+    void PutU32(const uint32_t x);
+    void PutU64(const uint64_t x);
+    inline void PutI64(const int64_t x) { PutU64(uint64_t(x)); }
+    void PutString(const std::string_view str);
+    void PutBytes(const char *data, const size_t length);
+    // trailing_size is payload which is sent after the buffer without being appended to it
+    // throws if the payload is too large
+    void End(const size_t trailing_size=0);
+};
+
+// throws if the payload is shorter than what is being read
+class DaemonMessageReader
+{
+private:
+    const char *m_data;
+    size_t m_size;
+    size_t m_offset;
+public:
+    DaemonMessageReader(const char *data, const size_t size);
+    uint8_t GetU8();
+    uint32_t GetU32();
+    uint64_t GetU64();
+    inline int64_t GetI64() { return int64_t(GetU64()); }
+    std::string GetString();
+    // everything which hasn't been read yet
+    std::string_view GetRemaining();
+private:
+    const char *Take(const size_t length);
+};
+
+// returns false if there isn't a whole header yet, throws if it is invalid
+bool read_daemon_message_header(const char *data, const size_t size, DaemonMessageHeader &header);
+
+void write_daemon_process_info(DaemonMessageWriter &writer, const DaemonProcessInfo &info);
+DaemonProcessInfo read_daemon_process_info(DaemonMessageReader &reader);
+
+}
@@ -0,0 +1,483 @@
+#include "daemon_server.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <stdexcept>
+
+#include <fmt/core.h>
+#include <spdlog/spdlog.h>
+
+#include "tracing.h"
+
+namespace app {
+
+// size of each read from a client, requests are small
+static constexpr size_t RECV_SIZE = 0x1000;
+
+DaemonServer::DaemonServer(App &app, const std::string &socket_path)
+: m_app(app), m_socket_path(socket_path), m_is_running(true)
+{
+    m_listener = platform::listen_local_socket(socket_path);
+}
+
+DaemonServer::~DaemonServer() {
+    for (auto &client: m_clients) {
+        platform::close_socket(client->socket);
+    }
+    platform::close_socket(m_listener);
+    std::error_code ec;
+    std::filesystem::remove(m_socket_path, ec);
+}
+
+void DaemonServer::Stop() {
+    m_is_running = false;
+}
+
+void DaemonServer::Run() {
+    std::vector<platform::SocketPoll> polls;
+    while (m_is_running) {
+        polls.clear();
+        polls.push_back({ m_listener });
+        for (auto &client: m_clients) {
+            const bool is_write = !client->send_queue.empty();
+            polls.push_back({ client->socket, is_write });
+        }
+        if (!platform::poll_sockets(polls, POLL_INTERVAL_MS)) {
+            throw std::runtime_error("Failed to poll daemon sockets");
+        }
+
+        TRACE_SCOPE("daemon_update");
+        // clients accepted here are at the end, so they don't change the indices of the polls
+        if (polls[0].is_readable) {
+            AcceptClients();
+        }
+        for (size_t i = 1; i < polls.size(); i++) {
+            if (polls[i].is_readable) {
+                ReadClient(*m_clients[i-1]);
+            }
+        }
+
+        m_app.poll_launches();
+        UpdateProcessList();
+        QueueOutput();
+        for (auto &client: m_clients) {
+            FlushClient(*client);
+        }
+        ConsumeOutput();
+
+        auto it = std::remove_if(m_clients.begin(), m_clients.end(), [](const std::unique_ptr<Client> &client) {
+            if (client->is_closed) {
+                platform::close_socket(client->socket);
+            }
+            return client->is_closed;
+        });
+        m_clients.erase(it, m_clients.end());
+    }
+}
+
+void DaemonServer::AcceptClients() {
+    while (true) {
+        const auto socket = platform::accept_local_socket(m_listener);
+        if (socket == platform::INVALID_SOCKET_T) {
+            return;
+        }
+        // clients can launch processes, so only our own user is let in
+        if (!platform::is_local_socket_peer_trusted(socket)) {
+            spdlog::warn("Refused a daemon client running as another user");
+            platform::close_socket(socket);
+            continue;
+        }
+        auto client = std::make_unique<Client>();
+        client->socket = socket;
+        // a new client starts with everything we have
+        QueueMessage(*client, m_process_list);
+        m_clients.push_back(std::move(client));
+        spdlog::info("Daemon client connected ({} total)", m_clients.size());
+    }
+}
+
+void DaemonServer::ReadClient(Client &client) {
+    char data[RECV_SIZE];
+    while (!client.is_closed) {
+        const int64_t rv = platform::recv_socket(client.socket, data, sizeof(data));
+        if (rv < 0) {
+            spdlog::info("Daemon client disconnected");
+            client.is_closed = true;
+            return;
+        }
+        if (rv == 0) {
+            break;
+        }
+        client.recv_buffer.append(data, size_t(rv));
+    }
+
+    size_t offset = 0;
+    try {
+        DaemonMessageHeader header;
+        while (read_daemon_message_header(client.recv_buffer.data() + offset, client.recv_buffer.size() - offset, header)) {
+            const size_t message_size = DAEMON_HEADER_SIZE + size_t(header.size);
+            if ((client.recv_buffer.size() - offset) < message_size) {
+                break;
+            }
+            auto reader = DaemonMessageReader(client.recv_buffer.data() + offset + DAEMON_HEADER_SIZE, header.size);
+            HandleMessage(client, header, reader);
+            offset += message_size;
+        }
+    } catch (std::exception &ex) {
+        spdlog::warn(fmt::format("Dropping daemon client which sent an invalid message: {}", ex.what()));
+        client.is_closed = true;
+        return;
+    }
+    client.recv_buffer.erase(0, offset);
+}
+
+void DaemonServer::HandleMessage(Client &client, const DaemonMessageHeader &header, DaemonMessageReader &reader) {
+    std::string error;
+    switch (header.type) {
+    case DaemonMessageType::LAUNCH:
+        {
+            const auto name = reader.GetString();
+            auto &configs = m_app.m_managed_configs.GetConfigs();
+            auto it = std::find_if(configs.begin(), configs.end(), [&name](auto &managed_cfg) {
+                return managed_cfg->GetConfig().name == name;
+            });
+            if (it == configs.end()) {
+                error = fmt::format("Unknown app ({})", name);
+                break;
+            }
+            m_app.launch_app((*it)->GetConfig());
+        }
+        break;
+    case DaemonMessageType::TERMINATE:
+        {
+            const uint64_t id = reader.GetU64();
+            auto *process = FindProcess(id);
+            if (process == nullptr) {
+                error = fmt::format("Unknown process ({})", id);
+                break;
+            }
+            process->Terminate();
+        }
+        break;
+    case DaemonMessageType::SUBSCRIBE:
+        {
+            const uint64_t id = reader.GetU64();
+            const uint64_t offset = reader.GetU64();
+            const uint32_t window = reader.GetU32();
+            if (FindProcess(id) == nullptr) {
+                error = fmt::format("Unknown process ({})", id);
+                break;
+            }
+            // without a window the subscriber never has credit, which would hold up lossless capture for good
+            if (window == 0) {
+                error = fmt::format("Subscription to ({}) needs a window", id);
+                break;
+            }
+            // subscribing again moves an existing subscription to the new offset
+            auto &subs = client.subscriptions;
+            auto it = std::find_if(subs.begin(), subs.end(), [id](const Subscription &sub) { return sub.process_id == id; });
+            if (it == subs.end()) {
+                subs.push_back({ id, offset, window, window });
+            } else {
+                it->offset = offset;
+                it->credit = window;
+                it->window = window;
+            }
+        }
+        break;
+    case DaemonMessageType::UNSUBSCRIBE:
+        {
+            const uint64_t id = reader.GetU64();
+            auto &subs = client.subscriptions;
+            subs.erase(
+                std::remove_if(subs.begin(), subs.end(), [id](const Subscription &sub) { return sub.process_id == id; }),
+                subs.end());
+        }
+        break;
+    case DaemonMessageType::CREDIT:
+        {
+            const uint64_t id = reader.GetU64();
+            const uint32_t bytes = reader.GetU32();
+            for (auto &sub: client.subscriptions) {
+                if (sub.process_id == id) {
+                    sub.credit += bytes;
+                }
+            }
+        }
+        // sent for every chunk that is consumed, so it isn't answered
+        return;
+    default:
+        error = fmt::format("Unknown request type ({})", uint16_t(header.type));
+        break;
+    }
+
+    std::string result;
+    auto writer = DaemonMessageWriter(result, DaemonMessageType::RESULT, header.request_id);
+    writer.PutU8(error.empty() ? 1 : 0);
+    writer.PutString(error);
+    writer.End();
+    QueueMessage(client, std::move(result));
+}
+
+void DaemonServer::QueueMessage(Client &client, std::string data) {
+    client.total_pending += data.size();
+    client.send_queue.push_back({ std::move(data) });
+}
+
+void DaemonServer::QueueGap(Client &client, const uint64_t process_id, const uint64_t offset, const uint64_t length) {
+    std::string gap;
+    auto writer = DaemonMessageWriter(gap, DaemonMessageType::GAP);
+    writer.PutU64(process_id);
+    writer.PutU64(offset);
+    writer.PutU64(length);
+    writer.End();
+    QueueMessage(client, std::move(gap));
+}
+
+// states and readiness change rarely, so this is usually one comparison with the last list
+void DaemonServer::UpdateProcessList() {
+    std::string process_list;
+    auto writer = DaemonMessageWriter(process_list, DaemonMessageType::PROCESS_LIST);
+    auto &configs = m_app.m_managed_configs.GetConfigs();
+    writer.PutU32(uint32_t(configs.size()));
+    for (auto &managed_cfg: configs) {
+        writer.PutString(managed_cfg->GetConfig().name);
+    }
+    writer.PutU32(uint32_t(m_app.m_processes.size()));
+    for (auto &process: m_app.m_processes) {
+        DaemonProcessInfo info;
+        info.id = process->GetId();
+        info.name = process->GetName();
+        info.state = uint8_t(process->GetState());
+        info.is_ready = process->IsReady();
+        info.exit_code = process->GetExitCode();
+        write_daemon_process_info(writer, info);
+    }
+    writer.End();
+
+    if (process_list == m_process_list) {
+        return;
+    }
+    m_process_list = std::move(process_list);
+    for (auto &client: m_clients) {
+        QueueMessage(*client, m_process_list);
+    }
+}
+
+// every subscriber of a process is served from one look at its ring
+// only the offsets are queued here, the output itself is read out of the ring when it is sent
+void DaemonServer::QueueOutput() {
+    std::vector<StyleRun> runs;
+    for (auto &process: m_app.m_processes) {
+        const uint64_t id = process->GetId();
+        auto &buffer = process->GetBuffer();
+        // the writer may move on after this, FlushClient() checks the output is still there when it sends it
+        const uint64_t total_written = buffer.GetTotalWritten();
+        const uint64_t oldest_offset = total_written - std::min(total_written, uint64_t(buffer.GetMaxSize()));
+        for (auto &client: m_clients) {
+            for (auto &sub: client->subscriptions) {
+                if (sub.process_id != id) {
+                    continue;
+                }
+                if (sub.offset < oldest_offset) {
+                    QueueGap(*client, id, sub.offset, oldest_offset - sub.offset);
+                    sub.offset = oldest_offset;
+                }
+                while ((sub.offset < total_written) && (sub.credit > 0) && (client->total_pending < MAX_PENDING_SEND_SIZE)) {
+                    size_t length = size_t(std::min({
+                        total_written - sub.offset, uint64_t(MAX_OUTPUT_CHUNK_SIZE), sub.credit }));
+                    // every run after the one in effect at the offset starts past it, so a cut chunk still has output
+                    process->GetStyles().GetRuns(sub.offset, sub.offset + length, runs);
+                    if (runs.size() > MAX_STYLE_RUNS) {
+                        length = size_t(runs[MAX_STYLE_RUNS].offset - sub.offset);
+                        runs.resize(MAX_STYLE_RUNS);
+                    }
+                    if (!runs.empty()) {
+                        std::string styles;
+                        auto styles_writer = DaemonMessageWriter(styles, DaemonMessageType::STYLES);
+                        styles_writer.PutU64(id);
+                        styles_writer.PutU32(uint32_t(runs.size()));
+                        for (auto &run: runs) {
+                            styles_writer.PutU64(run.offset);
+                            styles_writer.PutU32(run.style.foreground);
+                            styles_writer.PutU32(run.style.background);
+                            styles_writer.PutU8(run.style.attributes);
+                        }
+                        styles_writer.End();
+                        QueueMessage(*client, std::move(styles));
+                    }
+                    PendingSend send;
+                    auto writer = DaemonMessageWriter(send.data, DaemonMessageType::OUTPUT);
+                    writer.PutU64(id);
+                    writer.PutU64(sub.offset);
+                    writer.End(length);
+                    send.process_id = id;
+                    send.offset = sub.offset;
+                    send.length = length;
+                    client->total_pending += send.data.size() + length;
+                    client->send_queue.push_back(std::move(send));
+                    sub.offset += length;
+                    sub.credit -= length;
+                }
+            }
+        }
+    }
+}
+
+// output is gathered straight from the rings into each send
+// the rings are locked so they aren't remapped during the send, but lossy capture can still overwrite them
+// output overwritten before any of it was sent becomes a gap, output overwritten while it was being sent
+// is followed by a gap so the client knows to discard it
+void DaemonServer::FlushClient(Client &client) {
+    platform::SocketBuffer buffers[platform::MAX_SOCKET_BUFFERS];
+    struct SentOutput {
+        ScrollingBuffer *buffer;
+        uint64_t process_id;
+        uint64_t offset;
+        size_t length;
+        size_t send_offset;     // where the output starts in the gathered send
+    };
+    std::vector<SentOutput> sent_outputs;
+    // queued once we are done walking the queue
+    std::vector<SentOutput> gaps;
+    std::vector<ScrollingBuffer *> locked_buffers;
+    std::vector<std::shared_lock<std::shared_mutex>> locks;
+
+    while (!client.is_closed && !client.send_queue.empty()) {
+        sent_outputs.clear();
+        gaps.clear();
+        locked_buffers.clear();
+        locks.clear();
+
+        size_t total_buffers = 0;
+        size_t total_gathered = 0;
+        size_t skip = client.total_sent;
+        for (auto &send: client.send_queue) {
+            if ((total_buffers + 2) > platform::MAX_SOCKET_BUFFERS) {
+                break;
+            }
+            if (send.length > 0) {
+                auto *process = FindProcess(send.process_id);
+                ScrollingBuffer *buffer = (process != nullptr) ? &process->GetBuffer() : nullptr;
+                // a shared lock can't be taken twice by one thread if a resize is waiting on it
+                if ((buffer != nullptr) && (std::find(locked_buffers.begin(), locked_buffers.end(), buffer) == locked_buffers.end())) {
+                    locked_buffers.push_back(buffer);
+                    locks.push_back(buffer->LockRead());
+                }
+                const bool is_overwritten =
+                    (buffer == nullptr) ||
+                    ((buffer->GetWriteEnd() - send.offset) > uint64_t(buffer->GetMaxSize()));
+                if (is_overwritten) {
+                    if (skip == 0) {
+                        // nothing has been sent yet so the whole message can be replaced
+                        client.total_pending -= send.data.size() + send.length;
+                        const uint64_t process_id = send.process_id;
+                        const uint64_t offset = send.offset;
+                        const size_t length = send.length;
+                        send = PendingSend();
+                        auto writer = DaemonMessageWriter(send.data, DaemonMessageType::GAP);
+                        writer.PutU64(process_id);
+                        writer.PutU64(offset);
+                        writer.PutU64(length);
+                        writer.End();
+                        client.total_pending += send.data.size();
+                    } else {
+                        // the header is already out so the size can't change, pad it and discard it with a gap
+                        send.data.resize(send.data.size() + send.length, '\0');
+                        gaps.push_back({ nullptr, send.process_id, send.offset, send.length, 0 });
+                        send.length = 0;
+                    }
+                } else {
+                    sent_outputs.push_back({ buffer, send.process_id, send.offset, send.length, 0 });
+                }
+            }
+
+            if (skip < send.data.size()) {
+                buffers[total_buffers++] = { send.data.data() + skip, send.data.size() - skip };
+                total_gathered += send.data.size() - skip;
+                skip = 0;
+            } else {
+                skip -= send.data.size();
+            }
+            if (send.length > 0) {
+                auto &output = sent_outputs.back();
+                output.send_offset = total_gathered;
+                buffers[total_buffers++] = { output.buffer->GetBufferAtOffset(send.offset) + skip, send.length - skip };
+                total_gathered += send.length - skip;
+                skip = 0;
+            }
+        }
+
+        const int64_t rv = platform::send_socket_vectored(client.socket, buffers, total_buffers);
+        if (rv < 0) {
+            client.is_closed = true;
+            return;
+        }
+
+        // only output which made it into the send can have been torn
+        // the write end covers a read from the process which is landing in the ring but isn't counted yet
+        for (auto &output: sent_outputs) {
+            if (output.send_offset >= size_t(rv)) {
+                break;
+            }
+            if ((output.buffer->GetWriteEnd() - output.offset) > uint64_t(output.buffer->GetMaxSize())) {
+                gaps.push_back(output);
+            }
+        }
+        locks.clear();
+        for (auto &gap: gaps) {
+            QueueGap(client, gap.process_id, gap.offset, gap.length);
+        }
+
+        size_t total_sent = client.total_sent + size_t(rv);
+        client.total_pending -= size_t(rv);
+        while (!client.send_queue.empty()) {
+            auto &send = client.send_queue.front();
+            const size_t size = send.data.size() + send.length;
+            if (total_sent < size) {
+                break;
+            }
+            total_sent -= size;
+            client.send_queue.pop_front();
+        }
+        client.total_sent = total_sent;
+        if (rv == 0) {
+            break;
+        }
+    }
+}
+
+// lossy subscribers are served from the ring and never hold up capture, so the daemon consumes everything
+// lossless output is only consumed once every subscriber has read it, which it acknowledges by returning credit
+// a lossless process nobody is subscribed to is consumed straight away so it doesn't stall while detached
+void DaemonServer::ConsumeOutput() {
+    for (auto &process: m_app.m_processes) {
+        auto &buffer = process->GetBuffer();
+        uint64_t consumed_offset = buffer.GetTotalWritten();
+        if (process->GetCaptureMode() == CaptureMode::LOSSLESS) {
+            const uint64_t id = process->GetId();
+            for (auto &client: m_clients) {
+                for (auto &sub: client->subscriptions) {
+                    if (sub.process_id != id) {
+                        continue;
+                    }
+                    const uint64_t total_unread = sub.window - std::min(sub.credit, sub.window);
+                    const uint64_t read_offset = sub.offset - std::min(total_unread, sub.offset);
+                    consumed_offset = std::min(consumed_offset, read_offset);
+                }
+            }
+        }
+        buffer.MarkConsumed(consumed_offset);
+    }
+}
+
+AppProcess *DaemonServer::FindProcess(const uint64_t id) {
+    for (auto &process: m_app.m_processes) {
+        if (process->GetId() == id) {
+            return process.get();
+        }
+    }
+    return nullptr;
+}
+
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "app.h"
+#include "daemon_protocol.h"
+#include "platform.h"
+
+namespace app {
+
+// long running owner of the app and its processes, so they outlive the gui which connects as a client
+// capture runs on the listener threads as usual and never waits on a client, the daemon consumes all output
+// straight away and subscribers are served from whatever is still in the ring
+// output is sent straight from the ring, a subscriber which falls behind gets a gap for what was overwritten
+// everything else, including every call into the app, runs on the thread which called Run()
+class DaemonServer
+{
+public:
+    static constexpr int POLL_INTERVAL_MS = 16;
+    // output is only queued for a client while less than this is waiting to be sent to it
+    static constexpr size_t MAX_PENDING_SEND_SIZE = 0x100000;
+    static constexpr size_t MAX_OUTPUT_CHUNK_SIZE = 0x10000;
+    // a chunk is cut short at the run past this so its STYLES stays under the message size limit
+    static constexpr size_t MAX_STYLE_RUNS = 0x8000;
+private:
+    struct Subscription {
+        uint64_t process_id;
+        uint64_t offset;        // next byte to queue
+        uint64_t credit;        // bytes the client will still take
+        uint64_t window;        // credit the client started with, what it hasn't returned is still unread
+    };
+    // output is read from the ring when it is sent, after the header in data
+    struct PendingSend {
+        std::string data;
+        uint64_t process_id = 0;
+        uint64_t offset = 0;
+        size_t length = 0;      // zero if there is no output
+    };
+    struct Client {
+        platform::socket_t socket;
+        std::string recv_buffer;
+        std::deque<PendingSend> send_queue;
+        size_t total_sent = 0;      // of the message at the front of the queue
+        size_t total_pending = 0;   // bytes in the queue including output
+        std::vector<Subscription> subscriptions;
+        bool is_closed = false;
+    };
+    App &m_app;
+    std::string m_socket_path;
+    platform::socket_t m_listener;
+    std::vector<std::unique_ptr<Client>> m_clients;
+    // the last list that was sent, it is only sent again when something in it changes
+    std::string m_process_list;
+    std::atomic<bool> m_is_running;
+public:
+    // throws if the socket couldn't be listened on
+    DaemonServer(App &app, const std::string &socket_path);
+    ~DaemonServer();
+    // serves clients until Stop() is called
+    void Run();
+    // can be called from a signal handler
+    void Stop();
+    DaemonServer(const DaemonServer &) = delete;
+    DaemonServer &operator=(const DaemonServer &) = delete;
+private:
+    void AcceptClients();
+    void ReadClient(Client &client);
+    void HandleMessage(Client &client, const DaemonMessageHeader &header, DaemonMessageReader &reader);
+    void QueueMessage(Client &client, std::string data);
+    void QueueGap(Client &client, const uint64_t process_id, const uint64_t offset, const uint64_t length);
+    void UpdateProcessList();
+    void QueueOutput();
+    void FlushClient(Client &client);
+    void ConsumeOutput();
+    AppProcess *FindProcess(const uint64_t id);
+};
+
+}
@@ -2,49 +2,133 @@
 #include <sstream>
 #include <memory>
 #include <unordered_map>
+#include <filesystem>
+#include <stdexcept>
+
+#include <spdlog/spdlog.h>
+#include <fmt/core.h>
 
 #include "environ.h"
+#include "app_schema.h"
+#include "platform.h"
+#include "tracing.h"
+#ifdef __linux__
+#include "mount_sandbox.h"
+#include "path_redirect_table.h"
+#endif
 
 namespace app {
 
-#define WIN32_LEAN_AND_MEAN
-#include <windows.h>
-#include <tchar.h>
-#include <processenv.h>
-
-
 environment_t get_env() {
     environment_t env;
+    for (auto &env_string: platform::read_env_strings()) {
+        const size_t split = env_string.find('=');
+        if (split == std::string::npos) {
+            continue;
+        }
+        env[env_string.substr(0, split)] = env_string.substr(split+1);
+    }
+    return env;
+}
+
+tstring create_env_string(environment_t &env) {
+    std::stringstream ss;
+    for (auto &[key, value]: env) {
+        ss << key << '=' << value << '\0';
+    }
+    ss << '\0';
+    return ss.str();
+}
+
+#ifdef __linux__
+// built next to our executable by the same cmake project
+static const char *PATH_REDIRECT_SHIM_FILENAME = "libpath_redirect_shim.so";
+
+// the table maps the same real directories as the sandbox, and is kept in the environment root
+// throws if the shim is missing since the app asked for its paths to be redirected
+static void add_path_redirect(environment_t &env, environment_t &orig, EnvParams &params, std::vector<std::string> *created_paths) {
+    TRACE_SCOPE("add_path_redirect");
+    namespace fs = std::filesystem;
+    const auto shim_path = fs::read_symlink("/proc/self/exe").parent_path() / PATH_REDIRECT_SHIM_FILENAME;
+    if (!fs::exists(shim_path)) {
+        throw std::runtime_error(fmt::format("Failed to find path redirect shim ({})", shim_path.string()));
+    }
+
+    const auto root = fs::absolute(params.root);
+    const auto redirects = get_path_redirects(get_sandbox_mounts(env, orig), root.string());
+    const auto table_path = (root / "path_redirect_table.bin").string();
+    write_path_redirect_table(table_path, compile_path_redirects(redirects));
+    env[PATH_REDIRECT_TABLE_ENV] = table_path;
+    if (created_paths != nullptr) {
+        created_paths->push_back(table_path);
+    }
 
-    auto free_block = [](LPTCH p) { FreeEnvironmentStrings(p); };
-    auto env_block = std::unique_ptr<TCHAR, decltype(free_block)>{
-            GetEnvironmentStrings(), free_block};
+    // keep anything else that is preloaded
+    auto it = env.find("LD_PRELOAD");
+    env["LD_PRELOAD"] = ((it != env.end()) && !it->second.empty()) ?
+        fmt::format("{}:{}", shim_path.string(), it->second) :
+        shim_path.string();
+}
+#endif
 
+environment_t create_env_from_cfg(environment_t &orig, EnvConfig &cfg, EnvParams &params, std::vector<std::string> *created_paths) {
+    TRACE_SCOPE("create_env_from_cfg");
+    namespace fs = std::filesystem;
+    environment_t env;
 
-    for (LPTCH i = env_block.get(); *i != '\0'; ++i) {
-        std::basic_stringstream<TCHAR> key_ss;
-        std::basic_stringstream<TCHAR> value_ss;
+    auto fill_params = [&params](const std::string &v) {
+        return fmt::format(fmt::runtime(v), 
+            fmt::arg("root", params.root),
+            fmt::arg("username", params.username));
+    };
 
-        for (; *i != '='; ++i) {
-            key_ss << *i;
+    auto create_directory = [created_paths](const std::string &s_in) {
+        TRACE_SCOPE("create_directory");
+        try {
+            fs::create_directories(fs::path(s_in));
+            if (created_paths != nullptr) {
+                created_paths->push_back(s_in);
+            }
+        } catch (std::exception &ex) {
+            spdlog::warn(fmt::format("Failed to create directory ({}): ({})", s_in, ex.what()));
         }
-        ++i;
-        for (; *i != '\0'; ++i) {
-            value_ss << *i;
+    };
+
+    // directories
+    for (auto &[k,v]: cfg.env_directories) {
+        auto dir = fill_params(v);
+        // pass absolute directory to environment
+        env.insert({k, fs::absolute(dir).string() });
+        create_directory(dir);
+    }
+
+    for (auto &v: cfg.seed_directories) {
+        auto dir = fill_params(v);
+        create_directory(dir);
+    }
+
+    // variables
+    for (auto &[k,v]: cfg.override_variables) {
+        env.insert({k, fill_params(v)});
+    }
+
+    for (auto &k: cfg.pass_through_variables) {
+        if (!orig.contains(k)) {
+            continue;
         }
-        env[key_ss.str()] = value_ss.str();
+        auto &v = orig.at(k);
+        env.insert({k, fill_params(v)});
+    }
+
+    if (params.redirect_paths) {
+#ifdef __linux__
+        add_path_redirect(env, orig, params, created_paths);
+#else
+        spdlog::warn(fmt::format("Path redirection isn't supported on this platform ({})", params.root));
+#endif
     }
 
     return env;
 }
 
-tstring create_env_string(environment_t &env) {
-    std::basic_stringstream<TCHAR> ss;
-    for (auto &[key, value]: env) {
-        ss << key << (TCHAR)('=') << value << (TCHAR)('\0');
-    }
-    ss << (TCHAR)('\0');
-    return ss.str();
 }
-
-}
\ No newline at end of file
@@ -1,16 +1,31 @@
 #pragma once
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 namespace app {
 
-#define WIN32_LEAN_AND_MEAN
-#include <tchar.h>
-
-typedef std::basic_string<TCHAR> tstring; // Generally convenient
+// environment blocks are always narrow, they are passed to CreateProcessA on windows
+typedef std::string tstring;
 typedef std::unordered_map<tstring, tstring> environment_t;
 
+struct EnvConfig;
+
+// parameters determined by the app config which are substituted into the environment config
+struct EnvParams {
+    std::string root;
+    std::string username;
+    // preload the path redirect shim with a table compiled from the environment directories, linux only
+    bool redirect_paths = false;
+};
+
 environment_t get_env();
 tstring create_env_string(environment_t &env);
+// helper function for initialising an environment for a process
+// inherits from parent environment with changes determined by
+// 1. EnvConfig: environment configuration file (reuseable - i.e. default_env.json)
+// 2. EnvParams: determinied by app config      (specialized - apps.json)
+// the directories and files it creates are added to created_paths if given
+environment_t create_env_from_cfg(environment_t &orig, EnvConfig &cfg, EnvParams &params, std::vector<std::string> *created_paths=nullptr);
 
 }
\ No newline at end of file
@@ -0,0 +1,521 @@
+#include "fork_server.h"
+
+#include <string.h>
+#include <stdexcept>
+
+#include <fmt/core.h>
+#include <spdlog/spdlog.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/prctl.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char **environ;
+
+namespace app {
+
+enum class MessageType: uint32_t {
+    ADD_ENVIRONMENT,    // client -> server, no reply
+    SPAWN,              // client -> server
+    SPAWN_RESULT,       // server -> client, carries the process's file descriptors
+    EXITED,             // server -> client, sent when a child is reaped
+};
+
+struct MessageHeader {
+    MessageType type;
+    int32_t pid;
+    uint64_t request_id;
+    uint64_t env_id;
+    int32_t error;
+    int32_t status;
+};
+
+// a spawn result carries stdin, stdout, stderr and the pidfd
+constexpr size_t MAX_MESSAGE_FDS = 4;
+
+// payloads are a list of null terminated strings
+static void append_string(std::vector<char> &payload, const std::string &str) {
+    payload.insert(payload.end(), str.begin(), str.end());
+    payload.push_back('\0');
+}
+
+static std::vector<const char *> split_strings(const char *data, const size_t size) {
+    std::vector<const char *> strings;
+    size_t start = 0;
+    for (size_t i = 0; i < size; i++) {
+        if (data[i] == '\0') {
+            strings.push_back(&data[start]);
+            start = i+1;
+        }
+    }
+    return strings;
+}
+
+static bool send_message(
+    const int socket, const MessageHeader &header, const std::vector<char> &payload,
+    const int *fds=nullptr, const size_t total_fds=0)
+{
+    iovec iov[2];
+    iov[0].iov_base = const_cast<MessageHeader *>(&header);
+    iov[0].iov_len = sizeof(header);
+    iov[1].iov_base = const_cast<char *>(payload.data());
+    iov[1].iov_len = payload.size();
+
+    msghdr msg = {};
+    msg.msg_iov = iov;
+    msg.msg_iovlen = payload.empty() ? 1 : 2;
+
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int) * MAX_MESSAGE_FDS)];
+    if (total_fds > 0) {
+        msg.msg_control = control;
+        msg.msg_controllen = CMSG_SPACE(sizeof(int) * total_fds);
+        auto *cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int) * total_fds);
+        memcpy(CMSG_DATA(cmsg), fds, sizeof(int) * total_fds);
+    }
+
+    while (true) {
+        const ssize_t total_sent = sendmsg(socket, &msg, MSG_NOSIGNAL);
+        if ((total_sent < 0) && (errno == EINTR)) {
+            continue;
+        }
+        return total_sent == ssize_t(sizeof(header) + payload.size());
+    }
+}
+
+// returns the message size including the header, 0 if the other end closed and -1 on error
+static ssize_t receive_message(
+    const int socket, MessageHeader &header, std::vector<char> &payload,
+    int *fds, size_t &total_fds)
+{
+    iovec iov[2];
+    iov[0].iov_base = &header;
+    iov[0].iov_len = sizeof(header);
+    iov[1].iov_base = payload.data();
+    iov[1].iov_len = payload.size();
+
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int) * MAX_MESSAGE_FDS)];
+    msghdr msg = {};
+    msg.msg_iov = iov;
+    msg.msg_iovlen = 2;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    ssize_t total_read = 0;
+    do {
+        total_read = recvmsg(socket, &msg, MSG_CMSG_CLOEXEC);
+    } while ((total_read < 0) && (errno == EINTR));
+    if (total_read <= 0) {
+        return total_read;
+    }
+
+    total_fds = 0;
+    for (auto *cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if ((cmsg->cmsg_level != SOL_SOCKET) || (cmsg->cmsg_type != SCM_RIGHTS)) {
+            continue;
+        }
+        const size_t total = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        memcpy(&fds[total_fds], CMSG_DATA(cmsg), sizeof(int) * total);
+        total_fds += total;
+    }
+
+    if ((msg.msg_flags & (MSG_TRUNC | MSG_CTRUNC)) || (size_t(total_read) < sizeof(header))) {
+        for (size_t i = 0; i < total_fds; i++) {
+            close(fds[i]);
+        }
+        total_fds = 0;
+        errno = EMSGSIZE;
+        return -1;
+    }
+    return total_read;
+}
+
+// server side
+struct ServerEnvironment {
+    std::vector<char> data;
+    std::vector<char *> envp;
+};
+
+static void reap_children(const int socket) {
+    int status = 0;
+    pid_t pid;
+    while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+        MessageHeader header = {};
+        header.type = MessageType::EXITED;
+        header.pid = pid;
+        header.status = status;
+        send_message(socket, header, {});
+    }
+}
+
+static void spawn_child(
+    const int socket, const MessageHeader &request, const char *payload, const size_t payload_size,
+    std::unordered_map<uint64_t, ServerEnvironment> &environments)
+{
+    MessageHeader reply = {};
+    reply.type = MessageType::SPAWN_RESULT;
+    reply.request_id = request.request_id;
+
+    auto strings = split_strings(payload, payload_size);
+    char **envp = environ;
+    if (request.env_id != 0) {
+        auto it = environments.find(request.env_id);
+        envp = (it != environments.end()) ? it->second.envp.data() : nullptr;
+    }
+    if ((strings.size() < 2) || (envp == nullptr)) {
+        reply.error = EINVAL;
+        send_message(socket, reply, {});
+        return;
+    }
+    const char *exec_path = strings[0];
+    const char *cwd = strings[1];
+    std::vector<char *> argv;
+    argv.push_back(const_cast<char *>(exec_path));
+    for (size_t i = 2; i < strings.size(); i++) {
+        argv.push_back(const_cast<char *>(strings[i]));
+    }
+    argv.push_back(nullptr);
+
+    // [read, write] for stdin, stdout, stderr
+    int pipes[3][2] = {{-1,-1}, {-1,-1}, {-1,-1}};
+    auto close_pipes = [&pipes]() {
+        for (auto &fds: pipes) {
+            for (int &fd: fds) {
+                if (fd >= 0) close(fd);
+                fd = -1;
+            }
+        }
+    };
+    for (auto &fds: pipes) {
+        if (pipe2(fds, O_CLOEXEC) != 0) {
+            reply.error = errno;
+            close_pipes();
+            send_message(socket, reply, {});
+            return;
+        }
+    }
+
+    posix_spawn_file_actions_t file_actions;
+    posix_spawn_file_actions_init(&file_actions);
+    posix_spawn_file_actions_adddup2(&file_actions, pipes[0][0], STDIN_FILENO);
+    posix_spawn_file_actions_adddup2(&file_actions, pipes[1][1], STDOUT_FILENO);
+    posix_spawn_file_actions_adddup2(&file_actions, pipes[2][1], STDERR_FILENO);
+    if (cwd[0] != '\0') {
+        posix_spawn_file_actions_addchdir_np(&file_actions, cwd);
+    }
+
+    // undo the signal mask the server uses for its signalfd
+    posix_spawnattr_t attr;
+    posix_spawnattr_init(&attr);
+    sigset_t empty_mask;
+    sigemptyset(&empty_mask);
+    sigset_t default_signals;
+    sigemptyset(&default_signals);
+    sigaddset(&default_signals, SIGCHLD);
+    sigaddset(&default_signals, SIGPIPE);
+    posix_spawnattr_setsigmask(&attr, &empty_mask);
+    posix_spawnattr_setsigdefault(&attr, &default_signals);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF);
+
+    pid_t pid = -1;
+    reply.error = posix_spawn(&pid, exec_path, &file_actions, &attr, argv.data(), envp);
+    posix_spawn_file_actions_destroy(&file_actions);
+    posix_spawnattr_destroy(&attr);
+
+    // the child's ends are only needed by the child
+    close(pipes[0][0]); pipes[0][0] = -1;
+    close(pipes[1][1]); pipes[1][1] = -1;
+    close(pipes[2][1]); pipes[2][1] = -1;
+
+    if (reply.error != 0) {
+        close_pipes();
+        send_message(socket, reply, {});
+        return;
+    }
+
+    // the child can't be reaped before this since we only reap between requests
+    reply.pid = pid;
+    const int pidfd = int(syscall(SYS_pidfd_open, pid, 0));
+    int fds[MAX_MESSAGE_FDS] = { pipes[0][1], pipes[1][0], pipes[2][0], pidfd };
+    const size_t total_fds = (pidfd >= 0) ? 4 : 3;
+    send_message(socket, reply, {}, fds, total_fds);
+    close_pipes();
+    if (pidfd >= 0) {
+        close(pidfd);
+    }
+}
+
+[[noreturn]] static void run_server(const int socket) {
+    prctl(PR_SET_NAME, "fork server");
+    // exit with the app even if it doesn't get to close the socket
+    prctl(PR_SET_PDEATHSIG, SIGKILL);
+
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &mask, nullptr);
+    const int signal_fd = signalfd(-1, &mask, SFD_CLOEXEC | SFD_NONBLOCK);
+
+    std::unordered_map<uint64_t, ServerEnvironment> environments;
+    std::vector<char> payload(ForkServer::MAX_MESSAGE_SIZE);
+    pollfd poll_fds[2] = {
+        { socket, POLLIN, 0 },
+        { signal_fd, POLLIN, 0 },
+    };
+
+    while (true) {
+        if (poll(poll_fds, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        if (poll_fds[1].revents & POLLIN) {
+            signalfd_siginfo info;
+            while (read(signal_fd, &info, sizeof(info)) == sizeof(info)) {}
+            reap_children(socket);
+        }
+        if (poll_fds[0].revents == 0) {
+            continue;
+        }
+
+        MessageHeader header;
+        int fds[MAX_MESSAGE_FDS];
+        size_t total_fds = 0;
+        const ssize_t total_read = receive_message(socket, header, payload, fds, total_fds);
+        if ((total_read < 0) && (errno == EMSGSIZE)) {
+            continue;
+        }
+        // the app closed its end
+        if (total_read <= 0) {
+            break;
+        }
+        const size_t payload_size = size_t(total_read) - sizeof(header);
+        for (size_t i = 0; i < total_fds; i++) {
+            close(fds[i]);
+        }
+
+        switch (header.type) {
+        case MessageType::ADD_ENVIRONMENT:
+        {
+            auto &env = environments[header.env_id];
+            env.data.assign(payload.begin(), payload.begin() + ptrdiff_t(payload_size));
+            env.envp.clear();
+            for (auto *entry: split_strings(env.data.data(), env.data.size())) {
+                env.envp.push_back(const_cast<char *>(entry));
+            }
+            env.envp.push_back(nullptr);
+            break;
+        }
+        case MessageType::SPAWN:
+            spawn_child(socket, header, payload.data(), payload_size, environments);
+            break;
+        default:
+            break;
+        }
+    }
+    _exit(0);
+}
+
+// client side
+ForkServer::ForkServer() {
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, fds) != 0) {
+        throw std::runtime_error(fmt::format("Failed to create fork server socket: {}", strerror(errno)));
+    }
+    const pid_t pid = fork();
+    if (pid < 0) {
+        const int err = errno;
+        close(fds[0]);
+        close(fds[1]);
+        throw std::runtime_error(fmt::format("Failed to fork the fork server: {}", strerror(err)));
+    }
+    if (pid == 0) {
+        // anything else the app had open doesn't belong in the server or its children
+        const int socket = fds[1];
+        close(fds[0]);
+        if (socket > STDERR_FILENO+1) {
+            close_range(STDERR_FILENO+1, unsigned(socket-1), 0);
+        }
+        close_range(unsigned(socket+1), ~0U, 0);
+        run_server(socket);
+    }
+    close(fds[1]);
+    m_socket = fds[0];
+    m_server_pid = pid;
+    m_reader_thread = std::thread([this]() { ReaderThread(); });
+}
+
+ForkServer::~ForkServer() {
+    {
+        auto lock = std::scoped_lock(m_mutex);
+        m_is_running = false;
+    }
+    // the server exits once it sees its end close
+    shutdown(m_socket, SHUT_RDWR);
+    m_reader_thread.join();
+    close(m_socket);
+    waitpid(m_server_pid, nullptr, 0);
+
+    for (auto &[id, result]: m_spawn_results) {
+        auto &p = result.process;
+        for (int fd: { p.pidfd, p.stdin_fd, p.stdout_fd, p.stderr_fd }) {
+            if (fd >= 0) close(fd);
+        }
+    }
+}
+
+uint64_t ForkServer::FindEnvironment(const std::string &key) {
+    auto lock = std::scoped_lock(m_mutex);
+    auto it = m_environments.find(key);
+    return (it != m_environments.end()) ? it->second : 0;
+}
+
+uint64_t ForkServer::AddEnvironment(const std::string &key, const std::vector<std::string> &env) {
+    std::vector<char> payload;
+    for (auto &entry: env) {
+        append_string(payload, entry);
+    }
+    if (payload.size() > MAX_MESSAGE_SIZE) {
+        throw std::runtime_error(fmt::format("Environment is too large for the fork server ({} bytes)", payload.size()));
+    }
+
+    auto lock = std::scoped_lock(m_mutex);
+    MessageHeader header = {};
+    header.type = MessageType::ADD_ENVIRONMENT;
+    header.env_id = m_next_env_id++;
+    if (!send_message(m_socket, header, payload)) {
+        throw std::runtime_error(fmt::format("Failed to send environment to the fork server: {}", strerror(errno)));
+    }
+    m_environments[key] = header.env_id;
+    return header.env_id;
+}
+
+SpawnedProcess ForkServer::Spawn(const SpawnRequest &request) {
+    std::vector<char> payload;
+    append_string(payload, request.exec_path);
+    append_string(payload, request.cwd);
+    for (auto &arg: request.args) {
+        append_string(payload, arg);
+    }
+    if (payload.size() > MAX_MESSAGE_SIZE) {
+        throw std::runtime_error(fmt::format("Arguments are too large for the fork server ({} bytes)", payload.size()));
+    }
+
+    MessageHeader header = {};
+    header.type = MessageType::SPAWN;
+    header.env_id = request.env_id;
+    {
+        auto lock = std::scoped_lock(m_mutex);
+        header.request_id = m_next_request_id++;
+    }
+    // each message on a seqpacket socket is sent whole so this doesn't need the lock
+    if (!send_message(m_socket, header, payload)) {
+        throw std::runtime_error(fmt::format("Failed to send spawn request to the fork server: {}", strerror(errno)));
+    }
+
+    auto lock = std::unique_lock(m_mutex);
+    m_cv.wait(lock, [this, &header]() { return !m_is_running || m_spawn_results.contains(header.request_id); });
+    auto it = m_spawn_results.find(header.request_id);
+    if (it == m_spawn_results.end()) {
+        throw std::runtime_error("Fork server stopped");
+    }
+    auto result = it->second;
+    m_spawn_results.erase(it);
+    if (result.error != 0) {
+        throw std::runtime_error(fmt::format("Failed to spawn ({}): {}", request.exec_path, strerror(result.error)));
+    }
+    return result.process;
+}
+
+std::optional<int> ForkServer::TakeExitStatus(const pid_t pid) {
+    auto lock = std::scoped_lock(m_mutex);
+    auto it = m_exit_statuses.find(pid);
+    if (it == m_exit_statuses.end()) {
+        return std::nullopt;
+    }
+    const int status = it->second;
+    m_exit_statuses.erase(it);
+    return status;
+}
+
+int ForkServer::WaitExitStatus(const pid_t pid) {
+    auto lock = std::unique_lock(m_mutex);
+    m_cv.wait(lock, [this, pid]() { return !m_is_running || m_exit_statuses.contains(pid); });
+    auto it = m_exit_statuses.find(pid);
+    if (it == m_exit_statuses.end()) {
+        return -1;
+    }
+    const int status = it->second;
+    m_exit_statuses.erase(it);
+    return status;
+}
+
+void ForkServer::ForgetExitStatus(const pid_t pid) {
+    auto lock = std::scoped_lock(m_mutex);
+    if (m_exit_statuses.erase(pid) == 0) {
+        m_forgotten_pids.insert(pid);
+    }
+}
+
+void ForkServer::ReaderThread() {
+    std::vector<char> payload(MAX_MESSAGE_SIZE);
+    while (true) {
+        MessageHeader header;
+        int fds[MAX_MESSAGE_FDS];
+        size_t total_fds = 0;
+        const ssize_t total_read = receive_message(m_socket, header, payload, fds, total_fds);
+        if ((total_read < 0) && (errno == EMSGSIZE)) {
+            continue;
+        }
+        if (total_read <= 0) {
+            break;
+        }
+
+        auto lock = std::scoped_lock(m_mutex);
+        if (header.type == MessageType::SPAWN_RESULT) {
+            SpawnResult result;
+            result.error = header.error;
+            if ((header.error == 0) && (total_fds >= 3)) {
+                result.process.pid = header.pid;
+                result.process.stdin_fd = fds[0];
+                result.process.stdout_fd = fds[1];
+                result.process.stderr_fd = fds[2];
+                result.process.pidfd = (total_fds >= 4) ? fds[3] : -1;
+            } else {
+                for (size_t i = 0; i < total_fds; i++) {
+                    close(fds[i]);
+                }
+                result.error = (header.error != 0) ? header.error : EPROTO;
+            }
+            m_spawn_results[header.request_id] = result;
+        } else if (header.type == MessageType::EXITED) {
+            // the pid can only be reused after this so it is never confused with a later process
+            if (m_forgotten_pids.erase(header.pid) == 0) {
+                m_exit_statuses[header.pid] = header.status;
+            }
+        } else {
+            for (size_t i = 0; i < total_fds; i++) {
+                close(fds[i]);
+            }
+        }
+        m_cv.notify_all();
+    }
+
+    auto lock = std::scoped_lock(m_mutex);
+    if (m_is_running) {
+        spdlog::warn("Fork server stopped");
+    }
+    m_is_running = false;
+    m_cv.notify_all();
+}
+
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <stdint.h>
+#include <condition_variable>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <sys/types.h>
+
+namespace app {
+
+// process spawned by the fork server, the caller owns the file descriptors
+struct SpawnedProcess {
+    pid_t pid = -1;
+    int pidfd = -1;         // becomes readable once the process exits
+    int stdin_fd = -1;
+    int stdout_fd = -1;
+    int stderr_fd = -1;
+};
+
+struct SpawnRequest {
+    uint64_t env_id = 0;
+    std::string exec_path;
+    std::string cwd;        // inherits the server's working directory if empty
+    std::vector<std::string> args;  // not including argv[0]
+};
+
+// helper process which is forked early and spawns every child on request
+// each compiled environment is sent to it once and reused by every later launch in that environment
+// so a repeated launch skips reading and validating the environment config and is a single request
+// children only inherit the server's file descriptors instead of everything the app has open
+// the server reaps its children and reports their exit status back, since we can poll a pidfd
+// for a process that isn't our child but can't wait on it
+class ForkServer
+{
+public:
+    static constexpr size_t MAX_MESSAGE_SIZE = 0x40000;
+private:
+    struct SpawnResult {
+        int error = 0;
+        SpawnedProcess process;
+    };
+    int m_socket = -1;
+    pid_t m_server_pid = -1;
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    uint64_t m_next_request_id = 1;
+    uint64_t m_next_env_id = 1;
+    std::unordered_map<std::string, uint64_t> m_environments;
+    std::unordered_map<uint64_t, SpawnResult> m_spawn_results;
+    // wait statuses of reaped processes until they are taken
+    std::unordered_map<pid_t, int> m_exit_statuses;
+    // processes nobody will take the status of, it is dropped when they are reaped
+    std::unordered_set<pid_t> m_forgotten_pids;
+    bool m_is_running = true;
+    std::thread m_reader_thread;
+public:
+    // forks the server, throws if it couldn't be started
+    // create this before starting other threads so the server doesn't inherit their locks
+    ForkServer();
+    ~ForkServer();
+    // returns 0 if the environment hasn't been sent yet
+    // the key should change with the environment config, e.g. include its path and modification time
+    uint64_t FindEnvironment(const std::string &key);
+    // env is a list of "KEY=VALUE" entries
+    uint64_t AddEnvironment(const std::string &key, const std::vector<std::string> &env);
+    // throws if the server couldn't spawn the process
+    SpawnedProcess Spawn(const SpawnRequest &request);
+    // returns the wait status once the server has reaped the process
+    std::optional<int> TakeExitStatus(const pid_t pid);
+    int WaitExitStatus(const pid_t pid);
+    // called when the status of a process won't be taken, e.g. it was left running when its owner went away
+    void ForgetExitStatus(const pid_t pid);
+    ForkServer(const ForkServer &) = delete;
+    ForkServer& operator=(const ForkServer &) = delete;
+private:
+    void ReaderThread();
+};
+
+}
@@ -0,0 +1,83 @@
+#include "frame_profiler.h"
+
+#include <string.h>
+#include <algorithm>
+
+namespace app {
+
+FrameProfiler &FrameProfiler::Get() {
+    static FrameProfiler profiler;
+    return profiler;
+}
+
+void FrameProfiler::SetIsEnabled(const bool is_enabled) {
+    if (is_enabled && !m_is_enabled) {
+        Reset();
+    }
+    m_is_enabled = is_enabled;
+}
+
+int FrameProfiler::RegisterSection(const char *name) {
+    for (size_t i = 0; i < m_total_sections; i++) {
+        if (strcmp(m_section_names[i], name) == 0) {
+            return int(i);
+        }
+    }
+
+    // share the last section if we run out of space instead of writing out of bounds
+    if (m_total_sections == MAX_SECTIONS) {
+        return int(MAX_SECTIONS-1);
+    }
+
+    m_section_names[m_total_sections] = name;
+    return int(m_total_sections++);
+}
+
+void FrameProfiler::BeginFrame() {
+    if (!m_is_enabled) {
+        return;
+    }
+    m_frame_start = clock::now();
+}
+
+void FrameProfiler::EndFrame() {
+    if (!m_is_enabled) {
+        return;
+    }
+
+    auto &frame = m_frames[m_curr_frame];
+    frame.frame_number = m_frame_number++;
+    frame.total_ms = std::chrono::duration<float, std::milli>(clock::now() - m_frame_start).count();
+
+    // keep the slowest frames with their breakdown
+    if ((m_total_worst_frames < TOTAL_WORST_FRAMES) ||
+        (frame.total_ms > m_worst_frames[m_total_worst_frames-1].total_ms))
+    {
+        if (m_total_worst_frames < TOTAL_WORST_FRAMES) {
+            m_total_worst_frames++;
+        }
+        m_worst_frames[m_total_worst_frames-1] = frame;
+        std::sort(
+            m_worst_frames.begin(), m_worst_frames.begin() + m_total_worst_frames,
+            [](const Frame &a, const Frame &b) { return a.total_ms > b.total_ms; });
+    }
+
+    m_curr_frame = (m_curr_frame + 1) % TOTAL_FRAMES;
+    m_total_frames = std::min(m_total_frames + 1, TOTAL_FRAMES);
+    m_frames[m_curr_frame] = Frame{};
+}
+
+void FrameProfiler::Reset() {
+    m_frames.fill(Frame{});
+    m_curr_frame = 0;
+    m_total_frames = 0;
+    m_total_worst_frames = 0;
+    m_frame_start = clock::now();
+}
+
+const FrameProfiler::Frame &FrameProfiler::GetFrame(const size_t index) const {
+    const size_t oldest = (m_curr_frame + TOTAL_FRAMES - m_total_frames) % TOTAL_FRAMES;
+    return m_frames[(oldest + index) % TOTAL_FRAMES];
+}
+
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <stdint.h>
+#include <array>
+#include <chrono>
+
+namespace app {
+
+// per frame profiler for the gui thread
+// named sections are timed with scoped timers and accumulated into a ring of recent frames
+// when disabled a scoped timer only checks a flag so it can be left in hot paths
+class FrameProfiler
+{
+public:
+    static constexpr size_t MAX_SECTIONS = 32;
+    static constexpr size_t TOTAL_FRAMES = 256;
+    static constexpr size_t TOTAL_WORST_FRAMES = 8;
+    using clock = std::chrono::steady_clock;
+
+    struct Frame {
+        uint64_t frame_number = 0;
+        float total_ms = 0.0f;
+        std::array<float, MAX_SECTIONS> section_ms = {0};
+    };
+private:
+    bool m_is_enabled = false;
+    std::array<const char *, MAX_SECTIONS> m_section_names = {0};
+    size_t m_total_sections = 0;
+    // ring of recent frames with the current frame being written to
+    std::array<Frame, TOTAL_FRAMES> m_frames;
+    size_t m_curr_frame = 0;
+    size_t m_total_frames = 0;
+    uint64_t m_frame_number = 0;
+    clock::time_point m_frame_start;
+    // slowest frames since the profiler was enabled, sorted from slowest
+    std::array<Frame, TOTAL_WORST_FRAMES> m_worst_frames;
+    size_t m_total_worst_frames = 0;
+public:
+    static FrameProfiler &Get();
+    inline bool IsEnabled() const { return m_is_enabled; }
+    void SetIsEnabled(const bool is_enabled);
+    // sections are registered once and identified by their index
+    int RegisterSection(const char *name);
+    inline void AddSectionTime(const int id, const clock::duration dt) {
+        m_frames[m_curr_frame].section_ms[id] += std::chrono::duration<float, std::milli>(dt).count();
+    }
+    void BeginFrame();
+    void EndFrame();
+    void Reset();
+
+    inline size_t GetTotalSections() const { return m_total_sections; }
+    inline const char *GetSectionName(const size_t id) const { return m_section_names[id]; }
+    // frames are indexed from oldest to newest completed frame
+    inline size_t GetTotalFrames() const { return m_total_frames; }
+    const Frame &GetFrame(const size_t index) const;
+    inline size_t GetTotalWorstFrames() const { return m_total_worst_frames; }
+    inline const Frame &GetWorstFrame(const size_t index) const { return m_worst_frames[index]; }
+};
+
+// accumulates the time spent in a scope into a profiler section
+class ScopedTimer
+{
+private:
+    const int m_id;
+    const bool m_is_enabled;
+    FrameProfiler::clock::time_point m_start;
+public:
+    ScopedTimer(const int id)
+    : m_id(id), m_is_enabled(FrameProfiler::Get().IsEnabled())
+    {
+        if (m_is_enabled) {
+            m_start = FrameProfiler::clock::now();
+        }
+    }
+    ~ScopedTimer() {
+        if (m_is_enabled) {
+            FrameProfiler::Get().AddSectionTime(m_id, FrameProfiler::clock::now() - m_start);
+        }
+    }
+    ScopedTimer(const ScopedTimer &) = delete;
+    ScopedTimer& operator=(const ScopedTimer &) = delete;
+};
+
+}
+
+#define PROFILE_CONCAT_IMPL(x, y) x##y
+#define PROFILE_CONCAT(x, y) PROFILE_CONCAT_IMPL(x, y)
+
+// time the rest of the enclosing scope under a named section
+#define PROFILE_SCOPE(name) \
+    static const int PROFILE_CONCAT(_profile_section_, __LINE__) = app::FrameProfiler::Get().RegisterSection(name); \
+    app::ScopedTimer PROFILE_CONCAT(_profile_timer_, __LINE__)(PROFILE_CONCAT(_profile_section_, __LINE__))
@@ -0,0 +1,486 @@
+#include "launch_scheduler.h"
+
+#include <algorithm>
+#include <functional>
+#include <unordered_map>
+#include <unordered_set>
+
+#include <fmt/core.h>
+#include <spdlog/spdlog.h>
+
+#include "tracing.h"
+
+namespace app {
+
+const char *launch_state_to_string(const LaunchRequest::State state) {
+    switch (state) {
+    case LaunchRequest::State::QUEUED:      return "queued";
+    case LaunchRequest::State::LAUNCHING:   return "launching";
+    case LaunchRequest::State::LAUNCHED:    return "launched";
+    case LaunchRequest::State::FAILED:      return "failed";
+    case LaunchRequest::State::CANCELLED:   return "cancelled";
+    default:                                return "unknown";
+    }
+}
+
+LaunchScheduler::LaunchScheduler()
+: m_next_start_time(clock::now())
+{}
+
+LaunchScheduler::~LaunchScheduler() {
+    Shutdown();
+}
+
+void LaunchScheduler::Shutdown() {
+    std::vector<std::thread> workers;
+    {
+        auto lock = std::scoped_lock(m_mutex);
+        m_is_running = false;
+        for (auto &request: m_requests) {
+            if (request->state == LaunchRequest::State::QUEUED) {
+                request->state = LaunchRequest::State::CANCELLED;
+                request->error = "Shutting down";
+            }
+        }
+        workers = std::move(m_workers);
+        m_workers.clear();
+    }
+    m_cv.notify_all();
+    for (auto &worker: workers) {
+        worker.join();
+    }
+}
+
+std::vector<uint64_t> LaunchScheduler::Enqueue(
+    const std::vector<AppConfig> &configs, const environment_t &parent_env,
+    const TerminalSize terminal_size, process_update_callback_t on_update,
+    process_exit_callback_t on_exit, launch_failure_callback_t on_failure)
+{
+    auto lock = std::unique_lock(m_mutex);
+
+    std::vector<std::shared_ptr<LaunchRequest>> batch;
+    for (auto &cfg: configs) {
+        auto request = std::make_shared<LaunchRequest>();
+        request->id = m_next_id++;
+        request->launch_id = Tracer::Get().CreateLaunchId();
+        request->enqueue_timestamp = Tracer::GetTimestamp();
+        request->config = cfg;
+        request->parent_env = parent_env;
+        request->terminal_size = terminal_size;
+        // launched processes wake up workers waiting on them
+        request->on_update = [this, on_update]() {
+            if (on_update) {
+                on_update();
+            }
+            Notify();
+        };
+        request->on_exit = on_exit;
+        request->on_failure = on_failure;
+        batch.push_back(std::move(request));
+    }
+
+    // dependencies on apps in the same batch take priority over earlier launches
+    for (auto &request: batch) {
+        for (auto &name: request->config.depends_on) {
+            auto it = std::find_if(batch.begin(), batch.end(), [&name](auto &other) { return other->config.name == name; });
+            auto dependency = (it != batch.end()) ? *it : FindRequestByName(name);
+            if (dependency == nullptr) {
+                request->state = LaunchRequest::State::FAILED;
+                request->error = fmt::format("Dependency ({}) hasn't been launched", name);
+                break;
+            }
+            if (dependency == request) {
+                request->state = LaunchRequest::State::FAILED;
+                request->error = "App depends on itself";
+                break;
+            }
+            request->dependencies.push_back(dependency->id);
+        }
+    }
+
+    // requests that depend on each other would wait forever
+    // only the batch can have cycles since earlier requests can't depend on new ones
+    {
+        enum class Mark { NONE, VISITING, DONE };
+        std::unordered_map<uint64_t, Mark> marks;
+        std::unordered_map<uint64_t, LaunchRequest*> batch_ids;
+        for (auto &request: batch) {
+            batch_ids[request->id] = request.get();
+        }
+        std::function<bool (LaunchRequest*)> has_cycle = [&](LaunchRequest *request) -> bool {
+            auto &mark = marks[request->id];
+            if (mark == Mark::VISITING) return true;
+            if (mark == Mark::DONE) return false;
+            mark = Mark::VISITING;
+            for (auto id: request->dependencies) {
+                auto it = batch_ids.find(id);
+                if ((it != batch_ids.end()) && has_cycle(it->second)) {
+                    return true;
+                }
+            }
+            marks[request->id] = Mark::DONE;
+            return false;
+        };
+        for (auto &request: batch) {
+            marks.clear();
+            if (has_cycle(request.get())) {
+                request->state = LaunchRequest::State::FAILED;
+                request->error = "Circular dependency";
+            }
+        }
+    }
+
+    std::vector<uint64_t> ids;
+    std::vector<std::shared_ptr<LaunchRequest>> failed;
+    for (auto &request: batch) {
+        if (!m_is_running && (request->state == LaunchRequest::State::QUEUED)) {
+            request->state = LaunchRequest::State::CANCELLED;
+            request->error = "Shutting down";
+        }
+        if (request->state == LaunchRequest::State::FAILED) {
+            m_errors.push_back(fmt::format("Failed to launch ({}): {}", request->config.name, request->error));
+            failed.push_back(request);
+        }
+        ids.push_back(request->id);
+        m_requests.push_back(std::move(request));
+    }
+
+    StartWorkers();
+    UpdateTotalWaiting();
+    PruneFinished();
+    m_cv.notify_all();
+    lock.unlock();
+    NotifyFailures(failed);
+    return ids;
+}
+
+void LaunchScheduler::Cancel(const uint64_t id) {
+    auto lock = std::scoped_lock(m_mutex);
+    auto request = FindRequest(id);
+    if ((request == nullptr) || (request->state != LaunchRequest::State::QUEUED)) {
+        return;
+    }
+    request->state = LaunchRequest::State::CANCELLED;
+    request->error = "Cancelled by user";
+    UpdateTotalWaiting();
+    // dependent requests get cancelled by the workers
+    m_cv.notify_all();
+}
+
+size_t LaunchScheduler::GetMaxConcurrent() {
+    auto lock = std::scoped_lock(m_mutex);
+    return m_max_concurrent;
+}
+
+void LaunchScheduler::SetMaxConcurrent(const size_t max_concurrent) {
+    auto lock = std::scoped_lock(m_mutex);
+    m_max_concurrent = std::clamp(max_concurrent, size_t(1), MAX_WORKERS);
+    StartWorkers();
+    m_cv.notify_all();
+}
+
+std::chrono::milliseconds LaunchScheduler::GetStaggerDelay() {
+    auto lock = std::scoped_lock(m_mutex);
+    return m_stagger_delay;
+}
+
+void LaunchScheduler::SetStaggerDelay(const std::chrono::milliseconds delay) {
+    auto lock = std::scoped_lock(m_mutex);
+    m_stagger_delay = std::max(delay, std::chrono::milliseconds(0));
+    m_next_start_time = std::min(m_next_start_time, clock::now() + m_stagger_delay);
+    m_cv.notify_all();
+}
+
+void LaunchScheduler::Notify() {
+    if (m_total_waiting == 0) {
+        return;
+    }
+    // take the lock so a worker can't miss this between checking dependencies and waiting
+    {
+        auto lock = std::scoped_lock(m_mutex);
+    }
+    m_cv.notify_all();
+}
+
+void LaunchScheduler::TakeResults(std::vector<std::unique_ptr<AppProcess>> &processes, std::vector<std::string> &errors) {
+    auto lock = std::scoped_lock(m_mutex);
+    for (auto &process: m_launched) {
+        processes.push_back(std::move(process));
+    }
+    m_launched.clear();
+    for (auto &error: m_errors) {
+        errors.push_back(std::move(error));
+    }
+    m_errors.clear();
+}
+
+std::vector<LaunchRequest> LaunchScheduler::GetRequests() {
+    auto lock = std::scoped_lock(m_mutex);
+    std::vector<LaunchRequest> requests;
+    requests.reserve(m_requests.size());
+    for (auto &request: m_requests) {
+        LaunchRequest copy;
+        copy.id = request->id;
+        copy.launch_id = request->launch_id;
+        copy.enqueue_timestamp = request->enqueue_timestamp;
+        copy.config = request->config;
+        copy.dependencies = request->dependencies;
+        copy.state = request->state;
+        copy.error = request->error;
+        copy.is_ready = request->is_ready;
+        copy.is_exited = request->is_exited;
+        copy.exit_code = request->exit_code;
+        requests.push_back(std::move(copy));
+    }
+    return requests;
+}
+
+void LaunchScheduler::StartWorkers() {
+    while (m_is_running && (m_workers.size() < m_max_concurrent)) {
+        m_workers.emplace_back([this]() { WorkerThread(); });
+    }
+}
+
+std::shared_ptr<LaunchRequest> LaunchScheduler::FindRequest(const uint64_t id) {
+    for (auto &request: m_requests) {
+        if (request->id == id) {
+            return request;
+        }
+    }
+    return nullptr;
+}
+
+std::shared_ptr<LaunchRequest> LaunchScheduler::FindRequestByName(const std::string &name) {
+    for (auto it = m_requests.rbegin(); it != m_requests.rend(); it++) {
+        auto &request = *it;
+        if (request->config.name != name) {
+            continue;
+        }
+        if ((request->state == LaunchRequest::State::FAILED) || (request->state == LaunchRequest::State::CANCELLED)) {
+            continue;
+        }
+        return request;
+    }
+    return nullptr;
+}
+
+LaunchScheduler::DependencyStatus LaunchScheduler::GetDependencyStatus(const LaunchRequest &request) {
+    auto status = DependencyStatus::READY;
+    for (auto id: request.dependencies) {
+        auto dependency = FindRequest(id);
+        if (dependency == nullptr) {
+            return DependencyStatus::FAILED;
+        }
+
+        switch (dependency->state) {
+        case LaunchRequest::State::QUEUED:
+        case LaunchRequest::State::LAUNCHING:
+            status = DependencyStatus::WAITING;
+            break;
+        case LaunchRequest::State::LAUNCHED:
+            // either printing the ready pattern or exiting successfully satisfies the dependency
+            if (dependency->is_ready) {
+                break;
+            }
+            if (!dependency->is_exited) {
+                status = DependencyStatus::WAITING;
+                break;
+            }
+            if (dependency->exit_code != 0) {
+                return DependencyStatus::FAILED;
+            }
+            break;
+        case LaunchRequest::State::FAILED:
+        case LaunchRequest::State::CANCELLED:
+        default:
+            return DependencyStatus::FAILED;
+        }
+    }
+    return status;
+}
+
+void LaunchScheduler::UpdateDependencyState(LaunchRequest &request, const AppProcess &process) {
+    request.is_ready = request.is_ready || process.IsReady();
+    if (process.GetState() == AppProcess::State::TERMINATED) {
+        request.is_exited = true;
+        request.exit_code = process.GetExitCode();
+    }
+}
+
+std::shared_ptr<LaunchRequest> LaunchScheduler::FindNextRequest(std::vector<std::shared_ptr<LaunchRequest>> &cancelled) {
+    // requests are started in the order they were queued once their dependencies are ready
+    for (auto &request: m_requests) {
+        if (request->state != LaunchRequest::State::QUEUED) {
+            continue;
+        }
+        const auto status = GetDependencyStatus(*request);
+        if (status == DependencyStatus::FAILED) {
+            request->state = LaunchRequest::State::CANCELLED;
+            request->error = "Dependency failed";
+            m_errors.push_back(fmt::format("Cancelled launch of ({}) since a dependency failed", request->config.name));
+            cancelled.push_back(request);
+            continue;
+        }
+        if (status == DependencyStatus::READY) {
+            return request;
+        }
+    }
+    return nullptr;
+}
+
+void LaunchScheduler::UpdateTotalWaiting() {
+    size_t total_waiting = 0;
+    for (auto &request: m_requests) {
+        if ((request->state == LaunchRequest::State::QUEUED) && !request->dependencies.empty()) {
+            total_waiting++;
+        }
+    }
+    m_total_waiting = total_waiting;
+}
+
+void LaunchScheduler::PruneFinished() {
+    // keep requests that queued requests still depend on
+    std::unordered_set<uint64_t> referenced_ids;
+    size_t total_finished = 0;
+    for (auto &request: m_requests) {
+        if ((request->state == LaunchRequest::State::QUEUED) || (request->state == LaunchRequest::State::LAUNCHING)) {
+            referenced_ids.insert(request->dependencies.begin(), request->dependencies.end());
+        } else {
+            total_finished++;
+        }
+    }
+
+    // and the newest launch of every app so later requests can still depend on it by name
+    std::unordered_set<std::string> resolved_names;
+    for (auto it = m_requests.rbegin(); it != m_requests.rend(); it++) {
+        auto &request = *it;
+        if ((request->state == LaunchRequest::State::FAILED) || (request->state == LaunchRequest::State::CANCELLED)) {
+            continue;
+        }
+        if (resolved_names.insert(request->config.name).second) {
+            referenced_ids.insert(request->id);
+        }
+    }
+
+    for (auto it = m_requests.begin(); (it != m_requests.end()) && (total_finished > MAX_FINISHED_REQUESTS);) {
+        auto &request = *it;
+        const bool is_finished = (request->state != LaunchRequest::State::QUEUED) && (request->state != LaunchRequest::State::LAUNCHING);
+        if (is_finished && !referenced_ids.contains(request->id)) {
+            it = m_requests.erase(it);
+            total_finished--;
+        } else {
+            it++;
+        }
+    }
+}
+
+void LaunchScheduler::WorkerThread() {
+    Tracer::Get().SetThreadName("launcher");
+    std::vector<std::shared_ptr<LaunchRequest>> cancelled;
+    auto lock = std::unique_lock(m_mutex);
+    while (m_is_running) {
+        if (m_total_launching >= m_max_concurrent) {
+            m_cv.wait(lock);
+            continue;
+        }
+
+        auto request = FindNextRequest(cancelled);
+        UpdateTotalWaiting();
+        if (!cancelled.empty()) {
+            lock.unlock();
+            NotifyFailures(cancelled);
+            cancelled.clear();
+            lock.lock();
+            continue;
+        }
+        if (request == nullptr) {
+            m_cv.wait(lock);
+            continue;
+        }
+
+        // space out process starts
+        const auto now = clock::now();
+        if (now < m_next_start_time) {
+            m_cv.wait_until(lock, m_next_start_time);
+            continue;
+        }
+
+        request->state = LaunchRequest::State::LAUNCHING;
+        m_total_launching++;
+        m_next_start_time = now + m_stagger_delay;
+        lock.unlock();
+
+        // the process reports back through its own callbacks, where it is sure to be alive
+        // its listener can call them before the constructor returns, so the update has to wait for the pointer
+        auto launched = std::make_shared<std::atomic<const AppProcess*>>(nullptr);
+        auto on_update = [this, request, launched]() {
+            const auto *process = launched->load();
+            if ((process != nullptr) && process->IsReady()) {
+                auto lock = std::scoped_lock(m_mutex);
+                request->is_ready = true;
+            }
+            request->on_update();
+        };
+        auto on_exit = [this, request](AppProcess &process) {
+            {
+                auto lock = std::scoped_lock(m_mutex);
+                UpdateDependencyState(*request, process);
+            }
+            m_cv.notify_all();
+            if (request->on_exit) {
+                request->on_exit(process);
+            }
+        };
+
+        std::unique_ptr<AppProcess> process;
+        std::string error;
+        {
+            auto trace_launch_scope = TraceLaunchScope(request->launch_id);
+            Tracer::Get().AddEvent("launch_queue_wait", request->enqueue_timestamp, Tracer::GetTimestamp());
+            TRACE_SCOPE("launch_app");
+            try {
+                process = std::make_unique<AppProcess>(
+                    request->config, request->parent_env,
+                    request->terminal_size, std::move(on_update), std::move(on_exit));
+            } catch (std::exception &ex) {
+                error = ex.what();
+            }
+        }
+
+        lock.lock();
+        m_total_launching--;
+        const bool is_failed = (process == nullptr);
+        if (!is_failed) {
+            request->state = LaunchRequest::State::LAUNCHED;
+            // catch up on anything reported before the pointer was set
+            UpdateDependencyState(*request, *process);
+            launched->store(process.get());
+            m_launched.push_back(std::move(process));
+        } else {
+            request->state = LaunchRequest::State::FAILED;
+            request->error = error;
+            m_errors.push_back(fmt::format("Failed to launch ({}): {}", request->config.name, error));
+        }
+        UpdateTotalWaiting();
+        PruneFinished();
+        m_cv.notify_all();
+
+        // wake up the gui so it can take the result
+        lock.unlock();
+        request->on_update();
+        if (is_failed) {
+            NotifyFailures({ request });
+        }
+        lock.lock();
+    }
+}
+
+void LaunchScheduler::NotifyFailures(const std::vector<std::shared_ptr<LaunchRequest>> &requests) {
+    for (auto &request: requests) {
+        if (request->on_failure) {
+            request->on_failure(request->error);
+        }
+    }
+}
+
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "app_schema.h"
+#include "app_process.h"
+#include "environ.h"
+
+namespace app {
+
+// called without the lock held if a request ends without launching its process
+typedef std::function<void (const std::string &error)> launch_failure_callback_t;
+
+// a queued launch and what happened to it
+struct LaunchRequest {
+    enum State { QUEUED, LAUNCHING, LAUNCHED, FAILED, CANCELLED };
+    uint64_t id;
+    uint64_t launch_id;     // for tracing
+    int64_t enqueue_timestamp;
+    AppConfig config;
+    environment_t parent_env;
+    TerminalSize terminal_size;
+    process_update_callback_t on_update;
+    process_exit_callback_t on_exit;
+    launch_failure_callback_t on_failure;
+    // requests which have to exit successfully or print their ready pattern first
+    std::vector<uint64_t> dependencies;
+    State state = QUEUED;
+    std::string error;
+    // what dependents need from the launched process, reported by its callbacks
+    // the process is owned by the app and can be destroyed while the request is still kept around
+    bool is_ready = false;
+    bool is_exited = false;
+    int64_t exit_code = 0;
+};
+
+const char *launch_state_to_string(const LaunchRequest::State state);
+
+// launches processes on worker threads so the gui never waits on environment setup
+// limits how many launches run at once and can space out process starts
+// dependencies are resolved by app name against the same batch or earlier launches
+class LaunchScheduler
+{
+public:
+    static constexpr size_t MAX_WORKERS = 8;
+    // finished requests kept around to show in the gui
+    // the newest launch of each app is kept past this so dependencies on it still resolve
+    static constexpr size_t MAX_FINISHED_REQUESTS = 64;
+    using clock = std::chrono::steady_clock;
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::vector<std::thread> m_workers;
+    std::list<std::shared_ptr<LaunchRequest>> m_requests;
+    // results waiting to be taken by the app
+    std::vector<std::unique_ptr<AppProcess>> m_launched;
+    std::vector<std::string> m_errors;
+    uint64_t m_next_id = 1;
+    size_t m_max_concurrent = 2;
+    std::chrono::milliseconds m_stagger_delay{0};
+    size_t m_total_launching = 0;
+    clock::time_point m_next_start_time;
+    bool m_is_running = true;
+    // skip waking workers on process output if nothing is waiting on a dependency
+    std::atomic<size_t> m_total_waiting{0};
+public:
+    LaunchScheduler();
+    ~LaunchScheduler();
+    // cancels queued requests and waits for the launches in progress, later requests are cancelled straight away
+    void Shutdown();
+    // returns immediately with the id of each request
+    std::vector<uint64_t> Enqueue(
+        const std::vector<AppConfig> &configs, const environment_t &parent_env,
+        const TerminalSize terminal_size, process_update_callback_t on_update,
+        process_exit_callback_t on_exit={}, launch_failure_callback_t on_failure={});
+    void Cancel(const uint64_t id);
+    size_t GetMaxConcurrent();
+    void SetMaxConcurrent(const size_t max_concurrent);
+    std::chrono::milliseconds GetStaggerDelay();
+    void SetStaggerDelay(const std::chrono::milliseconds delay);
+    // recheck dependencies, called when a launched process has new output or exits
+    void Notify();
+    // move launched processes and launch errors to the caller
+    void TakeResults(std::vector<std::unique_ptr<AppProcess>> &processes, std::vector<std::string> &errors);
+    // copy of the queue for display
+    std::vector<LaunchRequest> GetRequests();
+    LaunchScheduler(const LaunchScheduler &) = delete;
+    LaunchScheduler& operator=(const LaunchScheduler &) = delete;
+private:
+    enum class DependencyStatus { WAITING, READY, FAILED };
+    // all of these expect the lock to be held
+    void StartWorkers();
+    std::shared_ptr<LaunchRequest> FindRequest(const uint64_t id);
+    std::shared_ptr<LaunchRequest> FindRequestByName(const std::string &name);
+    DependencyStatus GetDependencyStatus(const LaunchRequest &request);
+    static void UpdateDependencyState(LaunchRequest &request, const AppProcess &process);
+    // requests cancelled because a dependency failed are added to cancelled
+    std::shared_ptr<LaunchRequest> FindNextRequest(std::vector<std::shared_ptr<LaunchRequest>> &cancelled);
+    void UpdateTotalWaiting();
+    void PruneFinished();
+    void WorkerThread();
+    // runs the failure callbacks, the lock can't be held since they may enqueue again
+    static void NotifyFailures(const std::vector<std::shared_ptr<LaunchRequest>> &requests);
+};
+
+}
@@ -0,0 +1,69 @@
+#include "log_ring_sink.h"
+
+#include <string.h>
+#include <algorithm>
+
+namespace app {
+
+LogRingSink::LogRingSink()
+: m_slots(std::make_unique<Slot[]>(MAX_ENTRIES)), m_total_written(0)
+{
+    for (size_t i = 0; i < MAX_ENTRIES; i++) {
+        m_slots[i].sequence = 0;
+    }
+    set_pattern("[%H:%M:%S.%e] %v");
+}
+
+void LogRingSink::sink_it_(const spdlog::details::log_msg &msg) {
+    spdlog::memory_buf_t formatted;
+    formatter_->format(msg, formatted);
+
+    const uint64_t index = m_total_written.load(std::memory_order_relaxed);
+    auto &slot = m_slots[index % MAX_ENTRIES];
+
+    slot.sequence.store(2*index + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    auto &entry = slot.entry;
+    entry.level = msg.level;
+    entry.time = msg.time;
+    // drop the trailing newline added by the formatter
+    size_t length = formatted.size();
+    while ((length > 0) && ((formatted[length-1] == '\n') || (formatted[length-1] == '\r'))) {
+        length--;
+    }
+    entry.length = std::min(length, LogEntry::MAX_TEXT_LENGTH);
+    memcpy(entry.text.data(), formatted.data(), entry.length);
+
+    slot.sequence.store(2*index + 2, std::memory_order_release);
+    m_total_written.store(index + 1, std::memory_order_release);
+}
+
+bool LogRingSink::ReadEntry(const uint64_t index, LogEntry &entry) const {
+    const auto &slot = m_slots[index % MAX_ENTRIES];
+    const uint64_t expected = 2*index + 2;
+    if (slot.sequence.load(std::memory_order_acquire) != expected) {
+        return false;
+    }
+
+    entry.level = slot.entry.level;
+    entry.time = slot.entry.time;
+    entry.length = std::min(slot.entry.length, LogEntry::MAX_TEXT_LENGTH);
+    memcpy(entry.text.data(), slot.entry.text.data(), entry.length);
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return slot.sequence.load(std::memory_order_relaxed) == expected;
+}
+
+bool LogRingSink::ReadLevel(const uint64_t index, spdlog::level::level_enum &level) const {
+    const auto &slot = m_slots[index % MAX_ENTRIES];
+    const uint64_t expected = 2*index + 2;
+    if (slot.sequence.load(std::memory_order_acquire) != expected) {
+        return false;
+    }
+    level = slot.entry.level;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return slot.sequence.load(std::memory_order_relaxed) == expected;
+}
+
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <array>
+#include <memory>
+
+#include <spdlog/sinks/base_sink.h>
+#include <spdlog/details/null_mutex.h>
+
+namespace app {
+
+// copy of a log entry read out of the ring
+struct LogEntry {
+    static constexpr size_t MAX_TEXT_LENGTH = 256;
+    spdlog::level::level_enum level;
+    spdlog::log_clock::time_point time;
+    size_t length;
+    std::array<char, MAX_TEXT_LENGTH> text;
+};
+
+// fixed size ring of formatted log messages which the gui reads directly
+// this is attached to an async logger so only its single worker thread writes to it
+// readers never block the writer, each slot has a sequence number so torn reads are detected
+class LogRingSink: public spdlog::sinks::base_sink<spdlog::details::null_mutex>
+{
+public:
+    static constexpr size_t MAX_ENTRIES = 2048;
+private:
+    struct Slot {
+        // odd while being written, 2*(index+1) once entry index has been written
+        std::atomic<uint64_t> sequence;
+        LogEntry entry;
+    };
+    std::unique_ptr<Slot[]> m_slots;
+    std::atomic<uint64_t> m_total_written;
+public:
+    LogRingSink();
+    inline uint64_t GetTotalWritten() const { return m_total_written; }
+    // the oldest index that is still in the ring
+    inline uint64_t GetOldestIndex() const {
+        const uint64_t total_written = m_total_written;
+        return (total_written > MAX_ENTRIES) ? (total_written - MAX_ENTRIES) : 0;
+    }
+    // returns false if the entry was overwritten or is still being written
+    bool ReadEntry(const uint64_t index, LogEntry &entry) const;
+    // peek at the level without copying the text
+    bool ReadLevel(const uint64_t index, spdlog::level::level_enum &level) const;
+protected:
+    void sink_it_(const spdlog::details::log_msg &msg) override;
+    void flush_() override {}
+};
+
+}
@@ -7,6 +7,7 @@
 #include "imgui_impl_glfw.h"
 #include "imgui_impl_opengl3.h"
 #include <stdio.h>
+#include <string.h>
 #if defined(IMGUI_IMPL_OPENGL_ES2)
 #include <GLES2/gl2.h>
 #endif
@@ -21,15 +22,24 @@
 
 #include <iostream>
 #include <filesystem>
+#include <atomic>
+#include <chrono>
+#include <thread>
 
 #include <fmt/format.h>
 #include <spdlog/spdlog.h>
+#include <spdlog/async.h>
 #include <spdlog/sinks/basic_file_sink.h>
 
 #include "app.h"
 #include "app_gui.h"
+#include "daemon_client.h"
+#include "daemon_protocol.h"
 #include "font_awesome_definitions.h"
+#include "frame_profiler.h"
 #include "imgui_config.h"
+#include "log_ring_sink.h"
+#include "tracing.h"
 
 #define WIN32_LEAN_AND_MEAN
 #define NOMINMAX
@@ -52,12 +62,85 @@ static void glfw_error_callback(int error, const char* description)
 }
 
 namespace fs = std::filesystem;
-static int run(const char *root_path);
+// connect_path is the daemon socket to attach to, empty if we own the processes ourselves
+static int run(const char *root_path, const std::string &connect_path);
+
+// logging
+static const size_t LOG_QUEUE_SIZE = 8192;
+static const int LOG_FLUSH_SECONDS = 1;
+static std::shared_ptr<app::LogRingSink> g_log_sink;
+
+// event driven rendering
+// we sleep until there is user input or a process has new output instead of rendering every vsync
+// imgui needs a few frames after an input to settle (popups opening, button releases)
+static const int TOTAL_FRAMES_AFTER_INPUT = 3;
+// refresh periodically while idle for things like the text cursor blinking
+static const double IDLE_REFRESH_SECONDS = 0.5;
+// frame rate cap when only process output is waking us up
+static const double STREAMING_FRAME_SECONDS = 1.0/30.0;
+
+static int g_frames_to_render = TOTAL_FRAMES_AFTER_INPUT;
+static std::atomic<bool> g_is_process_updated = false;
+
+static void on_input_event() {
+    g_frames_to_render = TOTAL_FRAMES_AFTER_INPUT;
+}
+
+// these are installed before imgui's callbacks which chain to them
+static void install_input_callbacks(GLFWwindow *window) {
+    glfwSetWindowFocusCallback(window, [](GLFWwindow*, int) { on_input_event(); });
+    glfwSetCursorEnterCallback(window, [](GLFWwindow*, int) { on_input_event(); });
+    glfwSetCursorPosCallback(window, [](GLFWwindow*, double, double) { on_input_event(); });
+    glfwSetMouseButtonCallback(window, [](GLFWwindow*, int, int, int) { on_input_event(); });
+    glfwSetScrollCallback(window, [](GLFWwindow*, double, double) { on_input_event(); });
+    glfwSetKeyCallback(window, [](GLFWwindow*, int, int, int, int) { on_input_event(); });
+    glfwSetCharCallback(window, [](GLFWwindow*, unsigned int) { on_input_event(); });
+    glfwSetWindowSizeCallback(window, [](GLFWwindow*, int, int) { on_input_event(); });
+    glfwSetWindowRefreshCallback(window, [](GLFWwindow*) { on_input_event(); });
+}
+
+// block until there is something new to render
+static void wait_for_events(GLFWwindow *window, double &last_frame_time) {
+    if (g_frames_to_render > 0) {
+        glfwPollEvents();
+        return;
+    }
+
+    // nothing is visible while minimised so only input can wake us up
+    if (glfwGetWindowAttrib(window, GLFW_ICONIFIED)) {
+        while (glfwGetWindowAttrib(window, GLFW_ICONIFIED) && !glfwWindowShouldClose(window)) {
+            glfwWaitEvents();
+        }
+        g_frames_to_render = TOTAL_FRAMES_AFTER_INPUT;
+        return;
+    }
+
+    glfwWaitEventsTimeout(IDLE_REFRESH_SECONDS);
+
+    // cap the frame rate if we only woke up because of process output
+    while ((g_frames_to_render == 0) && g_is_process_updated && !glfwWindowShouldClose(window)) {
+        const double remaining = (last_frame_time + STREAMING_FRAME_SECONDS) - glfwGetTime();
+        if (remaining <= 0.0) {
+            break;
+        }
+        glfwWaitEventsTimeout(remaining);
+    }
+}
 
 // Main code
 int main(int argc, char **argv) {
-    auto logger = spdlog::basic_logger_mt("root", "logs.txt");
+    // asynchronous logging so callers only enqueue a message
+    // a single worker thread writes to the log file and the ring buffer shown in the gui
+    spdlog::init_thread_pool(LOG_QUEUE_SIZE, 1);
+    auto file_sink = std::make_shared<spdlog::sinks::basic_file_sink_mt>("logs.txt");
+    g_log_sink = std::make_shared<app::LogRingSink>();
+    auto logger = std::make_shared<spdlog::async_logger>(
+        "root", spdlog::sinks_init_list{ file_sink, g_log_sink },
+        spdlog::thread_pool(), spdlog::async_overflow_policy::overrun_oldest);
     spdlog::set_default_logger(logger);
+    // file is flushed in the background instead of on every message
+    spdlog::flush_every(std::chrono::seconds(LOG_FLUSH_SECONDS));
+    logger->flush_on(spdlog::level::err);
 
     #if NDEBUG
     spdlog::set_level(spdlog::level::info);
@@ -70,18 +153,29 @@ int main(int argc, char **argv) {
     int rv = 1;
 
     try {
-        const char *root_path = (argc > 1) ? argv[1] : app::DEFAULT_APPS_FILEPATH;
-        rv = run(root_path);
+        // usage: main [apps.json] [--connect [socket]]
+        const char *root_path = app::DEFAULT_APPS_FILEPATH;
+        std::string connect_path;
+        for (int i = 1; i < argc; i++) {
+            if (strcmp(argv[i], "--connect") == 0) {
+                const bool has_path = ((i+1) < argc) && (strncmp(argv[i+1], "--", 2) != 0);
+                connect_path = has_path ? argv[++i] : app::get_default_daemon_socket_path();
+            } else {
+                root_path = argv[i];
+            }
+        }
+        rv = run(root_path, connect_path);
     } catch (std::exception &ex) {
         spdlog::critical(fmt::format("Exception in main: {}", ex.what()));
         rv = 1;
     }
 
     CoUninitialize();
+    spdlog::shutdown();
     return rv;
 }
 
-int run(const char *root_path)
+int run(const char *root_path, const std::string &connect_path)
 {
     // Setup window
     glfwSetErrorCallback(glfw_error_callback);
@@ -151,6 +245,7 @@ int run(const char *root_path)
     ImGuiSetupCustomConfig();
 
     // Setup Platform/Renderer backends
+    install_input_callbacks(window);
     ImGui_ImplGlfw_InitForOpenGL(window, true);
     ImGui_ImplOpenGL3_Init(glsl_version);
 
@@ -179,7 +274,23 @@ int run(const char *root_path)
 
     // our app
     ImVec4 clear_color = ImVec4(0.45f, 0.55f, 0.60f, 1.00f);
-    auto main_app = app::App(root_path);
+    app::Tracer::Get().SetThreadName("gui");
+    auto on_process_update = []() {
+        g_is_process_updated = true;
+        glfwPostEmptyEvent();
+    };
+    // as a client of a daemon we don't load or launch anything ourselves
+    std::unique_ptr<app::App> main_app;
+    std::unique_ptr<app::DaemonClient> daemon_client;
+    if (connect_path.empty()) {
+        main_app = std::make_unique<app::App>(root_path);
+        main_app->m_log_sink = g_log_sink;
+        main_app->m_on_process_update = on_process_update;
+    } else {
+        daemon_client = std::make_unique<app::DaemonClient>(connect_path, on_process_update);
+        spdlog::info(fmt::format("Connected to the daemon at {}", connect_path));
+    }
+    double last_frame_time = glfwGetTime();
 
     // Main loop
     while (!glfwWindowShouldClose(window))
@@ -189,23 +300,50 @@ int run(const char *root_path)
         // - When io.WantCaptureMouse is true, do not dispatch mouse input data to your main application.
         // - When io.WantCaptureKeyboard is true, do not dispatch keyboard input data to your main application.
         // Generally you may always pass all inputs to dear imgui, and hide them from your application based on those two flags.
-        glfwPollEvents();
+        {
+            PROFILE_SCOPE("main_wait_events");
+            wait_for_events(window, last_frame_time);
+        }
+        if (glfwWindowShouldClose(window)) {
+            break;
+        }
+        g_is_process_updated = false;
+        last_frame_time = glfwGetTime();
+        if (g_frames_to_render > 0) {
+            g_frames_to_render--;
+        }
+
+        auto &profiler = app::FrameProfiler::Get();
+        profiler.BeginFrame();
 
         // Start the Dear ImGui frame
-        ImGui_ImplOpenGL3_NewFrame();
-        ImGui_ImplGlfw_NewFrame();
-        ImGui::NewFrame();
+        {
+            PROFILE_SCOPE("main_new_frame");
+            ImGui_ImplOpenGL3_NewFrame();
+            ImGui_ImplGlfw_NewFrame();
+            ImGui::NewFrame();
+        }
 
-        app::gui::RenderApp(main_app, "Applications");
+        if (daemon_client != nullptr) {
+            app::gui::RenderDaemonClient(*daemon_client, "Applications");
+        } else {
+            app::gui::RenderApp(*main_app, "Applications");
+        }
 
         // Rendering
-        ImGui::Render();
-        int display_w, display_h;
-        glfwGetFramebufferSize(window, &display_w, &display_h);
-        glViewport(0, 0, display_w, display_h);
-        glClearColor(clear_color.x * clear_color.w, clear_color.y * clear_color.w, clear_color.z * clear_color.w, clear_color.w);
-        glClear(GL_COLOR_BUFFER_BIT);
-        ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+        {
+            PROFILE_SCOPE("main_imgui_render");
+            ImGui::Render();
+        }
+        {
+            PROFILE_SCOPE("main_gl_submit");
+            int display_w, display_h;
+            glfwGetFramebufferSize(window, &display_w, &display_h);
+            glViewport(0, 0, display_w, display_h);
+            glClearColor(clear_color.x * clear_color.w, clear_color.y * clear_color.w, clear_color.z * clear_color.w, clear_color.w);
+            glClear(GL_COLOR_BUFFER_BIT);
+            ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+        }
     	
         // Update and Render additional Platform Windows
         // (Platform functions may change the current OpenGL context, so we save/restore it to make it easier to paste this code elsewhere.
@@ -218,10 +356,18 @@ int run(const char *root_path)
             glfwMakeContextCurrent(backup_current_context);
         }
 
-        glfwSwapBuffers(window);
+        {
+            PROFILE_SCOPE("main_swap_buffers");
+            glfwSwapBuffers(window);
+        }
+        profiler.EndFrame();
     }
 
     // Cleanup
+    // the client's reader thread wakes up glfw when it disconnects
+    daemon_client.reset();
+    // so do the listener threads of our processes until the app has stopped them
+    main_app.reset();
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
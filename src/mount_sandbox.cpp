@@ -0,0 +1,248 @@
+#include "mount_sandbox.h"
+
+#include <string.h>
+#include <algorithm>
+#include <filesystem>
+#include <stdexcept>
+
+#include <fmt/core.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pwd.h>
+#include <sched.h>
+#include <sys/mount.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace app {
+
+namespace fs = std::filesystem;
+
+// home relative defaults from the xdg base directory specification
+struct XdgDirectory {
+    const char *key;
+    const char *home_relative_path;
+};
+
+static const XdgDirectory XDG_DIRECTORIES[] = {
+    { "XDG_CONFIG_HOME",    ".config" },
+    { "XDG_DATA_HOME",      ".local/share" },
+    { "XDG_STATE_HOME",     ".local/state" },
+    { "XDG_CACHE_HOME",     ".cache" },
+};
+
+static std::string get_real_home(const std::unordered_map<std::string, std::string> &parent_env) {
+    auto it = parent_env.find("HOME");
+    if ((it != parent_env.end()) && !it->second.empty()) {
+        return it->second;
+    }
+    auto *pw = getpwuid(getuid());
+    if ((pw != nullptr) && (pw->pw_dir != nullptr)) {
+        return pw->pw_dir;
+    }
+    throw std::runtime_error("Failed to find the home directory of the current user");
+}
+
+std::vector<SandboxMount> get_sandbox_mounts(
+    const std::unordered_map<std::string, std::string> &sandbox_env,
+    const std::unordered_map<std::string, std::string> &parent_env)
+{
+    const auto real_home = fs::path(get_real_home(parent_env)).lexically_normal();
+    std::vector<SandboxMount> mounts;
+
+    auto add_mount = [&mounts](const std::string &source, const fs::path &target) {
+        const auto source_path = fs::path(source).lexically_normal();
+        if (source_path == target) {
+            return;
+        }
+        mounts.push_back({ source_path.string(), target.string() });
+    };
+
+    auto home_it = sandbox_env.find("HOME");
+    if (home_it != sandbox_env.end()) {
+        add_mount(home_it->second, real_home);
+    }
+
+    for (auto &xdg: XDG_DIRECTORIES) {
+        auto it = sandbox_env.find(xdg.key);
+        if (it == sandbox_env.end()) {
+            continue;
+        }
+        auto real_it = parent_env.find(xdg.key);
+        const bool is_real_set = (real_it != parent_env.end()) && fs::path(real_it->second).is_absolute();
+        const auto target = is_real_set ?
+            fs::path(real_it->second).lexically_normal() :
+            (real_home / xdg.home_relative_path);
+        // already covered by the home mount
+        if ((home_it != sandbox_env.end()) &&
+            (fs::path(it->second).lexically_normal() == (fs::path(home_it->second).lexically_normal() / xdg.home_relative_path)) &&
+            (target == (real_home / xdg.home_relative_path)))
+        {
+            continue;
+        }
+        add_mount(it->second, target);
+    }
+
+    // parents have to be mounted before their children
+    std::stable_sort(mounts.begin(), mounts.end(), [](const SandboxMount &a, const SandboxMount &b) {
+        return std::count(a.target.begin(), a.target.end(), '/') < std::count(b.target.begin(), b.target.end(), '/');
+    });
+    return mounts;
+}
+
+// the fd numbers are reserved up front so the paths to them can be built before forking
+static int open_directory(const std::string &path) {
+    const int fd = open(path.c_str(), O_PATH | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) {
+        throw std::runtime_error(fmt::format("Failed to open sandbox directory ({}): {}", path, strerror(errno)));
+    }
+    return fd;
+}
+
+MountSandbox::MountSandbox(const std::vector<SandboxMount> &mounts, const SandboxMode mode, const std::string &work_dir)
+: m_mode(mode)
+{
+    m_uid_map = fmt::format("{0} {0} 1\n", getuid());
+    m_gid_map = fmt::format("{0} {0} 1\n", getgid());
+
+    try {
+        OpenMounts(mounts, work_dir);
+    } catch (...) {
+        CloseMounts();
+        throw;
+    }
+}
+
+void MountSandbox::OpenMounts(const std::vector<SandboxMount> &mounts, const std::string &work_dir) {
+    for (size_t i = 0; i < mounts.size(); i++) {
+        auto &src = mounts[i];
+        auto &dst = m_mounts.emplace_back();
+        fs::create_directories(src.source);
+        OpenDirectory(dst.source, src.source);
+        dst.target = src.target;
+
+        // the target can be missing, in which case it is created inside an earlier mount
+        const auto target = fs::path(src.target);
+        fs::path parent;
+        for (auto &part: target) {
+            parent /= part;
+            if (parent != target.root_path()) {
+                dst.target_parents.push_back(parent.string());
+            }
+        }
+
+        // there is nothing to overlay if the real directory doesn't exist
+        if ((m_mode == SandboxMode::OVERLAY) && fs::is_directory(target)) {
+            const auto mount_work_dir = fs::path(work_dir) / fmt::format("{}", i);
+            fs::create_directories(mount_work_dir);
+            OpenDirectory(dst.lower, target.string());
+            OpenDirectory(dst.work, mount_work_dir.string());
+            // userxattr lets overlayfs keep its metadata without privileges
+            dst.overlay_options = fmt::format(
+                "lowerdir={},upperdir={},workdir={},userxattr",
+                dst.lower.fd_path, dst.source.fd_path, dst.work.fd_path);
+        }
+    }
+}
+
+void MountSandbox::OpenDirectory(Directory &dir, const std::string &path) {
+    dir.path = path;
+    dir.fd = open_directory(path);
+    dir.fd_path = fmt::format("/proc/self/fd/{}", dir.fd);
+}
+
+MountSandbox::~MountSandbox() {
+    CloseMounts();
+}
+
+void MountSandbox::CloseMounts() {
+    for (auto &mount: m_mounts) {
+        for (auto *dir: { &mount.source, &mount.lower, &mount.work }) {
+            if (dir->fd >= 0) {
+                close(dir->fd);
+            }
+        }
+    }
+    m_mounts.clear();
+}
+
+int MountSandbox::Fail(const char *step) noexcept {
+    const int err = errno;
+    m_failed_step = step;
+    return err;
+}
+
+static bool write_file(const char *path, const char *data, const size_t length) noexcept {
+    const int fd = open(path, O_WRONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    const bool is_written = write(fd, data, length) == ssize_t(length);
+    close(fd);
+    return is_written;
+}
+
+static bool write_file(const char *path, const std::string &data) noexcept {
+    return write_file(path, data.data(), data.size());
+}
+
+int MountSandbox::Enter() noexcept {
+    if (unshare(CLONE_NEWUSER | CLONE_NEWNS) != 0) {
+        return Fail("unshare");
+    }
+    // we keep our own uid and gid so created files are owned by the user outside the namespace
+    // setgroups has to be denied before an unprivileged process can write its gid map
+    // a constant rather than a string since nothing may allocate in the forked child of a multithreaded parent
+    static constexpr char SETGROUPS_DENY[] = "deny";
+    if (!write_file("/proc/self/setgroups", SETGROUPS_DENY, sizeof(SETGROUPS_DENY)-1) && (errno != ENOENT)) {
+        return Fail("setgroups");
+    }
+    if (!write_file("/proc/self/uid_map", m_uid_map)) {
+        return Fail("uid_map");
+    }
+    if (!write_file("/proc/self/gid_map", m_gid_map)) {
+        return Fail("gid_map");
+    }
+    // stop our mounts from propagating back to the parent namespace
+    if (mount(nullptr, "/", nullptr, MS_REC | MS_PRIVATE, nullptr) != 0) {
+        return Fail("make_private");
+    }
+
+    // mounts can only use directories from our own mount namespace
+    // so reopen them in place of the reserved fds before anything is mounted
+    for (auto &m: m_mounts) {
+        for (auto *dir: { &m.source, &m.lower, &m.work }) {
+            if (dir->fd < 0) {
+                continue;
+            }
+            const int fd = open(dir->path.c_str(), O_PATH | O_DIRECTORY | O_CLOEXEC);
+            if (fd < 0) {
+                return Fail("open_directory");
+            }
+            if (dup3(fd, dir->fd, O_CLOEXEC) < 0) {
+                return Fail("open_directory");
+            }
+            close(fd);
+        }
+    }
+
+    for (auto &m: m_mounts) {
+        // errors show up when mounting
+        for (auto &parent: m.target_parents) {
+            mkdir(parent.c_str(), 0755);
+        }
+        if (!m.overlay_options.empty()) {
+            if (mount("overlay", m.target.c_str(), "overlay", 0, m.overlay_options.c_str()) != 0) {
+                return Fail("mount_overlay");
+            }
+        } else {
+            if (mount(m.source.fd_path.c_str(), m.target.c_str(), nullptr, MS_BIND | MS_REC, nullptr) != 0) {
+                return Fail("mount_bind");
+            }
+        }
+    }
+    return 0;
+}
+
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "app_schema.h"
+
+namespace app {
+
+struct SandboxMount {
+    std::string source;     // directory in the environment root
+    std::string target;     // real directory the program would otherwise use
+};
+
+// map the home and xdg directories of an environment to the real locations they replace
+// programs which ignore the environment variables and hard code ~/.config still end up in the environment
+// both environments should have absolute paths, mounts are ordered so parents come before children
+std::vector<SandboxMount> get_sandbox_mounts(
+    const std::unordered_map<std::string, std::string> &sandbox_env,
+    const std::unordered_map<std::string, std::string> &parent_env);
+
+// unprivileged user and mount namespace which mounts environment directories over the real ones
+// everything that allocates is done up front so Enter() can run between fork and exec
+class MountSandbox
+{
+private:
+    // directory which is opened before mounting since its path can be hidden by an earlier mount
+    struct Directory {
+        std::string path;
+        int fd = -1;
+        std::string fd_path;
+    };
+    struct Mount {
+        Directory source;
+        Directory lower;    // only for overlays
+        Directory work;
+        std::string target;
+        // parents of the target which may need to be created after the previous mounts
+        std::vector<std::string> target_parents;
+        std::string overlay_options;
+    };
+    SandboxMode m_mode;
+    std::vector<Mount> m_mounts;
+    std::string m_uid_map;
+    std::string m_gid_map;
+    const char *m_failed_step = nullptr;
+public:
+    // work_dir is used by overlayfs and has to be on the same filesystem as the environment
+    MountSandbox(const std::vector<SandboxMount> &mounts, const SandboxMode mode, const std::string &work_dir);
+    ~MountSandbox();
+    // call in the child process, only makes system calls
+    // returns 0 or the errno of the step that failed
+    int Enter() noexcept;
+    inline const char *GetFailedStep() const { return m_failed_step; }
+    MountSandbox(const MountSandbox &) = delete;
+    MountSandbox& operator=(const MountSandbox &) = delete;
+private:
+    void OpenMounts(const std::vector<SandboxMount> &mounts, const std::string &work_dir);
+    void OpenDirectory(Directory &dir, const std::string &path);
+    void CloseMounts();
+    int Fail(const char *step) noexcept;
+};
+
+}
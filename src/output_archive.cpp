@@ -0,0 +1,404 @@
+#include "output_archive.h"
+
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <stdexcept>
+
+#include <lz4frame.h>
+#include <spdlog/spdlog.h>
+#include <fmt/core.h>
+
+namespace fs = std::filesystem;
+
+namespace app {
+
+// index entries are written as is, archives are only read back on the machine which wrote them
+static_assert(sizeof(OutputArchiveFrame) == 24);
+
+OutputArchive::OutputArchive(std::string filepath)
+: OutputArchive(std::move(filepath), false)
+{
+    m_file.open(m_filepath, std::ios::binary | std::ios::trunc);
+    if (!m_file.is_open()) {
+        throw std::runtime_error(fmt::format("Failed to create output archive ({})", m_filepath));
+    }
+    m_index_file.open(m_filepath + INDEX_EXTENSION, std::ios::binary | std::ios::trunc);
+    if (!m_index_file.is_open()) {
+        throw std::runtime_error(fmt::format("Failed to create output archive index ({}{})", m_filepath, INDEX_EXTENSION));
+    }
+    m_segment.reserve(SEGMENT_SIZE);
+}
+
+OutputArchive::OutputArchive(std::string filepath, const bool is_read_only)
+: m_filepath(std::move(filepath)), m_is_read_only(is_read_only),
+  m_segment_offset(0), m_next_segment_id(0),
+  m_next_write_id(0), m_file_size(0),
+  m_cached_frame_offset(0), m_is_cache_valid(false),
+  m_total_archived(0), m_total_compressed(0), m_total_pending(0), m_total_dropped(0), m_compress_ns(0)
+{
+}
+
+OutputArchive::~OutputArchive() {
+    m_file.close();
+    m_index_file.close();
+}
+
+std::shared_ptr<OutputArchive> OutputArchive::Open(std::string filepath) {
+    auto archive = std::shared_ptr<OutputArchive>(new OutputArchive(std::move(filepath), true));
+    archive->LoadIndex();
+    return archive;
+}
+
+void OutputArchive::LoadIndex() {
+    std::error_code ec;
+    const uint64_t file_size = uint64_t(fs::file_size(m_filepath, ec));
+    if (ec) {
+        throw std::runtime_error(fmt::format("Failed to open output archive ({}): {}", m_filepath, ec.message()));
+    }
+    auto index_file = std::ifstream(m_filepath + INDEX_EXTENSION, std::ios::binary);
+    if (!index_file.is_open()) {
+        throw std::runtime_error(fmt::format("Failed to open output archive index ({}{})", m_filepath, INDEX_EXTENSION));
+    }
+
+    // the writer may have been killed part way through a segment, so only keep whole entries which point into the file
+    OutputArchiveFrame frame;
+    uint64_t end_offset = 0;
+    while (index_file.read(reinterpret_cast<char *>(&frame), sizeof(frame))) {
+        const bool is_in_file = (frame.file_offset + frame.compressed_size) <= file_size;
+        const bool is_in_order = frame.offset >= end_offset;
+        if (!is_in_file || !is_in_order) {
+            spdlog::warn(fmt::format("Output archive index is truncated at offset {} ({})", frame.offset, m_filepath));
+            break;
+        }
+        m_frames.push_back(frame);
+        end_offset = frame.offset + frame.size;
+        m_total_archived += uint64_t(frame.size);
+    }
+    m_file_size = file_size;
+    m_total_compressed = file_size;
+}
+
+void OutputArchive::Append(const char *data, const size_t length) {
+    if (m_is_read_only) {
+        return;
+    }
+    m_total_archived += uint64_t(length);
+    size_t total_read = 0;
+    while (total_read < length) {
+        const size_t size = std::min(length - total_read, SEGMENT_SIZE - m_segment.size());
+        m_segment.insert(m_segment.end(), data + total_read, data + total_read + size);
+        total_read += size;
+        if (m_segment.size() == SEGMENT_SIZE) {
+            SubmitSegment();
+        }
+    }
+}
+
+void OutputArchive::Flush() {
+    if (!m_segment.empty()) {
+        SubmitSegment();
+    }
+}
+
+void OutputArchive::SubmitSegment() {
+    const uint64_t segment_id = m_next_segment_id++;
+    const uint64_t offset = m_segment_offset;
+    const size_t size = m_segment.size();
+    m_segment_offset += uint64_t(size);
+
+    auto data = std::vector<char>();
+    data.reserve(SEGMENT_SIZE);
+    std::swap(data, m_segment);
+
+    m_total_pending += uint64_t(size);
+    if (!CompressionPool::Get().Submit(shared_from_this(), segment_id, offset, std::move(data))) {
+        m_total_pending -= uint64_t(size);
+        m_total_dropped += uint64_t(size);
+        // the write order is moved past it by the next worker so we never block on disk io
+        auto lock = std::scoped_lock(m_dropped_mutex);
+        m_dropped_ids.push_back(segment_id);
+    }
+}
+
+void OutputArchive::CompressSegment(const uint64_t segment_id, const uint64_t offset, const std::vector<char> &data) {
+    const auto start = std::chrono::steady_clock::now();
+
+    LZ4F_preferences_t prefs;
+    memset(&prefs, 0, sizeof(prefs));
+    prefs.frameInfo.blockSizeID = LZ4F_max64KB;
+    prefs.frameInfo.contentChecksumFlag = LZ4F_contentChecksumEnabled;
+    prefs.compressionLevel = 0;
+
+    CompressedSegment segment;
+    segment.data.resize(((data.size() + FRAME_SIZE - 1) / FRAME_SIZE) * LZ4F_compressFrameBound(FRAME_SIZE, &prefs));
+
+    size_t total_compressed = 0;
+    for (size_t i = 0; i < data.size(); i += FRAME_SIZE) {
+        const size_t size = std::min(FRAME_SIZE, data.size() - i);
+        prefs.frameInfo.contentSize = size;
+        const size_t compressed_size = LZ4F_compressFrame(
+            segment.data.data() + total_compressed, segment.data.size() - total_compressed,
+            data.data() + i, size, &prefs);
+        if (LZ4F_isError(compressed_size)) {
+            spdlog::error(fmt::format("Failed to compress output archive frame ({}): {}",
+                m_filepath, LZ4F_getErrorName(compressed_size)));
+            break;
+        }
+
+        OutputArchiveFrame frame;
+        frame.offset = offset + uint64_t(i);
+        frame.file_offset = uint64_t(total_compressed);     // relative until the segment is written
+        frame.size = uint32_t(size);
+        frame.compressed_size = uint32_t(compressed_size);
+        segment.frames.push_back(frame);
+        total_compressed += compressed_size;
+    }
+    segment.data.resize(total_compressed);
+
+    const auto duration = std::chrono::steady_clock::now() - start;
+    m_compress_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+    m_total_pending -= uint64_t(data.size());
+    WriteSegment(segment_id, std::move(segment));
+}
+
+void OutputArchive::WriteSegment(const uint64_t segment_id, CompressedSegment segment) {
+    auto lock = std::scoped_lock(m_write_mutex);
+    m_completed_segments.insert({ segment_id, std::move(segment) });
+    // segments after a dropped one are always submitted after it was recorded, so nothing waits on it forever
+    {
+        auto dropped_lock = std::scoped_lock(m_dropped_mutex);
+        for (const auto id: m_dropped_ids) {
+            m_completed_segments.insert({ id, {} });
+        }
+        m_dropped_ids.clear();
+    }
+
+    while (true) {
+        auto it = m_completed_segments.find(m_next_write_id);
+        if (it == m_completed_segments.end()) {
+            break;
+        }
+        auto &completed = it->second;
+        if (!completed.data.empty()) {
+            m_file.write(completed.data.data(), std::streamsize(completed.data.size()));
+            for (auto frame: completed.frames) {
+                frame.file_offset += m_file_size;
+                m_frames.push_back(frame);
+                m_index_file.write(reinterpret_cast<const char *>(&frame), sizeof(frame));
+            }
+            m_file_size += uint64_t(completed.data.size());
+            m_total_compressed += uint64_t(completed.data.size());
+        }
+        m_completed_segments.erase(it);
+        m_next_write_id++;
+    }
+    // readers open the file separately so it needs to be on disk
+    // the index goes second so it never points past the end of the file
+    m_file.flush();
+    m_index_file.flush();
+}
+
+OutputArchiveStats OutputArchive::GetStats() const {
+    OutputArchiveStats stats;
+    stats.total_archived = m_total_archived;
+    stats.total_compressed = m_total_compressed;
+    stats.total_pending = m_total_pending;
+    stats.total_dropped = m_total_dropped;
+    stats.compress_seconds = double(m_compress_ns) * 1e-9;
+    return stats;
+}
+
+uint64_t OutputArchive::GetReadableBegin() {
+    auto lock = std::scoped_lock(m_write_mutex);
+    return m_frames.empty() ? 0 : m_frames.front().offset;
+}
+
+uint64_t OutputArchive::GetReadableEnd() {
+    auto lock = std::scoped_lock(m_write_mutex);
+    return m_frames.empty() ? 0 : (m_frames.back().offset + m_frames.back().size);
+}
+
+bool OutputArchive::FindFrame(const uint64_t offset, OutputArchiveFrame &frame) {
+    auto lock = std::scoped_lock(m_write_mutex);
+    // frames are written in order of their offset
+    auto it = std::upper_bound(
+        m_frames.begin(), m_frames.end(), offset,
+        [](const uint64_t offset, const OutputArchiveFrame &frame) { return offset < frame.offset; });
+    if (it != m_frames.begin()) {
+        const auto &prev_frame = *std::prev(it);
+        if (offset < (prev_frame.offset + prev_frame.size)) {
+            frame = prev_frame;
+            return true;
+        }
+    }
+    if (it == m_frames.end()) {
+        return false;
+    }
+    frame = *it;
+    return true;
+}
+
+// expects the read mutex to be held
+bool OutputArchive::DecodeFrame(const OutputArchiveFrame &frame) {
+    if (m_is_cache_valid && (m_cached_frame_offset == frame.offset)) {
+        return true;
+    }
+    m_is_cache_valid = false;
+
+    if (!m_read_file.is_open()) {
+        m_read_file.open(m_filepath, std::ios::binary);
+        if (!m_read_file.is_open()) {
+            return false;
+        }
+    }
+
+    auto compressed = std::vector<char>(frame.compressed_size);
+    m_read_file.clear();
+    m_read_file.seekg(std::streamoff(frame.file_offset));
+    m_read_file.read(compressed.data(), std::streamsize(compressed.size()));
+    if (m_read_file.gcount() != std::streamsize(compressed.size())) {
+        return false;
+    }
+
+    LZ4F_dctx *ctx = nullptr;
+    if (LZ4F_isError(LZ4F_createDecompressionContext(&ctx, LZ4F_VERSION))) {
+        return false;
+    }
+    m_cached_frame.resize(frame.size);
+    size_t dst_size = m_cached_frame.size();
+    size_t src_size = compressed.size();
+    const size_t rv = LZ4F_decompress(ctx, m_cached_frame.data(), &dst_size, compressed.data(), &src_size, nullptr);
+    LZ4F_freeDecompressionContext(ctx);
+    // a return value of 0 means the whole frame was decoded
+    if ((rv != 0) || (dst_size != frame.size)) {
+        spdlog::warn(fmt::format("Failed to decode output archive frame at {} ({})", frame.offset, m_filepath));
+        return false;
+    }
+
+    m_cached_frame_offset = frame.offset;
+    m_is_cache_valid = true;
+    return true;
+}
+
+size_t OutputArchive::Read(const uint64_t offset, const size_t length, std::string &out, uint64_t &read_offset) {
+    auto lock = std::scoped_lock(m_read_mutex);
+    out.clear();
+    read_offset = offset;
+    uint64_t curr_offset = offset;
+    while (out.size() < length) {
+        OutputArchiveFrame frame;
+        if (!FindFrame(curr_offset, frame) || !DecodeFrame(frame)) {
+            break;
+        }
+        // skip a gap from dropped segments at the start, but never join output across one
+        if (frame.offset > curr_offset) {
+            if (!out.empty()) {
+                break;
+            }
+            curr_offset = frame.offset;
+            read_offset = curr_offset;
+        }
+        const size_t frame_index = size_t(curr_offset - frame.offset);
+        const size_t size = std::min(length - out.size(), size_t(frame.size) - frame_index);
+        out.append(m_cached_frame.data() + frame_index, size);
+        curr_offset += uint64_t(size);
+    }
+    return out.size();
+}
+
+bool OutputArchive::Find(const std::string &pattern, const uint64_t start_offset, uint64_t &match_offset) {
+    if (pattern.empty()) {
+        return false;
+    }
+
+    auto lock = std::scoped_lock(m_read_mutex);
+    // keep the tail of the previous frame so matches across frame boundaries are found
+    std::string window;
+    uint64_t curr_offset = std::max(start_offset, GetReadableBegin());
+    uint64_t window_offset = curr_offset;
+    while (true) {
+        OutputArchiveFrame frame;
+        if (!FindFrame(curr_offset, frame) || !DecodeFrame(frame)) {
+            return false;
+        }
+        // skip over gaps from dropped segments, a match can't span one
+        curr_offset = std::max(curr_offset, frame.offset);
+        if (curr_offset != window_offset + uint64_t(window.size())) {
+            window.clear();
+            window_offset = curr_offset;
+        }
+
+        const size_t frame_index = size_t(curr_offset - frame.offset);
+        window.append(m_cached_frame.data() + frame_index, size_t(frame.size) - frame_index);
+        const size_t index = window.find(pattern);
+        if (index != std::string::npos) {
+            match_offset = window_offset + uint64_t(index);
+            return true;
+        }
+
+        const size_t keep_size = std::min(window.size(), pattern.size()-1);
+        window_offset += uint64_t(window.size() - keep_size);
+        window.erase(0, window.size() - keep_size);
+        curr_offset = frame.offset + frame.size;
+    }
+}
+
+CompressionPool::CompressionPool()
+: m_queued_bytes(0), m_is_running(true)
+{
+    const size_t total_workers = std::max(1u, std::thread::hardware_concurrency()/4);
+    for (size_t i = 0; i < total_workers; i++) {
+        m_workers.emplace_back([this]() { WorkerThread(); });
+    }
+}
+
+CompressionPool::~CompressionPool() {
+    {
+        auto lock = std::scoped_lock(m_mutex);
+        m_is_running = false;
+    }
+    m_cv.notify_all();
+    for (auto &worker: m_workers) {
+        worker.join();
+    }
+}
+
+CompressionPool &CompressionPool::Get() {
+    static CompressionPool pool;
+    return pool;
+}
+
+bool CompressionPool::Submit(std::shared_ptr<OutputArchive> archive, const uint64_t segment_id, const uint64_t offset, std::vector<char> data) {
+    {
+        auto lock = std::scoped_lock(m_mutex);
+        if ((m_queued_bytes + data.size()) > MAX_QUEUED_BYTES) {
+            return false;
+        }
+        m_queued_bytes += data.size();
+        m_jobs.push_back({ std::move(archive), segment_id, offset, std::move(data) });
+    }
+    m_cv.notify_one();
+    return true;
+}
+
+void CompressionPool::WorkerThread() {
+    while (true) {
+        Job job;
+        {
+            auto lock = std::unique_lock(m_mutex);
+            m_cv.wait(lock, [this]() { return !m_jobs.empty() || !m_is_running; });
+            // finish what is queued so archives are complete on exit
+            if (m_jobs.empty()) {
+                return;
+            }
+            job = std::move(m_jobs.front());
+            m_jobs.pop_front();
+            m_queued_bytes -= job.data.size();
+        }
+        job.archive->CompressSegment(job.segment_id, job.offset, job.data);
+    }
+}
+
+}
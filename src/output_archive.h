@@ -0,0 +1,144 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace app {
+
+struct OutputArchiveStats {
+    uint64_t total_archived;    // bytes captured from the process
+    uint64_t total_compressed;  // bytes written to disk
+    uint64_t total_pending;     // bytes waiting to be compressed
+    uint64_t total_dropped;     // bytes dropped because the compression queue was full
+    double compress_seconds;    // time the compression workers spent on this archive
+};
+
+// location of an independently decodable lz4 frame in the archive file
+struct OutputArchiveFrame {
+    uint64_t offset;            // offset in the captured output
+    uint64_t file_offset;
+    uint32_t size;
+    uint32_t compressed_size;
+};
+
+// full output history of a process compressed to disk
+// the listener thread appends into an in memory segment which is handed to the compression pool once full
+// segments are split into fixed size lz4 frames so any offset can be read back by decoding a single frame
+// the file is a plain concatenation of lz4 frames so it can also be read with the lz4 command line tool
+// the frame index is appended to a sidecar file as segments are written, so archives can be read after the process is gone
+class OutputArchive: public std::enable_shared_from_this<OutputArchive>
+{
+public:
+    static constexpr size_t SEGMENT_SIZE = 0x100000;
+    static constexpr size_t FRAME_SIZE = 0x10000;
+    // the sidecar index is the archive filepath with this appended
+    static constexpr const char *INDEX_EXTENSION = ".index";
+private:
+    const std::string m_filepath;
+    const bool m_is_read_only;
+    // only used by the listener thread
+    std::vector<char> m_segment;
+    uint64_t m_segment_offset;
+    uint64_t m_next_segment_id;
+    // segments can finish compressing out of order, so they are written in order of their id
+    struct CompressedSegment {
+        std::vector<char> data;
+        std::vector<OutputArchiveFrame> frames;
+    };
+    std::mutex m_write_mutex;
+    std::ofstream m_file;
+    std::ofstream m_index_file;
+    std::map<uint64_t, CompressedSegment> m_completed_segments;
+    uint64_t m_next_write_id;
+    uint64_t m_file_size;
+    std::vector<OutputArchiveFrame> m_frames;
+    // segments dropped by the listener, which can't wait on the write lock
+    // the next worker to write skips the write order past them
+    std::mutex m_dropped_mutex;
+    std::vector<uint64_t> m_dropped_ids;
+    // cache of the last decoded frame for sequential reads
+    std::mutex m_read_mutex;
+    std::ifstream m_read_file;
+    uint64_t m_cached_frame_offset;
+    std::vector<char> m_cached_frame;
+    bool m_is_cache_valid;
+    // statistics
+    std::atomic<uint64_t> m_total_archived;
+    std::atomic<uint64_t> m_total_compressed;
+    std::atomic<uint64_t> m_total_pending;
+    std::atomic<uint64_t> m_total_dropped;
+    std::atomic<int64_t> m_compress_ns;
+public:
+    // throws std::runtime_error if the file can't be created
+    OutputArchive(std::string filepath);
+    ~OutputArchive();
+    // opens an archive written by an earlier process for reading, nothing can be appended to it
+    // throws std::runtime_error if the archive or its index can't be read
+    static std::shared_ptr<OutputArchive> Open(std::string filepath);
+    inline const std::string &GetFilepath() const { return m_filepath; }
+    // called from the listener thread, never waits on compression
+    void Append(const char *data, const size_t length);
+    // hand off the partially filled segment, called once the process has exited
+    void Flush();
+    OutputArchiveStats GetStats() const;
+    // range of the captured output which can be read back from disk
+    uint64_t GetReadableBegin();
+    uint64_t GetReadableEnd();
+    // reads from the first byte on disk at or after offset, which is returned in read_offset
+    // stops early at the next gap from dropped segments or data that isn't on disk yet
+    size_t Read(const uint64_t offset, const size_t length, std::string &out, uint64_t &read_offset);
+    // returns false if there is no match at or after start_offset
+    bool Find(const std::string &pattern, const uint64_t start_offset, uint64_t &match_offset);
+    OutputArchive(const OutputArchive &) = delete;
+    OutputArchive& operator=(const OutputArchive &) = delete;
+private:
+    friend class CompressionPool;
+    OutputArchive(std::string filepath, const bool is_read_only);
+    void LoadIndex();
+    void SubmitSegment();
+    void CompressSegment(const uint64_t segment_id, const uint64_t offset, const std::vector<char> &data);
+    void WriteSegment(const uint64_t segment_id, CompressedSegment segment);
+    // frame containing offset, or the next frame after it if offset is in a gap from dropped segments
+    bool FindFrame(const uint64_t offset, OutputArchiveFrame &frame);
+    bool DecodeFrame(const OutputArchiveFrame &frame);
+};
+
+// background workers which compress archive segments
+class CompressionPool
+{
+public:
+    // segments are dropped instead of blocking capture when this much is queued
+    static constexpr size_t MAX_QUEUED_BYTES = 64*OutputArchive::SEGMENT_SIZE;
+private:
+    struct Job {
+        std::shared_ptr<OutputArchive> archive;
+        uint64_t segment_id;
+        uint64_t offset;
+        std::vector<char> data;
+    };
+    std::vector<std::thread> m_workers;
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::deque<Job> m_jobs;
+    size_t m_queued_bytes;
+    bool m_is_running;
+public:
+    static CompressionPool &Get();
+    ~CompressionPool();
+    // returns false if the queue is full
+    bool Submit(std::shared_ptr<OutputArchive> archive, const uint64_t segment_id, const uint64_t offset, std::vector<char> data);
+private:
+    CompressionPool();
+    void WorkerThread();
+};
+
+}
@@ -0,0 +1,270 @@
+#include "output_layout.h"
+
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+
+#include "tracing.h"
+
+namespace app {
+
+// dropped lines are only erased from the front of the index once there are this many
+static constexpr size_t MIN_COMPACT_LINES = 0x1000;
+
+static inline size_t lowest_bit(const size_t i) {
+    return i & (~i + 1);
+}
+
+OutputLayout::OutputLayout() {
+    m_wrap_width = 0.0f;
+    m_char_width = 1.0f;
+    Reset();
+}
+
+void OutputLayout::Reset() {
+    m_line_offsets.clear();
+    m_line_rows.clear();
+    m_is_measured.clear();
+    m_row_tree.assign(1, 0);
+    m_first_line = 0;
+    m_total_unmeasured = 0;
+    m_measure_cursor = 0;
+    m_scanned_end = 0;
+    m_is_line_pending = true;
+    m_buffer = nullptr;
+    m_buffer_offset = 0;
+}
+
+bool OutputLayout::SetWrapWidth(const float wrap_width, const float char_width) {
+    if ((wrap_width == m_wrap_width) && (char_width == m_char_width)) {
+        return false;
+    }
+    TRACE_SCOPE("relayout_output");
+    m_wrap_width = wrap_width;
+    m_char_width = char_width;
+    const bool is_wrapped = m_wrap_width > 0.0f;
+    for (size_t i = m_first_line; i < m_line_offsets.size(); i++) {
+        m_line_rows[i] = EstimateRows(i);
+        m_is_measured[i] = is_wrapped ? 0 : 1;
+    }
+    m_total_unmeasured = is_wrapped ? GetTotalLines() : 0;
+    m_measure_cursor = m_first_line;
+    RebuildTree();
+    return true;
+}
+
+void OutputLayout::Update(const char *buffer, const uint64_t begin_offset, const uint64_t end_offset) {
+    // a different buffer, one which got more than a whole ring ahead of us or one which was resized
+    if ((end_offset < m_scanned_end) || (begin_offset > m_scanned_end) || (begin_offset < m_buffer_offset)) {
+        Reset();
+        m_scanned_end = begin_offset;
+    }
+    m_buffer = buffer;
+    m_buffer_offset = begin_offset;
+
+    // drop the lines which were overwritten, the oldest one can be partly overwritten
+    while ((GetTotalLines() >= 2) && (m_line_offsets[m_first_line+1] <= begin_offset)) {
+        SetLineRows(m_first_line, 0);
+        if (m_is_measured[m_first_line] == 0) {
+            m_total_unmeasured--;
+        }
+        m_is_measured[m_first_line] = 1;
+        m_first_line++;
+    }
+    if ((GetTotalLines() > 0) && (m_line_offsets[m_first_line] < begin_offset)) {
+        m_line_offsets[m_first_line] = begin_offset;
+        SetLineEstimate(m_first_line);
+    }
+    m_measure_cursor = std::max(m_measure_cursor, m_first_line);
+
+    if (end_offset > m_scanned_end) {
+        TRACE_SCOPE("index_output_lines");
+        size_t first_new_line = m_line_offsets.size();
+        // the last line keeps growing until it gets its newline
+        if ((first_new_line > m_first_line) && !m_is_line_pending) {
+            first_new_line--;
+            m_measure_cursor = std::min(m_measure_cursor, first_new_line);
+        }
+        uint64_t offset = m_scanned_end;
+        if (m_is_line_pending) {
+            AppendLine(offset);
+            m_is_line_pending = false;
+        }
+        while (offset < end_offset) {
+            const char *data = m_buffer + (offset - m_buffer_offset);
+            const void *newline = memchr(data, '\n', size_t(end_offset - offset));
+            if (newline == nullptr) {
+                break;
+            }
+            offset += uint64_t((const char *)(newline) - data) + 1;
+            if (offset < end_offset) {
+                AppendLine(offset);
+            } else {
+                m_is_line_pending = true;
+            }
+        }
+        m_scanned_end = end_offset;
+        // the length of a line is only known once the next one has been found
+        for (size_t i = first_new_line; i < m_line_offsets.size(); i++) {
+            SetLineEstimate(i);
+        }
+    }
+
+    // erase the dropped lines once they are half the index
+    if ((m_first_line >= MIN_COMPACT_LINES) && (m_first_line*2 >= m_line_offsets.size())) {
+        m_line_offsets.erase(m_line_offsets.begin(), m_line_offsets.begin() + m_first_line);
+        m_line_rows.erase(m_line_rows.begin(), m_line_rows.begin() + m_first_line);
+        m_is_measured.erase(m_is_measured.begin(), m_is_measured.begin() + m_first_line);
+        m_measure_cursor -= m_first_line;
+        m_first_line = 0;
+        RebuildTree();
+    }
+}
+
+void OutputLayout::Measure(const size_t first_line, const uint64_t total_rows, const size_t budget, const measure_t &measure) {
+    if ((m_wrap_width <= 0.0f) || (m_total_unmeasured == 0)) {
+        return;
+    }
+    TRACE_SCOPE("measure_output_lines");
+    const size_t end_line = m_line_offsets.size();
+    size_t index = m_first_line + first_line;
+    uint64_t rows = 0;
+    for (; (index < end_line) && (rows < total_rows); index++) {
+        if (m_is_measured[index] == 0) {
+            MeasureLine(index, measure);
+        }
+        rows += m_line_rows[index];
+    }
+
+    // everything between the visible lines and the cursor was measured by previous frames
+    if (index < m_measure_cursor) {
+        index = m_measure_cursor;
+    }
+    size_t total_measured = 0;
+    for (; (index < end_line) && (total_measured < budget) && (m_total_unmeasured > 0); index++) {
+        if (m_is_measured[index] == 0) {
+            MeasureLine(index, measure);
+            total_measured++;
+        }
+    }
+    m_measure_cursor = std::max(m_measure_cursor, index);
+}
+
+uint64_t OutputLayout::GetLineEnd(const size_t line) const {
+    const size_t index = m_first_line + line;
+    const bool is_last = (index + 1) == m_line_offsets.size();
+    uint64_t end = is_last ? m_scanned_end : m_line_offsets[index+1];
+    const uint64_t begin = m_line_offsets[index];
+    if ((end > begin) && (!is_last || m_is_line_pending)) {
+        end--;
+        // windows line endings
+        if ((end > begin) && (m_buffer[end - 1 - m_buffer_offset] == '\r')) {
+            end--;
+        }
+    }
+    return end;
+}
+
+size_t OutputLayout::FindRow(const uint64_t row, uint32_t &line_row) const {
+    // walk down the fenwick tree for the last line which starts at or before the row
+    const size_t total_lines = m_line_offsets.size();
+    size_t index = 0;
+    uint64_t remaining = row;
+    size_t step = 1;
+    while ((step*2) <= total_lines) {
+        step *= 2;
+    }
+    for (; step > 0; step /= 2) {
+        if (((index + step) <= total_lines) && (m_row_tree[index + step] <= remaining)) {
+            index += step;
+            remaining -= m_row_tree[index];
+        }
+    }
+    if (index >= total_lines) {
+        index = total_lines - 1;
+        line_row = m_line_rows[index] - 1;
+    } else {
+        line_row = uint32_t(remaining);
+    }
+    return std::max(index, m_first_line) - m_first_line;
+}
+
+size_t OutputLayout::FindOffset(const uint64_t offset) const {
+    auto begin = m_line_offsets.begin() + m_first_line;
+    auto it = std::upper_bound(begin, m_line_offsets.end(), offset);
+    return (it == begin) ? 0 : size_t(std::distance(begin, it)) - 1;
+}
+
+void OutputLayout::AppendLine(const uint64_t offset) {
+    // the line is estimated once its length is known, until then it takes a row
+    const size_t i = m_line_offsets.size() + 1;
+    m_line_offsets.push_back(offset);
+    m_line_rows.push_back(1);
+    m_is_measured.push_back(1);
+    m_row_tree.push_back(1 + GetPrefixRows(i - 1) - GetPrefixRows(i - lowest_bit(i)));
+}
+
+void OutputLayout::MeasureLine(const size_t index, const measure_t &measure) {
+    const size_t line = index - m_first_line;
+    const char *begin = m_buffer + (m_line_offsets[index] - m_buffer_offset);
+    const char *end = m_buffer + (GetLineEnd(line) - m_buffer_offset);
+    SetLineRows(index, std::max(measure(begin, end), uint32_t(1)));
+    m_is_measured[index] = 1;
+    m_total_unmeasured--;
+}
+
+uint32_t OutputLayout::EstimateRows(const size_t index) const {
+    if (m_wrap_width <= 0.0f) {
+        return 1;
+    }
+    // doesn't read the buffer since this runs before Update() is given the buffer of this frame
+    const bool is_last = (index + 1) == m_line_offsets.size();
+    const uint64_t end = is_last ? m_scanned_end : m_line_offsets[index+1];
+    const uint64_t length = end - m_line_offsets[index];
+    const float rows = ceilf(float(length) * m_char_width / m_wrap_width);
+    return std::max(uint32_t(rows), uint32_t(1));
+}
+
+void OutputLayout::SetLineEstimate(const size_t index) {
+    // without wrapping every line is a single row so there is nothing to measure
+    const uint8_t is_measured = (m_wrap_width > 0.0f) ? 0 : 1;
+    if ((m_is_measured[index] != 0) && (is_measured == 0)) {
+        m_total_unmeasured++;
+    }
+    if ((m_is_measured[index] == 0) && (is_measured != 0)) {
+        m_total_unmeasured--;
+    }
+    m_is_measured[index] = is_measured;
+    SetLineRows(index, EstimateRows(index));
+}
+
+void OutputLayout::SetLineRows(const size_t index, const uint32_t rows) {
+    const uint64_t delta = uint64_t(rows) - uint64_t(m_line_rows[index]);
+    m_line_rows[index] = rows;
+    // unsigned wrap around makes adding the delta work for shrinking lines too
+    for (size_t i = index + 1; i < m_row_tree.size(); i += lowest_bit(i)) {
+        m_row_tree[i] += delta;
+    }
+}
+
+uint64_t OutputLayout::GetPrefixRows(const size_t total_lines) const {
+    uint64_t rows = 0;
+    for (size_t i = total_lines; i > 0; i -= lowest_bit(i)) {
+        rows += m_row_tree[i];
+    }
+    return rows;
+}
+
+void OutputLayout::RebuildTree() {
+    const size_t total_lines = m_line_rows.size();
+    m_row_tree.assign(total_lines + 1, 0);
+    for (size_t i = 1; i <= total_lines; i++) {
+        m_row_tree[i] += m_line_rows[i-1];
+        const size_t parent = i + lowest_bit(i);
+        if (parent <= total_lines) {
+            m_row_tree[parent] += m_row_tree[i];
+        }
+    }
+}
+
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <functional>
+#include <vector>
+
+namespace app {
+
+// maps the lines of a scrolling buffer to the rows they take up when wrapped to the width of the output pane
+// lines are indexed as output arrives so a frame only scans what is new
+// rows are estimated from the line length until a line is measured, which happens to the visible lines first
+// lines above the visible ones keep their estimate until they are shown so the view doesn't shift under the user
+class OutputLayout
+{
+public:
+    // lines after the visible ones which are measured ahead of time each frame
+    static constexpr size_t MEASURE_BUDGET = 1024;
+    // number of rows a line takes at the current wrap width, the text doesn't include the newline
+    using measure_t = std::function<uint32_t (const char *begin, const char *end)>;
+private:
+    // absolute offset of the start of every line, the ones before m_first_line were overwritten
+    std::vector<uint64_t> m_line_offsets;
+    std::vector<uint32_t> m_line_rows;
+    std::vector<uint8_t> m_is_measured;
+    size_t m_first_line;
+    size_t m_total_unmeasured;
+    // fenwick tree over m_line_rows so the row of a line and the line at a row are both O(log n)
+    std::vector<uint64_t> m_row_tree;
+    // lines after the cursor haven't been looked at by the background measuring yet
+    size_t m_measure_cursor;
+    // the next scan for new lines starts here, a new line starts here once more output arrives if it is pending
+    uint64_t m_scanned_end;
+    bool m_is_line_pending;
+    float m_wrap_width;
+    float m_char_width;
+    // buffer from the last Update()
+    const char *m_buffer;
+    uint64_t m_buffer_offset;
+public:
+    OutputLayout();
+    void Reset();
+    // a width of 0 turns wrapping off so every line is a single row
+    // char_width is the average width of a character which unmeasured lines are estimated with
+    // returns true if the width changed and the lines went back to being estimated
+    bool SetWrapWidth(const float wrap_width, const float char_width);
+    // indexes new output and drops lines which were overwritten, buffer holds [begin_offset, end_offset)
+    // the buffer has to stay valid until the next Update() since lines are measured straight out of it
+    void Update(const char *buffer, const uint64_t begin_offset, const uint64_t end_offset);
+    // measures lines from first_line until they fill total_rows, then up to budget unmeasured lines after them
+    void Measure(const size_t first_line, const uint64_t total_rows, const size_t budget, const measure_t &measure);
+    // lines are indexed from the oldest one still in the buffer
+    inline size_t GetTotalLines() const { return m_line_offsets.size() - m_first_line; }
+    inline uint64_t GetTotalRows() const { return GetPrefixRows(m_line_offsets.size()); }
+    inline uint64_t GetLineRow(const size_t line) const { return GetPrefixRows(m_first_line + line); }
+    inline uint32_t GetLineRows(const size_t line) const { return m_line_rows[m_first_line + line]; }
+    inline uint64_t GetLineOffset(const size_t line) const { return m_line_offsets[m_first_line + line]; }
+    inline bool IsLineMeasured(const size_t line) const { return m_is_measured[m_first_line + line] != 0; }
+    // end of the text of a line, which leaves out the newline
+    uint64_t GetLineEnd(const size_t line) const;
+    // line at a row and the row within it, rows past the end give the last row of the last line
+    // there has to be at least one line
+    size_t FindRow(const uint64_t row, uint32_t &line_row) const;
+    // line containing an absolute offset, offsets before the first line give the first line
+    size_t FindOffset(const uint64_t offset) const;
+private:
+    void AppendLine(const uint64_t offset);
+    void MeasureLine(const size_t index, const measure_t &measure);
+    void SetLineRows(const size_t index, const uint32_t rows);
+    uint32_t EstimateRows(const size_t index) const;
+    void SetLineEstimate(const size_t index);
+    uint64_t GetPrefixRows(const size_t total_lines) const;
+    void RebuildTree();
+};
+
+}
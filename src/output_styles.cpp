@@ -0,0 +1,297 @@
+#include "output_styles.h"
+
+#include <string.h>
+#include <algorithm>
+
+#include "tracing.h"
+
+namespace app {
+
+static constexpr uint8_t ESC = 0x1B;
+static constexpr uint8_t BEL = 0x07;
+
+// the 16 basic colours, tuned to be readable on a dark background
+static const uint32_t BASIC_COLOURS[16] = {
+    0x000000, 0xCD3131, 0x0DBC79, 0xE5E510, 0x2472C8, 0xBC3FBC, 0x11A8CD, 0xE5E5E5,
+    0x666666, 0xF14C4C, 0x23D18B, 0xF5F543, 0x3B8EEA, 0xD670D6, 0x29B8DB, 0xFFFFFF,
+};
+
+uint32_t get_ansi_colour(const uint8_t index) {
+    if (index < 16) {
+        return BASIC_COLOURS[index];
+    }
+    // 6x6x6 colour cube
+    if (index < 232) {
+        static const uint32_t LEVELS[6] = { 0, 95, 135, 175, 215, 255 };
+        const uint32_t i = uint32_t(index - 16);
+        return (LEVELS[i / 36] << 16) | (LEVELS[(i / 6) % 6] << 8) | LEVELS[i % 6];
+    }
+    // grey ramp
+    const uint32_t level = 8 + 10*uint32_t(index - 232);
+    return (level << 16) | (level << 8) | level;
+}
+
+size_t OutputStyles::Parse(char *data, const size_t length, const uint64_t offset, const uint64_t begin_offset) {
+    TRACE_SCOPE("parse_styles");
+    // sequences are only ever removed so the output is compacted in place
+    size_t w = 0;
+    size_t i = 0;
+    while (i < length) {
+        // plain text is copied down in one go up to the next escape
+        if (m_state == State::GROUND) {
+            const void *escape = memchr(data + i, ESC, length - i);
+            const size_t end = (escape != nullptr) ? size_t((const char *)(escape) - data) : length;
+            if (w != i) {
+                memmove(data + w, data + i, end - i);
+            }
+            w += end - i;
+            i = end;
+            if (escape != nullptr) {
+                m_state = State::ESCAPE;
+                i++;
+            }
+            continue;
+        }
+
+        const uint8_t c = uint8_t(data[i++]);
+        switch (m_state) {
+        case State::ESCAPE:
+            if (c == '[') {
+                m_state = State::CSI;
+                m_total_params = 0;
+                m_param = 0;
+                m_is_next_sub_param = false;
+                m_is_ignored = false;
+            } else if ((c == ']') || (c == 'P') || (c == 'X') || (c == '^') || (c == '_')) {
+                m_state = State::STRING;
+                m_string_length = 0;
+            } else if ((c >= 0x20) && (c <= 0x2F)) {
+                m_state = State::ESCAPE_INTERMEDIATE;
+            } else if (c == ESC) {
+                // a repeated escape starts over
+            } else if (c == 'c') {
+                // full reset
+                m_style = TextStyle{};
+                AddRun(offset + w);
+                m_state = State::GROUND;
+            } else if (c < 0x20) {
+                // control characters still take effect in the middle of a sequence
+                data[w++] = char(c);
+                m_state = State::GROUND;
+            } else {
+                m_state = State::GROUND;
+            }
+            break;
+        case State::ESCAPE_INTERMEDIATE:
+            if ((c >= 0x30) && (c <= 0x7E)) {
+                m_state = State::GROUND;
+            } else if (c == ESC) {
+                m_state = State::ESCAPE;
+            } else if ((c < 0x20) || (c > 0x7E)) {
+                data[w++] = char(c);
+                m_state = State::GROUND;
+            }
+            break;
+        case State::CSI:
+            if ((c >= '0') && (c <= '9')) {
+                m_param = std::min(m_param*10 + uint32_t(c - '0'), uint32_t(0xFFFF));
+            } else if ((c == ';') || (c == ':')) {
+                PushParam();
+                m_is_next_sub_param = (c == ':');
+            } else if (((c >= 0x3C) && (c <= 0x3F)) || ((c >= 0x20) && (c <= 0x2F))) {
+                m_is_ignored = true;
+            } else if ((c >= 0x40) && (c <= 0x7E)) {
+                PushParam();
+                if ((c == 'm') && !m_is_ignored) {
+                    ApplySgr();
+                    AddRun(offset + w);
+                }
+                m_state = State::GROUND;
+            } else if (c == ESC) {
+                m_state = State::ESCAPE;
+            } else if (c < 0x20) {
+                data[w++] = char(c);
+            } else {
+                // not a control sequence after all so the byte is kept
+                data[w++] = char(c);
+                m_state = State::GROUND;
+            }
+            break;
+        case State::STRING:
+        case State::STRING_ESCAPE:
+            if ((m_state == State::STRING_ESCAPE) && (c == '\\')) {
+                m_state = State::GROUND;
+            } else if (c == BEL) {
+                m_state = State::GROUND;
+            } else if (c == ESC) {
+                m_state = State::STRING_ESCAPE;
+            } else if (++m_string_length >= MAX_STRING_LENGTH) {
+                m_state = State::GROUND;
+            } else {
+                m_state = State::STRING;
+            }
+            break;
+        case State::GROUND:
+        default:
+            break;
+        }
+    }
+
+    // the first run stays since it is the style at the start of the ring
+    const bool is_trim = (m_runs.size() >= 2) && (m_runs[1].offset <= begin_offset);
+    if (!m_scan_runs.empty() || is_trim) {
+        auto lock = std::scoped_lock(m_mutex);
+        m_runs.insert(m_runs.end(), m_scan_runs.begin(), m_scan_runs.end());
+        while (m_runs.size() > MAX_RUNS) {
+            m_runs.pop_front();
+        }
+        while ((m_runs.size() >= 2) && (m_runs[1].offset <= begin_offset)) {
+            m_runs.pop_front();
+        }
+        m_scan_runs.clear();
+    }
+    return w;
+}
+
+void OutputStyles::PushParam() {
+    if (m_total_params < MAX_PARAMS) {
+        m_params[m_total_params] = uint16_t(m_param);
+        m_is_sub_param[m_total_params] = m_is_next_sub_param;
+        m_total_params++;
+    }
+    m_param = 0;
+}
+
+void OutputStyles::ApplySgr() {
+    auto &style = m_style;
+    for (size_t i = 0; i < m_total_params; i++) {
+        // sub parameters of codes which don't take any are ignored, e.g. the underline style in 4:3
+        if (m_is_sub_param[i]) {
+            continue;
+        }
+        const uint16_t code = m_params[i];
+        switch (code) {
+        case 0:  style = TextStyle{}; break;
+        case 1:  style.attributes |= TextStyle::BOLD; break;
+        case 2:  style.attributes |= TextStyle::DIM; break;
+        case 3:  style.attributes |= TextStyle::ITALIC; break;
+        case 4:  style.attributes |= TextStyle::UNDERLINE; break;
+        case 7:  style.attributes |= TextStyle::INVERSE; break;
+        case 9:  style.attributes |= TextStyle::STRIKETHROUGH; break;
+        case 21: style.attributes |= TextStyle::UNDERLINE; break;
+        case 22: style.attributes &= ~uint8_t(TextStyle::BOLD | TextStyle::DIM); break;
+        case 23: style.attributes &= ~uint8_t(TextStyle::ITALIC); break;
+        case 24: style.attributes &= ~uint8_t(TextStyle::UNDERLINE); break;
+        case 27: style.attributes &= ~uint8_t(TextStyle::INVERSE); break;
+        case 29: style.attributes &= ~uint8_t(TextStyle::STRIKETHROUGH); break;
+        case 39: style.foreground = TextStyle::DEFAULT_COLOUR; break;
+        case 49: style.background = TextStyle::DEFAULT_COLOUR; break;
+        case 38:
+        case 48:
+        case 58:
+        {
+            // colon separated arguments are sub parameters, semicolon separated ones are the parameters after it
+            const bool is_colon = ((i+1) < m_total_params) && m_is_sub_param[i+1];
+            const uint16_t *args = &m_params[i+1];
+            size_t total_args = 0;
+            while (((i + 1 + total_args) < m_total_params) && (m_is_sub_param[i + 1 + total_args] == is_colon)) {
+                total_args++;
+            }
+            uint32_t colour = TextStyle::DEFAULT_COLOUR;
+            size_t total_used = 0;
+            if ((total_args >= 2) && (args[0] == 5)) {
+                colour = get_ansi_colour(uint8_t(args[1]));
+                total_used = 2;
+            } else if ((total_args >= 1) && (args[0] == 2)) {
+                // the colon form can have a colour space before the components
+                const size_t first = (is_colon && (total_args >= 5)) ? 2 : 1;
+                if (total_args >= (first + 3)) {
+                    const uint32_t r = std::min(args[first],   uint16_t(255));
+                    const uint32_t g = std::min(args[first+1], uint16_t(255));
+                    const uint32_t b = std::min(args[first+2], uint16_t(255));
+                    colour = (r << 16) | (g << 8) | b;
+                    total_used = first + 3;
+                }
+            }
+            if (total_used > 0) {
+                // underline colours aren't drawn
+                if (code == 38) {
+                    style.foreground = colour;
+                } else if (code == 48) {
+                    style.background = colour;
+                }
+            }
+            if (!is_colon) {
+                i += total_used;
+            }
+            break;
+        }
+        default:
+            if ((code >= 30) && (code <= 37)) {
+                style.foreground = get_ansi_colour(uint8_t(code - 30));
+            } else if ((code >= 40) && (code <= 47)) {
+                style.background = get_ansi_colour(uint8_t(code - 40));
+            } else if ((code >= 90) && (code <= 97)) {
+                style.foreground = get_ansi_colour(uint8_t(code - 90 + 8));
+            } else if ((code >= 100) && (code <= 107)) {
+                style.background = get_ansi_colour(uint8_t(code - 100 + 8));
+            }
+            break;
+        }
+    }
+}
+
+void OutputStyles::AddRun(const uint64_t offset) {
+    if (m_style == m_last_run_style) {
+        return;
+    }
+    m_last_run_style = m_style;
+    // sequences back to back only leave the last style
+    if (!m_scan_runs.empty() && (m_scan_runs.back().offset == offset)) {
+        m_scan_runs.back().style = m_style;
+        return;
+    }
+    m_scan_runs.push_back({ offset, m_style });
+}
+
+void OutputStyles::GetRuns(const uint64_t begin_offset, const uint64_t end_offset, std::vector<StyleRun> &runs) {
+    runs.clear();
+    auto lock = std::scoped_lock(m_mutex);
+    auto it = std::upper_bound(m_runs.begin(), m_runs.end(), begin_offset, [](const uint64_t offset, const StyleRun &run) {
+        return offset < run.offset;
+    });
+    if (it != m_runs.begin()) {
+        --it;
+    }
+    for (; (it != m_runs.end()) && (it->offset < end_offset); ++it) {
+        runs.push_back(*it);
+    }
+}
+
+void OutputStyles::AddRuns(const std::vector<StyleRun> &runs, const uint64_t begin_offset) {
+    auto lock = std::scoped_lock(m_mutex);
+    for (const auto &run: runs) {
+        if (run.style == m_last_run_style) {
+            continue;
+        }
+        m_last_run_style = run.style;
+        if (!m_runs.empty() && (m_runs.back().offset >= run.offset)) {
+            m_runs.back().style = run.style;
+            continue;
+        }
+        m_runs.push_back(run);
+    }
+    while (m_runs.size() > MAX_RUNS) {
+        m_runs.pop_front();
+    }
+    while ((m_runs.size() >= 2) && (m_runs[1].offset <= begin_offset)) {
+        m_runs.pop_front();
+    }
+}
+
+size_t OutputStyles::GetTotalRuns() {
+    auto lock = std::scoped_lock(m_mutex);
+    return m_runs.size();
+}
+
+}
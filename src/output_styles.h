@@ -0,0 +1,98 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+namespace app {
+
+// what a select graphic rendition escape sequence leaves the text looking like
+struct TextStyle {
+    // colours are 0xRRGGBB, text which never had one set uses the theme's
+    static constexpr uint32_t DEFAULT_COLOUR = 0xFFFFFFFF;
+    enum Attribute: uint8_t {
+        BOLD            = 1 << 0,
+        DIM             = 1 << 1,
+        ITALIC          = 1 << 2,
+        UNDERLINE       = 1 << 3,
+        INVERSE         = 1 << 4,
+        STRIKETHROUGH   = 1 << 5,
+    };
+    uint32_t foreground = DEFAULT_COLOUR;
+    uint32_t background = DEFAULT_COLOUR;
+    uint8_t attributes = 0;
+    bool operator==(const TextStyle &other) const = default;
+    inline bool IsDefault() const { return *this == TextStyle{}; }
+};
+
+// the style of the output from an absolute offset up to the next run
+struct StyleRun {
+    uint64_t offset;
+    TextStyle style;
+};
+
+// parses ansi escape sequences out of the output of a process as it is captured
+// the sequences are stripped from the output and the colours they set are kept as runs on the side
+// so the output pane draws spans from the runs instead of parsing the output every frame
+// the parser state is kept between calls so a sequence split across two reads still parses
+class OutputStyles
+{
+public:
+    // oldest runs are dropped past this, that output is then drawn in the default style
+    static constexpr size_t MAX_RUNS = 0x20000;
+    // parameters past this in a single sequence are ignored
+    static constexpr size_t MAX_PARAMS = 32;
+    // strings which are never terminated stop being swallowed after this many bytes
+    static constexpr size_t MAX_STRING_LENGTH = 0x1000;
+private:
+    enum class State {
+        GROUND,
+        ESCAPE,                 // after ESC
+        ESCAPE_INTERMEDIATE,    // ESC followed by intermediate bytes until the final byte
+        CSI,                    // ESC [ parameters until the final byte
+        STRING,                 // OSC, DCS, SOS, PM and APC until the string terminator
+        STRING_ESCAPE,          // ESC inside a string which may start the terminator
+    };
+    State m_state = State::GROUND;
+    // parameters of the current control sequence
+    uint16_t m_params[MAX_PARAMS];
+    // set if the parameter was a sub parameter joined to the previous one with a colon
+    bool m_is_sub_param[MAX_PARAMS];
+    size_t m_total_params = 0;
+    uint32_t m_param = 0;
+    bool m_is_next_sub_param = false;
+    // private or intermediate bytes mean it isn't a plain sgr sequence
+    bool m_is_ignored = false;
+    size_t m_string_length = 0;
+    TextStyle m_style;
+    // style of the newest run, only touched by the thread which adds runs
+    TextStyle m_last_run_style;
+    // runs of the current chunk which are added in one go
+    std::vector<StyleRun> m_scan_runs;
+    std::mutex m_mutex;
+    // ascending offsets, the first run is the one in effect at the start of the ring
+    std::deque<StyleRun> m_runs;
+public:
+    // data is stripped of escape sequences in place, returns the length which is left
+    // offset is the absolute offset data will be written at and begin_offset is the oldest byte still in the ring
+    size_t Parse(char *data, const size_t length, const uint64_t offset, const uint64_t begin_offset);
+    // runs which cover [begin_offset, end_offset), starting with the one in effect at begin_offset
+    // if the first run starts after begin_offset the output before it has the default style
+    void GetRuns(const uint64_t begin_offset, const uint64_t end_offset, std::vector<StyleRun> &runs);
+    size_t GetTotalRuns();
+    // runs parsed somewhere else, e.g. by the daemon, in ascending offsets from the newest one we have
+    // offsets are absolute in our output, begin_offset is the oldest byte still in the ring
+    void AddRuns(const std::vector<StyleRun> &runs, const uint64_t begin_offset);
+private:
+    void PushParam();
+    void ApplySgr();
+    // starts a run with the current style unless it is the same as the last one
+    void AddRun(const uint64_t offset);
+};
+
+// colour of an index into the xterm 256 colour palette as 0xRRGGBB
+uint32_t get_ansi_colour(const uint8_t index);
+
+}
@@ -0,0 +1,438 @@
+#include "output_transcoder.h"
+
+#include <string.h>
+#include <algorithm>
+
+#include <spdlog/spdlog.h>
+#include <fmt/core.h>
+
+#include "platform.h"
+
+// sse2 is always there on x64, elsewhere the scalar loops do everything
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define OUTPUT_TRANSCODER_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace app {
+
+// upper halves of the codepages we fall back to when the system can't give us one
+static const uint16_t CP437_UPPER[128] = {
+    0x00C7, 0x00FC, 0x00E9, 0x00E2, 0x00E4, 0x00E0, 0x00E5, 0x00E7,
+    0x00EA, 0x00EB, 0x00E8, 0x00EF, 0x00EE, 0x00EC, 0x00C4, 0x00C5,
+    0x00C9, 0x00E6, 0x00C6, 0x00F4, 0x00F6, 0x00F2, 0x00FB, 0x00F9,
+    0x00FF, 0x00D6, 0x00DC, 0x00A2, 0x00A3, 0x00A5, 0x20A7, 0x0192,
+    0x00E1, 0x00ED, 0x00F3, 0x00FA, 0x00F1, 0x00D1, 0x00AA, 0x00BA,
+    0x00BF, 0x2310, 0x00AC, 0x00BD, 0x00BC, 0x00A1, 0x00AB, 0x00BB,
+    0x2591, 0x2592, 0x2593, 0x2502, 0x2524, 0x2561, 0x2562, 0x2556,
+    0x2555, 0x2563, 0x2551, 0x2557, 0x255D, 0x255C, 0x255B, 0x2510,
+    0x2514, 0x2534, 0x252C, 0x251C, 0x2500, 0x253C, 0x255E, 0x255F,
+    0x255A, 0x2554, 0x2569, 0x2566, 0x2560, 0x2550, 0x256C, 0x2567,
+    0x2568, 0x2564, 0x2565, 0x2559, 0x2558, 0x2552, 0x2553, 0x256B,
+    0x256A, 0x2518, 0x250C, 0x2588, 0x2584, 0x258C, 0x2590, 0x2580,
+    0x03B1, 0x00DF, 0x0393, 0x03C0, 0x03A3, 0x03C3, 0x00B5, 0x03C4,
+    0x03A6, 0x0398, 0x03A9, 0x03B4, 0x221E, 0x03C6, 0x03B5, 0x2229,
+    0x2261, 0x00B1, 0x2265, 0x2264, 0x2320, 0x2321, 0x00F7, 0x2248,
+    0x00B0, 0x2219, 0x00B7, 0x221A, 0x207F, 0x00B2, 0x25A0, 0x00A0,
+};
+
+static const uint16_t CP1252_UPPER[128] = {
+    0x20AC, 0x0081, 0x201A, 0x0192, 0x201E, 0x2026, 0x2020, 0x2021,
+    0x02C6, 0x2030, 0x0160, 0x2039, 0x0152, 0x008D, 0x017D, 0x008F,
+    0x0090, 0x2018, 0x2019, 0x201C, 0x201D, 0x2022, 0x2013, 0x2014,
+    0x02DC, 0x2122, 0x0161, 0x203A, 0x0153, 0x009D, 0x017E, 0x0178,
+    0x00A0, 0x00A1, 0x00A2, 0x00A3, 0x00A4, 0x00A5, 0x00A6, 0x00A7,
+    0x00A8, 0x00A9, 0x00AA, 0x00AB, 0x00AC, 0x00AD, 0x00AE, 0x00AF,
+    0x00B0, 0x00B1, 0x00B2, 0x00B3, 0x00B4, 0x00B5, 0x00B6, 0x00B7,
+    0x00B8, 0x00B9, 0x00BA, 0x00BB, 0x00BC, 0x00BD, 0x00BE, 0x00BF,
+    0x00C0, 0x00C1, 0x00C2, 0x00C3, 0x00C4, 0x00C5, 0x00C6, 0x00C7,
+    0x00C8, 0x00C9, 0x00CA, 0x00CB, 0x00CC, 0x00CD, 0x00CE, 0x00CF,
+    0x00D0, 0x00D1, 0x00D2, 0x00D3, 0x00D4, 0x00D5, 0x00D6, 0x00D7,
+    0x00D8, 0x00D9, 0x00DA, 0x00DB, 0x00DC, 0x00DD, 0x00DE, 0x00DF,
+    0x00E0, 0x00E1, 0x00E2, 0x00E3, 0x00E4, 0x00E5, 0x00E6, 0x00E7,
+    0x00E8, 0x00E9, 0x00EA, 0x00EB, 0x00EC, 0x00ED, 0x00EE, 0x00EF,
+    0x00F0, 0x00F1, 0x00F2, 0x00F3, 0x00F4, 0x00F5, 0x00F6, 0x00F7,
+    0x00F8, 0x00F9, 0x00FA, 0x00FB, 0x00FC, 0x00FD, 0x00FE, 0x00FF,
+};
+
+static constexpr uint32_t REPLACEMENT_CHARACTER = 0xFFFD;
+
+static inline size_t encode_utf8(uint32_t code_point, uint8_t *dst) {
+    if (code_point < 0x80) {
+        dst[0] = uint8_t(code_point);
+        return 1;
+    }
+    if (code_point < 0x800) {
+        dst[0] = uint8_t(0xC0 | (code_point >> 6));
+        dst[1] = uint8_t(0x80 | (code_point & 0x3F));
+        return 2;
+    }
+    if ((code_point >= 0x110000) || ((code_point >= 0xD800) && (code_point <= 0xDFFF))) {
+        code_point = REPLACEMENT_CHARACTER;
+    }
+    if (code_point < 0x10000) {
+        dst[0] = uint8_t(0xE0 | (code_point >> 12));
+        dst[1] = uint8_t(0x80 | ((code_point >> 6) & 0x3F));
+        dst[2] = uint8_t(0x80 | (code_point & 0x3F));
+        return 3;
+    }
+    dst[0] = uint8_t(0xF0 | (code_point >> 18));
+    dst[1] = uint8_t(0x80 | ((code_point >> 12) & 0x3F));
+    dst[2] = uint8_t(0x80 | ((code_point >> 6) & 0x3F));
+    dst[3] = uint8_t(0x80 | (code_point & 0x3F));
+    return 4;
+}
+
+size_t find_non_ascii(const char *data, const size_t length) {
+    size_t i = 0;
+#ifdef OUTPUT_TRANSCODER_SSE2
+    for (; (i + 16) <= length; i += 16) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+        if (_mm_movemask_epi8(v) != 0) {
+            break;
+        }
+    }
+#endif
+    for (; (i + 8) <= length; i += 8) {
+        uint64_t word;
+        memcpy(&word, data + i, sizeof(word));
+        if ((word & 0x8080808080808080ull) != 0) {
+            break;
+        }
+    }
+    for (; i < length; i++) {
+        if ((uint8_t(data[i]) & 0x80) != 0) {
+            return i;
+        }
+    }
+    return length;
+}
+
+enum class Utf8Sequence { VALID, INCOMPLETE, INVALID };
+
+// checks the sequence at src against the byte ranges of well formed utf-8
+// so overlong encodings, surrogates and anything past the last plane fail on their first bad byte
+// size is the length of the sequence, or of the valid bytes before the bad one which is at least the lead byte
+static Utf8Sequence check_utf8_sequence(const uint8_t *src, const size_t length, size_t &size) {
+    const uint8_t c = src[0];
+    size_t total_bytes = 0;
+    uint8_t second_min = 0x80;
+    uint8_t second_max = 0xBF;
+    if ((c >= 0xC2) && (c <= 0xDF)) {
+        total_bytes = 2;
+    } else if (c == 0xE0) {
+        total_bytes = 3;
+        second_min = 0xA0;
+    } else if (c == 0xED) {
+        total_bytes = 3;
+        second_max = 0x9F;
+    } else if ((c >= 0xE1) && (c <= 0xEF)) {
+        total_bytes = 3;
+    } else if (c == 0xF0) {
+        total_bytes = 4;
+        second_min = 0x90;
+    } else if (c == 0xF4) {
+        total_bytes = 4;
+        second_max = 0x8F;
+    } else if ((c >= 0xF1) && (c <= 0xF3)) {
+        total_bytes = 4;
+    } else {
+        size = 1;
+        return Utf8Sequence::INVALID;
+    }
+    for (size = 1; size < total_bytes; size++) {
+        if (size >= length) {
+            return Utf8Sequence::INCOMPLETE;
+        }
+        const uint8_t b = src[size];
+        const uint8_t min = (size == 1) ? second_min : 0x80;
+        const uint8_t max = (size == 1) ? second_max : 0xBF;
+        if ((b < min) || (b > max)) {
+            return Utf8Sequence::INVALID;
+        }
+    }
+    return Utf8Sequence::VALID;
+}
+
+// returns the length of the valid utf-8 at the start of the data
+// total_incomplete is the length of a sequence which is cut off by the end of the data and follows it
+static size_t find_invalid_utf8(const uint8_t *src, const size_t length, size_t &total_incomplete) {
+    total_incomplete = 0;
+    size_t i = 0;
+    while (true) {
+        i += find_non_ascii(reinterpret_cast<const char *>(src + i), length - i);
+        if (i >= length) {
+            return length;
+        }
+        size_t size = 0;
+        const auto sequence = check_utf8_sequence(src + i, length - i, size);
+        if (sequence == Utf8Sequence::INCOMPLETE) {
+            total_incomplete = size;
+            return i;
+        }
+        if (sequence == Utf8Sequence::INVALID) {
+            return i;
+        }
+        i += size;
+    }
+}
+
+bool is_valid_utf8(const char *data, const size_t length) {
+    size_t total_incomplete = 0;
+    const size_t total_valid = find_invalid_utf8(reinterpret_cast<const uint8_t *>(data), length, total_incomplete);
+    return (total_valid + total_incomplete) == length;
+}
+
+OutputTranscoder::OutputTranscoder(const OutputEncoding encoding)
+: m_encoding(encoding), m_total_input(0), m_has_pending_byte(false), m_pending_byte(0), m_pending_surrogate(0),
+  m_total_utf8_carry(0)
+{
+    m_utf8_carry.fill(0);
+    for (auto &entry: m_codepage_table) {
+        entry.fill(0);
+    }
+    // auto detection falls back to the console codepage
+    if ((encoding != OutputEncoding::OEM) && (encoding != OutputEncoding::ANSI) && (encoding != OutputEncoding::AUTO)) {
+        return;
+    }
+
+    const bool is_ansi = (encoding == OutputEncoding::ANSI);
+    const uint32_t codepage = is_ansi ? platform::get_ansi_codepage() : platform::get_oem_codepage();
+    uint32_t code_points[256];
+    if (!platform::get_codepage_table(codepage, code_points)) {
+        const uint32_t fallback = is_ansi ? 1252 : 437;
+        if (codepage != fallback) {
+            spdlog::warn(fmt::format("Codepage {} can't be decoded, using codepage {} instead", codepage, fallback));
+        }
+        const uint16_t *upper = is_ansi ? CP1252_UPPER : CP437_UPPER;
+        for (uint32_t i = 0; i < 256; i++) {
+            code_points[i] = (i < 0x80) ? i : upper[i - 0x80];
+        }
+    }
+    for (size_t i = 0; i < 256; i++) {
+        auto &entry = m_codepage_table[i];
+        entry[3] = uint8_t(encode_utf8(code_points[i], entry.data()));
+    }
+}
+
+size_t OutputTranscoder::Convert(const char *src, const size_t length, char *dst) {
+    const uint8_t *input = reinterpret_cast<const uint8_t *>(src);
+    uint8_t *output = reinterpret_cast<uint8_t *>(dst);
+    size_t skip = 0;
+    if (GetEncoding() == OutputEncoding::AUTO) {
+        skip = DetectEncoding(input, length);
+    }
+
+    size_t total_written = 0;
+    switch (GetEncoding()) {
+    case OutputEncoding::UTF16LE:
+        total_written = ConvertUtf16(input + skip, length - skip, output);
+        break;
+    case OutputEncoding::OEM:
+    case OutputEncoding::ANSI:
+        total_written = ConvertCodepage(input + skip, length - skip, output);
+        break;
+    // the carried over start of a sequence is joined with the input so they are checked as one
+    case OutputEncoding::UTF8:
+        m_scratch.assign(m_utf8_carry.begin(), m_utf8_carry.begin() + m_total_utf8_carry);
+        m_scratch.insert(m_scratch.end(), input + skip, input + length);
+        m_total_utf8_carry = 0;
+        total_written = ConvertUtf8(m_scratch.data(), m_scratch.size(), output);
+        break;
+    // undecided output is plain ascii so it is the same in every encoding
+    case OutputEncoding::AUTO:
+    default:
+        memcpy(output, input + skip, length - skip);
+        total_written = length - skip;
+        break;
+    }
+    m_total_input += uint64_t(length);
+    return total_written;
+}
+
+size_t OutputTranscoder::WriteCarry(char *dst) {
+    const size_t total_carry = m_total_utf8_carry;
+    memcpy(dst, m_utf8_carry.data(), total_carry);
+    m_total_utf8_carry = 0;
+    return total_carry;
+}
+
+size_t OutputTranscoder::RepairUtf8(char *data, const size_t length) {
+    uint8_t *src = reinterpret_cast<uint8_t *>(data);
+    size_t total_incomplete = 0;
+    const size_t total_valid = find_invalid_utf8(src, length, total_incomplete);
+    if ((total_valid + total_incomplete) == length) {
+        memcpy(m_utf8_carry.data(), src + total_valid, total_incomplete);
+        m_total_utf8_carry = total_incomplete;
+        return total_valid;
+    }
+    // replacements can be longer than what they replace, so the rest is copied out and converted back in
+    m_scratch.assign(src + total_valid, src + length);
+    return total_valid + ConvertUtf8(m_scratch.data(), m_scratch.size(), src + total_valid);
+}
+
+size_t OutputTranscoder::DetectEncoding(const uint8_t *src, const size_t length) {
+    // byte order marks only mean something at the very start
+    if (m_total_input == 0) {
+        if ((length >= 2) && (src[0] == 0xFF) && (src[1] == 0xFE)) {
+            m_encoding = OutputEncoding::UTF16LE;
+            return 2;
+        }
+        if ((length >= 3) && (src[0] == 0xEF) && (src[1] == 0xBB) && (src[2] == 0xBF)) {
+            m_encoding = OutputEncoding::UTF8;
+            return 3;
+        }
+    }
+
+    // the high byte of ascii, latin, greek and cyrillic in utf-16 is a control character
+    // which text in the other encodings almost never has, least of all in every other byte
+    // the same goes for the high bytes of a surrogate pair
+    const size_t first_high_byte = ((m_total_input & 1) == 0) ? 1 : 0;
+    size_t total_matches = 0;
+    for (size_t i = first_high_byte; i < length; i += 2) {
+        const uint8_t c = src[i];
+        if ((c < 0x20) && (c != '\t') && (c != '\n') && (c != '\r') && (c != 0x1B)) {
+            total_matches++;
+        } else if (((c & 0xFC) == 0xD8) && ((i + 2) < length) && ((src[i+2] & 0xFC) == 0xDC)) {
+            total_matches += 2;
+            i += 2;
+        }
+    }
+    if ((total_matches > 0) && ((total_matches*2) >= (length/2))) {
+        m_encoding = OutputEncoding::UTF16LE;
+        // keep the code units aligned to the start of the output
+        return first_high_byte == 0 ? 1 : 0;
+    }
+
+    const char *data = reinterpret_cast<const char *>(src);
+    const size_t first_non_ascii = find_non_ascii(data, length);
+    if (first_non_ascii == length) {
+        return 0;
+    }
+    // text in a legacy codepage is almost never valid utf-8 once it has anything but ascii
+    if (is_valid_utf8(data + first_non_ascii, length - first_non_ascii)) {
+        m_encoding = OutputEncoding::UTF8;
+    } else {
+        m_encoding = OutputEncoding::OEM;
+    }
+    return 0;
+}
+
+size_t OutputTranscoder::ConvertUtf16(const uint8_t *src, const size_t length, uint8_t *dst) {
+    uint8_t *out = dst;
+    auto write_unit = [this, &out](uint16_t unit) {
+        const bool is_high_surrogate = (unit >= 0xD800) && (unit <= 0xDBFF);
+        const bool is_low_surrogate = (unit >= 0xDC00) && (unit <= 0xDFFF);
+        if (m_pending_surrogate != 0) {
+            if (is_low_surrogate) {
+                const uint32_t code_point = 0x10000 + (uint32_t(m_pending_surrogate - 0xD800) << 10) + uint32_t(unit - 0xDC00);
+                m_pending_surrogate = 0;
+                out += encode_utf8(code_point, out);
+                return;
+            }
+            m_pending_surrogate = 0;
+            out += encode_utf8(REPLACEMENT_CHARACTER, out);
+        }
+        if (is_high_surrogate) {
+            m_pending_surrogate = unit;
+            return;
+        }
+        out += encode_utf8(is_low_surrogate ? REPLACEMENT_CHARACTER : unit, out);
+    };
+
+    size_t i = 0;
+    if (m_has_pending_byte && (length > 0)) {
+        m_has_pending_byte = false;
+        write_unit(uint16_t(m_pending_byte | (uint16_t(src[0]) << 8)));
+        i = 1;
+    }
+
+    while ((i + 2) <= length) {
+#ifdef OUTPUT_TRANSCODER_SSE2
+        // runs of ascii are narrowed 16 code units at a time
+        if (m_pending_surrogate == 0) {
+            const __m128i non_ascii_mask = _mm_set1_epi16(int16_t(0xFF80));
+            const __m128i zero = _mm_setzero_si128();
+            for (; (i + 32) <= length; i += 32, out += 16) {
+                const __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+                const __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i + 16));
+                const __m128i non_ascii = _mm_and_si128(_mm_or_si128(lo, hi), non_ascii_mask);
+                if (_mm_movemask_epi8(_mm_cmpeq_epi16(non_ascii, zero)) != 0xFFFF) {
+                    break;
+                }
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(out), _mm_packus_epi16(lo, hi));
+            }
+        }
+#endif
+        // anything else goes a code unit at a time until the next block
+        const size_t block_end = i + (std::min(length - i, size_t(32)) & ~size_t(1));
+        for (; i < block_end; i += 2) {
+            write_unit(uint16_t(src[i] | (uint16_t(src[i+1]) << 8)));
+        }
+    }
+
+    if (i < length) {
+        m_pending_byte = src[i];
+        m_has_pending_byte = true;
+    }
+    return size_t(out - dst);
+}
+
+size_t OutputTranscoder::ConvertCodepage(const uint8_t *src, const size_t length, uint8_t *dst) const {
+    uint8_t *out = dst;
+    size_t i = 0;
+    while (i < length) {
+#ifdef OUTPUT_TRANSCODER_SSE2
+        // ascii is the same in every codepage we decode
+        for (; (i + 16) <= length; i += 16, out += 16) {
+            const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+            if (_mm_movemask_epi8(v) != 0) {
+                break;
+            }
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out), v);
+        }
+#endif
+        // the whole entry is copied and the length picks how much of it stays
+        // this can write one byte past the last character, which GetMaxOutputSize() leaves room for
+        const size_t block_end = std::min(length, i + 16);
+        for (; i < block_end; i++) {
+            const auto &entry = m_codepage_table[src[i]];
+            memcpy(out, entry.data(), 4);
+            out += entry[3];
+        }
+    }
+    return size_t(out - dst);
+}
+
+// each invalid sequence becomes one replacement character, which is never longer than 3 bytes per byte it replaces
+// the carried over start of a sequence is always valid so far, it can only add a single replacement character
+size_t OutputTranscoder::ConvertUtf8(const uint8_t *src, const size_t length, uint8_t *dst) {
+    uint8_t *out = dst;
+    size_t i = 0;
+    while (true) {
+        const size_t total_ascii = find_non_ascii(reinterpret_cast<const char *>(src + i), length - i);
+        memcpy(out, src + i, total_ascii);
+        out += total_ascii;
+        i += total_ascii;
+        if (i >= length) {
+            break;
+        }
+        size_t size = 0;
+        const auto sequence = check_utf8_sequence(src + i, length - i, size);
+        if (sequence == Utf8Sequence::INCOMPLETE) {
+            memcpy(m_utf8_carry.data(), src + i, size);
+            m_total_utf8_carry = size;
+            break;
+        }
+        if (sequence == Utf8Sequence::VALID) {
+            memcpy(out, src + i, size);
+            out += size;
+        } else {
+            out += encode_utf8(REPLACEMENT_CHARACTER, out);
+        }
+        i += size;
+    }
+    return size_t(out - dst);
+}
+
+}
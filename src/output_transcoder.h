@@ -0,0 +1,73 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <array>
+#include <atomic>
+#include <vector>
+
+#include "app_schema.h"
+
+namespace app {
+
+// converts the output of a child to utf-8 a chunk at a time as it is captured
+// code units, surrogate pairs and utf-8 sequences which are split across reads are carried over to the next call
+// invalid input becomes U+FFFD so the output is always valid utf-8, utf-8 input included
+class OutputTranscoder
+{
+public:
+    // a byte of input never becomes more than this many bytes of output, replacement characters included
+    static constexpr size_t MAX_EXPANSION = 3;
+    // output of the carried over byte and surrogate on top of that
+    static constexpr size_t MAX_CARRY_SIZE = 4;
+private:
+    // auto until the output shows what it is
+    std::atomic<OutputEncoding> m_encoding;
+    // utf-8 encoding of every byte of the legacy codepage, the length is the last byte
+    std::array<std::array<uint8_t, 4>, 256> m_codepage_table;
+    uint64_t m_total_input;
+    // odd byte of a utf-16 code unit split across two reads
+    bool m_has_pending_byte;
+    uint8_t m_pending_byte;
+    // high surrogate waiting for its low surrogate, 0 if none
+    uint16_t m_pending_surrogate;
+    // start of a utf-8 sequence waiting for the rest of it
+    std::array<uint8_t, 4> m_utf8_carry;
+    size_t m_total_utf8_carry;
+    // copy of the input while invalid utf-8 is replaced
+    std::vector<uint8_t> m_scratch;
+public:
+    OutputTranscoder(const OutputEncoding encoding=OutputEncoding::UTF8);
+    inline OutputEncoding GetEncoding() const { return m_encoding.load(std::memory_order_relaxed); }
+    // utf-8 output can be read straight into the buffer and repaired there with RepairUtf8()
+    inline bool IsPassthrough() const { return GetEncoding() == OutputEncoding::UTF8; }
+    inline static size_t GetMaxOutputSize(const size_t input_size) {
+        return input_size*MAX_EXPANSION + MAX_CARRY_SIZE;
+    }
+    // largest input which is guaranteed to fit, 0 if the output space is too small for any
+    inline static size_t GetMaxInputSize(const size_t output_size) {
+        return (output_size > MAX_CARRY_SIZE) ? (output_size - MAX_CARRY_SIZE) / MAX_EXPANSION : 0;
+    }
+    // dst needs room for GetMaxOutputSize(length) bytes, returns how many were written
+    size_t Convert(const char *src, const size_t length, char *dst);
+    // writes the start of a sequence carried over from the last read, returns its length
+    // the next read goes after it so the two are checked as one
+    size_t WriteCarry(char *dst);
+    // data is the carried over bytes followed by the read, with room for GetMaxOutputSize() of the read
+    // valid output is left where it is, it is only copied if it has sequences to replace
+    // returns the length to keep, a sequence cut off at the end is carried over instead
+    size_t RepairUtf8(char *data, const size_t length);
+private:
+    // returns the number of bytes to skip, i.e. a byte order mark
+    size_t DetectEncoding(const uint8_t *src, const size_t length);
+    size_t ConvertUtf16(const uint8_t *src, const size_t length, uint8_t *dst);
+    size_t ConvertCodepage(const uint8_t *src, const size_t length, uint8_t *dst) const;
+    size_t ConvertUtf8(const uint8_t *src, const size_t length, uint8_t *dst);
+};
+
+// index of the first byte which isn't ascii, length if there isn't one
+size_t find_non_ascii(const char *data, const size_t length);
+// a sequence cut off by the end of the data counts as valid since the rest may still be coming
+bool is_valid_utf8(const char *data, const size_t length);
+
+}
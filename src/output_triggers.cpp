@@ -0,0 +1,134 @@
+#include "output_triggers.h"
+
+#include <algorithm>
+
+#include <fmt/core.h>
+#include <spdlog/spdlog.h>
+
+#include "tracing.h"
+
+namespace app {
+
+static std::vector<std::string> get_patterns(const std::vector<TriggerRule> &rules, const std::string &ready_pattern) {
+    std::vector<std::string> patterns;
+    for (auto &rule: rules) {
+        patterns.push_back(rule.pattern);
+    }
+    if (!ready_pattern.empty()) {
+        patterns.push_back(ready_pattern);
+    }
+    return patterns;
+}
+
+OutputTriggers::OutputTriggers(const std::string &label, const std::vector<TriggerRule> &rules, const std::string &ready_pattern)
+: m_label(label), m_rules(rules), m_automaton(get_patterns(rules, ready_pattern))
+{
+    m_counts = std::make_unique<std::atomic<uint64_t>[]>(rules.size());
+    for (size_t i = 0; i < rules.size(); i++) {
+        m_counts[i] = 0;
+    }
+    m_scan_counts.resize(rules.size(), 0);
+    m_last_action_ns.resize(rules.size(), 0);
+    m_total_suppressed.resize(rules.size(), 0);
+}
+
+OutputTriggers::Events OutputTriggers::Scan(const char *data, const size_t length, const uint64_t offset) {
+    Events events;
+    if (IsEmpty()) {
+        return events;
+    }
+    TRACE_SCOPE("scan_triggers");
+
+    // counts and highlights are batched so the shared state is only touched once per chunk
+    auto &counts = m_scan_counts;
+    auto &highlights = m_scan_highlights;
+    std::fill(counts.begin(), counts.end(), 0);
+    highlights.clear();
+    bool is_match = false;
+    const uint32_t total_rules = uint32_t(m_rules.size());
+    m_automaton.Scan(data, length, [&](const uint32_t pattern, const size_t end) {
+        if (pattern >= total_rules) {
+            events.is_ready = true;
+            return;
+        }
+        is_match = true;
+        counts[pattern]++;
+        auto &rule = m_rules[pattern];
+        switch (rule.action) {
+        case TriggerAction::HIGHLIGHT:
+            // only the most recent ones are kept anyway
+            if (highlights.size() >= (2*MAX_HIGHLIGHTS)) {
+                highlights.erase(highlights.begin(), highlights.begin() + MAX_HIGHLIGHTS);
+            }
+            highlights.push_back(offset + uint64_t(end) - 1);
+            break;
+        case TriggerAction::NOTIFY:
+            if (!IsActionAllowed(pattern)) {
+                m_total_suppressed[pattern]++;
+                break;
+            }
+            if (m_total_suppressed[pattern] > 0) {
+                spdlog::warn(fmt::format("({}) printed ({}), {} more times since the last warning",
+                    m_label, rule.pattern, m_total_suppressed[pattern]));
+                m_total_suppressed[pattern] = 0;
+            } else {
+                spdlog::warn(fmt::format("({}) printed ({})", m_label, rule.pattern));
+            }
+            break;
+        case TriggerAction::TERMINATE:
+            events.is_terminate = true;
+            break;
+        case TriggerAction::LAUNCH:
+            if (IsActionAllowed(pattern)) {
+                auto lock = std::scoped_lock(m_mutex);
+                m_pending_launches.push_back(rule.launch_app);
+                events.is_launch = true;
+            }
+            break;
+        case TriggerAction::COUNT:
+        default:
+            break;
+        }
+    });
+    if (!is_match) {
+        return events;
+    }
+
+    for (size_t i = 0; i < counts.size(); i++) {
+        if (counts[i] > 0) {
+            m_counts[i].fetch_add(counts[i], std::memory_order_relaxed);
+        }
+    }
+    if (!highlights.empty()) {
+        auto lock = std::scoped_lock(m_mutex);
+        m_highlights.insert(m_highlights.end(), highlights.begin(), highlights.end());
+        while (m_highlights.size() > MAX_HIGHLIGHTS) {
+            m_highlights.pop_front();
+        }
+    }
+    return events;
+}
+
+bool OutputTriggers::IsActionAllowed(const uint32_t rule) {
+    const int64_t now = Tracer::GetTimestamp();
+    if ((m_last_action_ns[rule] != 0) && ((now - m_last_action_ns[rule]) < ACTION_INTERVAL_NS)) {
+        return false;
+    }
+    m_last_action_ns[rule] = now;
+    return true;
+}
+
+void OutputTriggers::GetHighlights(const uint64_t begin_offset, const uint64_t end_offset, std::vector<uint64_t> &highlights) {
+    highlights.clear();
+    auto lock = std::scoped_lock(m_mutex);
+    auto begin = std::lower_bound(m_highlights.begin(), m_highlights.end(), begin_offset);
+    auto end = std::lower_bound(begin, m_highlights.end(), end_offset);
+    highlights.insert(highlights.end(), begin, end);
+}
+
+std::vector<std::string> OutputTriggers::TakeLaunches() {
+    auto lock = std::scoped_lock(m_mutex);
+    return std::move(m_pending_launches);
+}
+
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "app_schema.h"
+#include "trigger_automaton.h"
+
+namespace app {
+
+// runs the trigger rules and ready pattern of an app over its output as it is captured
+// every pattern is compiled into one automaton so the output is only scanned once
+// the scan runs on the listener thread, the gui and the app read back the results
+class OutputTriggers
+{
+public:
+    // most recent highlighted matches kept for the output pane
+    static constexpr size_t MAX_HIGHLIGHTS = 0x1000;
+    // notifications and launches happen at most this often per rule
+    static constexpr int64_t ACTION_INTERVAL_NS = 1'000'000'000;
+    // actions which the listener thread has to carry out itself
+    struct Events {
+        bool is_ready = false;
+        bool is_terminate = false;
+        bool is_launch = false;
+    };
+private:
+    std::string m_label;
+    std::vector<TriggerRule> m_rules;
+    // the ready pattern is compiled in after the rules
+    TriggerAutomaton m_automaton;
+    std::unique_ptr<std::atomic<uint64_t>[]> m_counts;
+    // only touched by the listener thread
+    std::vector<uint64_t> m_scan_counts;
+    std::vector<uint64_t> m_scan_highlights;
+    std::vector<int64_t> m_last_action_ns;
+    std::vector<uint64_t> m_total_suppressed;
+    std::mutex m_mutex;
+    // absolute offset of the last byte of each highlighted match, ascending
+    std::deque<uint64_t> m_highlights;
+    std::vector<std::string> m_pending_launches;
+public:
+    OutputTriggers(const std::string &label, const std::vector<TriggerRule> &rules, const std::string &ready_pattern);
+    // offset is the absolute offset of the first byte of data in the scrolling buffer
+    Events Scan(const char *data, const size_t length, const uint64_t offset);
+    inline bool IsEmpty() const { return m_automaton.GetTotalPatterns() == 0; }
+    inline const std::vector<TriggerRule> &GetRules() const { return m_rules; }
+    inline uint64_t GetCount(const size_t rule) const { return m_counts[rule].load(std::memory_order_relaxed); }
+    // highlighted offsets within [begin_offset, end_offset) in ascending order
+    void GetHighlights(const uint64_t begin_offset, const uint64_t end_offset, std::vector<uint64_t> &highlights);
+    // apps to launch which were requested since the last call
+    std::vector<std::string> TakeLaunches();
+private:
+    bool IsActionAllowed(const uint32_t rule);
+};
+
+}
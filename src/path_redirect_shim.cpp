@@ -0,0 +1,423 @@
+// preload library which rewrites absolute paths before they reach the filesystem
+// catches programs which ignore HOME and XDG_*_HOME and open hard coded paths in the real home
+// the rewrite table is compiled by the launcher and mapped read only, see path_redirect_table.h
+// only absolute paths are rewritten, relative paths resolve against the working directory as usual
+#include <dlfcn.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "path_redirect_table.h"
+
+namespace {
+
+app::PathRedirectTable g_table;
+
+// map the table before main, raw system calls are used so our own hooks aren't entered
+__attribute__((constructor))
+void load_table() {
+    const char *filepath = getenv(app::PATH_REDIRECT_TABLE_ENV);
+    if (filepath == nullptr) {
+        return;
+    }
+    const int fd = int(syscall(SYS_openat, AT_FDCWD, filepath, O_RDONLY | O_CLOEXEC));
+    if (fd < 0) {
+        return;
+    }
+    struct stat st;
+    if ((fstat(fd, &st) != 0) || (st.st_size <= 0)) {
+        close(fd);
+        return;
+    }
+    void *data = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return;
+    }
+    // the mapping lives as long as the process
+    if (!g_table.Load(data, size_t(st.st_size))) {
+        munmap(data, size_t(st.st_size));
+    }
+}
+
+// buffer is on the caller's stack so nothing is allocated per call
+inline const char *redirect(const char *path, char *buffer) {
+    if ((path == nullptr) || (path[0] != '/')) {
+        return path;
+    }
+    return g_table.Rewrite(path, buffer, PATH_MAX) ? buffer : path;
+}
+
+// resolved on first use since other libraries can call in before our constructor runs
+template <typename T>
+T get_next(const char *name) {
+    return reinterpret_cast<T>(dlsym(RTLD_NEXT, name));
+}
+
+inline bool is_mode_needed(const int flags) {
+    return ((flags & O_CREAT) != 0) || ((flags & O_TMPFILE) == O_TMPFILE);
+}
+
+}
+
+// older glibc versions only export the versioned stat wrappers
+extern "C" {
+int __xstat(int ver, const char *path, struct stat *buf);
+int __lxstat(int ver, const char *path, struct stat *buf);
+int __xstat64(int ver, const char *path, struct stat64 *buf);
+int __lxstat64(int ver, const char *path, struct stat64 *buf);
+int __fxstatat(int ver, int dirfd, const char *path, struct stat *buf, int flags);
+int __fxstatat64(int ver, int dirfd, const char *path, struct stat64 *buf, int flags);
+}
+
+// binaries built with _FORTIFY_SOURCE call the checked versions instead
+extern "C" {
+int __open_2(const char *path, int flags);
+int __open64_2(const char *path, int flags);
+int __openat_2(int dirfd, const char *path, int flags);
+int __openat64_2(int dirfd, const char *path, int flags);
+char *__realpath_chk(const char *path, char *resolved_path, size_t resolved_length);
+}
+
+#define CALL_NEXT(name, ...) \
+    static auto next = get_next<decltype(&name)>(#name); \
+    if (next == nullptr) { errno = ENOSYS; return -1; } \
+    return next(__VA_ARGS__)
+
+extern "C" {
+
+int open(const char *path, int flags, ...) {
+    mode_t mode = 0;
+    if (is_mode_needed(flags)) {
+        va_list args;
+        va_start(args, flags);
+        mode = va_arg(args, mode_t);
+        va_end(args);
+    }
+    char buffer[PATH_MAX];
+    CALL_NEXT(open, redirect(path, buffer), flags, mode);
+}
+
+int open64(const char *path, int flags, ...) {
+    mode_t mode = 0;
+    if (is_mode_needed(flags)) {
+        va_list args;
+        va_start(args, flags);
+        mode = va_arg(args, mode_t);
+        va_end(args);
+    }
+    char buffer[PATH_MAX];
+    CALL_NEXT(open64, redirect(path, buffer), flags, mode);
+}
+
+int openat(int dirfd, const char *path, int flags, ...) {
+    mode_t mode = 0;
+    if (is_mode_needed(flags)) {
+        va_list args;
+        va_start(args, flags);
+        mode = va_arg(args, mode_t);
+        va_end(args);
+    }
+    char buffer[PATH_MAX];
+    CALL_NEXT(openat, dirfd, redirect(path, buffer), flags, mode);
+}
+
+int openat64(int dirfd, const char *path, int flags, ...) {
+    mode_t mode = 0;
+    if (is_mode_needed(flags)) {
+        va_list args;
+        va_start(args, flags);
+        mode = va_arg(args, mode_t);
+        va_end(args);
+    }
+    char buffer[PATH_MAX];
+    CALL_NEXT(openat64, dirfd, redirect(path, buffer), flags, mode);
+}
+
+int __open_2(const char *path, int flags) {
+    char buffer[PATH_MAX];
+    CALL_NEXT(__open_2, redirect(path, buffer), flags);
+}
+
+int __open64_2(const char *path, int flags) {
+    char buffer[PATH_MAX];
+    CALL_NEXT(__open64_2, redirect(path, buffer), flags);
+}
+
+int __openat_2(int dirfd, const char *path, int flags) {
+    char buffer[PATH_MAX];
+    CALL_NEXT(__openat_2, dirfd, redirect(path, buffer), flags);
+}
+
+int __openat64_2(int dirfd, const char *path, int flags) {
+    char buffer[PATH_MAX];
+    CALL_NEXT(__openat64_2, dirfd, redirect(path, buffer), flags);
+}
+
+int creat(const char *path, mode_t mode) {
+    char buffer[PATH_MAX];
+    CALL_NEXT(creat, redirect(path, buffer), mode);
+}
+
+int creat64(const char *path, mode_t mode) {
+    char buffer[PATH_MAX];
+    CALL_NEXT(creat64, redirect(path, buffer), mode);
+}
+
+FILE *fopen(const char *path, const char *mode) {
+    char buffer[PATH_MAX];
+    static auto next = get_next<decltype(&fopen)>("fopen");
+    if (next == nullptr) { errno = ENOSYS; return nullptr; }
+    return next(redirect(path, buffer), mode);
+}
+
+FILE *fopen64(const char *path, const char *mode) {
+    char buffer[PATH_MAX];
+    static auto next = get_next<decltype(&fopen64)>("fopen64");
+    if (next == nullptr) { errno = ENOSYS; return nullptr; }
+    return next(redirect(path, buffer), mode);
+}
+
+DIR *opendir(const char *path) {
+    char buffer[PATH_MAX];
+    static auto next = get_next<decltype(&opendir)>("opendir");
+    if (next == nullptr) { errno = ENOSYS; return nullptr; }
+    return next(redirect(path, buffer));
+}
+
+int stat(const char *path, struct stat *buf) {
+    char buffer[PATH_MAX];
+    CALL_NEXT(stat, redirect(path, buffer), buf);
+}
+
+int lstat(const char *path, struct stat *buf) {
+    char buffer[PATH_MAX];
+    CALL_NEXT(lstat, redirect(path, buffer), buf);
+}
+
+int stat64(const char *path, struct stat64 *buf) {
+    char buffer[PATH_MAX];
+    CALL_NEXT(stat64, redirect(path, buffer), buf);
+}
+
+int lstat64(const char *path, struct stat64 *buf) {
+    char buffer[PATH_MAX];
+    CALL_NEXT(lstat64, redirect(path, buffer), buf);
+}
+
+int fstatat(int dirfd, const char *path, struct stat *buf, int flags) {
+    char buffer[PATH_MAX];
+    CALL_NEXT(fstatat, dirfd, redirect(path, buffer), buf, flags);
+}
+
+int fstatat64(int dirfd, const char *path, struct stat64 *buf, int flags) {
+    char buffer[PATH_MAX];
+    CALL_NEXT(fstatat64, dirfd, redirect(path, buffer), buf, flags);
+}
+
+int statx(int dirfd, const char *path, int flags, unsigned int mask, struct statx *buf) {
+    char buffer[PATH_MAX];
+    CALL_NEXT(statx, dirfd, redirect(path, buffer), flags, mask, buf);
+}
+
+int __xstat(int ver, const char *path, struct stat *buf) {
+    char buffer[PATH_MAX];
+    CALL_NEXT(__xstat, ver, redirect(path, buffer), buf);
+}
+
+int __lxstat(int ver, const char *path, struct stat *buf) {
+    char buffer[PATH_MAX];
+    CALL_NEXT(__lxstat, ver, redirect(path, buffer), buf);
+}
+
+int __xstat64(int ver, const char *path, struct stat64 *buf) {
+    char buffer[PATH_MAX];
+    CALL_NEXT(__xstat64, ver, redirect(path, buffer), buf);
+}
+
+int __lxstat64(int ver, const char *path, struct stat64 *buf) {
+    char buffer[PATH_MAX];
+    CALL_NEXT(__lxstat64, ver, redirect(path, buffer), buf);
+}
+
+int __fxstatat(int ver, int dirfd, const char *path, struct stat *buf, int flags) {
+    char buffer[PATH_MAX];
+    CALL_NEXT(__fxstatat, ver, dirfd, redirect(path, buffer), buf, flags);
+}
+
+int __fxstatat64(int ver, int dirfd, const char *path, struct stat64 *buf, int flags) {
+    char buffer[PATH_MAX];
+    CALL_NEXT(__fxstatat64, ver, dirfd, redirect(path, buffer), buf, flags);
+}
+
+int access(const char *path, int mode) {
+    char buffer[PATH_MAX];
+    CALL_NEXT(access, redirect(path, buffer), mode);
+}
+
+int faccessat(int dirfd, const char *path, int mode, int flags) {
+    char buffer[PATH_MAX];
+    CALL_NEXT(faccessat, dirfd, redirect(path, buffer), mode, flags);
+}
+
+int mkdir(const char *path, mode_t mode) {
+    char buffer[PATH_MAX];
+    CALL_NEXT(mkdir, redirect(path, buffer), mode);
+}
+
+int mkdirat(int dirfd, const char *path, mode_t mode) {
+    char buffer[PATH_MAX];
+    CALL_NEXT(mkdirat, dirfd, redirect(path, buffer), mode);
+}
+
+int rmdir(const char *path) {
+    char buffer[PATH_MAX];
+    CALL_NEXT(rmdir, redirect(path, buffer));
+}
+
+int unlink(const char *path) {
+    char buffer[PATH_MAX];
+    CALL_NEXT(unlink, redirect(path, buffer));
+}
+
+int unlinkat(int dirfd, const char *path, int flags) {
+    char buffer[PATH_MAX];
+    CALL_NEXT(unlinkat, dirfd, redirect(path, buffer), flags);
+}
+
+// remove calls unlink or rmdir inside libc where our hooks don't see them
+int remove(const char *path) {
+    char buffer[PATH_MAX];
+    CALL_NEXT(remove, redirect(path, buffer));
+}
+
+int link(const char *old_path, const char *new_path) {
+    char old_buffer[PATH_MAX];
+    char new_buffer[PATH_MAX];
+    CALL_NEXT(link, redirect(old_path, old_buffer), redirect(new_path, new_buffer));
+}
+
+int linkat(int old_dirfd, const char *old_path, int new_dirfd, const char *new_path, int flags) {
+    char old_buffer[PATH_MAX];
+    char new_buffer[PATH_MAX];
+    CALL_NEXT(linkat, old_dirfd, redirect(old_path, old_buffer), new_dirfd, redirect(new_path, new_buffer), flags);
+}
+
+// the target is rewritten too since the kernel follows it later without asking us
+int symlink(const char *target, const char *link_path) {
+    char target_buffer[PATH_MAX];
+    char link_buffer[PATH_MAX];
+    CALL_NEXT(symlink, redirect(target, target_buffer), redirect(link_path, link_buffer));
+}
+
+int symlinkat(const char *target, int dirfd, const char *link_path) {
+    char target_buffer[PATH_MAX];
+    char link_buffer[PATH_MAX];
+    CALL_NEXT(symlinkat, redirect(target, target_buffer), dirfd, redirect(link_path, link_buffer));
+}
+
+int chmod(const char *path, mode_t mode) {
+    char buffer[PATH_MAX];
+    CALL_NEXT(chmod, redirect(path, buffer), mode);
+}
+
+int fchmodat(int dirfd, const char *path, mode_t mode, int flags) {
+    char buffer[PATH_MAX];
+    CALL_NEXT(fchmodat, dirfd, redirect(path, buffer), mode, flags);
+}
+
+int chown(const char *path, uid_t owner, gid_t group) {
+    char buffer[PATH_MAX];
+    CALL_NEXT(chown, redirect(path, buffer), owner, group);
+}
+
+int lchown(const char *path, uid_t owner, gid_t group) {
+    char buffer[PATH_MAX];
+    CALL_NEXT(lchown, redirect(path, buffer), owner, group);
+}
+
+int fchownat(int dirfd, const char *path, uid_t owner, gid_t group, int flags) {
+    char buffer[PATH_MAX];
+    CALL_NEXT(fchownat, dirfd, redirect(path, buffer), owner, group, flags);
+}
+
+// both paths are rewritten so a file saved through a temporary and renamed into place stays in the environment
+int rename(const char *old_path, const char *new_path) {
+    char old_buffer[PATH_MAX];
+    char new_buffer[PATH_MAX];
+    CALL_NEXT(rename, redirect(old_path, old_buffer), redirect(new_path, new_buffer));
+}
+
+int renameat(int old_dirfd, const char *old_path, int new_dirfd, const char *new_path) {
+    char old_buffer[PATH_MAX];
+    char new_buffer[PATH_MAX];
+    CALL_NEXT(renameat, old_dirfd, redirect(old_path, old_buffer), new_dirfd, redirect(new_path, new_buffer));
+}
+
+int renameat2(int old_dirfd, const char *old_path, int new_dirfd, const char *new_path, unsigned int flags) {
+    char old_buffer[PATH_MAX];
+    char new_buffer[PATH_MAX];
+    CALL_NEXT(renameat2, old_dirfd, redirect(old_path, old_buffer), new_dirfd, redirect(new_path, new_buffer), flags);
+}
+
+ssize_t readlink(const char *path, char *buf, size_t size) {
+    char buffer[PATH_MAX];
+    CALL_NEXT(readlink, redirect(path, buffer), buf, size);
+}
+
+ssize_t readlinkat(int dirfd, const char *path, char *buf, size_t size) {
+    char buffer[PATH_MAX];
+    CALL_NEXT(readlinkat, dirfd, redirect(path, buffer), buf, size);
+}
+
+// the resolved path is the one inside the environment
+char *realpath(const char *path, char *resolved_path) {
+    char buffer[PATH_MAX];
+    static auto next = get_next<decltype(&realpath)>("realpath");
+    if (next == nullptr) { errno = ENOSYS; return nullptr; }
+    return next(redirect(path, buffer), resolved_path);
+}
+
+char *__realpath_chk(const char *path, char *resolved_path, size_t resolved_length) {
+    char buffer[PATH_MAX];
+    static auto next = get_next<decltype(&__realpath_chk)>("__realpath_chk");
+    if (next == nullptr) { errno = ENOSYS; return nullptr; }
+    return next(redirect(path, buffer), resolved_path, resolved_length);
+}
+
+char *canonicalize_file_name(const char *path) {
+    char buffer[PATH_MAX];
+    static auto next = get_next<decltype(&canonicalize_file_name)>("canonicalize_file_name");
+    if (next == nullptr) { errno = ENOSYS; return nullptr; }
+    return next(redirect(path, buffer));
+}
+
+int chdir(const char *path) {
+    char buffer[PATH_MAX];
+    CALL_NEXT(chdir, redirect(path, buffer));
+}
+
+int truncate(const char *path, off_t length) {
+    char buffer[PATH_MAX];
+    CALL_NEXT(truncate, redirect(path, buffer), length);
+}
+
+int truncate64(const char *path, off64_t length) {
+    char buffer[PATH_MAX];
+    CALL_NEXT(truncate64, redirect(path, buffer), length);
+}
+
+int utimensat(int dirfd, const char *path, const struct timespec times[2], int flags) {
+    char buffer[PATH_MAX];
+    CALL_NEXT(utimensat, dirfd, redirect(path, buffer), times, flags);
+}
+
+}
@@ -0,0 +1,157 @@
+#include "path_redirect_table.h"
+
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <stdexcept>
+
+#include <fmt/core.h>
+
+#include "mount_sandbox.h"
+#include "platform.h"
+
+namespace app {
+
+namespace fs = std::filesystem;
+
+// prefixes are compared byte for byte so they need a canonical form
+static std::string normalise_prefix(const std::string &path) {
+    auto normal = fs::path(path).lexically_normal().generic_string();
+    while ((normal.size() > 1) && (normal.back() == '/')) {
+        normal.pop_back();
+    }
+    return normal;
+}
+
+std::vector<PathRedirect> get_path_redirects(const std::vector<SandboxMount> &mounts, const std::string &env_root) {
+    std::vector<PathRedirect> redirects;
+    const auto root = normalise_prefix(fs::absolute(env_root).string());
+    redirects.push_back({ root, root });
+    for (auto &mount: mounts) {
+        redirects.push_back({ mount.target, mount.source });
+    }
+    return redirects;
+}
+
+std::vector<uint8_t> compile_path_redirects(const std::vector<PathRedirect> &redirects) {
+    // byte trie which is compressed into a radix trie when it is flattened
+    struct BuildNode {
+        std::map<char, uint32_t> children;
+        uint32_t rule = PATH_REDIRECT_NO_RULE;
+    };
+    std::vector<BuildNode> build_nodes(1);
+    std::vector<PathRedirectRule> rules;
+    std::string strings;
+
+    for (auto &redirect: redirects) {
+        const auto from = normalise_prefix(redirect.from);
+        const auto to = normalise_prefix(redirect.to);
+        if ((from.size() < 2) || (from[0] != '/')) {
+            throw std::runtime_error(fmt::format("Path redirect needs an absolute directory below the root ({})", redirect.from));
+        }
+
+        uint32_t curr = 0;
+        for (const char c: from) {
+            auto it = build_nodes[curr].children.find(c);
+            if (it != build_nodes[curr].children.end()) {
+                curr = it->second;
+                continue;
+            }
+            const auto next = uint32_t(build_nodes.size());
+            build_nodes[curr].children.insert({c, next});
+            build_nodes.emplace_back();
+            curr = next;
+        }
+        if (build_nodes[curr].rule != PATH_REDIRECT_NO_RULE) {
+            throw std::runtime_error(fmt::format("Path redirect is given more than once ({})", from));
+        }
+
+        PathRedirectRule rule;
+        rule.from_length = uint32_t(from.size());
+        rule.to_offset = uint32_t(strings.size());
+        rule.to_length = uint32_t(to.size());
+        rule.is_pass_through = (from == to) ? 1 : 0;
+        strings.append(to);
+        build_nodes[curr].rule = uint32_t(rules.size());
+        rules.push_back(rule);
+    }
+
+    // chains of nodes with a single child and no rule become one labelled node
+    // children are placed together after their parent
+    std::vector<PathRedirectNode> nodes(1);
+    nodes[0] = { 0, 0, 0, 0, build_nodes[0].rule };
+    std::vector<std::pair<uint32_t, uint32_t>> pending = {{ 0, 0 }}; // (node, build node)
+    while (!pending.empty()) {
+        const auto [node_index, build_index] = pending.back();
+        pending.pop_back();
+        auto &children = build_nodes[build_index].children;
+        const auto first_child = uint32_t(nodes.size());
+        nodes[node_index].first_child = first_child;
+        nodes[node_index].total_children = uint32_t(children.size());
+        nodes.resize(nodes.size() + children.size());
+
+        uint32_t child_index = first_child;
+        for (auto [c, next]: children) {
+            std::string label(1, c);
+            while ((build_nodes[next].rule == PATH_REDIRECT_NO_RULE) && (build_nodes[next].children.size() == 1)) {
+                auto it = build_nodes[next].children.begin();
+                label.push_back(it->first);
+                next = it->second;
+            }
+            nodes[child_index] = {
+                uint32_t(strings.size()), uint32_t(label.size()),
+                0, 0, build_nodes[next].rule
+            };
+            strings.append(label);
+            pending.push_back({ child_index, next });
+            child_index++;
+        }
+    }
+
+    PathRedirectHeader header;
+    header.magic = PATH_REDIRECT_MAGIC;
+    header.version = PATH_REDIRECT_VERSION;
+    header.total_nodes = uint32_t(nodes.size());
+    header.total_rules = uint32_t(rules.size());
+    header.total_string_bytes = uint32_t(strings.size());
+    header.reserved = 0;
+
+    std::vector<uint8_t> table;
+    auto append = [&table](const void *data, const size_t size) {
+        auto *bytes = reinterpret_cast<const uint8_t *>(data);
+        table.insert(table.end(), bytes, bytes + size);
+    };
+    append(&header, sizeof(header));
+    append(nodes.data(), nodes.size()*sizeof(PathRedirectNode));
+    append(rules.data(), rules.size()*sizeof(PathRedirectRule));
+    append(strings.data(), strings.size());
+    return table;
+}
+
+// launched processes keep the table they were started with mapped, so it is never rewritten in place
+// the new table is written next to it and renamed over it, which leaves existing mappings on the old file
+void write_path_redirect_table(const std::string &filepath, const std::vector<uint8_t> &table) {
+    static std::atomic<uint64_t> total_writes = 0;
+    const auto temp_filepath = fmt::format("{}.{}.{}.tmp", filepath, platform::get_current_process_id(), total_writes++);
+    {
+        auto file = std::ofstream(temp_filepath, std::ios::binary | std::ios::trunc);
+        if (!file) {
+            throw std::runtime_error(fmt::format("Failed to open path redirect table ({})", temp_filepath));
+        }
+        file.write(reinterpret_cast<const char *>(table.data()), std::streamsize(table.size()));
+        if (!file) {
+            std::error_code ec;
+            fs::remove(temp_filepath, ec);
+            throw std::runtime_error(fmt::format("Failed to write path redirect table ({})", temp_filepath));
+        }
+    }
+    std::error_code ec;
+    fs::rename(temp_filepath, filepath, ec);
+    if (ec) {
+        fs::remove(temp_filepath, ec);
+        throw std::runtime_error(fmt::format("Failed to replace path redirect table ({}): {}", filepath, ec.message()));
+    }
+}
+
+}
@@ -0,0 +1,176 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+namespace app {
+
+// compiled table of path prefix rewrites which is mapped read only by the preload shim
+// the prefixes are stored as a radix trie so a lookup only walks the bytes of the path once
+// lookups never allocate since they run on every intercepted filesystem call
+constexpr uint32_t PATH_REDIRECT_MAGIC = 0x52485450; // "PTHR"
+constexpr uint32_t PATH_REDIRECT_VERSION = 1;
+constexpr uint32_t PATH_REDIRECT_NO_RULE = 0xFFFFFFFF;
+// environment variable the launcher uses to pass the table to the shim
+constexpr const char *PATH_REDIRECT_TABLE_ENV = "APPVIRTUALENV_PATH_REDIRECT_TABLE";
+
+struct PathRedirectHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t total_nodes;
+    uint32_t total_rules;
+    uint32_t total_string_bytes;
+    uint32_t reserved;
+};
+
+struct PathRedirectNode {
+    uint32_t label_offset;
+    uint32_t label_length;
+    // children are contiguous and sorted by the first byte of their label
+    uint32_t first_child;
+    uint32_t total_children;
+    uint32_t rule;
+};
+
+struct PathRedirectRule {
+    uint32_t from_length;
+    uint32_t to_offset;
+    uint32_t to_length;
+    // keeps paths under this prefix as they are, e.g. the environment root itself
+    uint32_t is_pass_through;
+};
+
+// read only view over a compiled table
+class PathRedirectTable
+{
+private:
+    const PathRedirectNode *m_nodes = nullptr;
+    const PathRedirectRule *m_rules = nullptr;
+    const char *m_strings = nullptr;
+    bool m_is_loaded = false;
+public:
+    // checks every offset once so lookups can trust the table
+    bool Load(const void *data, const size_t size) {
+        m_is_loaded = false;
+        if ((data == nullptr) || (size < sizeof(PathRedirectHeader))) {
+            return false;
+        }
+        auto *header = reinterpret_cast<const PathRedirectHeader *>(data);
+        if ((header->magic != PATH_REDIRECT_MAGIC) || (header->version != PATH_REDIRECT_VERSION) || (header->total_nodes == 0)) {
+            return false;
+        }
+        const size_t expected_size =
+            sizeof(PathRedirectHeader) +
+            size_t(header->total_nodes)*sizeof(PathRedirectNode) +
+            size_t(header->total_rules)*sizeof(PathRedirectRule) +
+            size_t(header->total_string_bytes);
+        if (size < expected_size) {
+            return false;
+        }
+        auto *bytes = reinterpret_cast<const uint8_t *>(data) + sizeof(PathRedirectHeader);
+        auto *nodes = reinterpret_cast<const PathRedirectNode *>(bytes);
+        bytes += size_t(header->total_nodes)*sizeof(PathRedirectNode);
+        auto *rules = reinterpret_cast<const PathRedirectRule *>(bytes);
+        bytes += size_t(header->total_rules)*sizeof(PathRedirectRule);
+        auto *strings = reinterpret_cast<const char *>(bytes);
+
+        for (uint32_t i = 0; i < header->total_nodes; i++) {
+            auto &node = nodes[i];
+            if ((uint64_t(node.label_offset) + node.label_length) > header->total_string_bytes) return false;
+            if ((i != 0) && (node.label_length == 0)) return false;
+            // children always come after their parent so a walk can't loop
+            if ((node.total_children > 0) && (node.first_child <= i)) return false;
+            if ((uint64_t(node.first_child) + node.total_children) > header->total_nodes) return false;
+            if ((node.rule != PATH_REDIRECT_NO_RULE) && (node.rule >= header->total_rules)) return false;
+        }
+        for (uint32_t i = 0; i < header->total_rules; i++) {
+            auto &rule = rules[i];
+            if ((uint64_t(rule.to_offset) + rule.to_length) > header->total_string_bytes) return false;
+        }
+
+        m_nodes = nodes;
+        m_rules = rules;
+        m_strings = strings;
+        m_is_loaded = true;
+        return true;
+    }
+
+    inline bool IsLoaded() const { return m_is_loaded; }
+
+    // longest prefix which ends on a path component boundary
+    const PathRedirectRule *Find(const char *path) const {
+        if (!m_is_loaded || (path == nullptr)) {
+            return nullptr;
+        }
+        const PathRedirectRule *best = nullptr;
+        const PathRedirectNode *node = &m_nodes[0];
+        size_t pos = 0;
+        while (true) {
+            const char c = path[pos];
+            if ((node->rule != PATH_REDIRECT_NO_RULE) && ((c == '\0') || (c == '/'))) {
+                best = &m_rules[node->rule];
+            }
+            if (c == '\0') {
+                break;
+            }
+            const PathRedirectNode *next = nullptr;
+            for (uint32_t i = 0; i < node->total_children; i++) {
+                auto *child = &m_nodes[node->first_child + i];
+                if (m_strings[child->label_offset] == c) {
+                    next = child;
+                    break;
+                }
+            }
+            if (next == nullptr) {
+                break;
+            }
+            // the path's terminator never matches a label byte so this stops at the end of the path
+            const char *label = &m_strings[next->label_offset];
+            uint32_t total_matched = 1;
+            while ((total_matched < next->label_length) && (label[total_matched] == path[pos + total_matched])) {
+                total_matched++;
+            }
+            if (total_matched != next->label_length) {
+                break;
+            }
+            pos += next->label_length;
+            node = next;
+        }
+        return best;
+    }
+
+    // returns false if the path is left as it is or the rewritten path doesn't fit
+    bool Rewrite(const char *path, char *out, const size_t out_size) const {
+        auto *rule = Find(path);
+        if ((rule == nullptr) || rule->is_pass_through) {
+            return false;
+        }
+        const char *suffix = &path[rule->from_length];
+        const size_t suffix_length = strlen(suffix);
+        if ((size_t(rule->to_length) + suffix_length + 1) > out_size) {
+            return false;
+        }
+        memcpy(out, &m_strings[rule->to_offset], rule->to_length);
+        memcpy(&out[rule->to_length], suffix, suffix_length + 1);
+        return true;
+    }
+};
+
+struct PathRedirect {
+    std::string from;
+    std::string to;     // same as from for a pass through
+};
+
+struct SandboxMount;
+
+// rewrite each real directory to the environment directory that replaces it
+// paths inside the environment root are passed through so they are never rewritten twice
+std::vector<PathRedirect> get_path_redirects(const std::vector<SandboxMount> &mounts, const std::string &env_root);
+// throws if a prefix isn't an absolute path or the same prefix is given twice
+std::vector<uint8_t> compile_path_redirects(const std::vector<PathRedirect> &redirects);
+void write_path_redirect_table(const std::string &filepath, const std::vector<uint8_t> &table);
+
+}
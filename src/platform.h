@@ -0,0 +1,180 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace app {
+class ForkServer;
+}
+
+// everything the core needs from the operating system, implemented in platform_win32.cpp and platform_posix.cpp
+// nothing outside of those files should include windows.h or the posix headers
+namespace app::platform {
+
+// mirrored ring memory
+// the same pages are mapped twice back to back, so a read or write that runs off the end of the ring
+// continues at the start of it without being split
+// the size has to be a multiple of get_ring_granularity()
+size_t get_ring_granularity();
+// returns nullptr on failure
+// a ring with a shared name can be opened read only by other processes with open_shared_ring_buffer()
+char *create_ring_buffer(const size_t size, char **mirror, const std::string &shared_name="");
+// the size is that of the ring being opened
+const char *open_shared_ring_buffer(const std::string &name, size_t &size, const char **mirror);
+void free_ring_buffer(const char *ring, const char *mirror, const size_t size);
+
+// named shared memory, created writable by us and opened read only by other processes
+// names are a single identifier without slashes, returns nullptr on failure
+void *create_shared_memory(const std::string &name, const size_t size);
+const void *open_shared_memory(const std::string &name, size_t &size);
+void free_shared_memory(const void *memory, const size_t size);
+// removes the name of shared memory or a shared ring, existing mappings of it stay valid
+// on windows the name goes away with the last mapping so this does nothing
+void unlink_shared_memory(const std::string &name);
+
+uint32_t get_current_process_id();
+
+// environment of our own process as key=value strings
+std::vector<std::string> read_env_strings();
+void set_env_variable(const std::string &key, const std::string &value);
+void unset_env_variable(const std::string &key);
+
+// local stream sockets
+// unix domain sockets on both platforms, windows has supported AF_UNIX since windows 10 1803
+#ifdef _WIN32
+typedef uintptr_t socket_t;
+#else
+typedef int socket_t;
+#endif
+static constexpr socket_t INVALID_SOCKET_T = socket_t(-1);
+
+// throws if the socket couldn't be created
+// a socket file left behind by a listener which is gone is replaced, a live one is an error
+// on linux the socket can only be connected to by our user, and a missing parent directory is created private to us
+socket_t listen_local_socket(const std::string &path);
+socket_t connect_local_socket(const std::string &path);
+// returns INVALID_SOCKET_T if there isn't a pending connection
+// the listener and the sockets it accepts are non-blocking, connected sockets are blocking
+socket_t accept_local_socket(const socket_t listener);
+// false if the other end runs as another user
+// always true on windows, where the socket is in the user's own temp directory
+bool is_local_socket_peer_trusted(const socket_t socket);
+// wakes up a thread blocked on the socket without closing it
+void shutdown_socket(const socket_t socket);
+void close_socket(const socket_t socket);
+// bytes sent or received, 0 if a non-blocking socket would block, -1 if the socket was closed or failed
+int64_t send_socket(const socket_t socket, const char *data, const size_t length);
+int64_t recv_socket(const socket_t socket, char *data, const size_t length);
+// gathers the buffers into a single send so they don't have to be copied together first
+struct SocketBuffer {
+    const char *data;
+    size_t length;
+};
+// buffers past the limit are left for the next send
+static constexpr size_t MAX_SOCKET_BUFFERS = 64;
+int64_t send_socket_vectored(const socket_t socket, const SocketBuffer *buffers, const size_t total_buffers);
+
+struct SocketPoll {
+    socket_t socket;
+    bool is_write = false;      // also wake up when it can be written to
+    bool is_readable = false;   // readable includes closed, so the next recv returns -1
+    bool is_writable = false;
+};
+// returns false on failure, a timeout isn't a failure
+bool poll_sockets(std::vector<SocketPoll> &sockets, const int timeout_ms);
+
+// false if there is no clipboard, e.g. a linux machine without a display
+bool copy_to_clipboard(const char *buffer, const size_t length);
+std::string wide_string_to_string(const std::wstring &wide_string);
+// legacy codepages children write in when they aren't using unicode
+uint32_t get_oem_codepage();
+uint32_t get_ansi_codepage();
+// code point of every byte of a single byte codepage, false if the system can't decode it
+bool get_codepage_table(const uint32_t codepage, uint32_t code_points[256]);
+
+// dimensions of the pseudo terminal given to a child process
+struct TerminalSize {
+    int16_t columns = 120;
+    int16_t rows = 30;
+};
+
+struct SpawnParams {
+    std::string exec_path;
+    // command line after the executable, on posix it is split into arguments the way the windows c runtime would
+    std::string args;
+    std::string cwd;
+    // null separated key=value pairs ending with an extra null, from create_env_string()
+    std::string env_block;
+    bool use_pty = false;
+    TerminalSize terminal_size;
+    // runs in the child between fork and exec, after its stdio is setup and before it changes directory
+    // it can only make system calls, returns 0 or an errno with the name of the step which failed
+    // the process is forked instead of spawned when this is set, ignored on windows
+    std::function<int (const char *&failed_step)> pre_exec;
+};
+
+#ifdef __linux__
+// launches with plain pipes and no pre exec hook are spawned by the fork server while one is set
+// the server has to outlive every process spawned through it, pass nullptr to spawn directly again
+void set_fork_server(ForkServer *server);
+#endif
+
+// child process with its stdio redirected to us
+// with a pseudo terminal stdout and stderr are merged into the single output stream of the terminal
+// the listener thread reads from it and waits on it, writes and resizes come from the gui thread
+class ChildProcess
+{
+public:
+    enum class Stream { STDOUT, STDERR };
+private:
+#ifdef _WIN32
+    void *m_process = nullptr;          // HANDLE
+    void *m_write_std_in = nullptr;
+    void *m_read_std_out = nullptr;
+    void *m_read_std_err = nullptr;
+    void *m_pseudo_console = nullptr;   // HPCON
+#else
+    int m_pid = -1;
+    int m_write_std_in = -1;
+    int m_read_std_out = -1;            // pseudo terminal master if there is one
+    int m_read_std_err = -1;
+    bool m_is_pseudo_console_open = false;
+    // the fork server is the parent of processes it spawned, so it reaps them and we signal them by pidfd
+    ForkServer *m_fork_server = nullptr;
+    int m_pidfd = -1;
+    // the process is reaped as soon as we see it exit, so we keep its exit code around
+    std::mutex m_exit_mutex;
+    bool m_is_exited = false;
+    int64_t m_exit_code = -1;
+#endif
+    bool m_is_pseudo_terminal = false;
+    std::mutex m_pseudo_console_mutex;
+public:
+    // throws if the process couldn't be started
+    ChildProcess(const SpawnParams &params);
+    ~ChildProcess();
+    ChildProcess(const ChildProcess &) = delete;
+    ChildProcess &operator=(const ChildProcess &) = delete;
+    inline bool IsPseudoTerminal() const { return m_is_pseudo_terminal; }
+    // bytes which can be read without blocking, returns false if the stream is broken
+    // a stream the process doesn't have, e.g. stderr with a pseudo terminal, is never broken or readable
+    bool GetPendingSize(const Stream stream, size_t &total_pending);
+    // returns false if the stream is broken
+    bool Read(const Stream stream, char *buffer, const size_t size, size_t &total_read);
+    size_t Write(const char *data, const size_t length);
+    bool HasExited();
+    // returns false if the process hadn't exited before the timeout
+    bool WaitForExit(const uint32_t timeout_ms, int64_t &exit_code);
+    bool Terminate();
+    // ignored if the process was launched with plain pipes or the pseudo terminal is closed
+    bool Resize(const TerminalSize size);
+    // once the output has been drained after the process exits
+    void ClosePseudoTerminal();
+};
+
+}
@@ -0,0 +1,906 @@
+#include "platform.h"
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <stdexcept>
+#include <thread>
+
+#include <spdlog/spdlog.h>
+#include <fmt/core.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <termios.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include "fork_server.h"
+#endif
+
+extern char **environ;
+
+namespace app::platform {
+
+static void warn_and_throw_errno(const std::string &message) {
+    const auto error = fmt::format("{} ({})", message, strerror(errno));
+    spdlog::warn(error);
+    throw std::runtime_error(error);
+}
+
+// ring memory
+size_t get_ring_granularity() {
+    return size_t(sysconf(_SC_PAGESIZE));
+}
+
+// a shared memory file mapped twice into a reserved region twice its size
+// the reservation means nothing else can be mapped between the two views
+static char *map_ring_views(const int fd, const size_t size, const int protection) {
+    char *placeholder = (char *)(mmap(nullptr, 2*size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+    if (placeholder == MAP_FAILED) {
+        spdlog::warn("Failed to reserve ring buffer ({})", strerror(errno));
+        return nullptr;
+    }
+
+    // each view replaces its half of the reservation
+    void *view1 = mmap(placeholder, size, protection, MAP_SHARED | MAP_FIXED, fd, 0);
+    void *view2 = (view1 != MAP_FAILED) ?
+        mmap(placeholder + size, size, protection, MAP_SHARED | MAP_FIXED, fd, 0) : MAP_FAILED;
+    if ((view1 == MAP_FAILED) || (view2 == MAP_FAILED)) {
+        spdlog::warn("Failed to map ring buffer views ({})", strerror(errno));
+        munmap(placeholder, 2*size);
+        return nullptr;
+    }
+    return placeholder;
+}
+
+// shm_open() names are a single path component with a leading slash
+static std::string get_shared_memory_name(const std::string &name) {
+    return "/" + name;
+}
+
+// a name left behind by a process which died with the same pid as us is replaced
+static int create_shared_memory_file(const std::string &name) {
+    const auto shm_name = get_shared_memory_name(name);
+    int fd = shm_open(shm_name.c_str(), O_CREAT | O_EXCL | O_RDWR | O_CLOEXEC, 0600);
+    if ((fd < 0) && (errno == EEXIST)) {
+        shm_unlink(shm_name.c_str());
+        fd = shm_open(shm_name.c_str(), O_CREAT | O_EXCL | O_RDWR | O_CLOEXEC, 0600);
+    }
+    return fd;
+}
+
+char *create_ring_buffer(const size_t size, char **mirror, const std::string &shared_name) {
+    if ((size == 0) || ((size % get_ring_granularity()) != 0)) {
+        return nullptr;
+    }
+
+    const int fd = shared_name.empty() ?
+        memfd_create("scrolling_buffer", MFD_CLOEXEC) :
+        create_shared_memory_file(shared_name);
+    if (fd < 0) {
+        spdlog::warn("Failed to create shared memory for ring buffer ({})", strerror(errno));
+        return nullptr;
+    }
+    if (ftruncate(fd, off_t(size)) != 0) {
+        spdlog::warn("Failed to size shared memory for ring buffer ({})", strerror(errno));
+        close(fd);
+        if (!shared_name.empty()) unlink_shared_memory(shared_name);
+        return nullptr;
+    }
+
+    char *ring = map_ring_views(fd, size, PROT_READ | PROT_WRITE);
+    // the views keep the memory alive
+    close(fd);
+    if (ring == nullptr) {
+        if (!shared_name.empty()) unlink_shared_memory(shared_name);
+        return nullptr;
+    }
+    *mirror = ring + size;
+    return ring;
+}
+
+const char *open_shared_ring_buffer(const std::string &name, size_t &size, const char **mirror) {
+    const int fd = shm_open(get_shared_memory_name(name).c_str(), O_RDONLY | O_CLOEXEC, 0);
+    if (fd < 0) {
+        return nullptr;
+    }
+    struct stat info;
+    if ((fstat(fd, &info) != 0) || (info.st_size <= 0) || ((size_t(info.st_size) % get_ring_granularity()) != 0)) {
+        close(fd);
+        return nullptr;
+    }
+    size = size_t(info.st_size);
+    const char *ring = map_ring_views(fd, size, PROT_READ);
+    close(fd);
+    if (ring == nullptr) {
+        return nullptr;
+    }
+    *mirror = ring + size;
+    return ring;
+}
+
+void free_ring_buffer(const char *ring, const char *mirror, const size_t size) {
+    munmap((void *)(ring), size);
+    munmap((void *)(mirror), size);
+}
+
+void *create_shared_memory(const std::string &name, const size_t size) {
+    const int fd = create_shared_memory_file(name);
+    if (fd < 0) {
+        spdlog::warn("Failed to create shared memory ({}): {}", name, strerror(errno));
+        return nullptr;
+    }
+    void *memory = (ftruncate(fd, off_t(size)) == 0) ?
+        mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+    close(fd);
+    if (memory == MAP_FAILED) {
+        spdlog::warn("Failed to map shared memory ({}): {}", name, strerror(errno));
+        unlink_shared_memory(name);
+        return nullptr;
+    }
+    return memory;
+}
+
+const void *open_shared_memory(const std::string &name, size_t &size) {
+    const int fd = shm_open(get_shared_memory_name(name).c_str(), O_RDONLY | O_CLOEXEC, 0);
+    if (fd < 0) {
+        return nullptr;
+    }
+    struct stat info;
+    void *memory = MAP_FAILED;
+    if ((fstat(fd, &info) == 0) && (info.st_size > 0)) {
+        size = size_t(info.st_size);
+        memory = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    return (memory != MAP_FAILED) ? memory : nullptr;
+}
+
+void free_shared_memory(const void *memory, const size_t size) {
+    munmap((void *)(memory), size);
+}
+
+// existing mappings stay valid, only the name goes away
+void unlink_shared_memory(const std::string &name) {
+    shm_unlink(get_shared_memory_name(name).c_str());
+}
+
+uint32_t get_current_process_id() {
+    return uint32_t(getpid());
+}
+
+// environment
+std::vector<std::string> read_env_strings() {
+    std::vector<std::string> env_strings;
+    for (char **i = environ; *i != nullptr; i++) {
+        env_strings.emplace_back(*i);
+    }
+    return env_strings;
+}
+
+void set_env_variable(const std::string &key, const std::string &value) {
+    setenv(key.c_str(), value.c_str(), 1);
+}
+
+void unset_env_variable(const std::string &key) {
+    unsetenv(key.c_str());
+}
+
+// local sockets
+static sockaddr_un get_socket_address(const std::string &path) {
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) {
+        throw std::runtime_error(fmt::format("Socket path is too long ({})", path));
+    }
+    memcpy(address.sun_path, path.c_str(), path.size()+1);
+    return address;
+}
+
+socket_t listen_local_socket(const std::string &path) {
+    const auto address = get_socket_address(path);
+    // a socket nobody is listening on is left over from a listener that didn't exit cleanly
+    if (std::filesystem::exists(path)) {
+        bool is_listening = false;
+        try {
+            close_socket(connect_local_socket(path));
+            is_listening = true;
+        } catch (std::runtime_error &) {}
+        if (is_listening) {
+            throw std::runtime_error(fmt::format("Socket is already being listened on ({})", path));
+        }
+        if ((unlink(path.c_str()) != 0) && (errno != ENOENT)) {
+            warn_and_throw_errno(fmt::format("Failed to remove stale socket ({})", path));
+        }
+    }
+
+    const auto parent_path = std::filesystem::path(path).parent_path();
+    if (!parent_path.empty() && (mkdir(parent_path.c_str(), 0700) != 0)) {
+        if (errno != EEXIST) {
+            warn_and_throw_errno(fmt::format("Failed to create socket directory ({})", parent_path.string()));
+        }
+        // another user could have made it first to swap the socket out from under us
+        struct stat st;
+        if ((stat(parent_path.c_str(), &st) == 0) && (st.st_uid != getuid()) && (st.st_uid != 0)) {
+            throw std::runtime_error(fmt::format("Socket directory is owned by another user ({})", parent_path.string()));
+        }
+    }
+
+    const int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if (fd < 0) {
+        warn_and_throw_errno("Failed to create socket");
+    }
+    // the socket file gets its mode from our umask, so it is narrowed before anyone can connect
+    if ((bind(fd, (const sockaddr *)(&address), sizeof(address)) != 0) ||
+        (chmod(path.c_str(), 0600) != 0) ||
+        (listen(fd, SOMAXCONN) != 0))
+    {
+        const int error = errno;
+        close(fd);
+        errno = error;
+        warn_and_throw_errno(fmt::format("Failed to listen on socket ({})", path));
+    }
+    return fd;
+}
+
+socket_t connect_local_socket(const std::string &path) {
+    const auto address = get_socket_address(path);
+    const int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        warn_and_throw_errno("Failed to create socket");
+    }
+    if (connect(fd, (const sockaddr *)(&address), sizeof(address)) != 0) {
+        const int error = errno;
+        close(fd);
+        throw std::runtime_error(fmt::format("Failed to connect to socket ({}): {}", path, strerror(error)));
+    }
+    return fd;
+}
+
+socket_t accept_local_socket(const socket_t listener) {
+    int fd = -1;
+    do {
+        fd = accept4(listener, nullptr, nullptr, SOCK_CLOEXEC | SOCK_NONBLOCK);
+    } while ((fd < 0) && (errno == EINTR));
+    return (fd >= 0) ? fd : INVALID_SOCKET_T;
+}
+
+bool is_local_socket_peer_trusted(const socket_t socket) {
+#ifdef __linux__
+    ucred credentials = {};
+    socklen_t length = sizeof(credentials);
+    if (getsockopt(socket, SOL_SOCKET, SO_PEERCRED, &credentials, &length) != 0) {
+        return false;
+    }
+    return credentials.uid == getuid();
+#else
+    uid_t uid;
+    gid_t gid;
+    if (getpeereid(socket, &uid, &gid) != 0) {
+        return false;
+    }
+    return uid == getuid();
+#endif
+}
+
+void shutdown_socket(const socket_t socket) {
+    shutdown(socket, SHUT_RDWR);
+}
+
+void close_socket(const socket_t socket) {
+    close(socket);
+}
+
+int64_t send_socket(const socket_t socket, const char *data, const size_t length) {
+    while (true) {
+        // a closed peer is reported as an error instead of raising sigpipe
+        const ssize_t rv = send(socket, data, length, MSG_NOSIGNAL);
+        if (rv >= 0) {
+            return int64_t(rv);
+        }
+        if (errno == EINTR) {
+            continue;
+        }
+        return ((errno == EAGAIN) || (errno == EWOULDBLOCK)) ? 0 : -1;
+    }
+}
+
+int64_t send_socket_vectored(const socket_t socket, const SocketBuffer *buffers, const size_t total_buffers) {
+    iovec iov[MAX_SOCKET_BUFFERS];
+    const size_t total_iov = std::min(total_buffers, MAX_SOCKET_BUFFERS);
+    for (size_t i = 0; i < total_iov; i++) {
+        iov[i].iov_base = const_cast<char *>(buffers[i].data);
+        iov[i].iov_len = buffers[i].length;
+    }
+    msghdr msg = {};
+    msg.msg_iov = iov;
+    msg.msg_iovlen = total_iov;
+    while (true) {
+        const ssize_t rv = sendmsg(socket, &msg, MSG_NOSIGNAL);
+        if (rv >= 0) {
+            return int64_t(rv);
+        }
+        if (errno == EINTR) {
+            continue;
+        }
+        return ((errno == EAGAIN) || (errno == EWOULDBLOCK)) ? 0 : -1;
+    }
+}
+
+int64_t recv_socket(const socket_t socket, char *data, const size_t length) {
+    while (true) {
+        const ssize_t rv = recv(socket, data, length, 0);
+        if (rv > 0) {
+            return int64_t(rv);
+        }
+        if (rv == 0) {
+            return -1;
+        }
+        if (errno == EINTR) {
+            continue;
+        }
+        return ((errno == EAGAIN) || (errno == EWOULDBLOCK)) ? 0 : -1;
+    }
+}
+
+bool poll_sockets(std::vector<SocketPoll> &sockets, const int timeout_ms) {
+    std::vector<pollfd> poll_fds(sockets.size());
+    for (size_t i = 0; i < sockets.size(); i++) {
+        poll_fds[i] = { sockets[i].socket, short(sockets[i].is_write ? (POLLIN | POLLOUT) : POLLIN), 0 };
+    }
+    const int rv = poll(poll_fds.data(), nfds_t(poll_fds.size()), timeout_ms);
+    if ((rv < 0) && (errno != EINTR)) {
+        return false;
+    }
+    for (size_t i = 0; i < sockets.size(); i++) {
+        const short revents = (rv > 0) ? poll_fds[i].revents : 0;
+        sockets[i].is_readable = (revents & (POLLIN | POLLHUP | POLLERR | POLLNVAL)) != 0;
+        sockets[i].is_writable = (revents & POLLOUT) != 0;
+    }
+    return true;
+}
+
+// clipboard
+// there is no clipboard api without a display server, so we hand it to the clipboard tool of the session
+bool copy_to_clipboard(const char *buffer, const size_t length) {
+    const char *command = nullptr;
+    if (getenv("WAYLAND_DISPLAY") != nullptr) {
+        command = "wl-copy";
+    } else if (getenv("DISPLAY") != nullptr) {
+        command = "xclip -selection clipboard";
+    } else {
+        return false;
+    }
+
+    FILE *pipe = popen(command, "w");
+    if (pipe == nullptr) {
+        return false;
+    }
+    const size_t total_written = fwrite(buffer, 1, length, pipe);
+    return (pclose(pipe) == 0) && (total_written == length);
+}
+
+// wchar_t holds a whole code point here, so this is just utf-8 encoding
+std::string wide_string_to_string(const std::wstring& wide_string) {
+    std::string result;
+    result.reserve(wide_string.size());
+    for (const wchar_t c: wide_string) {
+        const uint32_t x = uint32_t(c);
+        if (x < 0x80) {
+            result.push_back(char(x));
+        } else if (x < 0x800) {
+            result.push_back(char(0xC0 | (x >> 6)));
+            result.push_back(char(0x80 | (x & 0x3F)));
+        } else if (x < 0x10000) {
+            result.push_back(char(0xE0 | (x >> 12)));
+            result.push_back(char(0x80 | ((x >> 6) & 0x3F)));
+            result.push_back(char(0x80 | (x & 0x3F)));
+        } else if (x < 0x110000) {
+            result.push_back(char(0xF0 | (x >> 18)));
+            result.push_back(char(0x80 | ((x >> 12) & 0x3F)));
+            result.push_back(char(0x80 | ((x >> 6) & 0x3F)));
+            result.push_back(char(0x80 | (x & 0x3F)));
+        } else {
+            throw std::runtime_error(fmt::format("Invalid code point in wide string: {:#x}", x));
+        }
+    }
+    return result;
+}
+
+// there is no system codepage so we assume what a windows console would use
+uint32_t get_oem_codepage() {
+    return 437;
+}
+
+uint32_t get_ansi_codepage() {
+    return 1252;
+}
+
+bool get_codepage_table(const uint32_t, uint32_t[256]) {
+    return false;
+}
+
+// child process
+
+// split a command line the way CommandLineToArgvW does, so app configs work the same on every platform
+// whitespace separates arguments unless it is quoted, backslashes are only special before a quote
+static std::vector<std::string> split_command_line(const std::string &command_line) {
+    std::vector<std::string> args;
+    std::string arg;
+    bool is_arg = false;
+    bool is_quoted = false;
+    for (size_t i = 0; i < command_line.size(); i++) {
+        const char c = command_line[i];
+        if (c == '\\') {
+            size_t total_backslashes = 0;
+            while ((i < command_line.size()) && (command_line[i] == '\\')) {
+                total_backslashes++;
+                i++;
+            }
+            // 2n backslashes and a quote is n backslashes and a quote which is handled below
+            // 2n+1 backslashes and a quote is n backslashes and a literal quote
+            if ((i < command_line.size()) && (command_line[i] == '"')) {
+                arg.append(total_backslashes/2, '\\');
+                if ((total_backslashes % 2) == 1) {
+                    arg.push_back('"');
+                } else {
+                    i--;
+                }
+            } else {
+                arg.append(total_backslashes, '\\');
+                i--;
+            }
+            is_arg = true;
+        } else if (c == '"') {
+            is_quoted = !is_quoted;
+            is_arg = true;
+        } else if (((c == ' ') || (c == '\t')) && !is_quoted) {
+            if (is_arg) {
+                args.push_back(std::move(arg));
+                arg.clear();
+                is_arg = false;
+            }
+        } else {
+            arg.push_back(c);
+            is_arg = true;
+        }
+    }
+    if (is_arg) {
+        args.push_back(std::move(arg));
+    }
+    return args;
+}
+
+// a child which exits while we write to it would otherwise kill us with sigpipe
+static void ignore_sigpipe() {
+    static std::once_flag flag;
+    std::call_once(flag, []() { signal(SIGPIPE, SIG_IGN); });
+}
+
+static void close_fd(int &fd) {
+    if (fd >= 0) {
+        close(fd);
+        fd = -1;
+    }
+}
+
+#ifdef __linux__
+static std::atomic<ForkServer *> g_fork_server = nullptr;
+
+void set_fork_server(ForkServer *server) {
+    g_fork_server = server;
+}
+
+// each distinct environment is sent to the server once and reused by every later launch with it
+static SpawnedProcess spawn_with_fork_server(ForkServer &server, const SpawnParams &params) {
+    uint64_t env_id = server.FindEnvironment(params.env_block);
+    if (env_id == 0) {
+        std::vector<std::string> env;
+        const char *env_end = params.env_block.data() + params.env_block.size();
+        for (const char *i = params.env_block.data(); (i < env_end) && (*i != '\0'); i += strlen(i)+1) {
+            env.emplace_back(i);
+        }
+        env_id = server.AddEnvironment(params.env_block, env);
+    }
+
+    // relative paths are resolved by us, the same as a direct spawn
+    SpawnRequest request;
+    request.env_id = env_id;
+    request.exec_path = std::filesystem::absolute(params.exec_path).string();
+    request.cwd = params.cwd.empty() ? std::string() : std::filesystem::absolute(params.cwd).string();
+    request.args = split_command_line(params.args);
+    return server.Spawn(request);
+}
+#endif
+
+// what the child reports through the error pipe if it fails before exec
+struct ForkError {
+    int error;
+    char step[32];
+};
+
+// posix_spawn can't run code in the child, so a process with a pre exec hook is forked instead
+// the child only makes system calls since another thread could have held a lock of the allocator when we forked
+static pid_t fork_child(
+    const SpawnParams &params, const std::string &exec_path, const std::string &pseudo_terminal_path,
+    const int child_std_in, const int child_std_out, const int child_std_err,
+    char *const *argv, char *const *envp)
+{
+    // opened up front since the hook can mount over the directory the executable is in
+    const int exec_fd = open(exec_path.c_str(), O_PATH | O_CLOEXEC);
+    if (exec_fd < 0) {
+        throw std::runtime_error(fmt::format("Failed to start application ({}): {}", params.exec_path, strerror(errno)));
+    }
+    // the hook can also mount over our working directory, so the child changes directory by path afterwards
+    const auto cwd = params.cwd.empty() ? std::string() : std::filesystem::absolute(params.cwd).string();
+    int error_pipe[2];
+    if (pipe2(error_pipe, O_CLOEXEC) != 0) {
+        close(exec_fd);
+        warn_and_throw_errno("Failed to create child error pipe");
+    }
+
+    const pid_t pid = fork();
+    if (pid == 0) {
+        auto fail = [&](const char *step, const int error) {
+            ForkError report = {};
+            report.error = error;
+            strncpy(report.step, step, sizeof(report.step)-1);
+            [[maybe_unused]] const ssize_t rv = write(error_pipe[1], &report, sizeof(report));
+            _exit(127);
+        };
+        if (!pseudo_terminal_path.empty()) {
+            // the first terminal opened after starting a new session becomes the controlling terminal
+            if (setsid() < 0) {
+                fail("setsid", errno);
+            }
+            const int terminal = open(pseudo_terminal_path.c_str(), O_RDWR);
+            if (terminal < 0) {
+                fail("open_terminal", errno);
+            }
+            if ((dup2(terminal, STDIN_FILENO) < 0) || (dup2(terminal, STDOUT_FILENO) < 0) || (dup2(terminal, STDERR_FILENO) < 0)) {
+                fail("dup2", errno);
+            }
+            if (terminal > STDERR_FILENO) {
+                close(terminal);
+            }
+        } else {
+            if ((dup2(child_std_in, STDIN_FILENO) < 0) || (dup2(child_std_out, STDOUT_FILENO) < 0) || (dup2(child_std_err, STDERR_FILENO) < 0)) {
+                fail("dup2", errno);
+            }
+        }
+        const char *failed_step = "pre_exec";
+        const int error = params.pre_exec(failed_step);
+        if (error != 0) {
+            fail(failed_step, error);
+        }
+        if (!cwd.empty() && (chdir(cwd.c_str()) != 0)) {
+            fail("chdir", errno);
+        }
+        fexecve(exec_fd, argv, envp);
+        // a script's interpreter can't open the close on exec descriptor it is given
+        if (errno == ENOENT) {
+            execve(exec_path.c_str(), argv, envp);
+        }
+        fail("exec", errno);
+    }
+
+    close(exec_fd);
+    close(error_pipe[1]);
+    if (pid < 0) {
+        close(error_pipe[0]);
+        warn_and_throw_errno("Failed to fork child process");
+    }
+    // a successful exec closes the pipe without writing to it
+    ForkError report = {};
+    ssize_t rv = -1;
+    do {
+        rv = read(error_pipe[0], &report, sizeof(report));
+    } while ((rv < 0) && (errno == EINTR));
+    close(error_pipe[0]);
+    if (rv > 0) {
+        waitpid(pid, nullptr, 0);
+        throw std::runtime_error(fmt::format(
+            "Failed to start application ({}): {}: {}", params.exec_path, report.step, strerror(report.error)));
+    }
+    return pid;
+}
+
+ChildProcess::ChildProcess(const SpawnParams &params) {
+    ignore_sigpipe();
+
+#ifdef __linux__
+    auto *fork_server = g_fork_server.load();
+    if ((fork_server != nullptr) && !params.use_pty && !params.pre_exec) {
+        const auto process = spawn_with_fork_server(*fork_server, params);
+        m_pid = int(process.pid);
+        m_pidfd = process.pidfd;
+        m_write_std_in = process.stdin_fd;
+        m_read_std_out = process.stdout_fd;
+        m_read_std_err = process.stderr_fd;
+        m_fork_server = fork_server;
+        return;
+    }
+#endif
+
+    // descriptors which belong to the child and are closed once it has started
+    int child_std_in = -1;
+    int child_std_out = -1;
+    int child_std_err = -1;
+    std::string pseudo_terminal_path;
+
+    posix_spawn_file_actions_t file_actions;
+    posix_spawnattr_t attributes;
+    posix_spawn_file_actions_init(&file_actions);
+    posix_spawnattr_init(&attributes);
+
+    auto cleanup = [&]() {
+        posix_spawn_file_actions_destroy(&file_actions);
+        posix_spawnattr_destroy(&attributes);
+        close_fd(child_std_in);
+        close_fd(child_std_out);
+        close_fd(child_std_err);
+    };
+
+    try {
+        if (params.use_pty) {
+            // the child sees a terminal so its c runtime line buffers stdout instead of fully buffering it
+            // stdout and stderr are merged into the single output stream of the terminal
+            const int master = posix_openpt(O_RDWR | O_NOCTTY | O_CLOEXEC);
+            if (master < 0) {
+                warn_and_throw_errno("Failed to create pseudo terminal");
+            }
+            m_read_std_out = master;
+            m_write_std_in = dup(master);
+            if ((m_write_std_in < 0) || (fcntl(m_write_std_in, F_SETFD, FD_CLOEXEC) != 0)) {
+                warn_and_throw_errno("Failed to duplicate pseudo terminal");
+            }
+            if ((grantpt(master) != 0) || (unlockpt(master) != 0)) {
+                warn_and_throw_errno("Failed to unlock pseudo terminal");
+            }
+            // ptsname() returns a static buffer which launches on other threads would overwrite
+            char path[256];
+            const int ptsname_error = ptsname_r(master, path, sizeof(path));
+            if (ptsname_error != 0) {
+                errno = ptsname_error;
+                warn_and_throw_errno("Failed to get pseudo terminal name");
+            }
+            pseudo_terminal_path = path;
+
+            winsize size = {};
+            size.ws_col = (unsigned short)(params.terminal_size.columns);
+            size.ws_row = (unsigned short)(params.terminal_size.rows);
+            if (ioctl(master, TIOCSWINSZ, &size) != 0) {
+                warn_and_throw_errno("Failed to set pseudo terminal size");
+            }
+
+            // the child starts a new session, and the first terminal it opens becomes its controlling terminal
+            posix_spawnattr_setflags(&attributes, POSIX_SPAWN_SETSID);
+            posix_spawn_file_actions_addopen(&file_actions, STDIN_FILENO, pseudo_terminal_path.c_str(), O_RDWR, 0);
+            posix_spawn_file_actions_adddup2(&file_actions, STDIN_FILENO, STDOUT_FILENO);
+            posix_spawn_file_actions_adddup2(&file_actions, STDIN_FILENO, STDERR_FILENO);
+            m_is_pseudo_terminal = true;
+            m_is_pseudo_console_open = true;
+        } else {
+            // our ends are close on exec so the child only inherits its own ends through dup2
+            int fds[2];
+            if (pipe2(fds, O_CLOEXEC) != 0) {
+                warn_and_throw_errno("Failed to create child pipe on stdin");
+            }
+            child_std_in = fds[0];
+            m_write_std_in = fds[1];
+
+            if (pipe2(fds, O_CLOEXEC) != 0) {
+                warn_and_throw_errno("Failed to create child pipe on stdout");
+            }
+            m_read_std_out = fds[0];
+            child_std_out = fds[1];
+
+            if (pipe2(fds, O_CLOEXEC) != 0) {
+                warn_and_throw_errno("Failed to create child pipe on stderr");
+            }
+            m_read_std_err = fds[0];
+            child_std_err = fds[1];
+
+            posix_spawn_file_actions_adddup2(&file_actions, child_std_in, STDIN_FILENO);
+            posix_spawn_file_actions_adddup2(&file_actions, child_std_out, STDOUT_FILENO);
+            posix_spawn_file_actions_adddup2(&file_actions, child_std_err, STDERR_FILENO);
+        }
+
+        // the executable is resolved before changing directory, the same as CreateProcess
+        const auto exec_path = std::filesystem::absolute(params.exec_path).string();
+        if (!params.cwd.empty()) {
+            posix_spawn_file_actions_addchdir_np(&file_actions, params.cwd.c_str());
+        }
+
+        auto args = split_command_line(params.args);
+        std::vector<char *> argv;
+        argv.push_back(const_cast<char *>(exec_path.c_str()));
+        for (auto &arg: args) {
+            argv.push_back(arg.data());
+        }
+        argv.push_back(nullptr);
+
+        // the block is already null separated so the strings can point into it
+        std::vector<char *> envp;
+        const char *env_end = params.env_block.data() + params.env_block.size();
+        for (const char *i = params.env_block.data(); (i < env_end) && (*i != '\0'); i += strlen(i)+1) {
+            envp.push_back(const_cast<char *>(i));
+        }
+        envp.push_back(nullptr);
+
+        if (params.pre_exec) {
+            m_pid = fork_child(
+                params, exec_path, pseudo_terminal_path,
+                child_std_in, child_std_out, child_std_err,
+                argv.data(), envp.data());
+        } else {
+            const int error = posix_spawn(&m_pid, exec_path.c_str(), &file_actions, &attributes, argv.data(), envp.data());
+            if (error != 0) {
+                m_pid = -1;
+                throw std::runtime_error(fmt::format("Failed to start application ({}): {}", params.exec_path, strerror(error)));
+            }
+        }
+    } catch (...) {
+        cleanup();
+        close_fd(m_write_std_in);
+        close_fd(m_read_std_out);
+        close_fd(m_read_std_err);
+        throw;
+    }
+    cleanup();
+}
+
+ChildProcess::~ChildProcess() {
+    // reap it if we can, otherwise it is left as a zombie until we exit
+    // the fork server reaps it for us, so it is told to drop the status instead of keeping it forever
+    if (!HasExited() && (m_fork_server != nullptr)) {
+#ifdef __linux__
+        m_fork_server->ForgetExitStatus(pid_t(m_pid));
+#endif
+    }
+    close_fd(m_write_std_in);
+    close_fd(m_read_std_out);
+    close_fd(m_read_std_err);
+    close_fd(m_pidfd);
+}
+
+bool ChildProcess::GetPendingSize(const Stream stream, size_t &total_pending) {
+    const int fd = (stream == Stream::STDOUT) ? m_read_std_out : m_read_std_err;
+    total_pending = 0;
+    if (fd < 0) {
+        return true;
+    }
+
+    pollfd poll_fd = { fd, POLLIN, 0 };
+    const int rv = poll(&poll_fd, 1, 0);
+    if (rv < 0) {
+        return errno == EINTR;
+    }
+    if (poll_fd.revents == 0) {
+        return true;
+    }
+    // readable with nothing to read means the writer has gone, e.g. eof on a pipe or hangup on a terminal
+    int count = 0;
+    if ((ioctl(fd, FIONREAD, &count) != 0) || (count <= 0)) {
+        return false;
+    }
+    total_pending = size_t(count);
+    return true;
+}
+
+bool ChildProcess::Read(const Stream stream, char *buffer, const size_t size, size_t &total_read) {
+    const int fd = (stream == Stream::STDOUT) ? m_read_std_out : m_read_std_err;
+    total_read = 0;
+    ssize_t rv = -1;
+    do {
+        rv = read(fd, buffer, size);
+    } while ((rv < 0) && (errno == EINTR));
+    // the terminal returns eio instead of eof once the child side is closed
+    if (rv <= 0) {
+        return false;
+    }
+    total_read = size_t(rv);
+    return true;
+}
+
+size_t ChildProcess::Write(const char *data, const size_t length) {
+    size_t total_written = 0;
+    while (total_written < length) {
+        const ssize_t rv = write(m_write_std_in, data + total_written, length - total_written);
+        if (rv < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        total_written += size_t(rv);
+    }
+    return total_written;
+}
+
+bool ChildProcess::HasExited() {
+    auto lock = std::scoped_lock(m_exit_mutex);
+    if (m_is_exited || (m_pid < 0)) {
+        return m_is_exited;
+    }
+    int status = 0;
+    if (m_fork_server != nullptr) {
+#ifdef __linux__
+        const auto exit_status = m_fork_server->TakeExitStatus(pid_t(m_pid));
+        if (!exit_status) {
+            return false;
+        }
+        status = exit_status.value();
+#endif
+    } else if (waitpid(m_pid, &status, WNOHANG) != m_pid) {
+        return false;
+    }
+    // killed by a signal is reported the way a shell would
+    if (WIFEXITED(status)) {
+        m_exit_code = int64_t(WEXITSTATUS(status));
+    } else if (WIFSIGNALED(status)) {
+        m_exit_code = int64_t(128 + WTERMSIG(status));
+    }
+    m_is_exited = true;
+    return true;
+}
+
+bool ChildProcess::WaitForExit(const uint32_t timeout_ms, int64_t &exit_code) {
+    const auto end = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    while (!HasExited()) {
+        if (std::chrono::steady_clock::now() >= end) {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    auto lock = std::scoped_lock(m_exit_mutex);
+    exit_code = m_exit_code;
+    return true;
+}
+
+// once the child is reaped its pid can be reused, so we never signal it after that
+bool ChildProcess::Terminate() {
+    auto lock = std::scoped_lock(m_exit_mutex);
+    if (m_is_exited || (m_pid < 0)) {
+        return false;
+    }
+    // the fork server can reap it before we see it exit, the pidfd never refers to another process
+    if (m_pidfd >= 0) {
+        return syscall(SYS_pidfd_send_signal, m_pidfd, SIGKILL, nullptr, 0) == 0;
+    }
+    return kill(m_pid, SIGKILL) == 0;
+}
+
+bool ChildProcess::Resize(const TerminalSize size) {
+    auto lock = std::scoped_lock(m_pseudo_console_mutex);
+    if (!m_is_pseudo_console_open) {
+        return false;
+    }
+    winsize new_size = {};
+    new_size.ws_col = (unsigned short)(size.columns);
+    new_size.ws_row = (unsigned short)(size.rows);
+    return ioctl(m_read_std_out, TIOCSWINSZ, &new_size) == 0;
+}
+
+// the master is also our output stream so it stays open until we are destroyed
+void ChildProcess::ClosePseudoTerminal() {
+    auto lock = std::scoped_lock(m_pseudo_console_mutex);
+    m_is_pseudo_console_open = false;
+}
+
+}
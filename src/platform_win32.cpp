@@ -0,0 +1,724 @@
+#include "platform.h"
+
+#include <string.h>
+#include <stdio.h>
+#include <limits.h>
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+
+#include <spdlog/spdlog.h>
+#include <fmt/core.h>
+
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <winsock2.h>
+#include <afunix.h>
+#include <windows.h>
+#include <processenv.h>
+
+#pragma comment(lib, "mincore")
+#pragma comment(lib, "user32.lib")
+#pragma comment(lib, "ws2_32.lib")
+
+static void* MapRingBuffer(HANDLE section, unsigned int bufferSize, ULONG protection, void** secondaryView);
+static void FreeRingBuffer(void* ringBuffer, void* secondaryView);
+
+namespace app::platform {
+
+template <typename T>
+static void warn_and_throw(T x) {
+    spdlog::warn(x);
+    throw std::runtime_error(x);
+}
+
+// ring memory
+size_t get_ring_granularity() {
+    SYSTEM_INFO sys_info;
+    GetSystemInfo(&sys_info);
+    return size_t(sys_info.dwAllocationGranularity);
+}
+
+// named objects are per session so they don't need elevated privileges
+static std::string get_shared_memory_name(const std::string &name) {
+    return "Local\\" + name;
+}
+
+char *create_ring_buffer(const size_t size, char **mirror, const std::string &shared_name) {
+    if ((size == 0) || ((size % get_ring_granularity()) != 0) || (size > size_t(UINT_MAX))) {
+        return nullptr;
+    }
+    const std::string section_name = shared_name.empty() ? "" : get_shared_memory_name(shared_name);
+    HANDLE section = CreateFileMappingA(
+        INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, DWORD(size),
+        shared_name.empty() ? NULL : section_name.c_str());
+    if (section == NULL) {
+        spdlog::warn("Failed to create section for ring buffer ({})", GetLastError());
+        return nullptr;
+    }
+    if (GetLastError() == ERROR_ALREADY_EXISTS) {
+        spdlog::warn("Shared ring buffer already exists ({})", shared_name);
+        CloseHandle(section);
+        return nullptr;
+    }
+    // the views keep the section alive
+    char *ring = (char *)(MapRingBuffer(section, (unsigned int)(size), PAGE_READWRITE, (void **)(mirror)));
+    CloseHandle(section);
+    return ring;
+}
+
+const char *open_shared_ring_buffer(const std::string &name, size_t &size, const char **mirror) {
+    HANDLE section = OpenFileMappingA(FILE_MAP_READ, FALSE, get_shared_memory_name(name).c_str());
+    if (section == NULL) {
+        return nullptr;
+    }
+    // the size of a section isn't exposed, but a view of all of it is exactly as large since rings are
+    // a multiple of the allocation granularity
+    void *view = MapViewOfFile(section, FILE_MAP_READ, 0, 0, 0);
+    MEMORY_BASIC_INFORMATION info = {};
+    if ((view == NULL) || (VirtualQuery(view, &info, sizeof(info)) == 0)) {
+        if (view != NULL) UnmapViewOfFile(view);
+        CloseHandle(section);
+        return nullptr;
+    }
+    size = size_t(info.RegionSize);
+    UnmapViewOfFile(view);
+    const char *ring = (const char *)(MapRingBuffer(section, (unsigned int)(size), PAGE_READONLY, (void **)(mirror)));
+    CloseHandle(section);
+    return ring;
+}
+
+// virtualalloc2 circular buffer page: https://docs.microsoft.com/en-us/windows/win32/api/memoryapi/nf-memoryapi-virtualalloc2
+// unmapviewoffile page: https://docs.microsoft.com/en-us/windows/win32/api/memoryapi/nf-memoryapi-unmapviewoffile
+void free_ring_buffer(const char *ring, const char *mirror, const size_t size) {
+    FreeRingBuffer((void *)(ring), (void *)(mirror));
+}
+
+void *create_shared_memory(const std::string &name, const size_t size) {
+    HANDLE section = CreateFileMappingA(
+        INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, DWORD(uint64_t(size) >> 32), DWORD(size),
+        get_shared_memory_name(name).c_str());
+    if (section == NULL) {
+        spdlog::warn("Failed to create shared memory ({}): {}", name, GetLastError());
+        return nullptr;
+    }
+    if (GetLastError() == ERROR_ALREADY_EXISTS) {
+        spdlog::warn("Shared memory already exists ({})", name);
+        CloseHandle(section);
+        return nullptr;
+    }
+    void *memory = MapViewOfFile(section, FILE_MAP_ALL_ACCESS, 0, 0, size);
+    CloseHandle(section);
+    return memory;
+}
+
+const void *open_shared_memory(const std::string &name, size_t &size) {
+    HANDLE section = OpenFileMappingA(FILE_MAP_READ, FALSE, get_shared_memory_name(name).c_str());
+    if (section == NULL) {
+        return nullptr;
+    }
+    void *memory = MapViewOfFile(section, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(section);
+    MEMORY_BASIC_INFORMATION info = {};
+    if ((memory == NULL) || (VirtualQuery(memory, &info, sizeof(info)) == 0)) {
+        if (memory != NULL) UnmapViewOfFile(memory);
+        return nullptr;
+    }
+    size = size_t(info.RegionSize);
+    return memory;
+}
+
+void free_shared_memory(const void *memory, const size_t size) {
+    UnmapViewOfFile(memory);
+}
+
+// named sections go away with their last view
+void unlink_shared_memory(const std::string &name) {}
+
+uint32_t get_current_process_id() {
+    return uint32_t(GetCurrentProcessId());
+}
+
+// environment
+// CreateProcessA takes a narrow environment block, so we read the narrow one as well
+std::vector<std::string> read_env_strings() {
+    auto free_block = [](LPCH p) { FreeEnvironmentStringsA(p); };
+    auto env_block = std::unique_ptr<CHAR, decltype(free_block)>{
+            GetEnvironmentStringsA(), free_block};
+
+    std::vector<std::string> env_strings;
+    for (LPCH i = env_block.get(); *i != '\0'; i += strlen(i)+1) {
+        env_strings.emplace_back(i);
+    }
+    return env_strings;
+}
+
+void set_env_variable(const std::string &key, const std::string &value) {
+    SetEnvironmentVariableA(key.c_str(), value.c_str());
+}
+
+void unset_env_variable(const std::string &key) {
+    SetEnvironmentVariableA(key.c_str(), NULL);
+}
+
+// local sockets
+static void init_winsock() {
+    static std::once_flag flag;
+    std::call_once(flag, []() {
+        WSADATA wsa_data;
+        if (WSAStartup(MAKEWORD(2, 2), &wsa_data) != 0) {
+            warn_and_throw("Failed to initialise winsock");
+        }
+    });
+}
+
+static sockaddr_un get_socket_address(const std::string &path) {
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) {
+        throw std::runtime_error(fmt::format("Socket path is too long ({})", path));
+    }
+    memcpy(address.sun_path, path.c_str(), path.size()+1);
+    return address;
+}
+
+static bool set_non_blocking(const SOCKET socket) {
+    u_long is_non_blocking = 1;
+    return ioctlsocket(socket, FIONBIO, &is_non_blocking) == 0;
+}
+
+socket_t listen_local_socket(const std::string &path) {
+    init_winsock();
+    const auto address = get_socket_address(path);
+    // a socket nobody is listening on is left over from a listener that didn't exit cleanly
+    if (GetFileAttributesA(path.c_str()) != INVALID_FILE_ATTRIBUTES) {
+        bool is_listening = false;
+        try {
+            close_socket(connect_local_socket(path));
+            is_listening = true;
+        } catch (std::runtime_error &) {}
+        if (is_listening) {
+            throw std::runtime_error(fmt::format("Socket is already being listened on ({})", path));
+        }
+        DeleteFileA(path.c_str());
+    }
+
+    SOCKET listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener == INVALID_SOCKET) {
+        warn_and_throw(fmt::format("Failed to create socket ({})", WSAGetLastError()));
+    }
+    if ((bind(listener, (const sockaddr *)(&address), sizeof(address)) != 0) ||
+        (listen(listener, SOMAXCONN) != 0) ||
+        !set_non_blocking(listener))
+    {
+        const int error = WSAGetLastError();
+        closesocket(listener);
+        warn_and_throw(fmt::format("Failed to listen on socket ({}): {}", path, error));
+    }
+    return socket_t(listener);
+}
+
+socket_t connect_local_socket(const std::string &path) {
+    init_winsock();
+    const auto address = get_socket_address(path);
+    SOCKET connection = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (connection == INVALID_SOCKET) {
+        warn_and_throw(fmt::format("Failed to create socket ({})", WSAGetLastError()));
+    }
+    if (connect(connection, (const sockaddr *)(&address), sizeof(address)) != 0) {
+        const int error = WSAGetLastError();
+        closesocket(connection);
+        throw std::runtime_error(fmt::format("Failed to connect to socket ({}): {}", path, error));
+    }
+    return socket_t(connection);
+}
+
+bool is_local_socket_peer_trusted(const socket_t) {
+    return true;
+}
+
+socket_t accept_local_socket(const socket_t listener) {
+    SOCKET connection = accept(SOCKET(listener), nullptr, nullptr);
+    if (connection == INVALID_SOCKET) {
+        return INVALID_SOCKET_T;
+    }
+    if (!set_non_blocking(connection)) {
+        closesocket(connection);
+        return INVALID_SOCKET_T;
+    }
+    return socket_t(connection);
+}
+
+void shutdown_socket(const socket_t socket) {
+    shutdown(SOCKET(socket), SD_BOTH);
+}
+
+void close_socket(const socket_t socket) {
+    closesocket(SOCKET(socket));
+}
+
+int64_t send_socket(const socket_t socket, const char *data, const size_t length) {
+    const int rv = send(SOCKET(socket), data, int(std::min(length, size_t(INT_MAX))), 0);
+    if (rv >= 0) {
+        return int64_t(rv);
+    }
+    return (WSAGetLastError() == WSAEWOULDBLOCK) ? 0 : -1;
+}
+
+int64_t send_socket_vectored(const socket_t socket, const SocketBuffer *buffers, const size_t total_buffers) {
+    WSABUF wsa_buffers[MAX_SOCKET_BUFFERS];
+    const size_t total_wsa_buffers = std::min(total_buffers, MAX_SOCKET_BUFFERS);
+    for (size_t i = 0; i < total_wsa_buffers; i++) {
+        wsa_buffers[i].buf = const_cast<char *>(buffers[i].data);
+        wsa_buffers[i].len = ULONG(std::min(buffers[i].length, size_t(ULONG_MAX)));
+    }
+    DWORD total_sent = 0;
+    const int rv = WSASend(SOCKET(socket), wsa_buffers, DWORD(total_wsa_buffers), &total_sent, 0, NULL, NULL);
+    if (rv == 0) {
+        return int64_t(total_sent);
+    }
+    return (WSAGetLastError() == WSAEWOULDBLOCK) ? 0 : -1;
+}
+
+int64_t recv_socket(const socket_t socket, char *data, const size_t length) {
+    const int rv = recv(SOCKET(socket), data, int(std::min(length, size_t(INT_MAX))), 0);
+    if (rv > 0) {
+        return int64_t(rv);
+    }
+    if (rv == 0) {
+        return -1;
+    }
+    return (WSAGetLastError() == WSAEWOULDBLOCK) ? 0 : -1;
+}
+
+bool poll_sockets(std::vector<SocketPoll> &sockets, const int timeout_ms) {
+    std::vector<WSAPOLLFD> poll_fds(sockets.size());
+    for (size_t i = 0; i < sockets.size(); i++) {
+        poll_fds[i].fd = SOCKET(sockets[i].socket);
+        poll_fds[i].events = sockets[i].is_write ? (POLLRDNORM | POLLWRNORM) : POLLRDNORM;
+        poll_fds[i].revents = 0;
+    }
+    // WSAPoll doesn't sleep if there is nothing to wait on
+    if (poll_fds.empty()) {
+        Sleep(DWORD(timeout_ms));
+        return true;
+    }
+    const int rv = WSAPoll(poll_fds.data(), ULONG(poll_fds.size()), timeout_ms);
+    if (rv == SOCKET_ERROR) {
+        return false;
+    }
+    for (size_t i = 0; i < sockets.size(); i++) {
+        const SHORT revents = (rv > 0) ? poll_fds[i].revents : 0;
+        sockets[i].is_readable = (revents & (POLLRDNORM | POLLHUP | POLLERR | POLLNVAL)) != 0;
+        sockets[i].is_writable = (revents & POLLWRNORM) != 0;
+    }
+    return true;
+}
+
+// clipboard
+// copy and paste a buffer to the clipboard
+// https://stackoverflow.com/questions/1264137/how-to-copy-string-to-clipboard-in-c
+bool copy_to_clipboard(const char *buffer, const size_t length) {
+    HGLOBAL hMem = GlobalAlloc(GMEM_MOVEABLE, length);
+    if (hMem == NULL) {
+        return false;
+    }
+    memcpy(GlobalLock(hMem), buffer, length);
+    GlobalUnlock(hMem);
+    if (!OpenClipboard(0)) {
+        GlobalFree(hMem);
+        return false;
+    }
+    EmptyClipboard();
+    const bool is_success = SetClipboardData(CF_TEXT, hMem) != NULL;
+    CloseClipboard();
+    // the clipboard owns the memory once it has been set
+    if (!is_success) {
+        GlobalFree(hMem);
+    }
+    return is_success;
+}
+
+std::string wide_string_to_string(const std::wstring& wide_string)
+{
+    if (wide_string.empty())
+    {
+        return "";
+    }
+
+    const auto size_needed = WideCharToMultiByte(CP_UTF8, 0, &wide_string.at(0), (int)wide_string.size(), nullptr, 0, nullptr, nullptr);
+    if (size_needed <= 0)
+    {
+        throw std::runtime_error("WideCharToMultiByte() failed: " + std::to_string(size_needed));
+    }
+
+    std::string result(size_needed, 0);
+    WideCharToMultiByte(CP_UTF8, 0, &wide_string.at(0), (int)wide_string.size(), &result.at(0), size_needed, nullptr, nullptr);
+    return result;
+}
+
+uint32_t get_oem_codepage() {
+    return uint32_t(GetOEMCP());
+}
+
+uint32_t get_ansi_codepage() {
+    return uint32_t(GetACP());
+}
+
+bool get_codepage_table(const uint32_t codepage, uint32_t code_points[256]) {
+    // double byte codepages need the lead byte so they can't be decoded a byte at a time
+    CPINFO info;
+    if (!GetCPInfo(UINT(codepage), &info) || (info.MaxCharSize != 1)) {
+        return false;
+    }
+    for (int i = 0; i < 256; i++) {
+        const char c = char(i);
+        wchar_t wc = 0;
+        if (MultiByteToWideChar(UINT(codepage), 0, &c, 1, &wc, 1) != 1) {
+            return false;
+        }
+        code_points[i] = uint32_t(wc);
+    }
+    return true;
+}
+
+// child process
+ChildProcess::ChildProcess(const SpawnParams &params) {
+    // setup win32 process parameters
+    PROCESS_INFORMATION process_info = {0};
+
+    STARTUPINFOEXA startup_info = {0};
+    startup_info.StartupInfo.cb = sizeof(STARTUPINFOEXA);
+
+    BOOL is_inherit_handles = TRUE;
+    DWORD dw_flags = CREATE_SUSPENDED | CREATE_NO_WINDOW;
+
+    // handles which belong to the child and are closed once it has started
+    HANDLE child_std_in = NULL;
+    HANDLE child_std_out = NULL;
+    HANDLE child_std_err = NULL;
+    std::vector<uint8_t> attribute_list_buffer;
+
+    if (params.use_pty) {
+        // pseudo console: https://docs.microsoft.com/en-us/windows/console/creating-a-pseudoconsole-session
+        // the child sees a terminal so its c runtime line buffers stdout instead of fully buffering it
+        // stdout and stderr are merged into the single output stream of the terminal
+        if (!CreatePipe(&child_std_in, &m_write_std_in, NULL, 0)) {
+            warn_and_throw("Failed to create pseudo console pipe on stdin");
+        }
+
+        if (!CreatePipe(&m_read_std_out, &child_std_out, NULL, 0)) {
+            warn_and_throw("Failed to create pseudo console pipe on stdout");
+        }
+
+        COORD size = { params.terminal_size.columns, params.terminal_size.rows };
+        HPCON pseudo_console = NULL;
+        if (FAILED(CreatePseudoConsole(size, child_std_in, child_std_out, 0, &pseudo_console))) {
+            warn_and_throw("Failed to create pseudo console");
+        }
+        m_pseudo_console = pseudo_console;
+
+        SIZE_T attribute_list_size = 0;
+        InitializeProcThreadAttributeList(NULL, 1, 0, &attribute_list_size);
+        attribute_list_buffer.resize(attribute_list_size);
+        startup_info.lpAttributeList = reinterpret_cast<LPPROC_THREAD_ATTRIBUTE_LIST>(attribute_list_buffer.data());
+
+        if (!InitializeProcThreadAttributeList(startup_info.lpAttributeList, 1, 0, &attribute_list_size)) {
+            warn_and_throw("Failed to initialise process attribute list for pseudo console");
+        }
+
+        if (!UpdateProcThreadAttribute(
+                startup_info.lpAttributeList, 0, 
+                PROC_THREAD_ATTRIBUTE_PSEUDOCONSOLE, 
+                pseudo_console, sizeof(HPCON), 
+                NULL, NULL)) 
+        {
+            warn_and_throw("Failed to attach pseudo console to process attributes");
+        }
+
+        // the pseudo console owns the child's end of the pipes, so nothing needs to be inherited
+        m_is_pseudo_terminal = true;
+        is_inherit_handles = FALSE;
+        dw_flags |= EXTENDED_STARTUPINFO_PRESENT;
+    } else {
+        // Set the bInheritHandle flag so pipe handles are inherited. 
+        SECURITY_ATTRIBUTES security_attr = {sizeof(security_attr)};
+        security_attr.bInheritHandle = TRUE; 
+
+        startup_info.StartupInfo.dwFlags = STARTF_USESTDHANDLES;
+
+        // TODO: free pipes if we fail somewhere along this?
+        if (!CreatePipe(&child_std_in, &m_write_std_in, &security_attr, 0)) {
+            warn_and_throw("Failed to create child pipe on stdin");
+        }
+            
+        if (!CreatePipe(&m_read_std_out, &child_std_out, &security_attr, 0)) {
+            warn_and_throw("Failed to create child pipe on stdout");
+        }
+
+        if (!CreatePipe(&m_read_std_err, &child_std_err, &security_attr, 0)) {
+            warn_and_throw("Failed to create child pipe on stderr");
+        }
+
+        if (!SetHandleInformation(m_read_std_err, HANDLE_FLAG_INHERIT, 0)) {
+            warn_and_throw("Failed to set handle information on std_err_rd");
+        }
+
+        if (!SetHandleInformation(m_read_std_out, HANDLE_FLAG_INHERIT, 0)) {
+            warn_and_throw("Failed to set handle information on std_out_rd");
+        }
+
+        startup_info.StartupInfo.hStdInput = child_std_in;
+        startup_info.StartupInfo.hStdOutput = child_std_out;
+        startup_info.StartupInfo.hStdError = child_std_err;
+    }
+
+    auto args_str = fmt::format("\"{}\" {}", params.exec_path, params.args);
+    auto env_block = params.env_block;
+
+    // create the process
+    bool rv = CreateProcessA(
+        params.exec_path.c_str(),
+        args_str.data(),
+        NULL, NULL,
+        is_inherit_handles, dw_flags,
+        env_block.data(),
+        params.cwd.c_str(),
+        &startup_info.StartupInfo, &process_info);
+
+    if (startup_info.lpAttributeList != NULL) {
+        DeleteProcThreadAttributeList(startup_info.lpAttributeList);
+    }
+    
+    if (!rv) {
+        throw std::runtime_error(fmt::format("Failed to start application ({})", params.exec_path));
+    }
+
+    m_process = process_info.hProcess;
+    ResumeThread(process_info.hThread);
+    CloseHandle(process_info.hThread);
+    CloseHandle(child_std_in);
+    CloseHandle(child_std_out);
+    if (child_std_err != NULL) {
+        CloseHandle(child_std_err);
+    }
+}
+
+ChildProcess::~ChildProcess() {
+    ClosePseudoTerminal();
+    for (HANDLE handle: { m_write_std_in, m_read_std_out, m_read_std_err, m_process }) {
+        if (handle != NULL) {
+            CloseHandle(handle);
+        }
+    }
+}
+
+bool ChildProcess::GetPendingSize(const Stream stream, size_t &total_pending) {
+    HANDLE pipe = (stream == Stream::STDOUT) ? m_read_std_out : m_read_std_err;
+    total_pending = 0;
+    if (pipe == NULL) {
+        return true;
+    }
+    DWORD count = 0;
+    if (!PeekNamedPipe(pipe, 0, 0, 0, &count, 0)) {
+        return false;
+    }
+    total_pending = size_t(count);
+    return true;
+}
+
+bool ChildProcess::Read(const Stream stream, char *buffer, const size_t size, size_t &total_read) {
+    HANDLE pipe = (stream == Stream::STDOUT) ? m_read_std_out : m_read_std_err;
+    DWORD dwRead = 0;
+    const BOOL is_success = ReadFile(
+        pipe, 
+        LPVOID(buffer), 
+        DWORD(size), 
+        &dwRead, 
+        nullptr
+    );
+    total_read = size_t(dwRead);
+    return is_success && (dwRead > 0);
+}
+
+size_t ChildProcess::Write(const char *data, const size_t length) {
+    DWORD total_written = 0;
+    WriteFile(m_write_std_in, LPCVOID(data), DWORD(length), &total_written, nullptr);
+    return size_t(total_written);
+}
+
+bool ChildProcess::HasExited() {
+    return WaitForSingleObject(m_process, 0) == WAIT_OBJECT_0;
+}
+
+bool ChildProcess::WaitForExit(const uint32_t timeout_ms, int64_t &exit_code) {
+    DWORD dw_exit_code = 0;
+    if ((WaitForSingleObject(m_process, DWORD(timeout_ms)) != WAIT_OBJECT_0) ||
+        !GetExitCodeProcess(m_process, &dw_exit_code)) 
+    {
+        return false;
+    }
+    exit_code = int64_t(dw_exit_code);
+    return true;
+}
+
+bool ChildProcess::Terminate() {
+    return TerminateProcess(m_process, 0);
+}
+
+bool ChildProcess::Resize(const TerminalSize size) {
+    auto lock = std::scoped_lock(m_pseudo_console_mutex);
+    if (m_pseudo_console == NULL) {
+        return false;
+    }
+    COORD coord = { size.columns, size.rows };
+    return SUCCEEDED(ResizePseudoConsole(HPCON(m_pseudo_console), coord));
+}
+
+void ChildProcess::ClosePseudoTerminal() {
+    auto lock = std::scoped_lock(m_pseudo_console_mutex);
+    if (m_pseudo_console != NULL) {
+        ClosePseudoConsole(HPCON(m_pseudo_console));
+        m_pseudo_console = NULL;
+    }
+}
+
+}
+
+// Map a section twice as a circular ring buffer, the caller owns the section handle
+// https://docs.microsoft.com/en-us/windows/win32/api/memoryapi/nf-memoryapi-virtualalloc2
+static void* MapRingBuffer(HANDLE section, unsigned int bufferSize, ULONG protection, void** secondaryView)
+{
+    BOOL result;
+    SYSTEM_INFO sysInfo;
+    void* ringBuffer = nullptr;
+    void* placeholder1 = nullptr;
+    void* placeholder2 = nullptr;
+    void* view1 = nullptr;
+    void* view2 = nullptr;
+
+    GetSystemInfo (&sysInfo);
+
+    if ((bufferSize % sysInfo.dwAllocationGranularity) != 0) {
+        return nullptr;
+    }
+
+    //
+    // Reserve a placeholder region where the buffer will be mapped.
+    //
+
+    placeholder1 = (PCHAR) VirtualAlloc2 (
+        nullptr,
+        nullptr,
+        2 * bufferSize,
+        MEM_RESERVE | MEM_RESERVE_PLACEHOLDER,
+        PAGE_NOACCESS,
+        nullptr, 0
+    );
+
+    if (placeholder1 == nullptr) {
+        printf ("VirtualAlloc2 failed, error %#x\n", GetLastError());
+        goto Exit;
+    }
+
+    //
+    // Split the placeholder region into two regions of equal size.
+    //
+
+    result = VirtualFree (
+        placeholder1,
+        bufferSize,
+        MEM_RELEASE | MEM_PRESERVE_PLACEHOLDER
+    );
+
+    if (result == FALSE) {
+        printf ("VirtualFreeEx failed, error %#x\n", GetLastError());
+        goto Exit;
+    }
+
+    placeholder2 = (void*) ((ULONG_PTR) placeholder1 + bufferSize);
+
+    //
+    // Map the section into the first placeholder region.
+    //
+
+    view1 = MapViewOfFile3 (
+        section,
+        nullptr,
+        placeholder1,
+        0,
+        bufferSize,
+        MEM_REPLACE_PLACEHOLDER,
+        protection,
+        nullptr, 0
+    );
+
+    if (view1 == nullptr) {
+        printf ("MapViewOfFile3 failed, error %#x\n", GetLastError());
+        goto Exit;
+    }
+
+    //
+    // Ownership transferred, don’t free this now.
+    //
+
+    placeholder1 = nullptr;
+
+    //
+    // Map the section into the second placeholder region.
+    //
+
+    view2 = MapViewOfFile3 (
+        section,
+        nullptr,
+        placeholder2,
+        0,
+        bufferSize,
+        MEM_REPLACE_PLACEHOLDER,
+        protection,
+        nullptr, 0
+    );
+
+    if (view2 == nullptr) {
+        printf ("MapViewOfFile3 failed, error %#x\n", GetLastError());
+        goto Exit;
+    }
+
+    //
+    // Success, return both mapped views to the caller.
+    //
+
+    ringBuffer = view1;
+    *secondaryView = view2;
+
+    placeholder2 = nullptr;
+    view1 = nullptr;
+    view2 = nullptr;
+
+Exit:
+
+    if (placeholder1 != nullptr) {
+        VirtualFree (placeholder1, 0, MEM_RELEASE);
+    }
+
+    if (placeholder2 != nullptr) {
+        VirtualFree (placeholder2, 0, MEM_RELEASE);
+    }
+
+    if (view1 != nullptr) {
+        UnmapViewOfFileEx (view1, 0);
+    }
+
+    if (view2 != nullptr) {
+        UnmapViewOfFileEx (view2, 0);
+    }
+
+    return ringBuffer;
+}
+
+static void FreeRingBuffer(void* ringBuffer, void* secondaryView)
+{
+    UnmapViewOfFile(ringBuffer);
+    UnmapViewOfFile(secondaryView);
+}
@@ -0,0 +1,195 @@
+#include "process_timeline.h"
+
+#include <string.h>
+#include <algorithm>
+#include <queue>
+#include <functional>
+
+namespace app {
+
+void ProcessTimeline::AddSource(AppProcess *process) {
+    if (HasSource(process)) {
+        return;
+    }
+    m_sources.push_back({ process, 0, 0, 0, {}, 0 });
+    Restart();
+}
+
+void ProcessTimeline::RemoveSource(AppProcess *process) {
+    auto it = std::remove_if(
+        m_sources.begin(), m_sources.end(),
+        [process](const Source &source) { return source.process == process; });
+    if (it == m_sources.end()) {
+        return;
+    }
+    m_sources.erase(it, m_sources.end());
+    Restart();
+}
+
+bool ProcessTimeline::HasSource(const AppProcess *process) const {
+    for (auto &source: m_sources) {
+        if (source.process == process) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void ProcessTimeline::Restart() {
+    m_lines.clear();
+    m_total_lines = 0;
+    m_start_timestamp = 0;
+    for (auto &source: m_sources) {
+        auto &buffer = source.process->GetBuffer();
+        const uint64_t total_chunks = buffer.GetTotalChunks();
+        const uint64_t max_chunks = buffer.GetMaxChunks();
+        const uint64_t total_written = buffer.GetTotalWritten();
+        source.next_chunk = (total_chunks > max_chunks) ? (total_chunks - max_chunks) : 0;
+        source.next_offset = total_written - std::min(total_written, uint64_t(buffer.GetMaxSize()));
+        source.line_timestamp_ns = 0;
+        source.pending_line.clear();
+        source.total_dropped = 0;
+
+        const int64_t start_timestamp = source.process->GetStartTimestamp();
+        if ((m_start_timestamp == 0) || (start_timestamp < m_start_timestamp)) {
+            m_start_timestamp = start_timestamp;
+        }
+    }
+}
+
+bool ProcessTimeline::PeekChunk(Source &source, const int64_t horizon_ns, ScrollingBufferChunk &chunk) {
+    auto &buffer = source.process->GetBuffer();
+    auto buffer_lock = buffer.LockRead();
+    const uint64_t total_chunks = buffer.GetTotalChunks();
+    const uint64_t max_chunks = buffer.GetMaxChunks();
+    // skip chunks that were overwritten before we got to them
+    const uint64_t oldest_chunk = (total_chunks > max_chunks) ? (total_chunks - max_chunks) : 0;
+    source.next_chunk = std::max(source.next_chunk, oldest_chunk);
+    if (!buffer.ReadChunk(source.next_chunk, chunk)) {
+        return false;
+    }
+    return chunk.timestamp_ns <= horizon_ns;
+}
+
+void ProcessTimeline::Update(const int64_t now_ns) {
+    const int64_t horizon_ns = now_ns - MERGE_DELAY_NS;
+
+    // min heap of the oldest unmerged chunk of each source
+    struct HeapEntry {
+        int64_t timestamp_ns;
+        size_t source_index;
+        ScrollingBufferChunk chunk;
+        bool operator>(const HeapEntry &other) const { return timestamp_ns > other.timestamp_ns; }
+    };
+    std::priority_queue<HeapEntry, std::vector<HeapEntry>, std::greater<HeapEntry>> heap;
+
+    for (size_t i = 0; i < m_sources.size(); i++) {
+        ScrollingBufferChunk chunk;
+        if (PeekChunk(m_sources[i], horizon_ns, chunk)) {
+            heap.push({ chunk.timestamp_ns, i, chunk });
+        }
+    }
+
+    while (!heap.empty()) {
+        const auto entry = heap.top();
+        heap.pop();
+        if (!MergeChunk(entry.source_index, entry.chunk)) {
+            continue;
+        }
+        ScrollingBufferChunk chunk;
+        if (PeekChunk(m_sources[entry.source_index], horizon_ns, chunk)) {
+            heap.push({ chunk.timestamp_ns, entry.source_index, chunk });
+        }
+    }
+
+    // flush partial lines from processes which won't write anymore
+    for (size_t i = 0; i < m_sources.size(); i++) {
+        auto &source = m_sources[i];
+        if (source.pending_line.empty()) {
+            continue;
+        }
+        if (source.process->GetState() != AppProcess::State::TERMINATED) {
+            continue;
+        }
+        if (source.next_offset == source.process->GetBuffer().GetTotalWritten()) {
+            PushLine(i);
+        }
+    }
+}
+
+bool ProcessTimeline::MergeChunk(const size_t source_index, const ScrollingBufferChunk &chunk) {
+    auto &source = m_sources[source_index];
+    auto &buffer = source.process->GetBuffer();
+    auto buffer_lock = buffer.LockRead();
+
+    // the chunk ends where the next one starts, or at the end of what has been written so far
+    // new chunks are added before their bytes are counted as written, so read the byte count first
+    const uint64_t total_written = buffer.GetTotalWritten();
+    ScrollingBufferChunk next_chunk;
+    const bool has_next_chunk = buffer.ReadChunk(source.next_chunk+1, next_chunk);
+    uint64_t end_offset = total_written;
+    if (has_next_chunk) {
+        end_offset = std::min(end_offset, next_chunk.offset);
+    }
+
+    uint64_t start_offset = std::max(source.next_offset, chunk.offset);
+    const uint64_t oldest_offset = total_written - std::min(total_written, uint64_t(buffer.GetMaxSize()));
+    if (start_offset < oldest_offset) {
+        source.total_dropped += oldest_offset - start_offset;
+        start_offset = oldest_offset;
+    }
+
+    if (start_offset < end_offset) {
+        // the buffer is mirrored so the bytes are contiguous
+        // copy them out first since the writer could lap us while we are reading
+        const size_t length = size_t(end_offset - start_offset);
+        m_scratch.assign(buffer.GetBufferAtOffset(start_offset), length);
+        if ((buffer.GetTotalWritten() - start_offset) > uint64_t(buffer.GetMaxSize())) {
+            source.total_dropped += length;
+        } else {
+            AppendBytes(source_index, m_scratch.data(), length, chunk.timestamp_ns);
+        }
+    }
+    source.next_offset = std::max(source.next_offset, end_offset);
+
+    const bool is_chunk_done = has_next_chunk && (end_offset == next_chunk.offset);
+    if (is_chunk_done) {
+        source.next_chunk++;
+    }
+    return is_chunk_done;
+}
+
+void ProcessTimeline::AppendBytes(const size_t source_index, const char *data, const size_t length, const int64_t timestamp_ns) {
+    auto &source = m_sources[source_index];
+    const char *end = data + length;
+    while (data < end) {
+        if (source.pending_line.empty()) {
+            source.line_timestamp_ns = timestamp_ns;
+        }
+        const char *line_end = (const char *)(memchr(data, '\n', size_t(end - data)));
+        const char *segment_end = (line_end != nullptr) ? line_end : end;
+        source.pending_line.append(data, segment_end);
+        data = (line_end != nullptr) ? (line_end + 1) : end;
+
+        if ((line_end != nullptr) || (source.pending_line.size() >= MAX_PENDING_LINE)) {
+            PushLine(source_index);
+        }
+    }
+}
+
+void ProcessTimeline::PushLine(const size_t source_index) {
+    auto &source = m_sources[source_index];
+    auto &text = source.pending_line;
+    if (!text.empty() && (text.back() == '\r')) {
+        text.pop_back();
+    }
+
+    if (m_lines.size() >= MAX_LINES) {
+        m_lines.pop_front();
+    }
+    m_lines.push_back({ source_index, source.line_timestamp_ns, std::move(text) });
+    m_total_lines++;
+    source.pending_line = std::string();
+}
+
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <deque>
+
+#include "app_process.h"
+
+namespace app {
+
+// a complete line of output from one of the merged processes
+struct TimelineLine {
+    size_t source_index;
+    int64_t timestamp_ns;   // arrival of the first byte of the line
+    std::string text;
+};
+
+// merges the output of several processes into one stream ordered by arrival time
+// uses a k-way merge over the timestamped chunks of each process buffer
+// each update only merges the chunks which arrived since the last update
+class ProcessTimeline
+{
+public:
+    static constexpr size_t MAX_LINES = 0x4000;
+    // partial lines longer than this are split so a process without newlines can't grow it forever
+    static constexpr size_t MAX_PENDING_LINE = 0x1000;
+    // chunks newer than this can still be merged with later reads so they aren't ordered yet
+    static constexpr int64_t MERGE_DELAY_NS = 2*ScrollingBuffer::CHUNK_RESOLUTION_NS;
+
+    struct Source {
+        AppProcess *process;
+        uint64_t next_chunk;        // absolute chunk index to merge next
+        uint64_t next_offset;       // absolute byte offset to merge next
+        int64_t line_timestamp_ns;
+        std::string pending_line;
+        uint64_t total_dropped;     // bytes overwritten before they could be merged
+    };
+private:
+    std::vector<Source> m_sources;
+    std::deque<TimelineLine> m_lines;
+    uint64_t m_total_lines = 0;
+    int64_t m_start_timestamp = 0;
+    std::string m_scratch;
+public:
+    // merging restarts from the oldest output in each buffer whenever the sources change
+    void AddSource(AppProcess *process);
+    void RemoveSource(AppProcess *process);
+    bool HasSource(const AppProcess *process) const;
+    void Update(const int64_t now_ns);
+    inline const std::vector<Source> &GetSources() const { return m_sources; }
+    inline const std::deque<TimelineLine> &GetLines() const { return m_lines; }
+    // monotonic count of merged lines, used to detect new output
+    inline uint64_t GetTotalLines() const { return m_total_lines; }
+    // earliest start time of the merged processes
+    inline int64_t GetStartTimestamp() const { return m_start_timestamp; }
+private:
+    void Restart();
+    bool PeekChunk(Source &source, const int64_t horizon_ns, ScrollingBufferChunk &chunk);
+    // returns true if the source moved onto its next chunk
+    bool MergeChunk(const size_t source_index, const ScrollingBufferChunk &chunk);
+    void AppendBytes(const size_t source_index, const char *data, const size_t length, const int64_t timestamp_ns);
+    void PushLine(const size_t source_index);
+};
+
+}
@@ -0,0 +1,107 @@
+// follows the output of a process exported with "share_output" from another process
+// reads straight out of the shared ring, so the capturing process never waits for us
+// output which was overwritten before we got to it is reported on stderr and skipped
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include <fmt/core.h>
+
+#include "shared_ring.h"
+
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#endif
+
+static constexpr size_t CHUNK_SIZE = 0x10000;
+
+static void print_usage(const char *name) {
+    fprintf(stderr,
+        "Usage: %s NAME [--from-end]\n"
+        "    NAME        Export name which is logged when the process is launched\n"
+        "    --from-end  Only print new output instead of everything still in the ring\n",
+        name);
+}
+
+int main(int argc, char **argv) {
+    const char *name = nullptr;
+    bool is_from_end = false;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--from-end") == 0) {
+            is_from_end = true;
+        } else if ((strcmp(argv[i], "--help") == 0) || (strcmp(argv[i], "-h") == 0)) {
+            print_usage(argv[0]);
+            return 0;
+        } else if (name == nullptr) {
+            name = argv[i];
+        } else {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+    if (name == nullptr) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    #ifdef _WIN32
+    _setmode(_fileno(stdout), _O_BINARY);
+    #endif
+
+    try {
+        auto reader = app::SharedRingReader(name);
+        std::vector<char> chunk(CHUNK_SIZE);
+        uint64_t offset = is_from_end ? reader.GetTotalWritten() : reader.GetOldestOffset();
+        uint64_t total_skipped = 0;
+
+        while (true) {
+            const uint64_t sequence = reader.GetSequence();
+            const bool is_closed = reader.IsWriterClosed();
+            if (!reader.Update()) {
+                fmt::print(stderr, "Lost the exported ring ({})\n", name);
+                return 1;
+            }
+
+            // copy out first and check afterwards, the writer could have lapped us during the copy
+            const uint64_t end_offset = reader.GetTotalWritten();
+            const uint64_t oldest_offset = reader.GetOldestOffset();
+            if (offset < oldest_offset) {
+                fmt::print(stderr, "Skipped {} bytes which were overwritten\n", oldest_offset - offset);
+                total_skipped += oldest_offset - offset;
+                offset = oldest_offset;
+            }
+            if (offset < end_offset) {
+                const size_t length = size_t(std::min(end_offset - offset, uint64_t(chunk.size())));
+                memcpy(chunk.data(), reader.GetBufferAtOffset(offset), length);
+                if (!reader.IsValid(offset)) {
+                    continue;
+                }
+                fwrite(chunk.data(), 1, length, stdout);
+                offset += uint64_t(length);
+                continue;
+            }
+
+            // the closed flag is set after the last write, so once it was seen everything is written
+            if (is_closed) {
+                break;
+            }
+            fflush(stdout);
+            while ((reader.GetSequence() == sequence) && !reader.IsWriterClosed()) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }
+        fflush(stdout);
+        if (total_skipped > 0) {
+            fmt::print(stderr, "Skipped {} bytes in total\n", total_skipped);
+        }
+    } catch (std::exception &ex) {
+        fmt::print(stderr, "{}\n", ex.what());
+        return 1;
+    }
+    return 0;
+}
@@ -1,23 +1,32 @@
 #include "scrolling_buffer.h"
 
-#include "utils.h"
+#include <string.h>
 #include <stdexcept>
+#include <algorithm>
+#include <chrono>
 
-#define WIN32_LEAN_AND_MEAN
-#define NOMINMAX
-#include <windows.h>
-
-#pragma comment(lib, "mincore")
-
-static void* CreateRingBuffer(unsigned int bufferSize, void** secondaryView);
+#include "platform.h"
 
 namespace app {
 
-ScrollingBuffer::ScrollingBuffer() {
+ScrollingBuffer::ScrollingBuffer(const size_t size) {
+    m_max_size = GetRingSize(size);
+    m_requested_size = size_t(m_max_size);
+    m_mapped_size = size_t(m_max_size);
+    m_is_lossless = false;
+    m_is_writer_closed = false;
     m_curr_size = 0;
     m_curr_write_index = 0;
     m_curr_read_index = 0;
-    m_ring_buffer = (char *)(CreateRingBuffer(m_max_size, (void **)(&m_ring_buffer_mirror)));
+    m_total_written = 0;
+    m_write_end = 0;
+    m_total_consumed = 0;
+    m_total_dropped = 0;
+    m_peak_pending_size = 0;
+    m_max_chunks = GetChunkCount(m_max_size);
+    m_chunks = std::make_unique<ScrollingBufferChunk[]>(m_max_chunks);
+    m_total_chunks = 0;
+    m_ring_buffer = platform::create_ring_buffer(m_max_size, &m_ring_buffer_mirror);
 
     if (m_ring_buffer == NULL) {
         throw std::runtime_error("Failed to allocate circular buffer pages for scrolling buffer");
@@ -25,182 +34,351 @@ ScrollingBuffer::ScrollingBuffer() {
 }
 
 ScrollingBuffer::~ScrollingBuffer() {
-    // virtualalloc2 circular buffer page: https://docs.microsoft.com/en-us/windows/win32/api/memoryapi/nf-memoryapi-virtualalloc2
-    // unmapviewoffile page: https://docs.microsoft.com/en-us/windows/win32/api/memoryapi/nf-memoryapi-unmapviewoffile
     // unmap the ring buffers
-    UnmapViewOfFile(m_ring_buffer);
-    UnmapViewOfFile(m_ring_buffer_mirror);
+    platform::free_ring_buffer(m_ring_buffer, m_ring_buffer_mirror, m_max_size);
+    if (m_export_header != nullptr) {
+        m_export_header->is_writer_closed.store(1, std::memory_order_release);
+        platform::unlink_shared_memory(get_shared_ring_name(m_export_name, m_export_header->generation));
+        platform::unlink_shared_memory(m_export_name);
+        platform::free_shared_memory(m_export_header, sizeof(SharedRingHeader));
+    }
 }
 
-void ScrollingBuffer::IncrementIndex(const size_t size) {
-    m_curr_write_index = (m_curr_write_index + size) % m_max_size;
-    // dont edit m_curr_size until we can guarantee a valid atomic write to it
-    // doing m_curr_size += size could place it into an invalid state (m_curr_size > m_max_size)
-    size_t new_curr_size = m_curr_size + size;
-
-    // overhang detection
-    if (new_curr_size > m_max_size) {
-        m_curr_size = m_max_size;
-        m_curr_read_index = m_curr_write_index;
-    // buffer hasn't wrapped around yet
-    } else {
-        m_curr_size = new_curr_size;
+bool ScrollingBuffer::Export(const std::string &name) {
+    if (m_export_header != nullptr) {
+        return false;
     }
-
+    auto *header = (SharedRingHeader *)(platform::create_shared_memory(name, sizeof(SharedRingHeader)));
+    if (header == nullptr) {
+        return false;
+    }
+    // the ring is moved into named memory, readers find it under generation 0
+    const size_t size = m_max_size;
+    char *ring_buffer_mirror = nullptr;
+    char *ring_buffer = platform::create_ring_buffer(size, &ring_buffer_mirror, get_shared_ring_name(name, 0));
+    if (ring_buffer == nullptr) {
+        platform::unlink_shared_memory(name);
+        platform::free_shared_memory(header, sizeof(SharedRingHeader));
+        return false;
+    }
+    memcpy(ring_buffer, m_ring_buffer, size);
+
+    // the new mapping is zeroed so only the fields need to be set, the magic goes last
+    header->version = SHARED_RING_VERSION;
+    header->generation.store(0);
+    header->ring_size.store(size);
+    header->begin_offset.store(m_total_written - std::min(uint64_t(m_total_written), uint64_t(size)));
+    header->total_written.store(m_total_written);
+    header->write_end.store(m_total_written);
+    header->sequence.store(0);
+    header->is_writer_closed.store(m_is_writer_closed ? 1 : 0);
+    std::atomic_thread_fence(std::memory_order_release);
+    header->magic = SHARED_RING_MAGIC;
+
+    char *old_ring_buffer = m_ring_buffer;
+    char *old_ring_buffer_mirror = m_ring_buffer_mirror;
+    {
+        auto lock = std::unique_lock(m_resize_mutex);
+        m_ring_buffer = ring_buffer;
+        m_ring_buffer_mirror = ring_buffer_mirror;
+        m_export_name = name;
+        m_export_header = header;
+    }
+    platform::free_ring_buffer(old_ring_buffer, old_ring_buffer_mirror, size);
+    return true;
 }
 
-};
-
+void ScrollingBuffer::PublishWrite(const size_t size) {
+    // the fence keeps the write into the ring from being seen before readers are told about it
+    const uint64_t write_end = m_total_written + uint64_t(std::min(size, size_t(m_max_size)));
+    m_write_end.store(write_end, std::memory_order_relaxed);
+    if (m_export_header != nullptr) {
+        m_export_header->write_end.store(write_end, std::memory_order_relaxed);
+    }
+    std::atomic_thread_fence(std::memory_order_release);
+}
 
-// Create a circular ring buffer
-// https://docs.microsoft.com/en-us/windows/win32/api/memoryapi/nf-memoryapi-virtualalloc2
-void* CreateRingBuffer(unsigned int bufferSize, void** secondaryView)
-{
-    BOOL result;
-    HANDLE section = nullptr;
-    SYSTEM_INFO sysInfo;
-    void* ringBuffer = nullptr;
-    void* placeholder1 = nullptr;
-    void* placeholder2 = nullptr;
-    void* view1 = nullptr;
-    void* view2 = nullptr;
-
-    GetSystemInfo (&sysInfo);
-
-    if ((bufferSize % sysInfo.dwAllocationGranularity) != 0) {
-        return nullptr;
-    }
-
-    //
-    // Reserve a placeholder region where the buffer will be mapped.
-    //
-
-    placeholder1 = (PCHAR) VirtualAlloc2 (
-        nullptr,
-        nullptr,
-        2 * bufferSize,
-        MEM_RESERVE | MEM_RESERVE_PLACEHOLDER,
-        PAGE_NOACCESS,
-        nullptr, 0
-    );
+void ScrollingBuffer::CloseWriter() {
+    m_is_writer_closed = true;
+    if (m_export_header != nullptr) {
+        m_export_header->is_writer_closed.store(1, std::memory_order_release);
+    }
+}
 
-    if (placeholder1 == nullptr) {
-        printf ("VirtualAlloc2 failed, error %#x\n", GetLastError());
-        goto Exit;
+size_t ScrollingBuffer::GetRingSize(const size_t size) {
+    size_t ring_size = MIN_SIZE;
+    while ((ring_size < size) && (ring_size < MAX_SIZE)) {
+        ring_size *= 2;
     }
+    return ring_size;
+}
 
-    //
-    // Split the placeholder region into two regions of equal size.
-    //
+size_t ScrollingBuffer::GetChunkCount(const size_t ring_size) {
+    return std::max(MIN_CHUNKS, ring_size / BYTES_PER_CHUNK);
+}
 
-    result = VirtualFree (
-        placeholder1,
-        bufferSize,
-        MEM_RELEASE | MEM_PRESERVE_PLACEHOLDER
-    );
+void ScrollingBuffer::RequestResize(const size_t size) {
+    m_requested_size = GetRingSize(size);
+}
 
-    if (result == FALSE) {
-        printf ("VirtualFreeEx failed, error %#x\n", GetLastError());
-        goto Exit;
+bool ScrollingBuffer::ApplyResize() {
+    const size_t old_size = m_max_size;
+    const size_t new_size = m_requested_size;
+    if (new_size == old_size) {
+        return false;
     }
 
-    placeholder2 = (void*) ((ULONG_PTR) placeholder1 + bufferSize);
-
-    //
-    // Create a pagefile-backed section for the buffer.
-    //
-
-    section = CreateFileMapping (
-        INVALID_HANDLE_VALUE,
-        nullptr,
-        PAGE_READWRITE,
-        0,
-        bufferSize, nullptr
-    );
+    // the request is dropped if it can't be applied, the buffer manager asks again on its next pass
+    const uint64_t total_written = m_total_written;
+    if (m_is_lossless && (new_size < old_size) && ((total_written - m_total_consumed) > uint64_t(new_size))) {
+        m_requested_size = old_size;
+        return false;
+    }
 
-    if (section == nullptr) {
-        printf ("CreateFileMapping failed, error %#x\n", GetLastError());
-        goto Exit;
+    m_mapped_size += new_size;
+    char *new_ring_buffer_mirror = nullptr;
+    // an exported ring moves to the next generation so readers can tell they need to map it again
+    const uint64_t generation = (m_export_header != nullptr) ? (m_export_header->generation + 1) : 0;
+    char *new_ring_buffer = platform::create_ring_buffer(
+        new_size, &new_ring_buffer_mirror,
+        (m_export_header != nullptr) ? get_shared_ring_name(m_export_name, generation) : "");
+    if (new_ring_buffer == nullptr) {
+        m_mapped_size -= new_size;
+        m_requested_size = old_size;
+        return false;
     }
 
-    //
-    // Map the section into the first placeholder region.
-    //
+    // the most recent bytes keep their absolute offsets, the mirror keeps both sides of the copy contiguous
+    // we are the only writer so the old ring doesn't change while we copy it
+    size_t keep_size = size_t(std::min(total_written, uint64_t(std::min(old_size, new_size))));
+    // readers must not see the unwritten part of a ring which was grown as output
+    if (m_export_header != nullptr) {
+        keep_size = size_t(std::min(uint64_t(keep_size), total_written - m_export_header->begin_offset));
+    }
+    const uint64_t keep_offset = total_written - uint64_t(keep_size);
+    memcpy(&new_ring_buffer[keep_offset % new_size], &m_ring_buffer[keep_offset % old_size], keep_size);
+
+    // the chunk index keeps its absolute addressing, only the newest chunks fit into a smaller one
+    const size_t old_max_chunks = m_max_chunks;
+    const size_t new_max_chunks = GetChunkCount(new_size);
+    auto new_chunks = std::make_unique<ScrollingBufferChunk[]>(new_max_chunks);
+    const uint64_t total_chunks = m_total_chunks.load(std::memory_order_relaxed);
+    const uint64_t keep_chunks = std::min(total_chunks, uint64_t(std::min(old_max_chunks, new_max_chunks)));
+    for (uint64_t i = total_chunks - keep_chunks; i < total_chunks; i++) {
+        new_chunks[i % new_max_chunks] = m_chunks[i % old_max_chunks];
+    }
 
-    view1 = MapViewOfFile3 (
-        section,
-        nullptr,
-        placeholder1,
-        0,
-        bufferSize,
-        MEM_REPLACE_PLACEHOLDER,
-        PAGE_READWRITE,
-        nullptr, 0
-    );
+    char *old_ring_buffer = m_ring_buffer;
+    char *old_ring_buffer_mirror = m_ring_buffer_mirror;
+    {
+        auto lock = std::unique_lock(m_resize_mutex);
+        m_ring_buffer = new_ring_buffer;
+        m_ring_buffer_mirror = new_ring_buffer_mirror;
+        m_max_size = new_size;
+        m_chunks.swap(new_chunks);
+        m_max_chunks = new_max_chunks;
+        m_curr_write_index = size_t(total_written % new_size);
+        m_curr_size = keep_size;
+        m_curr_read_index = (m_curr_write_index + new_size - keep_size) % new_size;
+    }
+    if (m_export_header != nullptr) {
+        m_export_header->begin_offset.store(keep_offset, std::memory_order_release);
+        m_export_header->ring_size.store(new_size, std::memory_order_release);
+        m_export_header->generation.store(generation, std::memory_order_release);
+        platform::unlink_shared_memory(get_shared_ring_name(m_export_name, generation-1));
+    }
+    // unmapping both views releases the old section, so this is where memory is given back
+    // readers which still have the old ring mapped keep it alive until they move to the new one
+    platform::free_ring_buffer(old_ring_buffer, old_ring_buffer_mirror, old_size);
+    m_mapped_size -= old_size;
+
+    // bytes that didn't fit into a smaller ring are dropped like an overrun
+    uint64_t total_consumed = m_total_consumed;
+    while ((total_written - total_consumed) > uint64_t(new_size)) {
+        const uint64_t oldest_valid = total_written - uint64_t(new_size);
+        if (m_total_consumed.compare_exchange_weak(total_consumed, oldest_valid)) {
+            m_total_dropped += (oldest_valid - total_consumed);
+            break;
+        }
+    }
+    return true;
+}
 
-    if (view1 == nullptr) {
-        printf ("MapViewOfFile3 failed, error %#x\n", GetLastError());
-        goto Exit;
+void ScrollingBuffer::IncrementIndex(const size_t size) {
+    if (size == 0) {
+        return;
     }
+    AddChunk(m_total_written);
 
-    //
-    // Ownership transferred, don’t free this now.
-    //
+    // only the writer resizes so this can't change underneath us
+    const size_t max_size = m_max_size;
+    m_curr_write_index = (m_curr_write_index + size) % max_size;
+    // dont edit m_curr_size until we can guarantee a valid atomic write to it
+    // doing m_curr_size += size could place it into an invalid state (m_curr_size > max_size)
+    size_t new_curr_size = m_curr_size + size;
 
-    placeholder1 = nullptr;
+    // overhang detection
+    if (new_curr_size > max_size) {
+        m_curr_size = max_size;
+        m_curr_read_index = m_curr_write_index;
+    // buffer hasn't wrapped around yet
+    } else {
+        m_curr_size = new_curr_size;
+    }
 
-    //
-    // Map the section into the second placeholder region.
-    //
+    const uint64_t total_written = m_total_written + uint64_t(size);
+    m_total_written = total_written;
+    m_write_end.store(total_written, std::memory_order_release);
+    if (m_export_header != nullptr) {
+        m_export_header->total_written.store(total_written, std::memory_order_release);
+        m_export_header->write_end.store(total_written, std::memory_order_release);
+        m_export_header->sequence.fetch_add(1, std::memory_order_release);
+    }
 
-    view2 = MapViewOfFile3 (
-        section,
-        nullptr,
-        placeholder2,
-        0,
-        bufferSize,
-        MEM_REPLACE_PLACEHOLDER,
-        PAGE_READWRITE,
-        nullptr, 0
-    );
+    // bytes that were overwritten before a consumer saw them are dropped
+    // the consumer cursor is moved up to the oldest byte still in the buffer
+    uint64_t total_consumed = m_total_consumed;
+    while ((total_written - total_consumed) > uint64_t(max_size)) {
+        const uint64_t oldest_valid = total_written - uint64_t(max_size);
+        if (m_total_consumed.compare_exchange_weak(total_consumed, oldest_valid)) {
+            m_total_dropped += (oldest_valid - total_consumed);
+            total_consumed = oldest_valid;
+            break;
+        }
+    }
 
-    if (view2 == nullptr) {
-        printf ("MapViewOfFile3 failed, error %#x\n", GetLastError());
-        goto Exit;
+    const size_t pending_size = size_t(total_written - total_consumed);
+    if (pending_size > m_peak_pending_size) {
+        m_peak_pending_size = pending_size;
     }
+}
 
-    //
-    // Success, return both mapped views to the caller.
-    //
+void ScrollingBuffer::AddChunk(const uint64_t offset) {
+    auto now = std::chrono::steady_clock::now().time_since_epoch();
+    const int64_t timestamp_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(now).count();
+
+    // merge with the previous chunk if it arrived recently
+    // only the writer resizes the index so it can't change underneath us
+    const size_t max_chunks = m_max_chunks;
+    const uint64_t total_chunks = m_total_chunks.load(std::memory_order_relaxed);
+    if (total_chunks > 0) {
+        const auto &prev_chunk = m_chunks[(total_chunks-1) % max_chunks];
+        if ((timestamp_ns - prev_chunk.timestamp_ns) < CHUNK_RESOLUTION_NS) {
+            return;
+        }
+    }
 
-    ringBuffer = view1;
-    *secondaryView = view2;
+    m_chunks[total_chunks % max_chunks] = { offset, timestamp_ns };
+    m_total_chunks.store(total_chunks+1, std::memory_order_release);
+}
 
-    placeholder2 = nullptr;
-    view1 = nullptr;
-    view2 = nullptr;
+template <typename F>
+bool ScrollingBuffer::PartitionChunks(F &&pred, uint64_t &chunk_index, uint64_t &lower_index, uint64_t &upper_index) const {
+    const size_t max_chunks = m_max_chunks;
+    const uint64_t total_chunks = m_total_chunks.load(std::memory_order_acquire);
+    lower_index = (total_chunks > max_chunks) ? (total_chunks - max_chunks) : 0;
+    upper_index = total_chunks;
+
+    uint64_t lo = lower_index;
+    uint64_t hi = upper_index;
+    while (lo < hi) {
+        const uint64_t mid = lo + (hi-lo)/2;
+        if (pred(m_chunks[mid % max_chunks])) {
+            lo = mid+1;
+        } else {
+            hi = mid;
+        }
+    }
+    chunk_index = lo;
 
-Exit:
+    // the writer may have lapped the oldest chunks we looked at
+    const uint64_t new_total_chunks = m_total_chunks.load(std::memory_order_acquire);
+    const uint64_t valid_index = (new_total_chunks > max_chunks) ? (new_total_chunks - max_chunks) : 0;
+    return lower_index >= valid_index;
+}
 
-    if (section != nullptr) {
-        CloseHandle (section);
+bool ScrollingBuffer::ReadChunk(const uint64_t chunk_index, ScrollingBufferChunk &chunk) const {
+    if (chunk_index >= m_total_chunks.load(std::memory_order_acquire)) {
+        return false;
     }
+    const size_t max_chunks = m_max_chunks;
+    chunk = m_chunks[chunk_index % max_chunks];
+    const uint64_t total_chunks = m_total_chunks.load(std::memory_order_acquire);
+    return (total_chunks - chunk_index) <= max_chunks;
+}
 
-    if (placeholder1 != nullptr) {
-        VirtualFree (placeholder1, 0, MEM_RELEASE);
+bool ScrollingBuffer::GetTimestampAtOffset(const uint64_t offset, int64_t &timestamp_ns) const {
+    uint64_t chunk_index, lower_index, upper_index;
+    auto is_before = [offset](const ScrollingBufferChunk &chunk) { return chunk.offset <= offset; };
+    if (!PartitionChunks(is_before, chunk_index, lower_index, upper_index)) {
+        return false;
+    }
+    // first chunk starts after the offset
+    if (chunk_index == lower_index) {
+        return false;
     }
+    // read again through ReadChunk since the writer can lap the slot after the partition was checked
+    ScrollingBufferChunk chunk;
+    if (!ReadChunk(chunk_index-1, chunk)) {
+        return false;
+    }
+    timestamp_ns = chunk.timestamp_ns;
+    return true;
+}
 
-    if (placeholder2 != nullptr) {
-        VirtualFree (placeholder2, 0, MEM_RELEASE);
+bool ScrollingBuffer::GetOffsetAtTime(const int64_t timestamp_ns, uint64_t &offset) const {
+    uint64_t chunk_index, lower_index, upper_index;
+    auto is_before = [timestamp_ns](const ScrollingBufferChunk &chunk) { return chunk.timestamp_ns < timestamp_ns; };
+    if (!PartitionChunks(is_before, chunk_index, lower_index, upper_index)) {
+        return false;
+    }
+    if (lower_index == upper_index) {
+        return false;
+    }
+    if (chunk_index == upper_index) {
+        offset = m_total_written;
+        return true;
     }
+    ScrollingBufferChunk chunk;
+    if (!ReadChunk(chunk_index, chunk)) {
+        return false;
+    }
+    offset = chunk.offset;
+    return true;
+}
 
-    if (view1 != nullptr) {
-        UnmapViewOfFileEx (view1, 0);
+size_t ScrollingBuffer::GetFreeSize() const {
+    const uint64_t max_size = m_max_size;
+    const uint64_t pending_size = m_total_written - m_total_consumed;
+    if (pending_size >= max_size) {
+        return 0;
     }
+    return size_t(max_size - pending_size);
+}
+
+void ScrollingBuffer::MarkConsumed() {
+    MarkConsumed(m_total_written);
+}
 
-    if (view2 != nullptr) {
-        UnmapViewOfFileEx (view2, 0);
+void ScrollingBuffer::MarkConsumed(const uint64_t offset) {
+    // the writer can also move the consumer cursor forward on overrun, so never move it backwards
+    const uint64_t target = std::min(offset, uint64_t(m_total_written));
+    uint64_t total_consumed = m_total_consumed;
+    while (total_consumed < target) {
+        if (m_total_consumed.compare_exchange_weak(total_consumed, target)) {
+            break;
+        }
     }
+}
 
-    return ringBuffer;
+ScrollingBufferStats ScrollingBuffer::GetStats() const {
+    ScrollingBufferStats stats;
+    stats.total_captured = m_total_written;
+    stats.total_dropped = m_total_dropped;
+    const uint64_t total_consumed = m_total_consumed;
+    stats.pending_size = size_t(stats.total_captured - std::min(total_consumed, stats.total_captured));
+    stats.peak_pending_size = m_peak_pending_size;
+    return stats;
 }
+
+};
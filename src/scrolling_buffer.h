@@ -1,29 +1,152 @@
 #pragma once
 
 #include <atomic>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <stdint.h>
+
+#include "shared_ring.h"
 
 namespace app {
 
+// counters for how much data passed through the scrolling buffer
+struct ScrollingBufferStats {
+    uint64_t total_captured;    // bytes written into the buffer
+    uint64_t total_dropped;     // bytes overwritten before a consumer saw them
+    size_t pending_size;        // bytes written but not consumed yet
+    size_t peak_pending_size;   // highest fill level of unconsumed bytes
+};
+
+// when a read from the process landed in the buffer
+struct ScrollingBufferChunk {
+    uint64_t offset;        // absolute offset of the first byte of the chunk
+    int64_t timestamp_ns;   // steady clock, same clock as Tracer::GetTimestamp()
+};
+
 // scrolling buffer that uses a memory mapped circular buffer
 // uses two adjacent virtual memory pages which point to the same underlying physical memory
 // this makes circular buffer logic simpler - no need to prevent overrun
+// the ring can be resized by remapping it, the recent bytes keep their absolute offsets
 class ScrollingBuffer 
 {
+public:
+    // ring sizes are powers of two which are a multiple of the allocation granularity
+    static constexpr size_t MIN_SIZE = 0x10000;
+    static constexpr size_t MAX_SIZE = 0x4000000;
+    // side index of chunk timestamps, chunks closer together than the resolution are merged
+    // the index is sized from the byte ring and resized with it, so a grown ring stays covered
+    // unless the output is very slow and bursty
+    static constexpr size_t MIN_CHUNKS = 0x1000;
+    static constexpr size_t BYTES_PER_CHUNK = 0x400;
+    static constexpr int64_t CHUNK_RESOLUTION_NS = 1'000'000;
 private:
     char *m_ring_buffer;
     char *m_ring_buffer_mirror;
-    const unsigned int m_max_size = 0x10000;
+    std::atomic<size_t> m_max_size;
+    std::atomic<size_t> m_requested_size;
+    // counts both rings while a resize is copying between them
+    std::atomic<size_t> m_mapped_size;
+    // held shared by readers while they use pointers into the ring, a resize swaps the ring under it
+    mutable std::shared_mutex m_resize_mutex;
+    // resizing never drops bytes which haven't been consumed yet
+    std::atomic<bool> m_is_lossless;
+    // set once the writer is done, after which resizes can be applied from any thread
+    std::atomic<bool> m_is_writer_closed;
     std::atomic<size_t> m_curr_size;
     size_t m_curr_write_index;
     std::atomic<size_t> m_curr_read_index;
+    // monotonic byte counts used for overrun accounting
+    std::atomic<uint64_t> m_total_written;
+    // end of the write in progress, anything older than this minus the ring size may be getting overwritten
+    std::atomic<uint64_t> m_write_end;
+    std::atomic<uint64_t> m_total_consumed;
+    std::atomic<uint64_t> m_total_dropped;
+    std::atomic<size_t> m_peak_pending_size;
+    // ring of chunks addressed by absolute chunk index like the byte ring
+    // replaced under the resize mutex when the byte ring is resized
+    std::unique_ptr<ScrollingBufferChunk[]> m_chunks;
+    std::atomic<size_t> m_max_chunks;
+    std::atomic<uint64_t> m_total_chunks;
+    // set if the ring is exported as shared memory for other processes to read
+    std::string m_export_name;
+    SharedRingHeader *m_export_header = nullptr;
+private:
+    void PublishWrite(const size_t size);
 public:
-    ScrollingBuffer();
+    ScrollingBuffer(const size_t size=MIN_SIZE);
     ~ScrollingBuffer();
     inline char *GetReadBuffer()  { return &m_ring_buffer[m_curr_read_index]; }
-    inline char *GetWriteBuffer() { return &m_ring_buffer[m_curr_write_index]; }
+    // size is the most that will be written before IncrementIndex(), readers are told those bytes
+    // are being overwritten so they can't mistake a half written chunk for old output
+    inline char *GetWriteBuffer(const size_t size=MAX_SIZE) {
+        PublishWrite(size);
+        return &m_ring_buffer[m_curr_write_index];
+    }
     inline size_t GetReadSize() { return m_curr_size; }
-    inline size_t GetMaxSize() { return m_max_size; }
+    inline size_t GetMaxSize() const { return m_max_size; }
+    // absolute addressing, bytes at an offset stay valid while GetTotalWritten()-offset <= GetMaxSize()
+    inline uint64_t GetTotalWritten() const { return m_total_written; }
+    // readers which copy straight out of the ring recheck this afterwards, the bytes at an offset
+    // were intact if GetWriteEnd()-offset <= GetMaxSize() since it covers a write which hasn't been counted yet
+    inline uint64_t GetWriteEnd() const {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return m_write_end.load(std::memory_order_relaxed);
+    }
+    inline const char *GetBufferAtOffset(const uint64_t offset) const { return &m_ring_buffer[offset % m_max_size]; }
+    // hold this while using pointers from GetBufferAtOffset() so the ring isn't remapped underneath them
+    // don't call into the buffer manager while holding it, it may be waiting to resize this buffer
+    inline std::shared_lock<std::shared_mutex> LockRead() const { return std::shared_lock(m_resize_mutex); }
+    // rounds up to a size the ring can be created with
+    static size_t GetRingSize(const size_t size);
+    // number of entries in the chunk index of a ring
+    static size_t GetChunkCount(const size_t ring_size);
+    // the resize is applied later by the writer, or by ApplyResize() once the writer is closed
+    // don't change a request which is still pending since the writer may already be applying it
+    void RequestResize(const size_t size);
+    inline size_t GetRequestedSize() const { return m_requested_size; }
+    inline bool IsResizePending() const { return m_requested_size != m_max_size; }
+    // memory held by the ring, this is never less than what is actually mapped
+    inline size_t GetMappedSize() const { return m_mapped_size; }
+    // remaps the ring if a resize was requested, returns true if it was resized
+    // the old and new rings are both mapped while the recent bytes are copied across
+    // the request is dropped if the ring couldn't be created or a lossless ring would drop unconsumed bytes
+    // only call this from the writer thread or after CloseWriter()
+    bool ApplyResize();
+    inline void SetIsLossless(const bool is_lossless) { m_is_lossless = is_lossless; }
+    // exports the ring as read only shared memory which a SharedRingReader can tail from another process
+    // call this before anything is written, returns false if it couldn't be exported
+    bool Export(const std::string &name);
+    inline const std::string &GetExportName() const { return m_export_name; }
+    void CloseWriter();
+    inline bool IsWriterClosed() const { return m_is_writer_closed; }
+    // space that can be written without overwriting unconsumed bytes
+    size_t GetFreeSize() const;
     void IncrementIndex(const size_t size);
+    // mark everything written so far as seen by a consumer
+    void MarkConsumed();
+    // mark everything up to an absolute offset as seen by a consumer
+    void MarkConsumed(const uint64_t offset);
+    ScrollingBufferStats GetStats() const;
+    // chunks are addressed by absolute index, the oldest ones are overwritten after GetMaxChunks()
+    // hold LockRead() while reading chunks since a resize replaces the index
+    inline uint64_t GetTotalChunks() const { return m_total_chunks.load(std::memory_order_acquire); }
+    inline size_t GetMaxChunks() const { return m_max_chunks; }
+    // returns false if the chunk hasn't been written yet or was overwritten
+    bool ReadChunk(const uint64_t chunk_index, ScrollingBufferChunk &chunk) const;
+    // arrival time of the chunk containing the byte at an offset
+    // returns false if the offset is older than the oldest chunk in the index
+    bool GetTimestampAtOffset(const uint64_t offset, int64_t &timestamp_ns) const;
+    // offset of the first chunk which arrived at or after a time
+    // times past the newest chunk give GetTotalWritten(), returns false if nothing was captured
+    bool GetOffsetAtTime(const int64_t timestamp_ns, uint64_t &offset) const;
+private:
+    void AddChunk(const uint64_t offset);
+    // binary search over the chunk index for the first chunk where pred is false
+    // returns the absolute chunk index or false if the index was overwritten during the search
+    template <typename F>
+    bool PartitionChunks(F &&pred, uint64_t &chunk_index, uint64_t &lower_index, uint64_t &upper_index) const;
 };
 
 }
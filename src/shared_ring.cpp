@@ -0,0 +1,91 @@
+#include "shared_ring.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include <fmt/core.h>
+
+#include "platform.h"
+
+namespace app {
+
+std::string get_shared_ring_name(const std::string &name, const uint64_t generation) {
+    return fmt::format("{}.{}", name, generation);
+}
+
+SharedRingReader::SharedRingReader(const std::string &name)
+: m_name(name)
+{
+    m_header = (const SharedRingHeader *)(platform::open_shared_memory(name, m_header_size));
+    if (m_header == nullptr) {
+        throw std::runtime_error(fmt::format("Nothing is exported as ({})", name));
+    }
+    if ((m_header_size < sizeof(SharedRingHeader)) ||
+        (m_header->magic != SHARED_RING_MAGIC) ||
+        (m_header->version != SHARED_RING_VERSION))
+    {
+        platform::free_shared_memory(m_header, m_header_size);
+        throw std::runtime_error(fmt::format("Shared memory isn't an exported ring ({})", name));
+    }
+    if (!Update()) {
+        platform::free_shared_memory(m_header, m_header_size);
+        throw std::runtime_error(fmt::format("Failed to map exported ring ({})", name));
+    }
+}
+
+SharedRingReader::~SharedRingReader() {
+    if (m_ring_buffer != nullptr) {
+        platform::free_ring_buffer(m_ring_buffer, m_ring_buffer_mirror, m_max_size);
+    }
+    platform::free_shared_memory(m_header, m_header_size);
+}
+
+bool SharedRingReader::Update() {
+    // the writer could resize again while we open the ring, so retry until we got the current one
+    while (true) {
+        const uint64_t generation = m_header->generation.load(std::memory_order_acquire);
+        if ((m_ring_buffer != nullptr) && (generation == m_generation)) {
+            return true;
+        }
+        // this may already belong to the next generation, which is never older so it is safe to use
+        const uint64_t begin_offset = m_header->begin_offset.load(std::memory_order_acquire);
+        size_t max_size = 0;
+        const char *ring_buffer_mirror = nullptr;
+        const char *ring_buffer = platform::open_shared_ring_buffer(
+            get_shared_ring_name(m_name, generation), max_size, &ring_buffer_mirror);
+        if (ring_buffer == nullptr) {
+            // the old ring is unlinked once the next one is published, so we may have just missed it
+            if (m_header->generation.load(std::memory_order_acquire) != generation) {
+                continue;
+            }
+            return false;
+        }
+        if (m_ring_buffer != nullptr) {
+            platform::free_ring_buffer(m_ring_buffer, m_ring_buffer_mirror, m_max_size);
+        }
+        m_ring_buffer = ring_buffer;
+        m_ring_buffer_mirror = ring_buffer_mirror;
+        m_max_size = max_size;
+        m_generation = generation;
+        m_begin_offset = begin_offset;
+    }
+}
+
+uint64_t SharedRingReader::GetOldestOffset() const {
+    const uint64_t write_end = m_header->write_end.load(std::memory_order_acquire);
+    return std::max(m_begin_offset, write_end - std::min(write_end, uint64_t(m_max_size)));
+}
+
+bool SharedRingReader::IsValid(const uint64_t offset) const {
+    // orders the reads of the ring before the checks, like the read side of a seqlock
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (m_header->generation.load(std::memory_order_relaxed) != m_generation) {
+        return false;
+    }
+    if (offset < m_begin_offset) {
+        return false;
+    }
+    return (m_header->write_end.load(std::memory_order_relaxed) - offset) <= uint64_t(m_max_size);
+}
+
+}
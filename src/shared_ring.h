@@ -0,0 +1,70 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <string>
+
+namespace app {
+
+// a scrolling buffer exported with ScrollingBuffer::Export() is a small header under its name
+// and the ring under "<name>.<generation>", a resize moves the ring to the next generation
+static constexpr uint32_t SHARED_RING_MAGIC = 0x474E4952;   // RING
+static constexpr uint32_t SHARED_RING_VERSION = 1;
+
+// only the writer stores to this, readers map it read only
+struct SharedRingHeader {
+    uint32_t magic;
+    uint32_t version;
+    std::atomic<uint64_t> generation;
+    std::atomic<uint64_t> ring_size;
+    // oldest offset the current generation holds, a grown ring starts with less than ring_size of history
+    std::atomic<uint64_t> begin_offset;
+    std::atomic<uint64_t> total_written;
+    // end of the write in progress, the writer may be overwriting anything older than write_end-ring_size
+    // bytes at an offset are valid while write_end-offset <= ring_size, offset >= begin_offset and the generation is the same
+    std::atomic<uint64_t> write_end;
+    // bumped after every write so readers can wait for output with a single load
+    std::atomic<uint64_t> sequence;
+    std::atomic<uint32_t> is_writer_closed;
+};
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "Shared ring header needs lock free atomics");
+
+std::string get_shared_ring_name(const std::string &name, const uint64_t generation);
+
+// read only view of an exported scrolling buffer, usually from another process
+// reads are loads from the mapping and never take a lock or make a syscall, so they can't hold up the writer
+// the writer doesn't know about readers either, a reader which falls behind finds its bytes overwritten
+class SharedRingReader
+{
+private:
+    std::string m_name;
+    const SharedRingHeader *m_header;
+    size_t m_header_size;
+    const char *m_ring_buffer = nullptr;
+    const char *m_ring_buffer_mirror = nullptr;
+    size_t m_max_size = 0;
+    uint64_t m_generation = 0;
+    uint64_t m_begin_offset = 0;
+public:
+    // throws if nothing is exported under the name
+    SharedRingReader(const std::string &name);
+    ~SharedRingReader();
+    // maps the ring again if the writer resized it, returns false if the new ring couldn't be mapped
+    // this is the only call which makes syscalls and only when the generation changed
+    bool Update();
+    inline uint64_t GetSequence() const { return m_header->sequence.load(std::memory_order_acquire); }
+    inline uint64_t GetTotalWritten() const { return m_header->total_written.load(std::memory_order_acquire); }
+    inline bool IsWriterClosed() const { return m_header->is_writer_closed.load(std::memory_order_acquire) != 0; }
+    inline size_t GetMaxSize() const { return m_max_size; }
+    // output before this is gone or about to be overwritten, so readers which fell behind should skip to it
+    uint64_t GetOldestOffset() const;
+    // like ScrollingBuffer, a read that runs off the end of the ring continues in the mirror
+    inline const char *GetBufferAtOffset(const uint64_t offset) const { return &m_ring_buffer[offset % m_max_size]; }
+    // check this after using bytes from GetBufferAtOffset(), they can't be trusted if the writer lapped or moved them
+    bool IsValid(const uint64_t offset) const;
+    SharedRingReader(const SharedRingReader &) = delete;
+    SharedRingReader &operator=(const SharedRingReader &) = delete;
+};
+
+}
@@ -0,0 +1,212 @@
+#include "supervisor.h"
+
+#include <algorithm>
+
+#include <fmt/core.h>
+#include <spdlog/spdlog.h>
+
+#include "tracing.h"
+
+namespace app {
+
+const char *supervised_state_to_string(const SupervisedStatus::State state) {
+    switch (state) {
+    case SupervisedStatus::State::RUNNING:      return "running";
+    case SupervisedStatus::State::BACKOFF:      return "waiting to restart";
+    case SupervisedStatus::State::STOPPED:      return "stopped";
+    case SupervisedStatus::State::CRASH_LOOP:   return "crash loop";
+    default:                                    return "unknown";
+    }
+}
+
+static std::string get_exit_reason(const AppProcess &process) {
+    if (process.IsTerminatedByUser()) {
+        return "terminated by user";
+    }
+    const int64_t exit_code = process.GetExitCode();
+    if (exit_code < 0) {
+        return "unknown exit code";
+    }
+    // ntstatus error codes like access violations are easier to read in hex
+    if (exit_code >= 0xC0000000) {
+        return fmt::format("exit code 0x{:08X}", uint32_t(exit_code));
+    }
+    return fmt::format("exit code {}", exit_code);
+}
+
+Supervisor::Supervisor(launch_callback_t launch)
+: m_launch(std::move(launch))
+{}
+
+void Supervisor::Shutdown() {
+    {
+        auto lock = std::scoped_lock(m_mutex);
+        m_is_running = false;
+    }
+    m_timer_wheel.Stop();
+}
+
+void Supervisor::OnProcessExit(AppProcess &process) {
+    auto &cfg = process.GetConfig();
+    if (cfg.restart_policy == RestartPolicy::NEVER) {
+        return;
+    }
+
+    auto lock = std::scoped_lock(m_mutex);
+    if (!m_is_running) {
+        return;
+    }
+    auto &service = m_services[cfg.name];
+    service.config = cfg;
+    service.last_exit_reason = get_exit_reason(process);
+
+    if (process.IsTerminatedByUser()) {
+        service.state = SupervisedStatus::State::STOPPED;
+        return;
+    }
+
+    const bool is_failure = process.GetExitCode() != 0;
+    if ((cfg.restart_policy == RestartPolicy::ON_FAILURE) && !is_failure) {
+        service.state = SupervisedStatus::State::STOPPED;
+        service.total_consecutive_failures = 0;
+        return;
+    }
+
+    const auto uptime = std::chrono::nanoseconds(Tracer::GetTimestamp() - process.GetStartTimestamp());
+    ScheduleRestart(service, std::chrono::duration_cast<clock::duration>(uptime));
+}
+
+void Supervisor::OnLaunchFailure(const AppConfig &cfg, const std::string &error) {
+    auto lock = std::scoped_lock(m_mutex);
+    if (!m_is_running) {
+        return;
+    }
+    auto it = m_services.find(cfg.name);
+    if (it == m_services.end()) {
+        return;
+    }
+    // the user stopped it or launched it again since
+    auto &service = it->second;
+    if (service.state != SupervisedStatus::State::RUNNING) {
+        return;
+    }
+    service.last_exit_reason = fmt::format("failed to launch: {}", error);
+    ScheduleRestart(service, clock::duration::zero());
+}
+
+void Supervisor::ScheduleRestart(Service &service, const clock::duration uptime) {
+    const auto &cfg = service.config;
+    const auto now = clock::now();
+    if (uptime >= STABLE_UPTIME) {
+        service.total_consecutive_failures = 0;
+    }
+
+    // too many restarts within the window means it is crash looping
+    const auto window = std::chrono::seconds(std::max(cfg.restart_window_seconds, 1));
+    while (!service.restart_times.empty() && ((now - service.restart_times.front()) > window)) {
+        service.restart_times.pop_front();
+    }
+    if (service.restart_times.size() >= size_t(std::max(cfg.max_restarts, 0))) {
+        service.state = SupervisedStatus::State::CRASH_LOOP;
+        auto warning = fmt::format(
+            "Stopped restarting ({}) after {} restarts within {}s, last exit was {}",
+            cfg.name, service.restart_times.size(), window.count(), service.last_exit_reason);
+        spdlog::warn(warning);
+        m_warnings.push_back(std::move(warning));
+        return;
+    }
+
+    const uint32_t total_doublings = std::min(service.total_consecutive_failures, uint32_t(16));
+    const auto backoff = std::min(
+        std::chrono::duration_cast<clock::duration>(INITIAL_BACKOFF * (uint64_t(1) << total_doublings)),
+        std::chrono::duration_cast<clock::duration>(MAX_BACKOFF));
+    service.total_consecutive_failures++;
+    service.state = SupervisedStatus::State::BACKOFF;
+    service.restart_time = now + backoff;
+
+    m_timer_wheel.Cancel(service.timer_id);
+    auto name = cfg.name;
+    service.timer_id = m_timer_wheel.Schedule(backoff, [this, name]() { Restart(name); });
+}
+
+void Supervisor::Restart(const std::string &name) {
+    AppConfig cfg;
+    {
+        auto lock = std::scoped_lock(m_mutex);
+        if (!m_is_running) {
+            return;
+        }
+        auto it = m_services.find(name);
+        if (it == m_services.end()) {
+            return;
+        }
+        auto &service = it->second;
+        if (service.state != SupervisedStatus::State::BACKOFF) {
+            return;
+        }
+        service.state = SupervisedStatus::State::RUNNING;
+        service.total_restarts++;
+        service.restart_times.push_back(clock::now());
+        service.timer_id = 0;
+        cfg = service.config;
+    }
+    spdlog::info(fmt::format("Restarting ({})", name));
+    m_launch(cfg);
+}
+
+void Supervisor::OnUserLaunch(const std::string &name) {
+    auto lock = std::scoped_lock(m_mutex);
+    auto it = m_services.find(name);
+    if (it == m_services.end()) {
+        return;
+    }
+    auto &service = it->second;
+    m_timer_wheel.Cancel(service.timer_id);
+    service.timer_id = 0;
+    service.state = SupervisedStatus::State::RUNNING;
+    service.total_consecutive_failures = 0;
+    service.restart_times.clear();
+}
+
+void Supervisor::Stop(const std::string &name) {
+    auto lock = std::scoped_lock(m_mutex);
+    auto it = m_services.find(name);
+    if (it == m_services.end()) {
+        return;
+    }
+    auto &service = it->second;
+    m_timer_wheel.Cancel(service.timer_id);
+    service.timer_id = 0;
+    if (service.state == SupervisedStatus::State::BACKOFF) {
+        service.state = SupervisedStatus::State::STOPPED;
+    }
+}
+
+std::optional<SupervisedStatus> Supervisor::GetStatus(const std::string &name) {
+    auto lock = std::scoped_lock(m_mutex);
+    auto it = m_services.find(name);
+    if (it == m_services.end()) {
+        return std::nullopt;
+    }
+    auto &service = it->second;
+    SupervisedStatus status;
+    status.state = service.state;
+    status.total_restarts = service.total_restarts;
+    status.last_exit_reason = service.last_exit_reason;
+    status.backoff_seconds = 0.0f;
+    if (service.state == SupervisedStatus::State::BACKOFF) {
+        const auto remaining = service.restart_time - clock::now();
+        status.backoff_seconds = std::max(std::chrono::duration<float>(remaining).count(), 0.0f);
+    }
+    return status;
+}
+
+void Supervisor::TakeWarnings(std::vector<std::string> &warnings) {
+    auto lock = std::scoped_lock(m_mutex);
+    for (auto &warning: m_warnings) {
+        warnings.push_back(std::move(warning));
+    }
+    m_warnings.clear();
+}
+
+}
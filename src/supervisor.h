@@ -0,0 +1,82 @@
+#pragma once
+
+#include <stdint.h>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "app_schema.h"
+#include "app_process.h"
+#include "timer_wheel.h"
+
+namespace app {
+
+// restart state of an app that was launched with a restart policy
+struct SupervisedStatus {
+    enum State { RUNNING, BACKOFF, STOPPED, CRASH_LOOP };
+    State state;
+    uint32_t total_restarts;
+    std::string last_exit_reason;
+    float backoff_seconds;      // time left until the next restart
+};
+
+const char *supervised_state_to_string(const SupervisedStatus::State state);
+
+// restarts apps according to their restart policy when their process exits
+// restarts are delayed with exponential backoff on a shared timer wheel
+// an app which restarts too often within its window is treated as crash looping and left stopped
+// a restart which fails to launch counts the same as a failed exit
+class Supervisor
+{
+public:
+    using clock = std::chrono::steady_clock;
+    using launch_callback_t = std::function<void (const AppConfig &)>;
+    static constexpr auto INITIAL_BACKOFF = std::chrono::milliseconds(500);
+    static constexpr auto MAX_BACKOFF = std::chrono::seconds(60);
+    // a process that stayed up this long resets the backoff
+    static constexpr auto STABLE_UPTIME = std::chrono::seconds(30);
+private:
+    struct Service {
+        AppConfig config;
+        SupervisedStatus::State state = SupervisedStatus::State::RUNNING;
+        uint32_t total_restarts = 0;
+        uint32_t total_consecutive_failures = 0;
+        std::deque<clock::time_point> restart_times;
+        std::string last_exit_reason;
+        uint64_t timer_id = 0;
+        clock::time_point restart_time;
+    };
+    std::mutex m_mutex;
+    std::unordered_map<std::string, Service> m_services;
+    std::vector<std::string> m_warnings;
+    launch_callback_t m_launch;
+    bool m_is_running = true;
+    // declared last so its thread is stopped before the services are destroyed
+    TimerWheel m_timer_wheel;
+public:
+    Supervisor(launch_callback_t launch);
+    // stops restarting and waits for a restart that is already running
+    // the owner calls this before anything the launch callback uses is destroyed
+    void Shutdown();
+    // called from the listener thread of an exiting process
+    void OnProcessExit(AppProcess &process);
+    // a restart couldn't launch the process, this counts as a failed exit
+    void OnLaunchFailure(const AppConfig &cfg, const std::string &error);
+    // an app was launched by the user, this cancels any pending restart and clears a crash loop
+    void OnUserLaunch(const std::string &name);
+    // cancel the pending restart of an app
+    void Stop(const std::string &name);
+    std::optional<SupervisedStatus> GetStatus(const std::string &name);
+    void TakeWarnings(std::vector<std::string> &warnings);
+private:
+    // expects the lock to be held
+    void ScheduleRestart(Service &service, const clock::duration uptime);
+    void Restart(const std::string &name);
+};
+
+}
@@ -0,0 +1,116 @@
+#include "timer_wheel.h"
+
+#include <algorithm>
+
+#include "tracing.h"
+
+namespace app {
+
+TimerWheel::TimerWheel()
+: m_next_tick(clock::now() + TICK)
+{
+    m_thread = std::thread([this]() { TimerThread(); });
+}
+
+TimerWheel::~TimerWheel() {
+    Stop();
+}
+
+void TimerWheel::Stop() {
+    {
+        auto lock = std::scoped_lock(m_mutex);
+        m_is_running = false;
+        for (auto &timers: m_slots) {
+            timers.clear();
+        }
+        m_timer_slots.clear();
+    }
+    m_cv.notify_all();
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+}
+
+uint64_t TimerWheel::Schedule(const clock::duration delay, callback_t callback) {
+    auto lock = std::scoped_lock(m_mutex);
+    if (!m_is_running) {
+        return 0;
+    }
+    // the wheel doesn't turn while it is empty so restart the tick from now
+    if (m_timer_slots.empty()) {
+        m_next_tick = clock::now() + TICK;
+    }
+
+    const auto tick_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(TICK).count();
+    const auto delay_ns = std::max(int64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(delay).count()), int64_t(0));
+    const uint64_t total_ticks = std::max(uint64_t((delay_ns + tick_ns - 1) / tick_ns), uint64_t(1));
+
+    const uint64_t id = m_next_id++;
+    const size_t slot = (m_curr_slot + size_t(total_ticks % TOTAL_SLOTS)) % TOTAL_SLOTS;
+    m_slots[slot].push_back({ id, (total_ticks-1) / TOTAL_SLOTS, std::move(callback) });
+    m_timer_slots[id] = slot;
+    m_cv.notify_all();
+    return id;
+}
+
+bool TimerWheel::Cancel(const uint64_t id) {
+    auto lock = std::scoped_lock(m_mutex);
+    auto it = m_timer_slots.find(id);
+    if (it == m_timer_slots.end()) {
+        return false;
+    }
+    auto &timers = m_slots[it->second];
+    timers.erase(
+        std::remove_if(timers.begin(), timers.end(), [id](const Timer &timer) { return timer.id == id; }),
+        timers.end());
+    m_timer_slots.erase(it);
+    return true;
+}
+
+size_t TimerWheel::GetTotalTimers() {
+    auto lock = std::scoped_lock(m_mutex);
+    return m_timer_slots.size();
+}
+
+void TimerWheel::TimerThread() {
+    Tracer::Get().SetThreadName("timer wheel");
+    std::vector<callback_t> expired;
+    auto lock = std::unique_lock(m_mutex);
+    while (m_is_running) {
+        if (m_timer_slots.empty()) {
+            m_cv.wait(lock);
+            continue;
+        }
+        if (clock::now() < m_next_tick) {
+            m_cv.wait_until(lock, m_next_tick);
+            continue;
+        }
+
+        // catch up on ticks we were late for
+        while (!m_timer_slots.empty() && (clock::now() >= m_next_tick)) {
+            m_curr_slot = (m_curr_slot + 1) % TOTAL_SLOTS;
+            m_next_tick += TICK;
+            auto &timers = m_slots[m_curr_slot];
+            for (auto it = timers.begin(); it != timers.end();) {
+                if (it->rounds > 0) {
+                    it->rounds--;
+                    it++;
+                    continue;
+                }
+                m_timer_slots.erase(it->id);
+                expired.push_back(std::move(it->callback));
+                it = timers.erase(it);
+            }
+        }
+
+        // callbacks can schedule new timers
+        lock.unlock();
+        for (auto &callback: expired) {
+            callback();
+        }
+        expired.clear();
+        lock.lock();
+    }
+}
+
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stdint.h>
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace app {
+
+// hashed timing wheel which runs its callbacks on a single thread
+// scheduling and cancelling are O(1) and each tick only looks at one slot
+// so it can hold a large number of timers without a thread or heap per timer
+class TimerWheel
+{
+public:
+    using clock = std::chrono::steady_clock;
+    using callback_t = std::function<void (void)>;
+    static constexpr size_t TOTAL_SLOTS = 512;
+    static constexpr auto TICK = std::chrono::milliseconds(100);
+private:
+    struct Timer {
+        uint64_t id;
+        uint64_t rounds;    // full turns of the wheel left before it fires
+        callback_t callback;
+    };
+    std::array<std::vector<Timer>, TOTAL_SLOTS> m_slots;
+    std::unordered_map<uint64_t, size_t> m_timer_slots;
+    uint64_t m_next_id = 1;
+    size_t m_curr_slot = 0;
+    clock::time_point m_next_tick;
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    bool m_is_running = true;
+    std::thread m_thread;
+public:
+    TimerWheel();
+    ~TimerWheel();
+    // drops every timer and joins the thread, nothing can be scheduled afterwards
+    // can't be called from a callback
+    void Stop();
+    // delays are rounded up to the next tick
+    uint64_t Schedule(const clock::duration delay, callback_t callback);
+    // returns false if the timer already fired or doesn't exist
+    bool Cancel(const uint64_t id);
+    size_t GetTotalTimers();
+    TimerWheel(const TimerWheel &) = delete;
+    TimerWheel& operator=(const TimerWheel &) = delete;
+private:
+    void TimerThread();
+};
+
+}
@@ -0,0 +1,153 @@
+#include "tracing.h"
+
+#include <chrono>
+#include <fstream>
+#include <vector>
+#include <algorithm>
+
+#include <rapidjson/ostreamwrapper.h>
+#include <rapidjson/writer.h>
+#include <fmt/core.h>
+
+namespace app {
+
+static thread_local TraceThreadBuffer *t_buffer = nullptr;
+static thread_local uint64_t t_launch_id = 0;
+static thread_local std::string t_thread_name;
+
+TraceThreadBuffer::TraceThreadBuffer(const uint32_t thread_id, std::string thread_name)
+: m_total_written(0), m_thread_id(thread_id), m_thread_name(std::move(thread_name))
+{}
+
+template <typename F>
+void TraceThreadBuffer::ForEachEvent(F &&func) const {
+    const uint64_t total_written = m_total_written.load(std::memory_order_acquire);
+    const uint64_t start = (total_written > MAX_EVENTS) ? (total_written - MAX_EVENTS) : 0;
+    auto events = std::vector<TraceEvent>();
+    events.reserve(size_t(total_written - start));
+    for (uint64_t i = start; i < total_written; i++) {
+        events.push_back(m_events[i % MAX_EVENTS]);
+    }
+
+    // skip events which the writer overwrote while we were copying
+    const uint64_t new_total_written = m_total_written.load(std::memory_order_acquire);
+    const uint64_t valid_start = (new_total_written > MAX_EVENTS) ? (new_total_written - MAX_EVENTS) : 0;
+    for (uint64_t i = std::max(start, valid_start); i < total_written; i++) {
+        func(events[size_t(i - start)]);
+    }
+}
+
+Tracer::Tracer()
+: m_is_enabled(false), m_next_launch_id(1)
+{}
+
+Tracer &Tracer::Get() {
+    static Tracer tracer;
+    return tracer;
+}
+
+int64_t Tracer::GetTimestamp() {
+    auto now = std::chrono::steady_clock::now().time_since_epoch();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(now).count();
+}
+
+TraceThreadBuffer &Tracer::GetThreadBuffer() {
+    if (t_buffer == nullptr) {
+        auto lock = std::scoped_lock(m_buffers_mutex);
+        const auto thread_id = uint32_t(m_buffers.size() + 1);
+        auto name = t_thread_name.empty() ? fmt::format("thread {}", thread_id) : t_thread_name;
+        m_buffers.push_back(std::make_unique<TraceThreadBuffer>(thread_id, std::move(name)));
+        t_buffer = m_buffers.back().get();
+    }
+    return *t_buffer;
+}
+
+void Tracer::SetThreadName(std::string name) {
+    t_thread_name = name;
+    if (t_buffer != nullptr) {
+        auto lock = std::scoped_lock(m_buffers_mutex);
+        t_buffer->SetThreadName(std::move(name));
+    }
+}
+
+void Tracer::AddEvent(const char *name, const int64_t start_ns, const int64_t end_ns) {
+    AddEvent(name, start_ns, end_ns, t_launch_id);
+}
+
+void Tracer::AddEvent(const char *name, const int64_t start_ns, const int64_t end_ns, const uint64_t launch_id) {
+    if (!m_is_enabled) {
+        return;
+    }
+    GetThreadBuffer().Push({ name, launch_id, start_ns, end_ns });
+}
+
+// chrome trace event format: https://docs.google.com/document/d/1CvAClvFfyA5R-PhYUmn5OOQtYMH4h6I0nSsKchNAySU
+// this can also be opened in perfetto
+bool Tracer::ExportChromeTrace(const char *filename) {
+    std::ofstream file(filename);
+    if (!file.is_open()) {
+        return false;
+    }
+
+    rapidjson::OStreamWrapper os(file);
+    rapidjson::Writer<rapidjson::OStreamWrapper> writer(os);
+
+    writer.StartObject();
+    writer.Key("displayTimeUnit");
+    writer.String("ms");
+    writer.Key("traceEvents");
+    writer.StartArray();
+
+    auto lock = std::scoped_lock(m_buffers_mutex);
+    for (auto &buffer: m_buffers) {
+        const auto tid = buffer->GetThreadId();
+
+        writer.StartObject();
+        writer.Key("name");  writer.String("thread_name");
+        writer.Key("ph");    writer.String("M");
+        writer.Key("pid");   writer.Uint(1);
+        writer.Key("tid");   writer.Uint(tid);
+        writer.Key("args");
+        writer.StartObject();
+        writer.Key("name");  writer.String(buffer->GetThreadName().c_str());
+        writer.EndObject();
+        writer.EndObject();
+
+        buffer->ForEachEvent([&writer, tid](const TraceEvent &ev) {
+            writer.StartObject();
+            writer.Key("name");  writer.String(ev.name);
+            writer.Key("cat");   writer.String((ev.launch_id != 0) ? "launch" : "app");
+            writer.Key("ph");    writer.String("X");
+            writer.Key("pid");   writer.Uint(1);
+            writer.Key("tid");   writer.Uint(tid);
+            writer.Key("ts");    writer.Double(double(ev.start_ns) * 1e-3);
+            writer.Key("dur");   writer.Double(double(ev.end_ns - ev.start_ns) * 1e-3);
+            writer.Key("args");
+            writer.StartObject();
+            writer.Key("launch_id"); writer.Uint64(ev.launch_id);
+            writer.EndObject();
+            writer.EndObject();
+        });
+    }
+
+    writer.EndArray();
+    writer.EndObject();
+    file << std::endl;
+    return true;
+}
+
+TraceLaunchScope::TraceLaunchScope(const uint64_t launch_id)
+: m_prev_launch_id(t_launch_id)
+{
+    t_launch_id = launch_id;
+}
+
+TraceLaunchScope::~TraceLaunchScope() {
+    t_launch_id = m_prev_launch_id;
+}
+
+uint64_t TraceLaunchScope::GetCurrentLaunchId() {
+    return t_launch_id;
+}
+
+}
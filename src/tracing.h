@@ -0,0 +1,118 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <array>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace app {
+
+// span based tracing that can be exported to the chrome trace event format
+// each thread writes into its own ring of events without locking
+// events are tagged with a launch id so all the stages of a launch can be found together
+struct TraceEvent {
+    const char *name;       // must have static lifetime, i.e. a string literal
+    uint64_t launch_id;     // 0 if the event is not part of a launch
+    int64_t start_ns;
+    int64_t end_ns;
+};
+
+// single producer ring of events owned by one thread
+class TraceThreadBuffer
+{
+public:
+    static constexpr size_t MAX_EVENTS = 0x1000;
+private:
+    std::array<TraceEvent, MAX_EVENTS> m_events;
+    std::atomic<uint64_t> m_total_written;
+    const uint32_t m_thread_id;
+    std::string m_thread_name;
+public:
+    TraceThreadBuffer(const uint32_t thread_id, std::string thread_name);
+    inline void Push(const TraceEvent &event) {
+        const uint64_t i = m_total_written.load(std::memory_order_relaxed);
+        m_events[i % MAX_EVENTS] = event;
+        m_total_written.store(i+1, std::memory_order_release);
+    }
+    inline uint32_t GetThreadId() const { return m_thread_id; }
+    inline const std::string &GetThreadName() const { return m_thread_name; }
+    inline void SetThreadName(std::string name) { m_thread_name = std::move(name); }
+    // copy out the events which are still in the ring
+    template <typename F>
+    void ForEachEvent(F &&func) const;
+};
+
+class Tracer
+{
+private:
+    std::atomic<bool> m_is_enabled;
+    std::atomic<uint64_t> m_next_launch_id;
+    // buffers are never freed since detached threads can still be writing to them
+    std::mutex m_buffers_mutex;
+    std::list<std::unique_ptr<TraceThreadBuffer>> m_buffers;
+public:
+    static Tracer &Get();
+    static int64_t GetTimestamp();
+    inline bool IsEnabled() const { return m_is_enabled; }
+    inline void SetIsEnabled(const bool is_enabled) { m_is_enabled = is_enabled; }
+    inline uint64_t CreateLaunchId() { return m_next_launch_id++; }
+    // name the calling thread in exported traces
+    void SetThreadName(std::string name);
+    // uses the launch id of the calling thread
+    void AddEvent(const char *name, const int64_t start_ns, const int64_t end_ns);
+    void AddEvent(const char *name, const int64_t start_ns, const int64_t end_ns, const uint64_t launch_id);
+    bool ExportChromeTrace(const char *filename);
+private:
+    Tracer();
+    TraceThreadBuffer &GetThreadBuffer();
+};
+
+// sets the launch id for spans created on this thread
+class TraceLaunchScope
+{
+private:
+    const uint64_t m_prev_launch_id;
+public:
+    TraceLaunchScope(const uint64_t launch_id);
+    ~TraceLaunchScope();
+    static uint64_t GetCurrentLaunchId();
+    TraceLaunchScope(const TraceLaunchScope &) = delete;
+    TraceLaunchScope& operator=(const TraceLaunchScope &) = delete;
+};
+
+// records the time between construction and End() or destruction
+class TraceSpan
+{
+private:
+    const char *m_name;
+    int64_t m_start_ns;
+    bool m_is_active;
+public:
+    TraceSpan(const char *name)
+    : m_name(name), m_start_ns(0), m_is_active(Tracer::Get().IsEnabled())
+    {
+        if (m_is_active) {
+            m_start_ns = Tracer::GetTimestamp();
+        }
+    }
+    ~TraceSpan() { End(); }
+    inline void End() {
+        if (m_is_active) {
+            Tracer::Get().AddEvent(m_name, m_start_ns, Tracer::GetTimestamp());
+            m_is_active = false;
+        }
+    }
+    TraceSpan(const TraceSpan &) = delete;
+    TraceSpan& operator=(const TraceSpan &) = delete;
+};
+
+}
+
+#define TRACE_CONCAT_IMPL(x, y) x##y
+#define TRACE_CONCAT(x, y) TRACE_CONCAT_IMPL(x, y)
+
+// trace the rest of the enclosing scope
+#define TRACE_SCOPE(name) app::TraceSpan TRACE_CONCAT(_trace_span_, __LINE__)(name)
@@ -0,0 +1,145 @@
+#include "trigger_automaton.h"
+
+#include <algorithm>
+#include <deque>
+
+namespace app {
+
+TriggerAutomaton::TriggerAutomaton(const std::vector<std::string> &patterns) {
+    // give every byte used by a pattern its own class, the rest share class 0
+    m_byte_classes.fill(0);
+    m_total_classes = 1;
+    for (auto &pattern: patterns) {
+        for (const char c: pattern) {
+            auto &byte_class = m_byte_classes[uint8_t(c)];
+            if (byte_class == 0) {
+                byte_class = uint16_t(m_total_classes++);
+            }
+        }
+    }
+    const size_t total_classes = m_total_classes;
+    const state_t NONE = ~state_t(0);
+
+    // build the trie with unpremultiplied states, the root is state 0
+    std::vector<state_t> trie(total_classes, NONE);
+    std::vector<std::vector<uint32_t>> outputs(1);
+    for (auto &pattern: patterns) {
+        const uint32_t pattern_index = uint32_t(m_pattern_lengths.size());
+        m_pattern_lengths.push_back(uint32_t(pattern.size()));
+        if (pattern.empty()) {
+            continue;
+        }
+        state_t state = 0;
+        for (const char c: pattern) {
+            const size_t index = size_t(state)*total_classes + m_byte_classes[uint8_t(c)];
+            if (trie[index] == NONE) {
+                trie[index] = state_t(outputs.size());
+                outputs.emplace_back();
+                trie.resize(trie.size() + total_classes, NONE);
+            }
+            state = trie[size_t(state)*total_classes + m_byte_classes[uint8_t(c)]];
+        }
+        outputs[state].push_back(pattern_index);
+    }
+    const size_t total_states = outputs.size();
+
+    // breadth first so a state's failure link is finished before its children need it
+    // missing edges are filled in from the failure state, which turns the trie into a dfa
+    std::vector<state_t> failure(total_states, 0);
+    std::vector<state_t> order;
+    order.reserve(total_states);
+    std::deque<state_t> queue;
+    for (size_t c = 0; c < total_classes; c++) {
+        auto &next = trie[c];
+        if (next == NONE) {
+            next = 0;
+        } else {
+            queue.push_back(next);
+        }
+    }
+    order.push_back(0);
+    while (!queue.empty()) {
+        const state_t state = queue.front();
+        queue.pop_front();
+        order.push_back(state);
+        auto &state_outputs = outputs[state];
+        auto &failure_outputs = outputs[failure[state]];
+        state_outputs.insert(state_outputs.end(), failure_outputs.begin(), failure_outputs.end());
+        for (size_t c = 0; c < total_classes; c++) {
+            auto &next = trie[size_t(state)*total_classes + c];
+            const state_t failure_next = trie[size_t(failure[state])*total_classes + c];
+            if (next == NONE) {
+                next = failure_next;
+            } else {
+                failure[next] = failure_next;
+                queue.push_back(next);
+            }
+        }
+    }
+
+    // renumber so the match states come last, the root has no outputs so it stays at 0
+    std::vector<state_t> renumber(total_states);
+    size_t total_renumbered = 0;
+    for (const bool is_match: { false, true }) {
+        if (is_match) {
+            m_first_match_state = state_t(total_renumbered * total_classes);
+        }
+        for (const state_t state: order) {
+            if (outputs[state].empty() != is_match) {
+                renumber[state] = state_t(total_renumbered++ * total_classes);
+            }
+        }
+    }
+    m_match_begin.push_back(0);
+    m_transitions.resize(total_states * total_classes);
+    for (const state_t state: order) {
+        const size_t row = size_t(renumber[state]);
+        for (size_t c = 0; c < total_classes; c++) {
+            m_transitions[row + c] = renumber[trie[size_t(state)*total_classes + c]];
+        }
+    }
+    // match states were numbered in the same order so their outputs can be appended in it
+    for (const state_t state: order) {
+        if (outputs[state].empty()) {
+            continue;
+        }
+        m_match_patterns.insert(m_match_patterns.end(), outputs[state].begin(), outputs[state].end());
+        m_match_begin.push_back(uint32_t(m_match_patterns.size()));
+    }
+
+    // memchr is fastest if only a few bytes can start a match, otherwise longer patterns can skip with bigrams
+    m_skip_mode = SkipMode::NONE;
+    m_min_pattern_length = 0;
+    for (const uint32_t length: m_pattern_lengths) {
+        if ((length > 0) && ((m_min_pattern_length == 0) || (length < m_min_pattern_length))) {
+            m_min_pattern_length = size_t(length);
+        }
+    }
+    for (size_t c = 0; c < 256; c++) {
+        if (m_transitions[m_byte_classes[c]] != 0) {
+            m_start_bytes.push_back(uint8_t(c));
+        }
+    }
+    if (!m_start_bytes.empty() && (m_start_bytes.size() <= MAX_START_BYTES)) {
+        m_skip_mode = SkipMode::START_BYTES;
+    } else if (m_min_pattern_length >= MIN_BIGRAM_PATTERN_LENGTH) {
+        // a bigram ending at index q of the first window of a pattern allows a shift of window-1-q
+        const size_t window = m_min_pattern_length;
+        const uint8_t max_shift = uint8_t(std::min(window - 1, size_t(UINT8_MAX)));
+        m_bigram_shifts.assign(0x10000, max_shift);
+        for (auto &pattern: patterns) {
+            if (pattern.empty()) {
+                continue;
+            }
+            for (size_t q = 1; q < window; q++) {
+                const uint16_t bigram = uint16_t(uint8_t(pattern[q-1])) | uint16_t(uint16_t(uint8_t(pattern[q])) << 8);
+                auto &shift = m_bigram_shifts[bigram];
+                shift = std::min(shift, uint8_t(std::min(window - 1 - q, size_t(UINT8_MAX))));
+            }
+        }
+        m_skip_mode = SkipMode::BIGRAM;
+    }
+    m_state = 0;
+}
+
+}
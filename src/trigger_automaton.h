@@ -0,0 +1,114 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <array>
+#include <string>
+#include <vector>
+
+namespace app {
+
+// aho-corasick automaton which finds many literal patterns in a single pass over the output
+// the state is kept between calls to Scan() so matches which straddle two chunks are still found
+// the failure links are folded into a dense transition table so every byte is a single load
+class TriggerAutomaton
+{
+public:
+    using state_t = uint32_t;
+    // skipping to the next byte that can start a match is only worth it for a few distinct bytes
+    static constexpr size_t MAX_START_BYTES = 3;
+    // bigram skipping moves at most this far minus one, so it needs patterns at least this long
+    static constexpr size_t MIN_BIGRAM_PATTERN_LENGTH = 4;
+private:
+    // bytes which don't appear in any pattern share a class, which keeps the rows short
+    std::array<uint16_t, 256> m_byte_classes;
+    size_t m_total_classes;
+    // states are premultiplied by the row length so they index the table directly
+    std::vector<state_t> m_transitions;
+    // every state with a match is numbered after this so the scan only needs a compare
+    state_t m_first_match_state;
+    // patterns which end at each match state, including those which are a suffix of it
+    std::vector<uint32_t> m_match_begin;
+    std::vector<uint32_t> m_match_patterns;
+    std::vector<uint32_t> m_pattern_lengths;
+    // how the scan skips over output which can't start a match
+    enum class SkipMode { NONE, START_BYTES, BIGRAM };
+    SkipMode m_skip_mode;
+    // bytes that leave the start state, used to skip ahead with memchr
+    std::vector<uint8_t> m_start_bytes;
+    // distance a window can move without passing the start of a match, indexed by its last two bytes
+    std::vector<uint8_t> m_bigram_shifts;
+    size_t m_min_pattern_length;
+    state_t m_state;
+public:
+    // empty patterns are ignored, an automaton without any patterns never matches
+    TriggerAutomaton(const std::vector<std::string> &patterns={});
+    // forget any partial match, the next Scan() starts from the beginning of the patterns
+    inline void Reset() { m_state = 0; }
+    inline size_t GetTotalPatterns() const { return m_pattern_lengths.size(); }
+    inline size_t GetTotalStates() const { return m_transitions.size() / m_total_classes; }
+    inline uint32_t GetPatternLength(const uint32_t pattern) const { return m_pattern_lengths[pattern]; }
+    // calls on_match(pattern, end) for every match, end is the index in data just past the last byte of it
+    // the match may have started in data from a previous call
+    template <typename F>
+    void Scan(const char *data, const size_t length, F &&on_match) {
+        const state_t *transitions = m_transitions.data();
+        const uint16_t *byte_classes = m_byte_classes.data();
+        const state_t first_match_state = m_first_match_state;
+        state_t state = m_state;
+        size_t i = 0;
+        while (i < length) {
+            // nothing is partially matched so we can skip ahead to where the next match could begin
+            if (state == 0) {
+                if (m_skip_mode == SkipMode::BIGRAM) {
+                    i = SkipBigrams(data, i, length);
+                } else if (m_skip_mode == SkipMode::START_BYTES) {
+                    i = SkipToStartByte(data, i, length);
+                }
+                if (i >= length) {
+                    break;
+                }
+            }
+            state = transitions[state + byte_classes[uint8_t(data[i])]];
+            i++;
+            if (state >= first_match_state) {
+                const size_t row = size_t(state - first_match_state) / m_total_classes;
+                for (uint32_t j = m_match_begin[row]; j < m_match_begin[row+1]; j++) {
+                    on_match(m_match_patterns[j], i);
+                }
+            }
+        }
+        m_state = state;
+    }
+private:
+    inline size_t SkipToStartByte(const char *data, const size_t offset, const size_t length) const {
+        size_t next = length;
+        for (const uint8_t c: m_start_bytes) {
+            const void *match = memchr(data + offset, c, next - offset);
+            if (match != nullptr) {
+                next = size_t((const char *)(match) - data);
+            }
+        }
+        return next;
+    }
+    // wu-manber shift over the last two bytes of a window as long as the shortest pattern
+    // a shift of zero means a pattern could start here, so the dfa takes over from there
+    // the end of the chunk is left to the dfa since the window would run past it
+    inline size_t SkipBigrams(const char *data, size_t offset, const size_t length) const {
+        const size_t window = m_min_pattern_length;
+        const uint8_t *shifts = m_bigram_shifts.data();
+        while ((offset + window) <= length) {
+            const size_t end = offset + window;
+            const uint16_t bigram = uint16_t(uint8_t(data[end-2])) | uint16_t(uint16_t(uint8_t(data[end-1])) << 8);
+            const uint8_t shift = shifts[bigram];
+            if (shift == 0) {
+                break;
+            }
+            offset += shift;
+        }
+        return offset;
+    }
+};
+
+}